@@ -559,3 +559,57 @@ gst_alsa_find_device_name (GstObject * obj, const gchar * device,
 
   return ret;
 }
+
+/* copy up to @frames interleaved frames between @data and the mmapped device
+ * buffer without waiting. Returns the number of frames transferred, which can
+ * be 0 when the device has no room or data, or a negative error */
+snd_pcm_sframes_t
+gst_alsa_mmap_transfer (snd_pcm_t * handle, guint8 * data,
+    snd_pcm_uframes_t frames, gboolean capture)
+{
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t offset, size;
+  snd_pcm_sframes_t avail, committed;
+  guint8 *area;
+  gint err;
+
+  /* a capture device does not start by itself in mmap mode */
+  if (capture && snd_pcm_state (handle) == SND_PCM_STATE_PREPARED) {
+    if ((err = snd_pcm_start (handle)) < 0)
+      return err;
+  }
+
+  if ((avail = snd_pcm_avail_update (handle)) < 0)
+    return avail;
+
+  size = MIN (frames, (snd_pcm_uframes_t) avail);
+  if (size == 0)
+    return 0;
+
+  /* this can return less than size when the area wraps around */
+  if ((err = snd_pcm_mmap_begin (handle, &areas, &offset, &size)) < 0)
+    return err;
+
+  /* interleaved, all channels are in the first area */
+  area = (guint8 *) areas[0].addr + (areas[0].first +
+      offset * areas[0].step) / 8;
+  if (capture)
+    memcpy (data, area, snd_pcm_frames_to_bytes (handle, size));
+  else
+    memcpy (area, data, snd_pcm_frames_to_bytes (handle, size));
+
+  committed = snd_pcm_mmap_commit (handle, offset, size);
+  if (committed >= 0 && (snd_pcm_uframes_t) committed != size)
+    committed = -EPIPE;
+
+  /* committing does not start playback either, start once the device buffer
+   * is full like snd_pcm_writei() does with our start threshold */
+  if (!capture && committed > 0 &&
+      snd_pcm_state (handle) == SND_PCM_STATE_PREPARED &&
+      snd_pcm_avail_update (handle) == 0) {
+    if ((err = snd_pcm_start (handle)) < 0)
+      return err;
+  }
+
+  return committed;
+}
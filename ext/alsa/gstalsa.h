@@ -52,4 +52,9 @@ gchar   * gst_alsa_find_device_name (GstObject        * obj,
                                      snd_pcm_t        * handle,
                                      snd_pcm_stream_t   stream);
 
+snd_pcm_sframes_t gst_alsa_mmap_transfer (snd_pcm_t         * handle,
+                                          guint8            * data,
+                                          snd_pcm_uframes_t   frames,
+                                          gboolean            capture);
+
 #endif /* __GST_ALSA_H__ */
@@ -55,6 +55,7 @@
 
 #define DEFAULT_DEVICE		"default"
 #define DEFAULT_DEVICE_NAME	""
+#define DEFAULT_MMAP		FALSE
 #define SPDIF_PERIOD_SIZE 1536
 #define SPDIF_BUFFER_SIZE 15360
 
@@ -62,7 +63,8 @@ enum
 {
   PROP_0,
   PROP_DEVICE,
-  PROP_DEVICE_NAME
+  PROP_DEVICE_NAME,
+  PROP_MMAP
 };
 
 static void gst_alsasink_init_interfaces (GType type);
@@ -209,6 +211,23 @@ gst_alsasink_class_init (GstAlsaSinkClass * klass)
       g_param_spec_string ("device-name", "Device name",
           "Human-readable name of the sound device", DEFAULT_DEVICE_NAME,
           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAlsaSink:mmap
+   *
+   * Open the device with mmap access and copy the samples from the ring
+   * buffer into the mmapped buffer of the device instead of using
+   * snd_pcm_writei(). This is the same number of copies as with read/write
+   * access, it only changes how the device is accessed. Falls back to
+   * read/write access when the device does not support mmap. Takes effect
+   * the next time the device is configured.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MMAP,
+      g_param_spec_boolean ("mmap", "MMap",
+          "Use mmap access to the device", DEFAULT_MMAP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -228,6 +247,9 @@ gst_alsasink_set_property (GObject * object, guint prop_id,
         sink->device = g_strdup (DEFAULT_DEVICE);
       }
       break;
+    case PROP_MMAP:
+      sink->mmap = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -251,6 +273,9 @@ gst_alsasink_get_property (GObject * object, guint prop_id,
           gst_alsa_find_device_name (GST_OBJECT_CAST (sink),
               sink->device, sink->handle, SND_PCM_STREAM_PLAYBACK));
       break;
+    case PROP_MMAP:
+      g_value_set_boolean (value, sink->mmap);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -265,6 +290,7 @@ gst_alsasink_init (GstAlsaSink * alsasink, GstAlsaSinkClass * g_class)
   alsasink->device = g_strdup (DEFAULT_DEVICE);
   alsasink->handle = NULL;
   alsasink->cached_caps = NULL;
+  alsasink->mmap = DEFAULT_MMAP;
   alsasink->alsa_lock = g_mutex_new ();
 
   g_static_mutex_lock (&output_mutex);
@@ -337,9 +363,16 @@ set_hwparams (GstAlsaSink * alsa)
 retry:
   /* choose all parameters */
   CHECK (snd_pcm_hw_params_any (alsa->handle, params), no_config);
-  /* set the interleaved read/write format */
-  CHECK (snd_pcm_hw_params_set_access (alsa->handle, params, alsa->access),
-      wrong_access);
+  /* set the interleaved read/write or mmap format */
+  if ((err = snd_pcm_hw_params_set_access (alsa->handle, params,
+              alsa->access)) < 0) {
+    if (alsa->access != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+      goto wrong_access;
+    GST_WARNING_OBJECT (alsa, "mmap access not available: %s, using "
+        "read/write access", snd_strerror (err));
+    alsa->access = SND_PCM_ACCESS_RW_INTERLEAVED;
+    goto retry;
+  }
   /* set the sample format */
   if (alsa->iec958) {
     /* Try to use big endian first else fallback to le and swap bytes */
@@ -645,7 +678,8 @@ alsasink_parse_spec (GstAlsaSink * alsa, GstRingBufferSpec * spec)
   alsa->channels = spec->channels;
   alsa->buffer_time = spec->buffer_time;
   alsa->period_time = spec->latency_time;
-  alsa->access = SND_PCM_ACCESS_RW_INTERLEAVED;
+  alsa->access = alsa->mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED :
+      SND_PCM_ACCESS_RW_INTERLEAVED;
 
   return TRUE;
 
@@ -826,16 +860,17 @@ gst_alsasink_write (GstAudioSink * asink, gpointer data, guint length)
   GstAlsaSink *alsa;
   gint err;
   gint cptr;
-  gint16 *ptr = data;
+  guint8 *ptr = data;
 
   alsa = GST_ALSA_SINK (asink);
 
   if (alsa->iec958 && alsa->need_swap) {
+    guint16 *swap = data;
     guint i;
 
     GST_DEBUG_OBJECT (asink, "swapping bytes");
     for (i = 0; i < length / 2; i++) {
-      ptr[i] = GUINT16_SWAP_LE_BE (ptr[i]);
+      swap[i] = GUINT16_SWAP_LE_BE (swap[i]);
     }
   }
 
@@ -850,6 +885,8 @@ gst_alsasink_write (GstAudioSink * asink, gpointer data, guint length)
     err = snd_pcm_wait (alsa->handle, (4 * alsa->period_time / 1000));
     if (err < 0) {
       GST_DEBUG_OBJECT (asink, "wait error, %d", err);
+    } else if (alsa->access == SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+      err = gst_alsa_mmap_transfer (alsa->handle, ptr, cptr, FALSE);
     } else {
       err = snd_pcm_writei (alsa->handle, ptr, cptr);
     }
@@ -57,6 +57,7 @@ struct _GstAlsaSink {
   snd_pcm_hw_params_t   *hwparams;
   snd_pcm_sw_params_t   *swparams;
 
+  gboolean mmap;
   snd_pcm_access_t access;
   snd_pcm_format_t format;
   guint rate;
@@ -53,12 +53,14 @@
 
 #define DEFAULT_PROP_DEVICE		"default"
 #define DEFAULT_PROP_DEVICE_NAME	""
+#define DEFAULT_PROP_MMAP		FALSE
 
 enum
 {
   PROP_0,
   PROP_DEVICE,
   PROP_DEVICE_NAME,
+  PROP_MMAP,
 };
 
 static void gst_alsasrc_init_interfaces (GType type);
@@ -226,6 +228,23 @@ gst_alsasrc_class_init (GstAlsaSrcClass * klass)
       g_param_spec_string ("device-name", "Device name",
           "Human-readable name of the sound device",
           DEFAULT_PROP_DEVICE_NAME, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAlsaSrc:mmap
+   *
+   * Open the device with mmap access and copy the samples from the mmapped
+   * buffer of the device into the ring buffer instead of using
+   * snd_pcm_readi(). This is the same number of copies as with read/write
+   * access, it only changes how the device is accessed. Falls back to
+   * read/write access when the device does not support mmap. Takes effect
+   * the next time the device is configured.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MMAP,
+      g_param_spec_boolean ("mmap", "MMap",
+          "Use mmap access to the device", DEFAULT_PROP_MMAP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -244,6 +263,9 @@ gst_alsasrc_set_property (GObject * object, guint prop_id,
         src->device = g_strdup (DEFAULT_PROP_DEVICE);
       }
       break;
+    case PROP_MMAP:
+      src->mmap = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -267,6 +289,9 @@ gst_alsasrc_get_property (GObject * object, guint prop_id,
           gst_alsa_find_device_name (GST_OBJECT_CAST (src),
               src->device, src->handle, SND_PCM_STREAM_CAPTURE));
       break;
+    case PROP_MMAP:
+      g_value_set_boolean (value, src->mmap);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -280,6 +305,7 @@ gst_alsasrc_init (GstAlsaSrc * alsasrc, GstAlsaSrcClass * g_class)
 
   alsasrc->device = g_strdup (DEFAULT_PROP_DEVICE);
   alsasrc->cached_caps = NULL;
+  alsasrc->mmap = DEFAULT_PROP_MMAP;
 
   alsasrc->alsa_lock = g_mutex_new ();
 }
@@ -338,9 +364,19 @@ set_hwparams (GstAlsaSrc * alsa)
 
   /* choose all parameters */
   CHECK (snd_pcm_hw_params_any (alsa->handle, params), no_config);
-  /* set the interleaved read/write format */
-  CHECK (snd_pcm_hw_params_set_access (alsa->handle, params, alsa->access),
-      wrong_access);
+  /* set the interleaved read/write or mmap format */
+  if ((err = snd_pcm_hw_params_set_access (alsa->handle, params,
+              alsa->access)) < 0) {
+    if (alsa->access != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+      goto wrong_access;
+    GST_WARNING_OBJECT (alsa, "mmap access not available: %s, using "
+        "read/write access", snd_strerror (err));
+    alsa->access = SND_PCM_ACCESS_RW_INTERLEAVED;
+    /* the failed call may have emptied the configuration space */
+    CHECK (snd_pcm_hw_params_any (alsa->handle, params), no_config);
+    CHECK (snd_pcm_hw_params_set_access (alsa->handle, params, alsa->access),
+        wrong_access);
+  }
   /* set the sample format */
   CHECK (snd_pcm_hw_params_set_format (alsa->handle, params, alsa->format),
       no_sample_format);
@@ -585,7 +621,8 @@ alsasrc_parse_spec (GstAlsaSrc * alsa, GstRingBufferSpec * spec)
   alsa->channels = spec->channels;
   alsa->buffer_time = spec->buffer_time;
   alsa->period_time = spec->latency_time;
-  alsa->access = SND_PCM_ACCESS_RW_INTERLEAVED;
+  alsa->access = alsa->mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED :
+      SND_PCM_ACCESS_RW_INTERLEAVED;
 
   return TRUE;
 
@@ -759,7 +796,7 @@ gst_alsasrc_read (GstAudioSrc * asrc, gpointer data, guint length)
   GstAlsaSrc *alsa;
   gint err;
   gint cptr;
-  gint16 *ptr;
+  guint8 *ptr;
 
   alsa = GST_ALSA_SRC (asrc);
 
@@ -768,7 +805,18 @@ gst_alsasrc_read (GstAudioSrc * asrc, gpointer data, guint length)
 
   GST_ALSA_SRC_LOCK (asrc);
   while (cptr > 0) {
-    if ((err = snd_pcm_readi (alsa->handle, ptr, cptr)) < 0) {
+    if (alsa->access == SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+      /* the mmap transfer does not block, wait for data when there is none */
+      err = gst_alsa_mmap_transfer (alsa->handle, ptr, cptr, TRUE);
+      if (err == 0) {
+        err = snd_pcm_wait (alsa->handle, (4 * alsa->period_time / 1000));
+        if (err >= 0)
+          continue;
+      }
+    } else {
+      err = snd_pcm_readi (alsa->handle, ptr, cptr);
+    }
+    if (err < 0) {
       if (err == -EAGAIN) {
         GST_DEBUG_OBJECT (asrc, "Read error: %s", snd_strerror (err));
         continue;
@@ -778,7 +826,7 @@ gst_alsasrc_read (GstAudioSrc * asrc, gpointer data, guint length)
       continue;
     }
 
-    ptr += err * alsa->channels;
+    ptr += snd_pcm_frames_to_bytes (alsa->handle, err);
     cptr -= err;
   }
   GST_ALSA_SRC_UNLOCK (asrc);
@@ -59,6 +59,7 @@ struct _GstAlsaSrc {
 
   GstCaps               *cached_caps;
 
+  gboolean              mmap;
   snd_pcm_access_t      access;
   snd_pcm_format_t      format;
   guint                 rate;
@@ -74,6 +74,14 @@
  * The eos signal can also be used to be informed when the EOS state is reached
  * to avoid polling.
  *
+ * Slow callbacks stall the streaming thread. When the "async-callbacks"
+ * property is set, the new-buffer, new-buffer-list and eos callbacks and
+ * signals are dispatched on a small thread pool shared by all appsinks
+ * instead. The callbacks of one appsink are never run concurrently and keep
+ * their order. The "max-pending-callbacks" property bounds the number of
+ * buffers that were not announced yet and the "callback-drop" property
+ * selects what happens when that bound is reached.
+ *
  * Last reviewed on 2008-12-17 (0.10.22)
  *
  * Since: 0.10.22
@@ -111,8 +119,39 @@ struct _GstAppSinkPrivate
   GstAppSinkCallbacks callbacks;
   gpointer user_data;
   GDestroyNotify notify;
+
+  /* asynchronous dispatch, protected by mutex */
+  gboolean async_callbacks;
+  guint max_pending;
+  GstAppSinkCallbackDrop callback_drop;
+  GQueue *pending;
+  guint n_pending;
+  gboolean dispatching;
+  GThread *dispatch_thread;
 };
 
+/* what to announce */
+typedef enum
+{
+  NOTIFY_EOS = 1,
+  NOTIFY_BUFFER,
+  NOTIFY_BUFFER_LIST
+} GstAppSinkNotify;
+
+/* a notification waiting for a dispatch thread, buffer notifications keep a
+ * ref to the buffer/list they announce so that dropping them can find it in
+ * the queue */
+typedef struct
+{
+  GstAppSinkNotify what;
+  GstMiniObject *obj;
+} GstAppSinkPending;
+
+/* the dispatch threads, shared by all appsinks */
+#define DISPATCH_MAX_THREADS	4
+static GThreadPool *dispatch_pool = NULL;
+G_LOCK_DEFINE_STATIC (dispatch_pool);
+
 GST_DEBUG_CATEGORY_STATIC (app_sink_debug);
 #define GST_CAT_DEFAULT app_sink_debug
 
@@ -128,6 +167,7 @@ enum
   SIGNAL_PULL_PREROLL,
   SIGNAL_PULL_BUFFER,
   SIGNAL_PULL_BUFFER_LIST,
+  SIGNAL_PULL_BUFFERS,
 
   LAST_SIGNAL
 };
@@ -136,6 +176,9 @@ enum
 #define DEFAULT_PROP_EMIT_SIGNALS	FALSE
 #define DEFAULT_PROP_MAX_BUFFERS	0
 #define DEFAULT_PROP_DROP		FALSE
+#define DEFAULT_PROP_ASYNC_CALLBACKS	FALSE
+#define DEFAULT_PROP_MAX_PENDING_CALLBACKS	0
+#define DEFAULT_PROP_CALLBACK_DROP	GST_APP_SINK_CALLBACK_BLOCK
 
 enum
 {
@@ -145,9 +188,31 @@ enum
   PROP_EMIT_SIGNALS,
   PROP_MAX_BUFFERS,
   PROP_DROP,
+  PROP_ASYNC_CALLBACKS,
+  PROP_MAX_PENDING_CALLBACKS,
+  PROP_CALLBACK_DROP,
   PROP_LAST
 };
 
+#define GST_TYPE_APP_SINK_CALLBACK_DROP (callback_drop_get_type ())
+static GType
+callback_drop_get_type (void)
+{
+  static GType callback_drop_type = 0;
+  static const GEnumValue callback_drop[] = {
+    {GST_APP_SINK_CALLBACK_BLOCK, "Block", "block"},
+    {GST_APP_SINK_CALLBACK_DROP_OLD, "Drop oldest", "drop-old"},
+    {GST_APP_SINK_CALLBACK_DROP_NEW, "Drop newest", "drop-new"},
+    {0, NULL, NULL},
+  };
+
+  if (!callback_drop_type) {
+    callback_drop_type =
+        g_enum_register_static ("GstAppSinkCallbackDrop", callback_drop);
+  }
+  return callback_drop_type;
+}
+
 static GstStaticPadTemplate gst_app_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -232,6 +297,40 @@ gst_app_marshal_BUFFER__VOID (GClosure * closure,
   gst_value_take_buffer (return_value, v_return);
 }
 
+static void
+gst_app_marshal_BUFFER_LIST__UINT_UINT64 (GClosure * closure,
+    GValue * return_value,
+    guint n_param_values,
+    const GValue * param_values,
+    gpointer invocation_hint, gpointer marshal_data)
+{
+  typedef GstBufferList *(*GMarshalFunc_BUFFER_LIST__UINT_UINT64) (gpointer
+      data1, guint arg_1, guint64 arg_2, gpointer data2);
+  register GMarshalFunc_BUFFER_LIST__UINT_UINT64 callback;
+  register GCClosure *cc = (GCClosure *) closure;
+  register gpointer data1, data2;
+  GstBufferList *v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 3);
+
+  if (G_CCLOSURE_SWAP_DATA (closure)) {
+    data1 = closure->data;
+    data2 = g_value_peek_pointer (param_values + 0);
+  } else {
+    data1 = g_value_peek_pointer (param_values + 0);
+    data2 = closure->data;
+  }
+  callback =
+      (GMarshalFunc_BUFFER_LIST__UINT_UINT64) (marshal_data ? marshal_data :
+      cc->callback);
+
+  v_return = callback (data1, g_value_get_uint (param_values + 1),
+      g_value_get_uint64 (param_values + 2), data2);
+
+  gst_value_take_mini_object (return_value, GST_MINI_OBJECT_CAST (v_return));
+}
+
 static void
 gst_app_sink_base_init (gpointer g_class)
 {
@@ -285,6 +384,51 @@ gst_app_sink_class_init (GstAppSinkClass * klass)
           "Drop old buffers when the buffer queue is filled", DEFAULT_PROP_DROP,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAppSink:async-callbacks
+   *
+   * Run the new-buffer, new-buffer-list and eos callbacks and signals on a
+   * shared pool of dispatch threads instead of the streaming thread. The
+   * callbacks of one appsink are still called one after the other, in
+   * order. The new-preroll callback is always called from the streaming
+   * thread.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_ASYNC_CALLBACKS,
+      g_param_spec_boolean ("async-callbacks", "Async callbacks",
+          "Dispatch callbacks and signals from a thread pool",
+          DEFAULT_PROP_ASYNC_CALLBACKS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAppSink:max-pending-callbacks
+   *
+   * The maximum number of buffers and buffer lists that were rendered but not
+   * announced yet by an asynchronous callback.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_PENDING_CALLBACKS,
+      g_param_spec_uint ("max-pending-callbacks", "Max pending callbacks",
+          "The maximum number of pending asynchronous callbacks "
+          "(0 = unlimited)", 0, G_MAXUINT,
+          DEFAULT_PROP_MAX_PENDING_CALLBACKS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAppSink:callback-drop
+   *
+   * What to do when "max-pending-callbacks" is reached.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CALLBACK_DROP,
+      g_param_spec_enum ("callback-drop", "Callback drop",
+          "What to do when the pending callbacks limit is reached",
+          GST_TYPE_APP_SINK_CALLBACK_DROP, DEFAULT_PROP_CALLBACK_DROP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstAppSink::eos:
    * @appsink: the appsink element that emited the signal
@@ -437,6 +581,27 @@ gst_app_sink_class_init (GstAppSinkClass * klass)
       G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstAppSinkClass,
           pull_buffer_list), NULL, NULL, gst_app_marshal_BUFFER__VOID,
       GST_TYPE_BUFFER_LIST, 0, G_TYPE_NONE);
+  /**
+   * GstAppSink::pull-buffers:
+   * @appsink: the appsink element to emit this signal on
+   * @max: the maximum number of queued buffers and buffer lists to take,
+   *     0 to take all of them
+   * @timeout: the maximum time to wait for the first buffer, or
+   *     #GST_CLOCK_TIME_NONE to wait forever
+   *
+   * Take all queued buffers and buffer lists, up to @max, in one go. See
+   * gst_app_sink_pull_buffers().
+   *
+   * Returns: a #GstBufferList or NULL when the appsink is stopped or EOS or
+   * when nothing was queued within @timeout.
+   *
+   * Since: 0.10.31
+   */
+  gst_app_sink_signals[SIGNAL_PULL_BUFFERS] =
+      g_signal_new ("pull-buffers", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstAppSinkClass,
+          pull_buffers), NULL, NULL, gst_app_marshal_BUFFER_LIST__UINT_UINT64,
+      GST_TYPE_BUFFER_LIST, 2, G_TYPE_UINT, G_TYPE_UINT64);
 
   basesink_class->unlock = gst_app_sink_unlock_start;
   basesink_class->unlock_stop = gst_app_sink_unlock_stop;
@@ -451,6 +616,7 @@ gst_app_sink_class_init (GstAppSinkClass * klass)
   klass->pull_preroll = gst_app_sink_pull_preroll;
   klass->pull_buffer = gst_app_sink_pull_buffer;
   klass->pull_buffer_list = gst_app_sink_pull_buffer_list;
+  klass->pull_buffers = gst_app_sink_pull_buffers;
 
   g_type_class_add_private (klass, sizeof (GstAppSinkPrivate));
 }
@@ -467,10 +633,14 @@ gst_app_sink_init (GstAppSink * appsink, GstAppSinkClass * klass)
   priv->mutex = g_mutex_new ();
   priv->cond = g_cond_new ();
   priv->queue = g_queue_new ();
+  priv->pending = g_queue_new ();
 
   priv->emit_signals = DEFAULT_PROP_EMIT_SIGNALS;
   priv->max_buffers = DEFAULT_PROP_MAX_BUFFERS;
   priv->drop = DEFAULT_PROP_DROP;
+  priv->async_callbacks = DEFAULT_PROP_ASYNC_CALLBACKS;
+  priv->max_pending = DEFAULT_PROP_MAX_PENDING_CALLBACKS;
+  priv->callback_drop = DEFAULT_PROP_CALLBACK_DROP;
 }
 
 static void
@@ -514,6 +684,7 @@ gst_app_sink_finalize (GObject * obj)
   g_mutex_free (priv->mutex);
   g_cond_free (priv->cond);
   g_queue_free (priv->queue);
+  g_queue_free (priv->pending);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -537,6 +708,24 @@ gst_app_sink_set_property (GObject * object, guint prop_id,
     case PROP_DROP:
       gst_app_sink_set_drop (appsink, g_value_get_boolean (value));
       break;
+    case PROP_ASYNC_CALLBACKS:
+      g_mutex_lock (appsink->priv->mutex);
+      appsink->priv->async_callbacks = g_value_get_boolean (value);
+      g_mutex_unlock (appsink->priv->mutex);
+      break;
+    case PROP_MAX_PENDING_CALLBACKS:
+      g_mutex_lock (appsink->priv->mutex);
+      appsink->priv->max_pending = g_value_get_uint (value);
+      /* the streaming thread might be waiting for a smaller limit */
+      g_cond_broadcast (appsink->priv->cond);
+      g_mutex_unlock (appsink->priv->mutex);
+      break;
+    case PROP_CALLBACK_DROP:
+      g_mutex_lock (appsink->priv->mutex);
+      appsink->priv->callback_drop = g_value_get_enum (value);
+      g_cond_broadcast (appsink->priv->cond);
+      g_mutex_unlock (appsink->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -572,6 +761,21 @@ gst_app_sink_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_DROP:
       g_value_set_boolean (value, gst_app_sink_get_drop (appsink));
       break;
+    case PROP_ASYNC_CALLBACKS:
+      g_mutex_lock (appsink->priv->mutex);
+      g_value_set_boolean (value, appsink->priv->async_callbacks);
+      g_mutex_unlock (appsink->priv->mutex);
+      break;
+    case PROP_MAX_PENDING_CALLBACKS:
+      g_mutex_lock (appsink->priv->mutex);
+      g_value_set_uint (value, appsink->priv->max_pending);
+      g_mutex_unlock (appsink->priv->mutex);
+      break;
+    case PROP_CALLBACK_DROP:
+      g_mutex_lock (appsink->priv->mutex);
+      g_value_set_enum (value, appsink->priv->callback_drop);
+      g_mutex_unlock (appsink->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -608,6 +812,26 @@ gst_app_sink_unlock_stop (GstBaseSink * bsink)
   return TRUE;
 }
 
+static GstAppSinkPending *
+gst_app_sink_pending_new (GstAppSinkNotify what, GstMiniObject * obj)
+{
+  GstAppSinkPending *pending;
+
+  pending = g_slice_new (GstAppSinkPending);
+  pending->what = what;
+  pending->obj = obj ? gst_mini_object_ref (obj) : NULL;
+
+  return pending;
+}
+
+static void
+gst_app_sink_pending_free (GstAppSinkPending * pending)
+{
+  if (pending->obj)
+    gst_mini_object_unref (pending->obj);
+  g_slice_free (GstAppSinkPending, pending);
+}
+
 static void
 gst_app_sink_flush_unlocked (GstAppSink * appsink)
 {
@@ -619,7 +843,11 @@ gst_app_sink_flush_unlocked (GstAppSink * appsink)
   gst_buffer_replace (&priv->preroll, NULL);
   while ((obj = g_queue_pop_head (priv->queue)))
     gst_mini_object_unref (obj);
-  g_cond_signal (priv->cond);
+  /* nothing left to announce */
+  g_queue_foreach (priv->pending, (GFunc) gst_app_sink_pending_free, NULL);
+  g_queue_clear (priv->pending);
+  priv->n_pending = 0;
+  g_cond_broadcast (priv->cond);
 }
 
 static gboolean
@@ -647,9 +875,158 @@ gst_app_sink_stop (GstBaseSink * psink)
   priv->flushing = TRUE;
   priv->started = FALSE;
   gst_app_sink_flush_unlocked (appsink);
+  /* make sure no callback runs anymore when we return, unless we are called
+   * from one */
+  while (priv->dispatching && priv->dispatch_thread != g_thread_self ())
+    g_cond_wait (priv->cond, priv->mutex);
+  g_mutex_unlock (priv->mutex);
+
+  return TRUE;
+}
+
+/* call the callback or emit the signal for @what */
+static void
+gst_app_sink_notify (GstAppSink * appsink, GstAppSinkNotify what,
+    gboolean emit)
+{
+  GstAppSinkPrivate *priv = appsink->priv;
+
+  switch (what) {
+    case NOTIFY_EOS:
+      if (priv->callbacks.eos)
+        priv->callbacks.eos (appsink, priv->user_data);
+      else
+        g_signal_emit (appsink, gst_app_sink_signals[SIGNAL_EOS], 0);
+      break;
+    case NOTIFY_BUFFER:
+      if (priv->callbacks.new_buffer)
+        priv->callbacks.new_buffer (appsink, priv->user_data);
+      else if (emit)
+        g_signal_emit (appsink, gst_app_sink_signals[SIGNAL_NEW_BUFFER], 0);
+      break;
+    case NOTIFY_BUFFER_LIST:
+      if (priv->callbacks.new_buffer_list)
+        priv->callbacks.new_buffer_list (appsink, priv->user_data);
+      break;
+  }
+}
+
+/* runs in a dispatch thread, one per appsink at a time so that the callbacks
+ * keep their order */
+static void
+gst_app_sink_dispatch_func (gpointer data, gpointer user_data)
+{
+  GstAppSink *appsink = GST_APP_SINK_CAST (data);
+  GstAppSinkPrivate *priv = appsink->priv;
+  GstAppSinkPending *pending;
+  GstAppSinkNotify what;
+  gboolean emit;
+
+  g_mutex_lock (priv->mutex);
+  priv->dispatch_thread = g_thread_self ();
+  while ((pending = g_queue_pop_head (priv->pending))) {
+    what = pending->what;
+    if (what != NOTIFY_EOS)
+      priv->n_pending--;
+    gst_app_sink_pending_free (pending);
+    /* wake up the streaming thread when it waits for pending callbacks */
+    g_cond_broadcast (priv->cond);
+    emit = priv->emit_signals;
+    g_mutex_unlock (priv->mutex);
+
+    GST_LOG_OBJECT (appsink, "dispatching %d", what);
+    gst_app_sink_notify (appsink, what, emit);
+
+    g_mutex_lock (priv->mutex);
+  }
+  priv->dispatch_thread = NULL;
+  priv->dispatching = FALSE;
+  g_cond_broadcast (priv->cond);
   g_mutex_unlock (priv->mutex);
 
+  gst_object_unref (appsink);
+}
+
+static GThreadPool *
+gst_app_sink_get_dispatch_pool (void)
+{
+  GError *err = NULL;
+
+  G_LOCK (dispatch_pool);
+  if (dispatch_pool == NULL) {
+    dispatch_pool = g_thread_pool_new (gst_app_sink_dispatch_func, NULL,
+        DISPATCH_MAX_THREADS, FALSE, &err);
+    if (err) {
+      GST_WARNING ("could not create dispatch threads: %s", err->message);
+      g_error_free (err);
+    }
+  }
+  G_UNLOCK (dispatch_pool);
+
+  return dispatch_pool;
+}
+
+/* queue @what about @obj for a dispatch thread, returns FALSE when the caller
+ * should notify itself. Must be called with the mutex held. */
+static gboolean
+gst_app_sink_dispatch_unlocked (GstAppSink * appsink, GstAppSinkNotify what,
+    GstMiniObject * obj)
+{
+  GstAppSinkPrivate *priv = appsink->priv;
+  GThreadPool *pool;
+
+  if (!priv->async_callbacks && !priv->dispatching)
+    return FALSE;
+
+  g_queue_push_tail (priv->pending, gst_app_sink_pending_new (what, obj));
+  if (what != NOTIFY_EOS)
+    priv->n_pending++;
+
+  if (!priv->dispatching) {
+    if (!(pool = gst_app_sink_get_dispatch_pool ()))
+      goto no_pool;
+
+    priv->dispatching = TRUE;
+    g_thread_pool_push (pool, gst_object_ref (appsink), NULL);
+  }
   return TRUE;
+
+  /* ERRORS */
+no_pool:
+  {
+    gst_app_sink_pending_free (g_queue_pop_tail (priv->pending));
+    if (what != NOTIFY_EOS)
+      priv->n_pending--;
+    return FALSE;
+  }
+}
+
+/* drop the oldest notification about a buffer/list and the buffer/list
+ * itself when it was not pulled yet */
+static void
+gst_app_sink_drop_pending_unlocked (GstAppSink * appsink)
+{
+  GstAppSinkPrivate *priv = appsink->priv;
+  GstAppSinkPending *pending;
+  GList *walk, *link;
+
+  for (walk = priv->pending->head; walk; walk = walk->next) {
+    pending = (GstAppSinkPending *) walk->data;
+    if (pending->what != NOTIFY_EOS)
+      break;
+  }
+  if (walk == NULL)
+    return;
+
+  if ((link = g_queue_find (priv->queue, pending->obj))) {
+    GST_DEBUG_OBJECT (appsink, "dropping unannounced buffer/list %p",
+        link->data);
+    gst_mini_object_unref (link->data);
+    g_queue_delete_link (priv->queue, link);
+  }
+  gst_app_sink_pending_free (pending);
+  g_queue_delete_link (priv->pending, walk);
+  priv->n_pending--;
 }
 
 static gboolean
@@ -665,13 +1042,14 @@ gst_app_sink_event (GstBaseSink * sink, GstEvent * event)
       GST_DEBUG_OBJECT (appsink, "receiving EOS");
       priv->is_eos = TRUE;
       g_cond_signal (priv->cond);
+      if (gst_app_sink_dispatch_unlocked (appsink, NOTIFY_EOS, NULL)) {
+        g_mutex_unlock (priv->mutex);
+        break;
+      }
       g_mutex_unlock (priv->mutex);
 
       /* emit EOS now */
-      if (priv->callbacks.eos)
-        priv->callbacks.eos (appsink, priv->user_data);
-      else
-        g_signal_emit (appsink, gst_app_sink_signals[SIGNAL_EOS], 0);
+      gst_app_sink_notify (appsink, NOTIFY_EOS, FALSE);
 
       break;
     case GST_EVENT_FLUSH_START:
@@ -770,21 +1148,46 @@ restart:
         goto flushing;
     }
   }
+  while (priv->async_callbacks && priv->max_pending > 0 &&
+      priv->n_pending >= priv->max_pending) {
+    if (priv->callback_drop == GST_APP_SINK_CALLBACK_DROP_NEW) {
+      GST_DEBUG_OBJECT (appsink, "callbacks behind, dropping new buffer/list");
+      g_mutex_unlock (priv->mutex);
+      return GST_FLOW_OK;
+    } else if (priv->callback_drop == GST_APP_SINK_CALLBACK_DROP_OLD) {
+      gst_app_sink_drop_pending_unlocked (appsink);
+    } else {
+      GST_DEBUG_OBJECT (appsink, "waiting for callbacks, pending %u >= %u",
+          priv->n_pending, priv->max_pending);
+
+      if (priv->unlock) {
+        g_mutex_unlock (priv->mutex);
+        if ((ret = gst_base_sink_wait_preroll (psink)) != GST_FLOW_OK)
+          goto stopping;
+
+        goto restart;
+      }
+
+      /* wait for a dispatch thread to catch up or flush */
+      g_cond_wait (priv->cond, priv->mutex);
+      if (priv->flushing)
+        goto flushing;
+    }
+  }
   /* we need to ref the buffer when pushing it in the queue */
   g_queue_push_tail (priv->queue, gst_mini_object_ref (data));
   g_cond_signal (priv->cond);
   emit = priv->emit_signals;
+  if (gst_app_sink_dispatch_unlocked (appsink,
+          is_list ? NOTIFY_BUFFER_LIST : NOTIFY_BUFFER, data)) {
+    g_mutex_unlock (priv->mutex);
+    return GST_FLOW_OK;
+  }
   g_mutex_unlock (priv->mutex);
 
-  if (is_list) {
-    if (priv->callbacks.new_buffer_list)
-      priv->callbacks.new_buffer_list (appsink, priv->user_data);
-  } else {
-    if (priv->callbacks.new_buffer)
-      priv->callbacks.new_buffer (appsink, priv->user_data);
-    else if (emit)
-      g_signal_emit (appsink, gst_app_sink_signals[SIGNAL_NEW_BUFFER], 0);
-  }
+  gst_app_sink_notify (appsink, is_list ? NOTIFY_BUFFER_LIST : NOTIFY_BUFFER,
+      emit);
+
   return GST_FLOW_OK;
 
 flushing:
@@ -1284,6 +1687,135 @@ gst_app_sink_pull_buffer_list (GstAppSink * appsink)
   return GST_BUFFER_LIST_CAST (gst_app_sink_pull_object (appsink));
 }
 
+/* append the groups of @list to @it, takes ownership of @list */
+static void
+gst_app_sink_append_list (GstBufferListIterator * it, GstBufferList * list)
+{
+  GstBufferListIterator *src;
+  GstBuffer *buf;
+
+  src = gst_buffer_list_iterate (list);
+  while (gst_buffer_list_iterator_next_group (src)) {
+    gst_buffer_list_iterator_add_group (it);
+    while ((buf = gst_buffer_list_iterator_next (src)))
+      gst_buffer_list_iterator_add (it, gst_buffer_ref (buf));
+  }
+  gst_buffer_list_iterator_free (src);
+  gst_buffer_list_unref (list);
+}
+
+/**
+ * gst_app_sink_pull_buffers:
+ * @appsink: a #GstAppSink
+ * @max: the maximum number of queued buffers and buffer lists to take, 0 to
+ *     take all of them
+ * @timeout: the maximum time to wait for the first buffer, or
+ *     #GST_CLOCK_TIME_NONE to wait forever
+ *
+ * This function blocks until a buffer, buffer list or EOS becomes available,
+ * the appsink element is set to the READY/NULL state or @timeout expires.
+ * It then takes all queued buffers and buffer lists, up to @max, with one
+ * lock acquisition and wakes up the streaming thread only once.
+ *
+ * Every queued buffer becomes a group of its own in the returned list, the
+ * groups of a rendered buffer list are kept as they were.
+ *
+ * If an EOS event was received before any buffers, this function returns
+ * %NULL. Use gst_app_sink_is_eos () to check for the EOS condition.
+ *
+ * Returns: a #GstBufferList or NULL when the appsink is stopped or EOS or
+ * when nothing was queued within @timeout.
+ *
+ * Since: 0.10.31
+ */
+GstBufferList *
+gst_app_sink_pull_buffers (GstAppSink * appsink, guint max,
+    GstClockTime timeout)
+{
+  GstAppSinkPrivate *priv;
+  GstBufferList *list;
+  GstBufferListIterator *it;
+  GstMiniObject *obj;
+  GQueue taken = G_QUEUE_INIT;
+  GTimeVal deadline;
+
+  g_return_val_if_fail (GST_IS_APP_SINK (appsink), NULL);
+
+  priv = appsink->priv;
+
+  if (GST_CLOCK_TIME_IS_VALID (timeout)) {
+    g_get_current_time (&deadline);
+    g_time_val_add (&deadline, timeout / GST_USECOND);
+  }
+
+  g_mutex_lock (priv->mutex);
+
+  while (TRUE) {
+    GST_DEBUG_OBJECT (appsink, "trying to grab buffers/lists");
+    if (!priv->started)
+      goto not_started;
+
+    if (!g_queue_is_empty (priv->queue))
+      break;
+
+    if (priv->is_eos)
+      goto eos;
+
+    /* nothing to return, wait */
+    GST_DEBUG_OBJECT (appsink, "waiting for a buffer/list");
+    if (!GST_CLOCK_TIME_IS_VALID (timeout)) {
+      g_cond_wait (priv->cond, priv->mutex);
+    } else if (!g_cond_timed_wait (priv->cond, priv->mutex, &deadline)) {
+      if (g_queue_is_empty (priv->queue))
+        goto timed_out;
+    }
+  }
+  while ((max == 0 || taken.length < max) &&
+      (obj = g_queue_pop_head (priv->queue)))
+    g_queue_push_tail (&taken, obj);
+  GST_DEBUG_OBJECT (appsink, "we have %u buffers/lists", taken.length);
+  g_cond_signal (priv->cond);
+  g_mutex_unlock (priv->mutex);
+
+  /* a single rendered list can be returned as is */
+  if (taken.length == 1 && GST_IS_BUFFER_LIST (taken.head->data))
+    return GST_BUFFER_LIST_CAST (g_queue_pop_head (&taken));
+
+  list = gst_buffer_list_new ();
+  it = gst_buffer_list_iterate (list);
+  while ((obj = g_queue_pop_head (&taken))) {
+    if (GST_IS_BUFFER_LIST (obj)) {
+      gst_app_sink_append_list (it, GST_BUFFER_LIST_CAST (obj));
+    } else {
+      gst_buffer_list_iterator_add_group (it);
+      gst_buffer_list_iterator_add (it, GST_BUFFER_CAST (obj));
+    }
+  }
+  gst_buffer_list_iterator_free (it);
+
+  return list;
+
+  /* special conditions */
+eos:
+  {
+    GST_DEBUG_OBJECT (appsink, "we are EOS, return NULL");
+    g_mutex_unlock (priv->mutex);
+    return NULL;
+  }
+not_started:
+  {
+    GST_DEBUG_OBJECT (appsink, "we are stopped, return NULL");
+    g_mutex_unlock (priv->mutex);
+    return NULL;
+  }
+timed_out:
+  {
+    GST_DEBUG_OBJECT (appsink, "timeout expired, return NULL");
+    g_mutex_unlock (priv->mutex);
+    return NULL;
+  }
+}
+
 /**
  * gst_app_sink_set_callbacks:
  * @appsink: a #GstAppSink
@@ -46,19 +46,22 @@ typedef struct _GstAppSinkPrivate GstAppSinkPrivate;
 /**
  * GstAppSinkCallbacks:
  * @eos: Called when the end-of-stream has been reached. This callback
- *       is called from the steaming thread.
+ *       is called from the steaming thread, or from a dispatch thread when
+ *       the "async-callbacks" property is set.
  * @new_preroll: Called when a new preroll buffer is available. 
  *       This callback is called from the steaming thread.
  *       The new preroll buffer can be retrieved with
  *       gst_app_sink_pull_preroll() either from this callback
  *       or from any other thread.
  * @new_buffer: Called when a new buffer is available. 
- *       This callback is called from the steaming thread.
+ *       This callback is called from the steaming thread, or from a
+ *       dispatch thread when the "async-callbacks" property is set.
  *       The new buffer can be retrieved with
  *       gst_app_sink_pull_buffer() either from this callback
  *       or from any other thread.
  * @new_buffer_list: Called when a new bufferlist is available. 
- *       This callback is called from the steaming thread.
+ *       This callback is called from the steaming thread, or from a
+ *       dispatch thread when the "async-callbacks" property is set.
  *       The new bufferlist can be retrieved with
  *       gst_app_sink_pull_buffer_list() either from this callback
  *       or from any other thread.
@@ -78,6 +81,26 @@ typedef struct {
   gpointer     _gst_reserved[GST_PADDING - 1];
 } GstAppSinkCallbacks;
 
+/**
+ * GstAppSinkCallbackDrop:
+ * @GST_APP_SINK_CALLBACK_BLOCK: Block the streaming thread until the
+ *    callbacks caught up.
+ * @GST_APP_SINK_CALLBACK_DROP_OLD: Drop the oldest buffer that was not
+ *    announced yet, together with its callback.
+ * @GST_APP_SINK_CALLBACK_DROP_NEW: Drop the new buffer.
+ *
+ * What to do when asynchronous callbacks fall behind and the
+ * "max-pending-callbacks" limit is reached.
+ *
+ * Since: 0.10.31
+ */
+typedef enum
+{
+  GST_APP_SINK_CALLBACK_BLOCK,
+  GST_APP_SINK_CALLBACK_DROP_OLD,
+  GST_APP_SINK_CALLBACK_DROP_NEW
+} GstAppSinkCallbackDrop;
+
 struct _GstAppSink
 {
   GstBaseSink basesink;
@@ -105,9 +128,11 @@ struct _GstAppSinkClass
   /* ABI added */
   GstBufferList * (*new_buffer_list)   (GstAppSink *sink);
   GstBufferList * (*pull_buffer_list)  (GstAppSink *sink);
+  GstBufferList * (*pull_buffers)      (GstAppSink *sink, guint max,
+                                        GstClockTime timeout);
 
   /*< private >*/
-  gpointer     _gst_reserved[GST_PADDING - 2];
+  gpointer     _gst_reserved[GST_PADDING - 3];
 };
 
 GType gst_app_sink_get_type(void);
@@ -129,6 +154,8 @@ gboolean        gst_app_sink_get_drop         (GstAppSink *appsink);
 GstBuffer *     gst_app_sink_pull_preroll     (GstAppSink *appsink);
 GstBuffer *     gst_app_sink_pull_buffer      (GstAppSink *appsink);
 GstBufferList * gst_app_sink_pull_buffer_list (GstAppSink *appsink);
+GstBufferList * gst_app_sink_pull_buffers     (GstAppSink *appsink, guint max,
+                                               GstClockTime timeout);
 
 void            gst_app_sink_set_callbacks    (GstAppSink * appsink,
                                                GstAppSinkCallbacks *callbacks,
@@ -100,6 +100,12 @@
  * this call, no more buffers can be pushed into appsrc until a flushing seek
  * happened or the state of the appsrc has gone through READY.
  *
+ * In random-access mode, demuxers often read the same ranges more than once,
+ * for example when they probe the end of a file and then go back to the
+ * start. Setting the "cache-size" property makes appsrc keep the data it
+ * handed out in a cache and serve later reads of cached ranges itself,
+ * without emitting seek-data and need-data.
+ *
  * Last reviewed on 2008-12-17 (0.10.10)
  *
  * Since: 0.10.22
@@ -113,15 +119,34 @@
 #include <gst/base/gstbasesrc.h>
 
 #include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include <glib/gstdio.h>
 
 #include "gstapp-marshal.h"
 #include "gstappsrc.h"
 
+typedef struct _GstAppSrcCache GstAppSrcCache;
+
+/* an item in the lock-free ring with the flush epoch it was pushed in */
+typedef struct
+{
+  gpointer item;
+  guint epoch;
+} GstAppSrcRingEntry;
+
 struct _GstAppSrcPrivate
 {
   GCond *cond;
   GMutex *mutex;
   GQueue *queue;
+  /* buffers of a dequeued buffer list, only used by the streaming thread */
+  GQueue *pending;
 
   GstCaps *caps;
   gint64 size;
@@ -145,8 +170,65 @@ struct _GstAppSrcPrivate
   GstAppSrcCallbacks callbacks;
   gpointer user_data;
   GDestroyNotify notify;
+
+  /* single producer, single consumer ring used instead of queue when
+   * lock-free is enabled. head and tail are free running counters, only the
+   * consumer moves head and only the producer moves tail. */
+  gboolean lock_free;
+  GstAppSrcRingEntry *ring;
+  volatile gint ring_head;
+  volatile gint ring_tail;
+  /* bytes that went in and out of the ring, modulo 2^32 */
+  volatile gint ring_in_bytes;
+  volatile gint ring_out_bytes;
+  /* set while the producer or consumer waits on cond */
+  volatile gint producer_waiting;
+  volatile gint consumer_waiting;
+  /* incremented on every flush, entries pushed before it are stale */
+  volatile gint ring_epoch;
+
+  /* byte range cache for random-access mode, protected by mutex */
+  guint64 cache_size;
+  guint cache_block_size;
+  gboolean cache_temp_file;
+  GstAppSrcCache *cache;
+};
+
+/* one block of the range cache, only the bytes between start and end are
+ * valid */
+typedef struct
+{
+  guint64 block;
+  guint start;
+  guint end;
+  guint8 *data;
+  /* in the lru queue */
+  GList link;
+} GstAppSrcCacheSlot;
+
+struct _GstAppSrcCache
+{
+  guint block_size;
+  /* the slots are allocated when needed, up to n_slots */
+  guint n_slots;
+  guint n_used;
+  /* block number -> slot */
+  GHashTable *index;
+  /* used slots, least recently used first */
+  GQueue lru;
+
+  /* the mapped temp file or NULL when the slots are in memory */
+  guint8 *map;
+  gsize map_size;
+
+  guint64 hits;
+  guint64 misses;
 };
 
+/* number of slots in the lock-free ring, must be a power of 2 */
+#define RING_SIZE 1024
+#define RING_MASK (RING_SIZE - 1)
+
 GST_DEBUG_CATEGORY_STATIC (app_src_debug);
 #define GST_CAT_DEFAULT app_src_debug
 
@@ -160,6 +242,7 @@ enum
   /* actions */
   SIGNAL_PUSH_BUFFER,
   SIGNAL_END_OF_STREAM,
+  SIGNAL_PUSH_BUFFER_LIST,
 
   LAST_SIGNAL
 };
@@ -174,6 +257,10 @@ enum
 #define DEFAULT_PROP_MAX_LATENCY   -1
 #define DEFAULT_PROP_EMIT_SIGNALS  TRUE
 #define DEFAULT_PROP_MIN_PERCENT   0
+#define DEFAULT_PROP_LOCK_FREE     FALSE
+#define DEFAULT_PROP_CACHE_SIZE    0
+#define DEFAULT_PROP_CACHE_BLOCK_SIZE (64 * 1024)
+#define DEFAULT_PROP_CACHE_TEMP_FILE FALSE
 
 enum
 {
@@ -189,6 +276,10 @@ enum
   PROP_MAX_LATENCY,
   PROP_EMIT_SIGNALS,
   PROP_MIN_PERCENT,
+  PROP_LOCK_FREE,
+  PROP_CACHE_SIZE,
+  PROP_CACHE_BLOCK_SIZE,
+  PROP_CACHE_TEMP_FILE,
   PROP_LAST
 };
 
@@ -245,6 +336,8 @@ static gboolean gst_app_src_query (GstBaseSrc * src, GstQuery * query);
 
 static GstFlowReturn gst_app_src_push_buffer_action (GstAppSrc * appsrc,
     GstBuffer * buffer);
+static GstFlowReturn gst_app_src_push_buffer_list_action (GstAppSrc * appsrc,
+    GstBufferList * list);
 
 static guint gst_app_src_signals[LAST_SIGNAL] = { 0 };
 
@@ -418,6 +511,71 @@ gst_app_src_class_init (GstAppSrcClass * klass)
           0, 100, DEFAULT_PROP_MIN_PERCENT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAppSrc::lock-free
+   *
+   * Queue pushed buffers in a lock-free ring instead of a locked queue. The
+   * mutex is then only taken when the streaming thread has to wait for data,
+   * when push-buffer has to wait for free space and when flushing.
+   *
+   * Only one thread may push buffers at a time in this mode. The ring holds
+   * at most 1024 buffers, when it is full push-buffer waits for free space
+   * regardless of the block property. This property can only be changed
+   * while appsrc is stopped and nothing is queued.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_LOCK_FREE,
+      g_param_spec_boolean ("lock-free", "Lock Free",
+          "Queue buffers in a lock-free ring, for a single pushing thread",
+          DEFAULT_PROP_LOCK_FREE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAppSrc::cache-size
+   *
+   * The size in bytes of a cache for the data of random-access streams.
+   * Reads of ranges that are completely in the cache are served without
+   * emitting seek-data and need-data. The cache holds blocks of
+   * "cache-block-size" bytes, the least recently used block is evicted when
+   * it is full. Changes take effect the next time appsrc is started.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_SIZE,
+      g_param_spec_uint64 ("cache-size", "Cache Size",
+          "The size of the range cache for random-access streams "
+          "(0 = disabled)", 0, G_MAXUINT64, DEFAULT_PROP_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAppSrc::cache-block-size
+   *
+   * The size in bytes of the blocks the range cache is made of, this is also
+   * the granularity of the eviction.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_BLOCK_SIZE,
+      g_param_spec_uint ("cache-block-size", "Cache Block Size",
+          "The size of the blocks of the range cache", 512, G_MAXINT,
+          DEFAULT_PROP_CACHE_BLOCK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAppSrc::cache-temp-file
+   *
+   * Keep the range cache in a memory mapped temporary file instead of
+   * memory, so that the kernel can page it out. The cache falls back to
+   * memory when no temporary file can be mapped.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_TEMP_FILE,
+      g_param_spec_boolean ("cache-temp-file", "Cache Temp File",
+          "Keep the range cache in a memory mapped temporary file",
+          DEFAULT_PROP_CACHE_TEMP_FILE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstAppSrc::need-data:
    * @appsrc: the appsrc element that emited the signal
@@ -497,6 +655,27 @@ gst_app_src_class_init (GstAppSrcClass * klass)
           end_of_stream), NULL, NULL, __gst_app_marshal_ENUM__VOID,
       GST_TYPE_FLOW_RETURN, 0, G_TYPE_NONE);
 
+   /**
+    * GstAppSrc::push-buffer-list:
+    * @appsrc: the appsrc
+    * @list: a buffer list to push
+    *
+    * Adds a buffer list to the queue of buffers that the appsrc element will
+    * push to its source pad. The list is queued as one unit. This function
+    * does not take ownership of the list so the list needs to be unreffed
+    * after calling this function.
+    *
+    * When the block property is TRUE, this function can block until free space
+    * becomes available in the queue.
+    *
+    * Since: 0.10.31
+    */
+  gst_app_src_signals[SIGNAL_PUSH_BUFFER_LIST] =
+      g_signal_new ("push-buffer-list", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstAppSrcClass,
+          push_buffer_list), NULL, NULL, __gst_app_marshal_ENUM__OBJECT,
+      GST_TYPE_FLOW_RETURN, 1, GST_TYPE_BUFFER_LIST);
+
   basesrc_class->create = gst_app_src_create;
   basesrc_class->start = gst_app_src_start;
   basesrc_class->stop = gst_app_src_stop;
@@ -511,6 +690,7 @@ gst_app_src_class_init (GstAppSrcClass * klass)
 
   klass->push_buffer = gst_app_src_push_buffer_action;
   klass->end_of_stream = gst_app_src_end_of_stream;
+  klass->push_buffer_list = gst_app_src_push_buffer_list_action;
 
   g_type_class_add_private (klass, sizeof (GstAppSrcPrivate));
 }
@@ -526,6 +706,7 @@ gst_app_src_init (GstAppSrc * appsrc, GstAppSrcClass * klass)
   priv->mutex = g_mutex_new ();
   priv->cond = g_cond_new ();
   priv->queue = g_queue_new ();
+  priv->pending = g_queue_new ();
 
   priv->size = DEFAULT_PROP_SIZE;
   priv->stream_type = DEFAULT_PROP_STREAM_TYPE;
@@ -536,19 +717,383 @@ gst_app_src_init (GstAppSrc * appsrc, GstAppSrcClass * klass)
   priv->max_latency = DEFAULT_PROP_MAX_LATENCY;
   priv->emit_signals = DEFAULT_PROP_EMIT_SIGNALS;
   priv->min_percent = DEFAULT_PROP_MIN_PERCENT;
+  priv->lock_free = DEFAULT_PROP_LOCK_FREE;
+  priv->cache_size = DEFAULT_PROP_CACHE_SIZE;
+  priv->cache_block_size = DEFAULT_PROP_CACHE_BLOCK_SIZE;
+  priv->cache_temp_file = DEFAULT_PROP_CACHE_TEMP_FILE;
 
   gst_base_src_set_live (GST_BASE_SRC (appsrc), DEFAULT_PROP_IS_LIVE);
 }
 
+static GstBufferListItem
+gst_app_src_add_size (GstBuffer ** buffer, guint group, guint idx,
+    gpointer user_data)
+{
+  *(guint *) user_data += GST_BUFFER_SIZE (*buffer);
+
+  return GST_BUFFER_LIST_CONTINUE;
+}
+
+/* size in bytes of a queued buffer or buffer list */
+static guint
+gst_app_src_item_size (gpointer item)
+{
+  guint size = 0;
+
+  if (GST_IS_BUFFER_LIST (item))
+    gst_buffer_list_foreach (GST_BUFFER_LIST_CAST (item),
+        gst_app_src_add_size, &size);
+  else
+    size = GST_BUFFER_SIZE (item);
+
+  return size;
+}
+
+static GstBufferListItem
+gst_app_src_add_pending (GstBuffer ** buffer, guint group, guint idx,
+    gpointer user_data)
+{
+  g_queue_push_tail ((GQueue *) user_data, gst_buffer_ref (*buffer));
+
+  return GST_BUFFER_LIST_CONTINUE;
+}
+
+/* get the next buffer out of a dequeued item. The buffers of a buffer list
+ * are moved to the pending queue and the first one is returned, NULL for an
+ * empty list. Takes ownership of @item. */
+static GstBuffer *
+gst_app_src_unpack_item (GstAppSrcPrivate * priv, gpointer item)
+{
+  GstBufferList *list;
+
+  if (!GST_IS_BUFFER_LIST (item))
+    return GST_BUFFER_CAST (item);
+
+  list = GST_BUFFER_LIST_CAST (item);
+  gst_buffer_list_foreach (list, gst_app_src_add_pending, priv->pending);
+  gst_buffer_list_unref (list);
+
+  return g_queue_pop_head (priv->pending);
+}
+
+/* called from the producer only, @epoch is the flush epoch the producer saw
+ * before it checked for flushing. Returns FALSE when the ring is full */
+static gboolean
+gst_app_src_ring_push (GstAppSrcPrivate * priv, gpointer item, guint epoch)
+{
+  guint tail = priv->ring_tail;
+
+  if (tail - (guint) g_atomic_int_get (&priv->ring_head) >= RING_SIZE)
+    return FALSE;
+
+  priv->ring[tail & RING_MASK].item = item;
+  priv->ring[tail & RING_MASK].epoch = epoch;
+  g_atomic_int_add (&priv->ring_in_bytes, gst_app_src_item_size (item));
+  /* full barrier, makes the slot visible before the new tail */
+  g_atomic_int_inc (&priv->ring_tail);
+
+  return TRUE;
+}
+
+/* called from the consumer only. The producer checks flushing before it
+ * pushes without the mutex, so a push that started before a flush can still
+ * land in the ring afterwards. Such items carry an old epoch and are dropped
+ * here. Returns NULL when the ring is empty */
+static gpointer
+gst_app_src_ring_pop (GstAppSrcPrivate * priv)
+{
+  GstAppSrcRingEntry *entry;
+  gpointer item;
+  guint head;
+
+  while (TRUE) {
+    head = priv->ring_head;
+    if (head == (guint) g_atomic_int_get (&priv->ring_tail))
+      return NULL;
+
+    entry = &priv->ring[head & RING_MASK];
+    item = g_atomic_pointer_get (&entry->item);
+    g_atomic_int_add (&priv->ring_out_bytes, gst_app_src_item_size (item));
+
+    if (G_LIKELY (entry->epoch == (guint) g_atomic_int_get (&priv->ring_epoch))) {
+      /* full barrier, the producer can only reuse the slot after this */
+      g_atomic_int_inc (&priv->ring_head);
+      return item;
+    }
+
+    g_atomic_int_inc (&priv->ring_head);
+    GST_DEBUG ("dropping item %p pushed before a flush", item);
+    gst_mini_object_unref (item);
+  }
+}
+
+static guint
+gst_app_src_ring_bytes (GstAppSrcPrivate * priv)
+{
+  return (guint) g_atomic_int_get (&priv->ring_in_bytes) -
+      (guint) g_atomic_int_get (&priv->ring_out_bytes);
+}
+
+static gboolean
+gst_app_src_ring_is_empty (GstAppSrcPrivate * priv)
+{
+  return g_atomic_int_get (&priv->ring_head) ==
+      g_atomic_int_get (&priv->ring_tail);
+}
+
+/* wake up the other side when it is waiting on cond. The flag is read after
+ * a full barrier on the ring, so a waiter that checked the ring before our
+ * change is already waiting and will get the broadcast. */
 static void
-gst_app_src_flush_queued (GstAppSrc * src)
+gst_app_src_ring_wakeup (GstAppSrcPrivate * priv, volatile gint * waiting)
+{
+  if (g_atomic_int_get (waiting)) {
+    g_mutex_lock (priv->mutex);
+    g_cond_broadcast (priv->cond);
+    g_mutex_unlock (priv->mutex);
+  }
+}
+
+static guint64
+gst_app_src_get_queued_bytes (GstAppSrcPrivate * priv)
 {
+  if (priv->lock_free)
+    return gst_app_src_ring_bytes (priv);
+  return priv->queued_bytes;
+}
+
+static gboolean
+gst_app_src_queue_is_empty (GstAppSrcPrivate * priv)
+{
+  if (priv->lock_free)
+    return gst_app_src_ring_is_empty (priv);
+  return g_queue_is_empty (priv->queue);
+}
+
+/* the range cache */
+static guint
+gst_app_src_cache_hash (gconstpointer key)
+{
+  guint64 block = *(const guint64 *) key;
+
+  return (guint) (block ^ (block >> 32));
+}
+
+static gboolean
+gst_app_src_cache_equal (gconstpointer a, gconstpointer b)
+{
+  return *(const guint64 *) a == *(const guint64 *) b;
+}
+
+/* map an unlinked temp file of @size bytes, returns NULL on failure */
+static guint8 *
+gst_app_src_cache_map_temp_file (gsize size)
+{
+#if defined (HAVE_SYS_MMAN_H) && defined (HAVE_UNISTD_H)
+  GError *err = NULL;
+  gchar *name = NULL;
+  gpointer map;
+  gint fd;
+
+  fd = g_file_open_tmp ("appsrc-cache-XXXXXX", &name, &err);
+  if (fd < 0) {
+    GST_WARNING ("could not create temp file: %s", err->message);
+    g_error_free (err);
+    return NULL;
+  }
+  /* the mapping keeps the data, the name is not needed anymore */
+  g_unlink (name);
+  g_free (name);
+
+  map = MAP_FAILED;
+  if (ftruncate (fd, size) == 0)
+    map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (map == MAP_FAILED) {
+    GST_WARNING ("could not map temp file: %s", g_strerror (errno));
+    return NULL;
+  }
+  return map;
+#else
+  GST_WARNING ("no mmap support");
+  return NULL;
+#endif
+}
+
+static GstAppSrcCache *
+gst_app_src_cache_new (guint64 size, guint block_size, gboolean temp_file)
+{
+  GstAppSrcCache *cache;
+
+  cache = g_new0 (GstAppSrcCache, 1);
+  cache->block_size = block_size;
+  cache->n_slots = MAX (1, MIN (size / block_size, G_MAXINT));
+  cache->index = g_hash_table_new (gst_app_src_cache_hash,
+      gst_app_src_cache_equal);
+  g_queue_init (&cache->lru);
+
+  if (temp_file && (guint64) cache->n_slots * block_size <= G_MAXSIZE) {
+    cache->map_size = (gsize) cache->n_slots * block_size;
+    cache->map = gst_app_src_cache_map_temp_file (cache->map_size);
+  }
+
+  return cache;
+}
+
+static void
+gst_app_src_cache_free (GstAppSrcCache * cache)
+{
+  GList *walk, *next;
+
+  g_hash_table_destroy (cache->index);
+  /* all slots are in the lru queue, the links are part of the slots */
+  for (walk = cache->lru.head; walk; walk = next) {
+    GstAppSrcCacheSlot *slot = walk->data;
+
+    next = walk->next;
+    if (!cache->map)
+      g_free (slot->data);
+    g_slice_free (GstAppSrcCacheSlot, slot);
+  }
+#ifdef HAVE_SYS_MMAN_H
+  if (cache->map)
+    munmap (cache->map, cache->map_size);
+#endif
+  g_free (cache);
+}
+
+/* get the slot for @block, taking a free or the least recently used slot
+ * when @block is not cached and @create is set */
+static GstAppSrcCacheSlot *
+gst_app_src_cache_get_slot (GstAppSrcCache * cache, guint64 block,
+    gboolean create)
+{
+  GstAppSrcCacheSlot *slot;
+
+  if ((slot = g_hash_table_lookup (cache->index, &block))) {
+    /* move to the most recently used end */
+    g_queue_unlink (&cache->lru, &slot->link);
+    g_queue_push_tail_link (&cache->lru, &slot->link);
+    return slot;
+  }
+  if (!create)
+    return NULL;
+
+  if (cache->n_used < cache->n_slots) {
+    slot = g_slice_new0 (GstAppSrcCacheSlot);
+    slot->link.data = slot;
+    if (cache->map)
+      slot->data = cache->map + (gsize) cache->n_used * cache->block_size;
+    else
+      slot->data = g_malloc (cache->block_size);
+    cache->n_used++;
+  } else {
+    slot = g_queue_peek_head (&cache->lru);
+    g_queue_unlink (&cache->lru, &slot->link);
+    g_hash_table_remove (cache->index, &slot->block);
+  }
+  slot->block = block;
+  slot->start = slot->end = 0;
+  g_hash_table_insert (cache->index, &slot->block, slot);
+  g_queue_push_tail_link (&cache->lru, &slot->link);
+
+  return slot;
+}
+
+/* remember @size bytes of @data at @offset */
+static void
+gst_app_src_cache_store (GstAppSrcCache * cache, guint64 offset,
+    const guint8 * data, guint size)
+{
+  GstAppSrcCacheSlot *slot;
+  guint start, end;
+
+  while (size > 0) {
+    start = offset % cache->block_size;
+    end = MIN (cache->block_size, start + size);
+
+    slot = gst_app_src_cache_get_slot (cache, offset / cache->block_size,
+        TRUE);
+    if (slot->start == slot->end || (start <= slot->end && end >= slot->start)) {
+      /* empty, overlapping or adjacent, extend the valid range */
+      if (slot->start == slot->end) {
+        slot->start = start;
+        slot->end = end;
+      } else {
+        slot->start = MIN (slot->start, start);
+        slot->end = MAX (slot->end, end);
+      }
+      memcpy (slot->data + start, data, end - start);
+    } else if (end - start > slot->end - slot->start) {
+      /* disjoint, keep the larger range */
+      slot->start = start;
+      slot->end = end;
+      memcpy (slot->data + start, data, end - start);
+    }
+    offset += end - start;
+    data += end - start;
+    size -= end - start;
+  }
+}
+
+/* a buffer with @size bytes at @offset when they are all cached, NULL
+ * otherwise */
+static GstBuffer *
+gst_app_src_cache_read (GstAppSrcCache * cache, guint64 offset, guint size)
+{
+  GstAppSrcCacheSlot *slot;
   GstBuffer *buf;
+  guint64 pos, block;
+  guint8 *data;
+  guint start, end, left;
+
+  /* check first, so that a miss does not change the lru order */
+  for (pos = offset, left = size; left > 0; pos += end - start,
+      left -= end - start) {
+    start = pos % cache->block_size;
+    end = MIN (cache->block_size, start + left);
+    block = pos / cache->block_size;
+    slot = g_hash_table_lookup (cache->index, &block);
+    if (!slot || slot->start > start || slot->end < end) {
+      cache->misses++;
+      return NULL;
+    }
+  }
+  cache->hits++;
+
+  buf = gst_buffer_new_and_alloc (size);
+  data = GST_BUFFER_DATA (buf);
+  for (pos = offset, left = size; left > 0; pos += end - start,
+      left -= end - start) {
+    start = pos % cache->block_size;
+    end = MIN (cache->block_size, start + left);
+    slot = gst_app_src_cache_get_slot (cache, pos / cache->block_size, FALSE);
+    memcpy (data, slot->data + start, end - start);
+    data += end - start;
+  }
+  return buf;
+}
+
+static void
+gst_app_src_flush_queued (GstAppSrc * src)
+{
+  gpointer item;
   GstAppSrcPrivate *priv = src->priv;
 
-  while ((buf = g_queue_pop_head (priv->queue)))
-    gst_buffer_unref (buf);
+  while ((item = g_queue_pop_head (priv->queue)))
+    gst_mini_object_unref (item);
   priv->queued_bytes = 0;
+
+  if (priv->ring) {
+    /* pushes that are still in progress end up in the old epoch */
+    g_atomic_int_inc (&priv->ring_epoch);
+    while ((item = gst_app_src_ring_pop (priv)))
+      gst_mini_object_unref (item);
+  }
+
+  while ((item = g_queue_pop_head (priv->pending)))
+    gst_buffer_unref (item);
 }
 
 static void
@@ -575,6 +1120,8 @@ gst_app_src_finalize (GObject * obj)
   g_mutex_free (priv->mutex);
   g_cond_free (priv->cond);
   g_queue_free (priv->queue);
+  g_queue_free (priv->pending);
+  g_free (priv->ring);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -623,6 +1170,37 @@ gst_app_src_set_property (GObject * object, guint prop_id,
     case PROP_MIN_PERCENT:
       priv->min_percent = g_value_get_uint (value);
       break;
+    case PROP_LOCK_FREE:
+    {
+      gboolean lock_free = g_value_get_boolean (value);
+
+      g_mutex_lock (priv->mutex);
+      if (priv->started || !g_queue_is_empty (priv->queue) ||
+          (priv->ring && !gst_app_src_ring_is_empty (priv))) {
+        GST_WARNING_OBJECT (appsrc, "can't change lock-free while running");
+      } else {
+        if (lock_free && !priv->ring)
+          priv->ring = g_new0 (GstAppSrcRingEntry, RING_SIZE);
+        priv->lock_free = lock_free;
+      }
+      g_mutex_unlock (priv->mutex);
+      break;
+    }
+    case PROP_CACHE_SIZE:
+      g_mutex_lock (priv->mutex);
+      priv->cache_size = g_value_get_uint64 (value);
+      g_mutex_unlock (priv->mutex);
+      break;
+    case PROP_CACHE_BLOCK_SIZE:
+      g_mutex_lock (priv->mutex);
+      priv->cache_block_size = g_value_get_uint (value);
+      g_mutex_unlock (priv->mutex);
+      break;
+    case PROP_CACHE_TEMP_FILE:
+      g_mutex_lock (priv->mutex);
+      priv->cache_temp_file = g_value_get_boolean (value);
+      g_mutex_unlock (priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -688,6 +1266,24 @@ gst_app_src_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_MIN_PERCENT:
       g_value_set_uint (value, priv->min_percent);
       break;
+    case PROP_LOCK_FREE:
+      g_value_set_boolean (value, priv->lock_free);
+      break;
+    case PROP_CACHE_SIZE:
+      g_mutex_lock (priv->mutex);
+      g_value_set_uint64 (value, priv->cache_size);
+      g_mutex_unlock (priv->mutex);
+      break;
+    case PROP_CACHE_BLOCK_SIZE:
+      g_mutex_lock (priv->mutex);
+      g_value_set_uint (value, priv->cache_block_size);
+      g_mutex_unlock (priv->mutex);
+      break;
+    case PROP_CACHE_TEMP_FILE:
+      g_mutex_lock (priv->mutex);
+      g_value_set_boolean (value, priv->cache_temp_file);
+      g_mutex_unlock (priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -756,6 +1352,12 @@ gst_app_src_stop (GstBaseSrc * bsrc)
   priv->flushing = TRUE;
   priv->started = FALSE;
   gst_app_src_flush_queued (appsrc);
+  if (priv->cache) {
+    GST_DEBUG_OBJECT (appsrc, "cache hits %" G_GUINT64_FORMAT ", misses %"
+        G_GUINT64_FORMAT, priv->cache->hits, priv->cache->misses);
+    gst_app_src_cache_free (priv->cache);
+    priv->cache = NULL;
+  }
   g_mutex_unlock (priv->mutex);
 
   return TRUE;
@@ -933,6 +1535,27 @@ gst_app_src_emit_need_data (GstAppSrc * appsrc, guint size)
   /* we can be flushing now because we released the lock */
 }
 
+/* called from the streaming thread with a buffer we are about to return */
+static void
+gst_app_src_prepare_buffer (GstAppSrc * appsrc, GstBuffer ** buf,
+    GstCaps * caps)
+{
+  GstAppSrcPrivate *priv = appsrc->priv;
+
+  GST_DEBUG_OBJECT (appsrc, "we have buffer %p of size %u", *buf,
+      GST_BUFFER_SIZE (*buf));
+
+  /* only update the offset when in random_access mode */
+  if (priv->stream_type == GST_APP_STREAM_TYPE_RANDOM_ACCESS) {
+    if (priv->cache)
+      gst_app_src_cache_store (priv->cache, priv->offset,
+          GST_BUFFER_DATA (*buf), GST_BUFFER_SIZE (*buf));
+    priv->offset += GST_BUFFER_SIZE (*buf);
+  }
+  *buf = gst_buffer_make_metadata_writable (*buf);
+  gst_buffer_set_caps (*buf, caps);
+}
+
 static GstFlowReturn
 gst_app_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
     GstBuffer ** buf)
@@ -959,12 +1582,68 @@ gst_app_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
     GST_OBJECT_UNLOCK (appsrc);
   }
 
+  /* the rest of a buffer list and, with the lock-free ring, queued buffers
+   * can be returned without taking the lock, unless we need to track the
+   * offset for random-access */
+  if (priv->stream_type != GST_APP_STREAM_TYPE_RANDOM_ACCESS) {
+    if ((*buf = g_queue_pop_head (priv->pending))) {
+      gst_app_src_prepare_buffer (appsrc, buf, caps);
+      if (caps)
+        gst_caps_unref (caps);
+      return GST_FLOW_OK;
+    }
+    if (priv->lock_free && !g_atomic_int_get (&priv->flushing)) {
+      gpointer item;
+
+      if ((item = gst_app_src_ring_pop (priv))) {
+        /* the producer might wait for free space */
+        gst_app_src_ring_wakeup (priv, &priv->producer_waiting);
+
+        if ((*buf = gst_app_src_unpack_item (priv, item))) {
+          gst_app_src_prepare_buffer (appsrc, buf, caps);
+
+          if (priv->min_percent && priv->max_bytes) {
+            if ((guint64) gst_app_src_ring_bytes (priv) * 100 /
+                priv->max_bytes <= priv->min_percent) {
+              g_mutex_lock (priv->mutex);
+              gst_app_src_emit_need_data (appsrc, size);
+              g_mutex_unlock (priv->mutex);
+            }
+          }
+          if (caps)
+            gst_caps_unref (caps);
+          return GST_FLOW_OK;
+        }
+      }
+    }
+  }
+
   g_mutex_lock (priv->mutex);
   /* check flushing first */
   if (G_UNLIKELY (priv->flushing))
     goto flushing;
 
   if (priv->stream_type == GST_APP_STREAM_TYPE_RANDOM_ACCESS) {
+    if (priv->cache_size > 0) {
+      if (G_UNLIKELY (priv->cache == NULL))
+        priv->cache = gst_app_src_cache_new (priv->cache_size,
+            priv->cache_block_size, priv->cache_temp_file);
+
+      /* serve cached ranges ourselves, unless the application already
+       * queued the data for this offset */
+      if ((priv->offset != offset || (gst_app_src_queue_is_empty (priv) &&
+                  g_queue_is_empty (priv->pending))) &&
+          (*buf = gst_app_src_cache_read (priv->cache, offset, size))) {
+        GST_LOG_OBJECT (appsrc, "cache hit for %u bytes at %" G_GUINT64_FORMAT,
+            size, offset);
+        gst_buffer_set_caps (*buf, caps);
+        g_mutex_unlock (priv->mutex);
+        if (caps)
+          gst_caps_unref (caps);
+        return GST_FLOW_OK;
+      }
+    }
+
     /* if we are dealing with a random-access stream, issue a seek if the offset
      * changed. */
     if (G_UNLIKELY (priv->offset != offset)) {
@@ -982,29 +1661,37 @@ gst_app_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
   }
 
   while (TRUE) {
-    /* return data as long as we have some */
-    if (!g_queue_is_empty (priv->queue)) {
-      guint buf_size;
-
-      *buf = g_queue_pop_head (priv->queue);
-      buf_size = GST_BUFFER_SIZE (*buf);
-
-      GST_DEBUG_OBJECT (appsrc, "we have buffer %p of size %u", *buf, buf_size);
+    /* first finish the buffer list we were working on */
+    if ((*buf = g_queue_pop_head (priv->pending))) {
+      gst_app_src_prepare_buffer (appsrc, buf, caps);
+      ret = GST_FLOW_OK;
+      break;
+    }
 
-      priv->queued_bytes -= buf_size;
+    /* return data as long as we have some */
+    if (!gst_app_src_queue_is_empty (priv)) {
+      gpointer item;
 
-      /* only update the offset when in random_access mode */
-      if (priv->stream_type == GST_APP_STREAM_TYPE_RANDOM_ACCESS)
-        priv->offset += buf_size;
-      *buf = gst_buffer_make_metadata_writable (*buf);
-      gst_buffer_set_caps (*buf, caps);
+      if (priv->lock_free) {
+        item = gst_app_src_ring_pop (priv);
+      } else {
+        item = g_queue_pop_head (priv->queue);
+        priv->queued_bytes -= gst_app_src_item_size (item);
+      }
 
       /* signal that we removed an item */
       g_cond_broadcast (priv->cond);
 
+      /* an empty buffer list, try again */
+      if (!(*buf = gst_app_src_unpack_item (priv, item)))
+        continue;
+
+      gst_app_src_prepare_buffer (appsrc, buf, caps);
+
       /* see if we go lower than the empty-percent */
       if (priv->min_percent && priv->max_bytes) {
-        if (priv->queued_bytes * 100 / priv->max_bytes <= priv->min_percent)
+        if (gst_app_src_get_queued_bytes (priv) * 100 / priv->max_bytes <=
+            priv->min_percent)
           /* ignore flushing state, we got a buffer and we will return it now.
            * Errors will be handled in the next round */
           gst_app_src_emit_need_data (appsrc, size);
@@ -1023,7 +1710,7 @@ gst_app_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
        * signal) we can still be empty because the pushed buffer got flushed or
        * when the application pushes the requested buffer later, we support both
        * possiblities. */
-      if (!g_queue_is_empty (priv->queue))
+      if (!gst_app_src_queue_is_empty (priv))
         continue;
 
       /* no buffer yet, maybe we are EOS, if not, block for more data. */
@@ -1034,7 +1721,19 @@ gst_app_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
       goto eos;
 
     /* nothing to return, wait a while for new data or flushing. */
-    g_cond_wait (priv->cond, priv->mutex);
+    if (priv->lock_free) {
+      /* full barrier before we check the ring again, a producer that pushed
+       * after this will see the flag and wake us up */
+      g_atomic_int_inc (&priv->consumer_waiting);
+      /* a producer waiting for space we freed without telling it */
+      if (g_atomic_int_get (&priv->producer_waiting))
+        g_cond_broadcast (priv->cond);
+      if (gst_app_src_ring_is_empty (priv))
+        g_cond_wait (priv->cond, priv->mutex);
+      g_atomic_int_add (&priv->consumer_waiting, -1);
+    } else {
+      g_cond_wait (priv->cond, priv->mutex);
+    }
   }
   g_mutex_unlock (priv->mutex);
   if (caps)
@@ -1425,18 +2124,116 @@ gst_app_src_get_emit_signals (GstAppSrc * appsrc)
   return result;
 }
 
+static void
+gst_app_src_emit_enough_data (GstAppSrc * appsrc, gboolean emit)
+{
+  GstAppSrcPrivate *priv = appsrc->priv;
+
+  if (priv->callbacks.enough_data)
+    priv->callbacks.enough_data (appsrc, priv->user_data);
+  else if (emit)
+    g_signal_emit (appsrc, gst_app_src_signals[SIGNAL_ENOUGH_DATA], 0, NULL);
+}
+
+static gboolean
+gst_app_src_ring_is_filled (GstAppSrcPrivate * priv)
+{
+  return priv->max_bytes && gst_app_src_ring_bytes (priv) >= priv->max_bytes;
+}
+
+static gboolean
+gst_app_src_ring_is_full (GstAppSrcPrivate * priv)
+{
+  return (guint) priv->ring_tail - (guint) g_atomic_int_get (&priv->ring_head)
+      >= RING_SIZE;
+}
+
+/* push-buffer on the lock-free ring. The mutex is only taken to wait for free
+ * space. Takes ownership of @item. */
 static GstFlowReturn
-gst_app_src_push_buffer_full (GstAppSrc * appsrc, GstBuffer * buffer,
+gst_app_src_push_item_lock_free (GstAppSrc * appsrc, gpointer item)
+{
+  gboolean first = TRUE;
+  GstAppSrcPrivate *priv = appsrc->priv;
+  guint epoch;
+
+  /* read before we check for flushing, a flush after this makes the item
+   * stale */
+  epoch = g_atomic_int_get (&priv->ring_epoch);
+
+  while (TRUE) {
+    gboolean filled;
+
+    /* can't accept buffers when we are flushing or EOS */
+    if (g_atomic_int_get (&priv->flushing))
+      goto flushing;
+
+    if (g_atomic_int_get (&priv->is_eos))
+      goto eos;
+
+    filled = gst_app_src_ring_is_filled (priv);
+    if (filled && first) {
+      GST_DEBUG_OBJECT (appsrc, "queue filled (%u >= %" G_GUINT64_FORMAT ")",
+          gst_app_src_ring_bytes (priv), priv->max_bytes);
+      /* only signal on the first push */
+      gst_app_src_emit_enough_data (appsrc, priv->emit_signals);
+      first = FALSE;
+      continue;
+    }
+
+    if (!filled || !priv->block) {
+      GST_DEBUG_OBJECT (appsrc, "queueing item %p", item);
+      if (gst_app_src_ring_push (priv, item, epoch))
+        break;
+    }
+
+    /* wait until the streaming thread frees up space or we flush */
+    g_mutex_lock (priv->mutex);
+    g_atomic_int_inc (&priv->producer_waiting);
+    if (!priv->flushing && !priv->is_eos && (gst_app_src_ring_is_full (priv)
+            || (priv->block && gst_app_src_ring_is_filled (priv)))) {
+      GST_DEBUG_OBJECT (appsrc, "waiting for free space");
+      g_cond_wait (priv->cond, priv->mutex);
+    }
+    g_atomic_int_add (&priv->producer_waiting, -1);
+    g_mutex_unlock (priv->mutex);
+  }
+
+  gst_app_src_ring_wakeup (priv, &priv->consumer_waiting);
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+flushing:
+  {
+    GST_DEBUG_OBJECT (appsrc, "refuse item %p, we are flushing", item);
+    gst_mini_object_unref (item);
+    return GST_FLOW_WRONG_STATE;
+  }
+eos:
+  {
+    GST_DEBUG_OBJECT (appsrc, "refuse item %p, we are EOS", item);
+    gst_mini_object_unref (item);
+    return GST_FLOW_UNEXPECTED;
+  }
+}
+
+/* queue a buffer or a buffer list */
+static GstFlowReturn
+gst_app_src_push_item_full (GstAppSrc * appsrc, gpointer item,
     gboolean steal_ref)
 {
   gboolean first = TRUE;
   GstAppSrcPrivate *priv;
 
-  g_return_val_if_fail (GST_IS_APP_SRC (appsrc), GST_FLOW_ERROR);
-  g_return_val_if_fail (GST_IS_BUFFER (buffer), GST_FLOW_ERROR);
-
   priv = appsrc->priv;
 
+  if (priv->lock_free) {
+    if (!steal_ref)
+      gst_mini_object_ref (item);
+    return gst_app_src_push_item_lock_free (appsrc, item);
+  }
+
   g_mutex_lock (priv->mutex);
 
   while (TRUE) {
@@ -1459,11 +2256,7 @@ gst_app_src_push_buffer_full (GstAppSrc * appsrc, GstBuffer * buffer,
         /* only signal on the first push */
         g_mutex_unlock (priv->mutex);
 
-        if (priv->callbacks.enough_data)
-          priv->callbacks.enough_data (appsrc, priv->user_data);
-        else if (emit)
-          g_signal_emit (appsrc, gst_app_src_signals[SIGNAL_ENOUGH_DATA], 0,
-              NULL);
+        gst_app_src_emit_enough_data (appsrc, emit);
 
         g_mutex_lock (priv->mutex);
         /* continue to check for flushing/eos after releasing the lock */
@@ -1485,11 +2278,11 @@ gst_app_src_push_buffer_full (GstAppSrc * appsrc, GstBuffer * buffer,
       break;
   }
 
-  GST_DEBUG_OBJECT (appsrc, "queueing buffer %p", buffer);
+  GST_DEBUG_OBJECT (appsrc, "queueing item %p", item);
   if (!steal_ref)
-    gst_buffer_ref (buffer);
-  g_queue_push_tail (priv->queue, buffer);
-  priv->queued_bytes += GST_BUFFER_SIZE (buffer);
+    gst_mini_object_ref (item);
+  g_queue_push_tail (priv->queue, item);
+  priv->queued_bytes += gst_app_src_item_size (item);
   g_cond_broadcast (priv->cond);
   g_mutex_unlock (priv->mutex);
 
@@ -1498,17 +2291,17 @@ gst_app_src_push_buffer_full (GstAppSrc * appsrc, GstBuffer * buffer,
   /* ERRORS */
 flushing:
   {
-    GST_DEBUG_OBJECT (appsrc, "refuse buffer %p, we are flushing", buffer);
+    GST_DEBUG_OBJECT (appsrc, "refuse item %p, we are flushing", item);
     if (steal_ref)
-      gst_buffer_unref (buffer);
+      gst_mini_object_unref (item);
     g_mutex_unlock (priv->mutex);
     return GST_FLOW_WRONG_STATE;
   }
 eos:
   {
-    GST_DEBUG_OBJECT (appsrc, "refuse buffer %p, we are EOS", buffer);
+    GST_DEBUG_OBJECT (appsrc, "refuse item %p, we are EOS", item);
     if (steal_ref)
-      gst_buffer_unref (buffer);
+      gst_mini_object_unref (item);
     g_mutex_unlock (priv->mutex);
     return GST_FLOW_UNEXPECTED;
   }
@@ -1534,7 +2327,10 @@ eos:
 GstFlowReturn
 gst_app_src_push_buffer (GstAppSrc * appsrc, GstBuffer * buffer)
 {
-  return gst_app_src_push_buffer_full (appsrc, buffer, TRUE);
+  g_return_val_if_fail (GST_IS_APP_SRC (appsrc), GST_FLOW_ERROR);
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), GST_FLOW_ERROR);
+
+  return gst_app_src_push_item_full (appsrc, buffer, TRUE);
 }
 
 /* push a buffer without stealing the ref of the buffer. This is used for the
@@ -1542,7 +2338,49 @@ gst_app_src_push_buffer (GstAppSrc * appsrc, GstBuffer * buffer)
 static GstFlowReturn
 gst_app_src_push_buffer_action (GstAppSrc * appsrc, GstBuffer * buffer)
 {
-  return gst_app_src_push_buffer_full (appsrc, buffer, FALSE);
+  g_return_val_if_fail (GST_IS_APP_SRC (appsrc), GST_FLOW_ERROR);
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), GST_FLOW_ERROR);
+
+  return gst_app_src_push_item_full (appsrc, buffer, FALSE);
+}
+
+/**
+ * gst_app_src_push_buffer_list:
+ * @appsrc: a #GstAppSrc
+ * @list: a #GstBufferList to push
+ *
+ * Adds all buffers of @list to the queue of buffers that the appsrc element
+ * will push to its source pad. The list is queued, accounted and signalled as
+ * one unit, which is cheaper than pushing its buffers one by one. This
+ * function takes ownership of the list.
+ *
+ * When the block property is TRUE, this function can block until free
+ * space becomes available in the queue.
+ *
+ * Returns: #GST_FLOW_OK when the list was successfuly queued.
+ * #GST_FLOW_WRONG_STATE when @appsrc is not PAUSED or PLAYING.
+ * #GST_FLOW_UNEXPECTED when EOS occured.
+ *
+ * Since: 0.10.31
+ */
+GstFlowReturn
+gst_app_src_push_buffer_list (GstAppSrc * appsrc, GstBufferList * list)
+{
+  g_return_val_if_fail (GST_IS_APP_SRC (appsrc), GST_FLOW_ERROR);
+  g_return_val_if_fail (GST_IS_BUFFER_LIST (list), GST_FLOW_ERROR);
+
+  return gst_app_src_push_item_full (appsrc, list, TRUE);
+}
+
+/* push a buffer list without stealing the ref of the list. This is used for
+ * the action signal. */
+static GstFlowReturn
+gst_app_src_push_buffer_list_action (GstAppSrc * appsrc, GstBufferList * list)
+{
+  g_return_val_if_fail (GST_IS_APP_SRC (appsrc), GST_FLOW_ERROR);
+  g_return_val_if_fail (GST_IS_BUFFER_LIST (list), GST_FLOW_ERROR);
+
+  return gst_app_src_push_item_full (appsrc, list, FALSE);
 }
 
 /**
@@ -110,9 +110,10 @@ struct _GstAppSrcClass
   /* actions */
   GstFlowReturn (*push_buffer)     (GstAppSrc *src, GstBuffer *buffer);
   GstFlowReturn (*end_of_stream)   (GstAppSrc *src);
+  GstFlowReturn (*push_buffer_list) (GstAppSrc *src, GstBufferList *list);
 
   /*< private >*/
-  gpointer     _gst_reserved[GST_PADDING];
+  gpointer     _gst_reserved[GST_PADDING - 1];
 };
 
 GType gst_app_src_get_type(void);
@@ -136,6 +137,7 @@ void             gst_app_src_set_emit_signals (GstAppSrc *appsrc, gboolean emit)
 gboolean         gst_app_src_get_emit_signals (GstAppSrc *appsrc);
 
 GstFlowReturn    gst_app_src_push_buffer      (GstAppSrc *appsrc, GstBuffer *buffer);
+GstFlowReturn    gst_app_src_push_buffer_list (GstAppSrc *appsrc, GstBufferList *list);
 GstFlowReturn    gst_app_src_end_of_stream    (GstAppSrc *appsrc);
 
 void             gst_app_src_set_callbacks    (GstAppSrc * appsrc,
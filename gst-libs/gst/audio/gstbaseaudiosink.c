@@ -62,6 +62,15 @@ struct _GstBaseAudioSinkPrivate
   /* number of microseconds we alow timestamps or clock slaving to drift
    * before resyncing */
   guint64 drift_tolerance;
+
+  /* state of the resample slaving method */
+  gdouble rs_ratio;
+  gdouble rs_pos;
+  gboolean rs_have_prev;
+  guint8 *rs_prev;
+  guint rs_prev_size;
+  guint8 *rs_buf;
+  guint rs_buf_size;
 };
 
 /* BaseAudioSink signals and args */
@@ -86,6 +95,13 @@ enum
 #define DEFAULT_PROVIDE_CLOCK   TRUE
 #define DEFAULT_SLAVE_METHOD    GST_BASE_AUDIO_SINK_SLAVE_SKEW
 
+/* the resample slaving method corrects the position error over this many
+ * seconds, with at most this relative rate change, and low-pass filters the
+ * rate with this factor per buffer */
+#define RESAMPLE_CORRECTION_TIME  1.0
+#define RESAMPLE_MAX_CORRECTION   0.005
+#define RESAMPLE_SMOOTHING        0.1
+
 /* FIXME, enable pull mode when clock slaving and trick modes are figured out */
 #define DEFAULT_CAN_ACTIVATE_PULL FALSE
 
@@ -319,6 +335,13 @@ gst_base_audio_sink_dispose (GObject * object)
     sink->ringbuffer = NULL;
   }
 
+  g_free (sink->priv->rs_prev);
+  sink->priv->rs_prev = NULL;
+  sink->priv->rs_prev_size = 0;
+  g_free (sink->priv->rs_buf);
+  sink->priv->rs_buf = NULL;
+  sink->priv->rs_buf_size = 0;
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -981,6 +1004,159 @@ gst_base_audio_sink_resample_slaving (GstBaseAudioSink * sink,
   *srender_stop = render_stop;
 }
 
+/* linear interpolation between consecutive input samples. pos is the
+ * position of the next output sample in the input, -1 being the last sample
+ * of the previous buffer, which is kept in prev. */
+#define DEFINE_RESAMPLE_LINEAR(type,round)                                    \
+static guint                                                                  \
+resample_linear_##type (const type * in, guint n_in, type * out,              \
+    guint max_out, type * prev, gint channels, gdouble * pos, gdouble step)   \
+{                                                                             \
+  const type *a, *b;                                                          \
+  gdouble p = *pos, frac;                                                     \
+  guint n;                                                                    \
+  gint i, c;                                                                  \
+                                                                              \
+  for (n = 0; n < max_out; n++) {                                             \
+    i = (gint) (p + 1.0) - 1;                                                 \
+    if (i + 1 >= (gint) n_in)                                                 \
+      break;                                                                  \
+    frac = p - i;                                                             \
+    a = i < 0 ? prev : in + i * channels;                                     \
+    b = in + (i + 1) * channels;                                              \
+    for (c = 0; c < channels; c++)                                            \
+      *out++ = (type) round (a[c] + (b[c] - (gdouble) a[c]) * frac);          \
+    p += step;                                                                \
+  }                                                                           \
+  *pos = p - n_in;                                                            \
+  memcpy (prev, in + (n_in - 1) * channels, channels * sizeof (type));        \
+                                                                              \
+  return n;                                                                   \
+}
+
+#define ROUND_INT(v)   ((v) < 0.0 ? (v) - 0.5 : (v) + 0.5)
+#define ROUND_FLOAT(v) (v)
+
+DEFINE_RESAMPLE_LINEAR (gint16, ROUND_INT)
+DEFINE_RESAMPLE_LINEAR (gint32, ROUND_INT)
+DEFINE_RESAMPLE_LINEAR (gfloat, ROUND_FLOAT)
+DEFINE_RESAMPLE_LINEAR (gdouble, ROUND_FLOAT)
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define FORMAT_S16_NE     GST_S16_LE
+#define FORMAT_S32_NE     GST_S32_LE
+#define FORMAT_FLOAT32_NE GST_FLOAT32_LE
+#define FORMAT_FLOAT64_NE GST_FLOAT64_LE
+#else
+#define FORMAT_S16_NE     GST_S16_BE
+#define FORMAT_S32_NE     GST_S32_BE
+#define FORMAT_FLOAT32_NE GST_FLOAT32_BE
+#define FORMAT_FLOAT64_NE GST_FLOAT64_BE
+#endif
+
+static void
+gst_base_audio_sink_resample_reset (GstBaseAudioSink * sink)
+{
+  sink->priv->rs_ratio = 0.0;
+  sink->priv->rs_pos = 0.0;
+  sink->priv->rs_have_prev = FALSE;
+}
+
+/* resample @samples samples at @data to the rate of the master clock. @error
+ * is the number of samples the data should start later than where we will
+ * write it, the rate is adjusted slightly to bring it to 0 over time.
+ * Returns FALSE when the format is not supported. */
+static gboolean
+gst_base_audio_sink_resample (GstBaseAudioSink * sink, guint8 ** data,
+    guint * samples, gint64 error)
+{
+  GstBaseAudioSinkPrivate *priv = sink->priv;
+  GstRingBufferSpec *spec = &sink->ringbuffer->spec;
+  GstClockTime rate_num, rate_denom;
+  gdouble ratio, correction;
+  guint max_out, n_out;
+  gint bps, channels;
+
+  switch (spec->format) {
+    case FORMAT_S16_NE:
+    case FORMAT_S32_NE:
+    case FORMAT_FLOAT32_NE:
+    case FORMAT_FLOAT64_NE:
+      break;
+    default:
+      return FALSE;
+  }
+  if (G_UNLIKELY (*samples == 0))
+    return TRUE;
+
+  bps = spec->bytes_per_sample;
+  channels = spec->channels;
+
+  /* the rate of the master clock relative to ours */
+  gst_clock_get_calibration (sink->provided_clock, NULL, NULL, &rate_num,
+      &rate_denom);
+  if (rate_num == 0 || rate_denom == 0)
+    rate_num = rate_denom = 1;
+  ratio = gst_guint64_to_gdouble (rate_denom) /
+      gst_guint64_to_gdouble (rate_num);
+
+  /* and steer towards the position the timestamps ask for */
+  correction = error / (spec->rate * RESAMPLE_CORRECTION_TIME);
+  ratio *= 1.0 + CLAMP (correction, -RESAMPLE_MAX_CORRECTION,
+      RESAMPLE_MAX_CORRECTION);
+
+  if (!priv->rs_have_prev) {
+    priv->rs_ratio = ratio;
+    priv->rs_pos = 0.0;
+  } else {
+    priv->rs_ratio += (ratio - priv->rs_ratio) * RESAMPLE_SMOOTHING;
+  }
+
+  if (G_UNLIKELY (priv->rs_prev_size != (guint) bps)) {
+    g_free (priv->rs_prev);
+    priv->rs_prev = g_malloc0 (bps);
+    priv->rs_prev_size = bps;
+  }
+  max_out = (guint) ((*samples + 1) * priv->rs_ratio) + 2;
+  if (G_UNLIKELY (priv->rs_buf_size < max_out * bps)) {
+    g_free (priv->rs_buf);
+    priv->rs_buf = g_malloc (max_out * bps);
+    priv->rs_buf_size = max_out * bps;
+  }
+
+  switch (spec->format) {
+    case FORMAT_S16_NE:
+      n_out = resample_linear_gint16 ((const gint16 *) * data, *samples,
+          (gint16 *) priv->rs_buf, max_out, (gint16 *) priv->rs_prev,
+          channels, &priv->rs_pos, 1.0 / priv->rs_ratio);
+      break;
+    case FORMAT_S32_NE:
+      n_out = resample_linear_gint32 ((const gint32 *) * data, *samples,
+          (gint32 *) priv->rs_buf, max_out, (gint32 *) priv->rs_prev,
+          channels, &priv->rs_pos, 1.0 / priv->rs_ratio);
+      break;
+    case FORMAT_FLOAT32_NE:
+      n_out = resample_linear_gfloat ((const gfloat *) * data, *samples,
+          (gfloat *) priv->rs_buf, max_out, (gfloat *) priv->rs_prev,
+          channels, &priv->rs_pos, 1.0 / priv->rs_ratio);
+      break;
+    default:
+      n_out = resample_linear_gdouble ((const gdouble *) * data, *samples,
+          (gdouble *) priv->rs_buf, max_out, (gdouble *) priv->rs_prev,
+          channels, &priv->rs_pos, 1.0 / priv->rs_ratio);
+      break;
+  }
+  priv->rs_have_prev = TRUE;
+
+  GST_LOG_OBJECT (sink, "resampled %u to %u samples, ratio %f, error %"
+      G_GINT64_FORMAT, *samples, n_out, priv->rs_ratio, error);
+
+  *data = priv->rs_buf;
+  *samples = n_out;
+
+  return TRUE;
+}
+
 /* algorithm to calculate sample positions that will result in changing the
  * playout pointer to match the clock rate of the master */
 static void
@@ -1508,6 +1684,7 @@ gst_base_audio_sink_render (GstBaseSink * bsink, GstBuffer * buf)
   /* always resync after a discont */
   if (G_UNLIKELY (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT))) {
     GST_DEBUG_OBJECT (sink, "resync after discont");
+    gst_base_audio_sink_resample_reset (sink);
     goto no_align;
   }
 
@@ -1515,6 +1692,7 @@ gst_base_audio_sink_render (GstBaseSink * bsink, GstBuffer * buf)
   if (G_UNLIKELY (sink->next_sample == -1)) {
     GST_DEBUG_OBJECT (sink,
         "no align possible: no previous sample position known");
+    gst_base_audio_sink_resample_reset (sink);
     goto no_align;
   }
 
@@ -1548,6 +1726,16 @@ gst_base_audio_sink_render (GstBaseSink * bsink, GstBuffer * buf)
 
   /* only align stop if we are not slaved to resample */
   if (slaved && sink->priv->slave_method == GST_BASE_AUDIO_SINK_SLAVE_RESAMPLE) {
+    /* convert the samples to the rate of the master clock and write them
+     * right after the previous ones, a resync is still needed when we drifted
+     * too far */
+    if (G_LIKELY (diff < maxdrift) && bsink->segment.rate == 1.0 &&
+        gst_base_audio_sink_resample (sink, &data, &samples, -align)) {
+      render_stop = render_start + samples;
+      GST_DEBUG_OBJECT (sink, "resampled to %u samples", samples);
+      goto no_align;
+    }
+    gst_base_audio_sink_resample_reset (sink);
     GST_DEBUG_OBJECT (sink, "no stop time align needed: we are slaved");
     goto no_align;
   }
@@ -80,7 +80,9 @@ G_BEGIN_DECLS
 
 /**
  * GstBaseAudioSinkSlaveMethod:
- * @GST_BASE_AUDIO_SINK_SLAVE_RESAMPLE: Resample to match the master clock
+ * @GST_BASE_AUDIO_SINK_SLAVE_RESAMPLE: Resample to match the master clock.
+ * 16 and 32 bits integer and float samples are converted with a smoothly
+ * adjusted rate, other formats drop or duplicate samples.
  * @GST_BASE_AUDIO_SINK_SLAVE_SKEW: Adjust playout pointer when master clock
  * drifts too much.
  * @GST_BASE_AUDIO_SINK_SLAVE_NONE: No adjustment is done.
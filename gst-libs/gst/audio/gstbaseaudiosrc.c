@@ -67,14 +67,256 @@ gst_base_audio_src_slave_method_get_type (void)
 #define GST_BASE_AUDIO_SRC_GET_PRIVATE(obj)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_BASE_AUDIO_SRC, GstBaseAudioSrcPrivate))
 
+typedef struct _GstBaseAudioSrcPool GstBaseAudioSrcPool;
+
 struct _GstBaseAudioSrcPrivate
 {
   gboolean provide_clock;
 
   /* the clock slaving algorithm in use */
   GstBaseAudioSrcSlaveMethod slave_method;
+
+  /* recycled segment sized buffers, only used from the streaming thread and
+   * while changing state */
+  GstBaseAudioSrcPool *pool;
+
+  /* stats of the pools we released, protected by the object lock */
+  guint64 buffers_allocated;
+  guint64 buffers_recycled;
+  guint64 buffers_missed;
+  guint64 buffers_freed;
+};
+
+/* Recycled segment buffers.
+ *
+ * Every buffer we push holds a ref to the pool it came from. When downstream
+ * drops the last ref to the buffer, its finalize method puts it back in the
+ * pool instead of freeing it, unless the pool was deactivated or someone
+ * replaced the memory of the buffer. The pool itself is refcounted so that
+ * buffers can outlive the element. */
+#define POOL_MAX_BUFFERS        8
+
+struct _GstBaseAudioSrcPool
+{
+  gint refcount;
+
+  GMutex *lock;
+  GSList *buffers;
+  guint n_buffers;
+  guint size;
+  gboolean active;
+
+  /* stats */
+  guint64 allocated;
+  guint64 recycled;
+  guint64 misses;
+  guint64 freed;
 };
 
+typedef struct
+{
+  GstBuffer buffer;
+
+  GstBaseAudioSrcPool *pool;
+} GstBaseAudioSrcBuffer;
+
+static GstBufferClass *pool_buffer_parent_class = NULL;
+
+static GType gst_base_audio_src_buffer_get_type (void);
+#define GST_TYPE_BASE_AUDIO_SRC_BUFFER (gst_base_audio_src_buffer_get_type())
+
+static GstBaseAudioSrcPool *
+gst_base_audio_src_pool_new (guint size)
+{
+  GstBaseAudioSrcPool *pool;
+
+  pool = g_slice_new0 (GstBaseAudioSrcPool);
+  pool->refcount = 1;
+  pool->lock = g_mutex_new ();
+  pool->size = size;
+  pool->active = TRUE;
+
+  return pool;
+}
+
+static GstBaseAudioSrcPool *
+gst_base_audio_src_pool_ref (GstBaseAudioSrcPool * pool)
+{
+  g_atomic_int_inc (&pool->refcount);
+
+  return pool;
+}
+
+static void
+gst_base_audio_src_pool_unref (GstBaseAudioSrcPool * pool)
+{
+  if (g_atomic_int_dec_and_test (&pool->refcount)) {
+    g_mutex_free (pool->lock);
+    g_slice_free (GstBaseAudioSrcPool, pool);
+  }
+}
+
+/* stop recycling and free all idle buffers, buffers still in use downstream
+ * are freed when they are released */
+static void
+gst_base_audio_src_pool_deactivate (GstBaseAudioSrc * src,
+    GstBaseAudioSrcPool * pool)
+{
+  GSList *buffers;
+
+  g_mutex_lock (pool->lock);
+  pool->active = FALSE;
+  buffers = pool->buffers;
+  pool->buffers = NULL;
+  pool->n_buffers = 0;
+
+  GST_DEBUG_OBJECT (src, "buffer pool of %u bytes: %" G_GUINT64_FORMAT
+      " allocated, %" G_GUINT64_FORMAT " recycled, %" G_GUINT64_FORMAT
+      " misses", pool->size, pool->allocated, pool->recycled, pool->misses);
+  g_mutex_unlock (pool->lock);
+
+  g_slist_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_slist_free (buffers);
+}
+
+/* deactivate the pool and add its stats to the totals of the element.
+ * Buffers that are still in use downstream are not counted as freed. */
+static void
+gst_base_audio_src_pool_release (GstBaseAudioSrc * src)
+{
+  GstBaseAudioSrcPrivate *priv = src->priv;
+  GstBaseAudioSrcPool *pool = priv->pool;
+
+  if (pool == NULL)
+    return;
+
+  gst_base_audio_src_pool_deactivate (src, pool);
+
+  GST_OBJECT_LOCK (src);
+  g_mutex_lock (pool->lock);
+  priv->buffers_allocated += pool->allocated;
+  priv->buffers_recycled += pool->recycled;
+  priv->buffers_missed += pool->misses;
+  priv->buffers_freed += pool->freed;
+  g_mutex_unlock (pool->lock);
+  priv->pool = NULL;
+  GST_OBJECT_UNLOCK (src);
+
+  gst_base_audio_src_pool_unref (pool);
+}
+
+static GstBuffer *
+gst_base_audio_src_pool_acquire (GstBaseAudioSrc * src, guint size)
+{
+  GstBaseAudioSrcPrivate *priv = src->priv;
+  GstBaseAudioSrcPool *pool;
+  GstBuffer *buf = NULL;
+
+  /* the segment size changed, start over */
+  if (G_UNLIKELY (priv->pool && priv->pool->size != size))
+    gst_base_audio_src_pool_release (src);
+  if (G_UNLIKELY (priv->pool == NULL)) {
+    pool = gst_base_audio_src_pool_new (size);
+    GST_OBJECT_LOCK (src);
+    priv->pool = pool;
+    GST_OBJECT_UNLOCK (src);
+  }
+
+  pool = priv->pool;
+
+  g_mutex_lock (pool->lock);
+  if (G_LIKELY (pool->buffers)) {
+    buf = pool->buffers->data;
+    pool->buffers = g_slist_delete_link (pool->buffers, pool->buffers);
+    pool->n_buffers--;
+    pool->recycled++;
+  } else {
+    pool->misses++;
+    pool->allocated++;
+  }
+  g_mutex_unlock (pool->lock);
+
+  if (G_UNLIKELY (buf == NULL)) {
+    GST_LOG_OBJECT (src, "buffer pool empty, allocating %u bytes", size);
+
+    buf = (GstBuffer *) gst_mini_object_new (GST_TYPE_BASE_AUDIO_SRC_BUFFER);
+    GST_BUFFER_MALLOCDATA (buf) = g_malloc (size);
+    GST_BUFFER_DATA (buf) = GST_BUFFER_MALLOCDATA (buf);
+    GST_BUFFER_SIZE (buf) = size;
+    ((GstBaseAudioSrcBuffer *) buf)->pool = gst_base_audio_src_pool_ref (pool);
+  }
+
+  return buf;
+}
+
+/* see the comment in ximagesink: the mini object is kept alive when we take
+ * a new ref in finalize and we must not chain up in that case */
+static void
+gst_base_audio_src_buffer_finalize (GstBaseAudioSrcBuffer * pbuf)
+{
+  GstBaseAudioSrcPool *pool = pbuf->pool;
+  GstBuffer *buf = GST_BUFFER_CAST (pbuf);
+
+  /* clear what the next user does not overwrite */
+  gst_buffer_set_caps (buf, NULL);
+  GST_BUFFER_FLAGS (buf) = 0;
+
+  g_mutex_lock (pool->lock);
+  if (pool->active && pool->n_buffers < POOL_MAX_BUFFERS &&
+      GST_BUFFER_DATA (buf) == GST_BUFFER_MALLOCDATA (buf) &&
+      GST_BUFFER_SIZE (buf) == pool->size) {
+    /* need to increment the refcount again to recycle */
+    gst_buffer_ref (buf);
+    pool->buffers = g_slist_prepend (pool->buffers, buf);
+    pool->n_buffers++;
+    g_mutex_unlock (pool->lock);
+    return;
+  }
+  pool->freed++;
+  g_mutex_unlock (pool->lock);
+
+  pbuf->pool = NULL;
+  gst_base_audio_src_pool_unref (pool);
+
+  GST_MINI_OBJECT_CLASS (pool_buffer_parent_class)->finalize
+      (GST_MINI_OBJECT_CAST (buf));
+}
+
+static void
+gst_base_audio_src_buffer_class_init (gpointer g_class, gpointer class_data)
+{
+  GstMiniObjectClass *mini_object_class = GST_MINI_OBJECT_CLASS (g_class);
+
+  pool_buffer_parent_class = g_type_class_peek_parent (g_class);
+
+  mini_object_class->finalize = (GstMiniObjectFinalizeFunction)
+      gst_base_audio_src_buffer_finalize;
+}
+
+static GType
+gst_base_audio_src_buffer_get_type (void)
+{
+  static GType _gst_base_audio_src_buffer_type;
+
+  if (G_UNLIKELY (_gst_base_audio_src_buffer_type == 0)) {
+    static const GTypeInfo buffer_info = {
+      sizeof (GstBufferClass),
+      NULL,
+      NULL,
+      gst_base_audio_src_buffer_class_init,
+      NULL,
+      NULL,
+      sizeof (GstBaseAudioSrcBuffer),
+      0,
+      NULL,
+      NULL
+    };
+    _gst_base_audio_src_buffer_type = g_type_register_static (GST_TYPE_BUFFER,
+        "GstBaseAudioSrcBuffer", &buffer_info, 0);
+  }
+  return _gst_base_audio_src_buffer_type;
+}
+
 /* BaseAudioSrc signals and args */
 enum
 {
@@ -98,6 +340,10 @@ enum
   PROP_ACTUAL_LATENCY_TIME,
   PROP_PROVIDE_CLOCK,
   PROP_SLAVE_METHOD,
+  PROP_BUFFERS_ALLOCATED,
+  PROP_BUFFERS_RECYCLED,
+  PROP_BUFFERS_MISSED,
+  PROP_BUFFERS_FREED,
   PROP_LAST
 };
 
@@ -215,6 +461,58 @@ gst_base_audio_src_class_init (GstBaseAudioSrcClass * klass)
           GST_TYPE_BASE_AUDIO_SRC_SLAVE_METHOD, DEFAULT_SLAVE_METHOD,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstBaseAudioSrc:buffers-allocated:
+   *
+   * The number of segment buffers that were allocated.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_BUFFERS_ALLOCATED,
+      g_param_spec_uint64 ("buffers-allocated", "Buffers Allocated",
+          "The number of segment buffers that were allocated",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstBaseAudioSrc:buffers-recycled:
+   *
+   * The number of segment buffers that were reused after downstream
+   * released them.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_BUFFERS_RECYCLED,
+      g_param_spec_uint64 ("buffers-recycled", "Buffers Recycled",
+          "The number of segment buffers that were reused",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstBaseAudioSrc:buffers-missed:
+   *
+   * The number of times no released segment buffer was available and a new
+   * one had to be allocated.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_BUFFERS_MISSED,
+      g_param_spec_uint64 ("buffers-missed", "Buffers Missed",
+          "The number of times no segment buffer could be reused",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstBaseAudioSrc:buffers-freed:
+   *
+   * The number of segment buffers that were freed instead of reused, for
+   * example when going to the READY state. Buffers that are still used
+   * downstream at that time are not counted when they are freed later.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_BUFFERS_FREED,
+      g_param_spec_uint64 ("buffers-freed", "Buffers Freed",
+          "The number of segment buffers that were freed",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_base_audio_src_change_state);
   gstelement_class->provide_clock =
@@ -234,6 +532,7 @@ gst_base_audio_src_class_init (GstBaseAudioSrcClass * klass)
    * thread-safety in GObject */
   g_type_class_ref (GST_TYPE_AUDIO_CLOCK);
   g_type_class_ref (GST_TYPE_RING_BUFFER);
+  g_type_class_ref (GST_TYPE_BASE_AUDIO_SRC_BUFFER);
 }
 
 static void
@@ -277,6 +576,8 @@ gst_base_audio_src_dispose (GObject * object)
   }
   GST_OBJECT_UNLOCK (src);
 
+  gst_base_audio_src_pool_release (src);
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -474,6 +775,40 @@ gst_base_audio_src_set_property (GObject * object, guint prop_id,
   }
 }
 
+/* the stats of the released pools and the current one */
+static guint64
+gst_base_audio_src_get_pool_stat (GstBaseAudioSrc * src, guint prop_id)
+{
+  GstBaseAudioSrcPrivate *priv = src->priv;
+  GstBaseAudioSrcPool *pool;
+  guint64 result = 0;
+
+  GST_OBJECT_LOCK (src);
+  if ((pool = priv->pool))
+    g_mutex_lock (pool->lock);
+
+  switch (prop_id) {
+    case PROP_BUFFERS_ALLOCATED:
+      result = priv->buffers_allocated + (pool ? pool->allocated : 0);
+      break;
+    case PROP_BUFFERS_RECYCLED:
+      result = priv->buffers_recycled + (pool ? pool->recycled : 0);
+      break;
+    case PROP_BUFFERS_MISSED:
+      result = priv->buffers_missed + (pool ? pool->misses : 0);
+      break;
+    case PROP_BUFFERS_FREED:
+      result = priv->buffers_freed + (pool ? pool->freed : 0);
+      break;
+  }
+
+  if (pool)
+    g_mutex_unlock (pool->lock);
+  GST_OBJECT_UNLOCK (src);
+
+  return result;
+}
+
 static void
 gst_base_audio_src_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
@@ -511,6 +846,13 @@ gst_base_audio_src_get_property (GObject * object, guint prop_id,
     case PROP_SLAVE_METHOD:
       g_value_set_enum (value, gst_base_audio_src_get_slave_method (src));
       break;
+    case PROP_BUFFERS_ALLOCATED:
+    case PROP_BUFFERS_RECYCLED:
+    case PROP_BUFFERS_MISSED:
+    case PROP_BUFFERS_FREED:
+      g_value_set_uint64 (value,
+          gst_base_audio_src_get_pool_stat (src, prop_id));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -786,8 +1128,11 @@ gst_base_audio_src_create (GstBaseSrc * bsrc, guint64 offset, guint length,
   /* get the number of samples to read */
   total_samples = samples = length / bps;
 
-  /* FIXME, using a bufferpool would be nice here */
-  buf = gst_buffer_new_and_alloc (length);
+  /* whole segments are what we read by default, recycle those */
+  if (G_LIKELY (length == spec->segsize))
+    buf = gst_base_audio_src_pool_acquire (src, length);
+  else
+    buf = gst_buffer_new_and_alloc (length);
   data = GST_BUFFER_DATA (buf);
 
   do {
@@ -1099,6 +1444,8 @@ gst_base_audio_src_change_state (GstElement * element,
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       GST_DEBUG_OBJECT (src, "PAUSED->READY");
       gst_ring_buffer_release (src->ringbuffer);
+      /* the streaming thread is stopped, drop the idle buffers */
+      gst_base_audio_src_pool_release (src);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
       GST_DEBUG_OBJECT (src, "READY->NULL");
@@ -1457,12 +1457,12 @@ gst_ring_buffer_clear_all (GstRingBuffer * buf)
 }
 
 
+/* wait until the device thread advanced segdone past @segdone, the value the
+ * caller saw when it decided to wait. The lock is only taken when we really
+ * have to sleep. */
 static gboolean
-wait_segment (GstRingBuffer * buf)
+wait_segment (GstRingBuffer * buf, gint segdone)
 {
-  gint segments;
-  gboolean wait = TRUE;
-
   /* buffer must be started now or we deadlock since nobody is reading */
   if (G_UNLIKELY (g_atomic_int_get (&buf->state) !=
           GST_RING_BUFFER_STATE_STARTED)) {
@@ -1471,15 +1471,15 @@ wait_segment (GstRingBuffer * buf)
       goto no_start;
 
     GST_DEBUG_OBJECT (buf, "start!");
-    segments = g_atomic_int_get (&buf->segdone);
     gst_ring_buffer_start (buf);
-
-    /* After starting, the writer may have wrote segments already and then we
-     * don't need to wait anymore */
-    if (G_LIKELY (g_atomic_int_get (&buf->segdone) != segments))
-      wait = FALSE;
   }
 
+  /* the device thread might have processed segments already, then we don't
+   * need to wait at all */
+  if (G_LIKELY (g_atomic_int_get (&buf->segdone) != segdone &&
+          !g_atomic_int_get (&buf->abidata.ABI.flushing)))
+    return TRUE;
+
   /* take lock first, then update our waiting flag */
   GST_OBJECT_LOCK (buf);
   if (G_UNLIKELY (buf->abidata.ABI.flushing))
@@ -1489,19 +1489,24 @@ wait_segment (GstRingBuffer * buf)
           GST_RING_BUFFER_STATE_STARTED))
     goto not_started;
 
-  if (G_LIKELY (wait)) {
-    if (g_atomic_int_compare_and_exchange (&buf->waiting, 0, 1)) {
-      GST_DEBUG_OBJECT (buf, "waiting..");
-      GST_RING_BUFFER_WAIT (buf);
-
-      if (G_UNLIKELY (buf->abidata.ABI.flushing))
-        goto flushing;
-
-      if (G_UNLIKELY (g_atomic_int_get (&buf->state) !=
-              GST_RING_BUFFER_STATE_STARTED))
-        goto not_started;
-    }
+  /* announce that we wait, then check segdone again. gst_ring_buffer_advance()
+   * updates segdone before it looks at the flag, so either we see the new
+   * segdone here or it sees the flag and signals us with the lock taken,
+   * which it can only do once we are sleeping. Both operations are full
+   * barriers. */
+  g_atomic_int_compare_and_exchange (&buf->waiting, 0, 1);
+  if (G_LIKELY (g_atomic_int_get (&buf->segdone) == segdone)) {
+    GST_DEBUG_OBJECT (buf, "waiting..");
+    GST_RING_BUFFER_WAIT (buf);
+
+    if (G_UNLIKELY (buf->abidata.ABI.flushing))
+      goto flushing;
+
+    if (G_UNLIKELY (g_atomic_int_get (&buf->state) !=
+            GST_RING_BUFFER_STATE_STARTED))
+      goto not_started;
   }
+  g_atomic_int_compare_and_exchange (&buf->waiting, 1, 0);
   GST_OBJECT_UNLOCK (buf);
 
   return TRUE;
@@ -1664,10 +1669,11 @@ default_commit (GstRingBuffer * buf, guint64 * sample,
     gboolean skip;
 
     while (TRUE) {
-      gint diff;
+      gint diff, seen;
 
       /* get the currently processed segment */
-      segdone = g_atomic_int_get (&buf->segdone) - buf->segbase;
+      seen = g_atomic_int_get (&buf->segdone);
+      segdone = seen - buf->segbase;
 
       /* see how far away it is from the write segment */
       diff = writeseg - segdone;
@@ -1692,7 +1698,7 @@ default_commit (GstRingBuffer * buf, guint64 * sample,
       }
 
       /* else we need to wait for the segment to become writable. */
-      if (!wait_segment (buf))
+      if (!wait_segment (buf, seen))
         goto not_started;
     }
 
@@ -1877,10 +1883,11 @@ gst_ring_buffer_read (GstRingBuffer * buf, guint64 sample, guchar * data,
     sampleoff = (sample % sps);
 
     while (TRUE) {
-      gint diff;
+      gint diff, seen;
 
       /* get the currently processed segment */
-      segdone = g_atomic_int_get (&buf->segdone) - buf->segbase;
+      seen = g_atomic_int_get (&buf->segdone);
+      segdone = seen - buf->segbase;
 
       /* see how far away it is from the read segment, normally segdone (where
        * the hardware is writing) is bigger than readseg (where software is
@@ -1907,7 +1914,7 @@ gst_ring_buffer_read (GstRingBuffer * buf, guint64 sample, guchar * data,
         break;
 
       /* else we need to wait for the segment to become readable. */
-      if (!wait_segment (buf))
+      if (!wait_segment (buf, seen))
         goto not_started;
     }
 
@@ -2006,12 +2013,13 @@ gst_ring_buffer_advance (GstRingBuffer * buf, guint advance)
 {
   g_return_if_fail (GST_IS_RING_BUFFER (buf));
 
-  /* update counter */
+  /* update counter, this is a full barrier so a waiter that sets its flag
+   * after this sees the new value and does not go to sleep */
   g_atomic_int_add (&buf->segdone, advance);
 
-  /* the lock is already taken when the waiting flag is set,
-   * we grab the lock as well to make sure the waiter is actually
-   * waiting for the signal */
+  /* only take the lock when someone waits. The lock is already taken when
+   * the waiting flag is set, we grab the lock as well to make sure the waiter
+   * is actually waiting for the signal */
   if (g_atomic_int_compare_and_exchange (&buf->waiting, 1, 0)) {
     GST_OBJECT_LOCK (buf);
     GST_DEBUG_OBJECT (buf, "signal waiter");
@@ -421,6 +421,75 @@ static AudioConvertPack pack_funcs[] = {
   (AudioConvertPack) MAKE_PACK_FUNC_NAME (s32_be_float),
 };
 
+/***
+ * fused conversion code
+ *
+ * These convert between the most common format pairs in one pass, without
+ * going through the intermediate format. They must produce exactly the same
+ * result as the generic unpack/quantize/pack chain.
+ */
+#define MAKE_FUSED_FUNC_NAME(name)                                      \
+audio_convert_fused_##name
+
+/* signed 16 bit to 32 bit float, both native endian */
+static void
+MAKE_FUSED_FUNC_NAME (s16_float) (AudioConvertCtx * ctx, gint16 * src,
+    gfloat * dst, gint count)
+{
+  count *= ctx->in.channels;
+  for (; count; count--)
+    *dst++ = (gfloat) ((*src++ * 65536) * (1.0 / 2147483647.0));
+}
+
+/* signed 24 bit to native endian signed 32 bit */
+#define MAKE_FUSED_FUNC_S24_S32(name, READ_FUNC)                        \
+static void                                                             \
+MAKE_FUSED_FUNC_NAME (name) (AudioConvertCtx * ctx, guint8 * src,       \
+    gint32 * dst, gint count)                                           \
+{                                                                       \
+  count *= ctx->in.channels;                                            \
+  for (; count; count--) {                                              \
+    *dst++ = (gint32) (((guint32) READ_FUNC (src)) << 8);               \
+    src += 3;                                                           \
+  }                                                                     \
+}
+
+MAKE_FUSED_FUNC_S24_S32 (s24_le_s32, READ24_FROM_LE);
+MAKE_FUSED_FUNC_S24_S32 (s24_be_s32, READ24_FROM_BE);
+
+#define IS_NATIVE_INT(fmt, w, d)                                        \
+    ((fmt)->is_int && (fmt)->sign && (fmt)->width == (w) &&             \
+     (fmt)->depth == (d) && (fmt)->endianness == G_BYTE_ORDER)
+#define IS_NATIVE_FLOAT(fmt)                                            \
+    (!(fmt)->is_int && (fmt)->width == 32 &&                            \
+     (fmt)->endianness == G_BYTE_ORDER)
+
+static AudioConvertFused
+audio_convert_get_fused_func (AudioConvertCtx * ctx)
+{
+  AudioConvertFmt *in = &ctx->in, *out = &ctx->out;
+
+  if (!ctx->mix_passthrough)
+    return NULL;
+
+  if (IS_NATIVE_INT (in, 16, 16) && IS_NATIVE_FLOAT (out))
+    return (AudioConvertFused) MAKE_FUSED_FUNC_NAME (s16_float);
+
+  if (IS_NATIVE_FLOAT (in) && IS_NATIVE_INT (out, 16, 16) &&
+      ctx->ns == NOISE_SHAPING_NONE)
+    return gst_audio_quantize_get_fused_f32_s16 (ctx);
+
+  if (in->is_int && in->sign && in->width == 24 && in->depth == 24 &&
+      IS_NATIVE_INT (out, 32, 32)) {
+    if (in->endianness == G_LITTLE_ENDIAN)
+      return (AudioConvertFused) MAKE_FUSED_FUNC_NAME (s24_le_s32);
+    else
+      return (AudioConvertFused) MAKE_FUSED_FUNC_NAME (s24_be_s32);
+  }
+
+  return NULL;
+}
+
 #define DOUBLE_INTERMEDIATE_FORMAT(ctx)                                 \
     ((!ctx->in.is_int && !ctx->out.is_int) || (ctx->ns != NOISE_SHAPING_NONE))
 
@@ -540,6 +609,10 @@ audio_convert_prepare_context (AudioConvertCtx * ctx, AudioConvertFmt * in,
 
   gst_audio_quantize_setup (ctx);
 
+  /* see if we can do everything in one go */
+  ctx->fused = audio_convert_get_fused_func (ctx);
+  GST_INFO ("use fused conversion %d", ctx->fused != NULL);
+
   return TRUE;
 }
 
@@ -556,6 +629,7 @@ audio_convert_clean_context (AudioConvertCtx * ctx)
   g_free (ctx->tmpbuf);
   ctx->tmpbuf = NULL;
   ctx->tmpbufsize = 0;
+  ctx->fused = NULL;
 
   return TRUE;
 }
@@ -590,6 +664,11 @@ audio_convert_convert (AudioConvertCtx * ctx, gpointer src,
   if (samples == 0)
     return TRUE;
 
+  if (ctx->fused) {
+    ctx->fused (ctx, src, dst, samples);
+    return TRUE;
+  }
+
   insize = ctx->in.unit_size * samples;
   outsize = ctx->out.unit_size * samples;
 
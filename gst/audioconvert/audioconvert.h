@@ -85,6 +85,13 @@ struct _AudioConvertFmt
   gint unit_size;
 };
 
+/* one non-zero coefficient of the channel conversion matrix */
+typedef struct
+{
+  gint in;
+  gfloat coeff;
+} AudioConvertMixTap;
+
 typedef void (*AudioConvertUnpack) (gpointer src, gpointer dst, gint scale,
     gint count);
 typedef void (*AudioConvertPack) (gpointer src, gpointer dst, gint scale,
@@ -93,6 +100,8 @@ typedef void (*AudioConvertPack) (gpointer src, gpointer dst, gint scale,
 typedef void (*AudioConvertMix) (AudioConvertCtx *, gpointer, gpointer, gint);
 typedef void (*AudioConvertQuantize) (AudioConvertCtx * ctx, gpointer src,
     gpointer dst, gint count);
+typedef void (*AudioConvertFused) (AudioConvertCtx * ctx, gpointer src,
+    gpointer dst, gint count);
 
 struct _AudioConvertCtx
 {
@@ -105,6 +114,13 @@ struct _AudioConvertCtx
   /* channel conversion matrix, m[in_channels][out_channels].
    * If identity matrix, passthrough applies. */
   gfloat **matrix;
+  /* sparse form of the matrix used for mixing, the non-zero coefficients
+   * of output channel j are mix_taps[mix_offsets[j]] up to
+   * mix_taps[mix_offsets[j+1]] (exclusive) */
+  AudioConvertMixTap *mix_taps;
+  gint *mix_offsets;
+  /* every output channel has exactly one input channel */
+  gboolean mix_single_tap;
   /* temp storage for channelmix */
   gpointer tmp;
 
@@ -122,10 +138,17 @@ struct _AudioConvertCtx
 
   AudioConvertQuantize quantize;
 
+  /* single pass conversion for common format pairs, replaces the
+   * unpack/mix/quantize/pack chain when set */
+  AudioConvertFused fused;
+
   GstAudioConvertDithering dither;
   GstAudioConvertNoiseShaping ns;
   /* last random number generated per channel for hifreq TPDF dither */
   gpointer last_random;
+  /* dither noise for the samples being quantized */
+  gpointer dither_buf;
+  gint dither_buf_size;
   /* contains the past quantization errors, error[out_channels][count] */
   gdouble *error_buf;
 };
@@ -266,6 +266,10 @@ gst_audio_convert_class_init (GstAudioConvertClass * klass)
       GST_DEBUG_FUNCPTR (gst_audio_convert_transform);
 
   basetransform_class->passthrough_on_same_caps = TRUE;
+
+  klass->caps_cache_lock = g_mutex_new ();
+  klass->caps_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, (GDestroyNotify) gst_caps_unref);
 }
 
 static void
@@ -550,6 +554,84 @@ structure_has_fixed_channel_positions (GstStructure * s,
   return TRUE;
 }
 
+/* Starting many pipelines transforms the same caps over and over again, and
+ * building the transformed caps is expensive, so we keep them around. The
+ * result only depends on the name and these fields of the input structure. */
+#define CAPS_CACHE_MAX_ENTRIES 128
+
+static const gchar *caps_cache_key_fields[] = {
+  "width", "depth", "rate", "channels", "endianness", "signed",
+  "channel-positions"
+};
+
+static gchar *
+gst_audio_convert_caps_cache_key (GstStructure * structure)
+{
+  GstStructure *s;
+  gchar *key;
+  gint i;
+
+  s = gst_structure_empty_new (gst_structure_get_name (structure));
+  for (i = 0; i < G_N_ELEMENTS (caps_cache_key_fields); i++) {
+    const GValue *v;
+
+    v = gst_structure_get_value (structure, caps_cache_key_fields[i]);
+    if (v)
+      gst_structure_set_value (s, caps_cache_key_fields[i], v);
+  }
+  key = gst_structure_to_string (s);
+  gst_structure_free (s);
+
+  return key;
+}
+
+static GstCaps *
+gst_audio_convert_caps_cache_lookup (GstAudioConvertClass * klass,
+    const gchar * key)
+{
+  GstCaps *caps;
+
+  g_mutex_lock (klass->caps_cache_lock);
+  caps = g_hash_table_lookup (klass->caps_cache, key);
+  if (caps)
+    gst_caps_ref (caps);
+  g_mutex_unlock (klass->caps_cache_lock);
+
+  return caps;
+}
+
+/* takes ownership of key */
+static void
+gst_audio_convert_caps_cache_store (GstAudioConvertClass * klass, gchar * key,
+    GstCaps * caps)
+{
+  g_mutex_lock (klass->caps_cache_lock);
+  /* all sorts of caps pass through here, don't grow without bounds */
+  if (g_hash_table_size (klass->caps_cache) >= CAPS_CACHE_MAX_ENTRIES)
+    g_hash_table_remove_all (klass->caps_cache);
+  g_hash_table_replace (klass->caps_cache, key, gst_caps_ref (caps));
+  g_mutex_unlock (klass->caps_cache_lock);
+}
+
+/* The steps below append a structure for every conversion we allow, in order
+ * of preference, and many of them are already covered by an earlier, wider
+ * one. Drop those: they can never be picked before the structure that covers
+ * them, and every structure we hand out is intersected with the peer caps
+ * again and again. Takes ownership of @caps. */
+static GstCaps *
+gst_audio_convert_caps_prune (GstCaps * caps)
+{
+  GstCaps *result;
+  GstStructure *s;
+
+  result = gst_caps_new_empty ();
+  while ((s = gst_caps_steal_structure (caps, 0)))
+    gst_caps_merge_structure (result, s);
+  gst_caps_unref (caps);
+
+  return result;
+}
+
 /* Audioconvert can perform all conversions on audio except for resampling. 
  * However, there are some conversions we _prefer_ not to do. For example, it's
  * better to convert format (float<->int, endianness, etc) than the number of
@@ -573,6 +655,8 @@ gst_audio_convert_transform_caps (GstBaseTransform * base,
     "width", "depth", "rate", "channels", "endianness", "signed"
   };
   const gchar *structure_name;
+  GstAudioConvertClass *klass;
+  gchar *key;
   int i;
 
   g_return_val_if_fail (GST_CAPS_IS_SIMPLE (caps), NULL);
@@ -580,6 +664,15 @@ gst_audio_convert_transform_caps (GstBaseTransform * base,
   structure = gst_caps_get_structure (caps, 0);
   structure_name = gst_structure_get_name (structure);
 
+  /* the transformation does not depend on the direction */
+  klass = GST_AUDIO_CONVERT_GET_CLASS (base);
+  key = gst_audio_convert_caps_cache_key (structure);
+  if ((ret = gst_audio_convert_caps_cache_lookup (klass, key))) {
+    GST_LOG_OBJECT (base, "using cached caps for %s", key);
+    g_free (key);
+    return ret;
+  }
+
   isfloat = strcmp (structure_name, "audio/x-raw-float") == 0;
 
   /* We operate on a version of the original structure with any additional
@@ -702,8 +795,12 @@ gst_audio_convert_transform_caps (GstBaseTransform * base,
   } else
     gst_caps_append_structure (ret, s);
 
+  ret = gst_audio_convert_caps_prune (ret);
+
   GST_DEBUG_OBJECT (base, "Caps transformed to %" GST_PTR_FORMAT, ret);
 
+  gst_audio_convert_caps_cache_store (klass, key, ret);
+
   return ret;
 }
 
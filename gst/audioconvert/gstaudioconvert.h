@@ -33,6 +33,7 @@
 #define GST_AUDIO_CONVERT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_AUDIO_CONVERT,GstAudioConvertClass))
 #define GST_IS_AUDIO_CONVERT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_AUDIO_CONVERT))
 #define GST_IS_AUDIO_CONVERT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_AUDIO_CONVERT))
+#define GST_AUDIO_CONVERT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj),GST_TYPE_AUDIO_CONVERT,GstAudioConvertClass))
 
 typedef struct _GstAudioConvert GstAudioConvert;
 typedef struct _GstAudioConvertClass GstAudioConvertClass;
@@ -55,6 +56,11 @@ struct _GstAudioConvert
 struct _GstAudioConvertClass
 {
   GstBaseTransformClass parent_class;
+
+  /* transformed caps, keyed on the serialized relevant fields of the
+   * input structure, shared by all instances */
+  GMutex *caps_cache_lock;
+  GHashTable *caps_cache;
 };
 
 #endif /* __GST_AUDIO_CONVERT_H__ */
@@ -42,6 +42,10 @@
 #define MAKE_QUANTIZE_FUNC_NAME(name)                                   \
 gst_audio_quantize_quantize_##name
 
+/* The dither noise for a whole buffer is generated at once before
+ * quantizing, see the dither definitions below. This keeps the random
+ * number generator out of the sample loops. */
+
 /* Quantize functions for gint32 as intermediate format */
 
 #define MAKE_QUANTIZE_FUNC_I(name, DITHER_INIT_FUNC, ADD_DITHER_FUNC,   \
@@ -52,7 +56,7 @@ MAKE_QUANTIZE_FUNC_NAME (name) (AudioConvertCtx *ctx, gint32 *src,      \
 {                                                                       \
   gint scale = ctx->out_scale;                                          \
   gint channels = ctx->out.channels;                                    \
-  gint chan_pos;                                                        \
+  gint i, n = count * channels;                                         \
                                                                         \
   if (scale > 0) {                                                      \
     gint32 tmp;                                                         \
@@ -60,64 +64,82 @@ MAKE_QUANTIZE_FUNC_NAME (name) (AudioConvertCtx *ctx, gint32 *src,      \
     guint32 bias = 1U << (scale - 1);                                   \
     DITHER_INIT_FUNC()                                                  \
                                                                         \
-    for (;count;count--) {                                              \
-      for (chan_pos = 0; chan_pos < channels; chan_pos++) {             \
-        tmp = *src++;                                                   \
-        ADD_DITHER_FUNC()                                               \
-        ROUND_FUNC()                                                    \
-        *dst = tmp & mask;                                              \
-        dst++;                                                          \
-      }                                                                 \
-    }                                                                   \
-  } else {                                                              \
-    for (;count;count--) {                                              \
-      for (chan_pos = 0; chan_pos < channels; chan_pos++) {             \
-        *dst = *src++;                                                  \
-        dst++;                                                          \
-      }                                                                 \
+    for (i = 0; i < n; i++) {                                           \
+      tmp = src[i];                                                     \
+      ADD_DITHER_FUNC()                                                 \
+      ROUND_FUNC()                                                      \
+      dst[i] = tmp & mask;                                              \
     }                                                                   \
+  } else if (src != dst) {                                              \
+    memcpy (dst, src, n * sizeof (gint32));                             \
   }                                                                     \
 }
 
+/* Fused conversion from native endian 32 bit float to native endian signed
+ * 16 bit. This does the same as unpacking to int, quantizing with the
+ * functions above and packing, in one pass over the samples. */
+
+#define MAKE_QUANTIZE_FUNC_F32_S16(name, DITHER_INIT_FUNC,              \
+                                   ADD_DITHER_FUNC, ROUND_FUNC)         \
+static void                                                             \
+MAKE_QUANTIZE_FUNC_NAME (name) (AudioConvertCtx *ctx, gfloat *src,      \
+                                gint16 *dst, gint count)                \
+{                                                                       \
+  gint scale = ctx->out_scale;                                          \
+  gint channels = ctx->out.channels;                                    \
+  gint i, n = count * channels;                                         \
+  gdouble temp;                                                         \
+  gint32 tmp;                                                           \
+  guint32 bias = 1U << (scale - 1);                                     \
+  DITHER_INIT_FUNC()                                                    \
+                                                                        \
+  for (i = 0; i < n; i++) {                                             \
+    temp = floor ((src[i] * 2147483647.0) + 0.5);                       \
+    tmp = (gint32) CLAMP (temp, G_MININT32, G_MAXINT32);                \
+    ADD_DITHER_FUNC()                                                   \
+    ROUND_FUNC()                                                        \
+    dst[i] = (gint16) (tmp >> scale);                                   \
+  }                                                                     \
+}
 
 /* Quantize functions for gdouble as intermediate format with
- * int as target */
+ * int as target.
+ *
+ * The noise shaping filters run over one channel at a time so that the
+ * error history of the channel can be kept in local variables. */
 
 #define MAKE_QUANTIZE_FUNC_F(name, DITHER_INIT_FUNC, NS_INIT_FUNC,      \
                              ADD_NS_FUNC, ADD_DITHER_FUNC,              \
-                             UPDATE_ERROR_FUNC)                         \
+                             UPDATE_ERROR_FUNC, NS_DONE_FUNC)           \
 static void                                                             \
 MAKE_QUANTIZE_FUNC_NAME (name) (AudioConvertCtx *ctx, gdouble *src,     \
                                 gdouble *dst, gint count)               \
 {                                                                       \
   gint scale = ctx->out_scale;                                          \
   gint channels = ctx->out.channels;                                    \
-  gint chan_pos;                                                        \
+  gint chan_pos, i, n = count * channels;                               \
   gdouble factor = (1U<<(32-scale-1)) - 1;                              \
                                                                         \
   if (scale > 0) {                                                      \
-    gdouble tmp;                                                        \
+    gdouble tmp, orig;                                                  \
     DITHER_INIT_FUNC()                                                  \
-    NS_INIT_FUNC()                                                      \
                                                                         \
-    for (;count;count--) {                                              \
-      for (chan_pos = 0; chan_pos < channels; chan_pos++) {             \
-        tmp = *src++;                                                   \
+    for (chan_pos = 0; chan_pos < channels; chan_pos++) {               \
+      NS_INIT_FUNC()                                                    \
+                                                                        \
+      for (i = chan_pos; i < n; i += channels) {                        \
+        tmp = src[i];                                                   \
         ADD_NS_FUNC()                                                   \
         ADD_DITHER_FUNC()                                               \
         tmp = floor(tmp * factor + 0.5);                                \
-        *dst = CLAMP (tmp, -factor - 1, factor);                        \
+        dst[i] = CLAMP (tmp, -factor - 1, factor);                      \
         UPDATE_ERROR_FUNC()                                             \
-        dst++;                                                          \
       }                                                                 \
+      NS_DONE_FUNC()                                                    \
     }                                                                   \
   } else {                                                              \
-    for (;count;count--) {                                              \
-      for (chan_pos = 0; chan_pos < channels; chan_pos++) {             \
-        *dst = *src++ * 2147483647.0;                                   \
-        dst++;                                                          \
-      }                                                                 \
-    }                                                                   \
+    for (i = 0; i < n; i++)                                             \
+      dst[i] = src[i] * 2147483647.0;                                   \
   }                                                                     \
 }
 
@@ -141,115 +163,239 @@ MAKE_QUANTIZE_FUNC_NAME (name) (AudioConvertCtx *ctx, gdouble *src,     \
  * We already add the rounding offset to the dither noise here
  * to have only one overflow check instead of two. */
 
-#define INIT_DITHER_RPDF_I()                                            \
-  gint32 rand;                                                          \
-  gint32 dither = (1<<(scale));
+static gpointer
+gst_audio_quantize_get_dither_buf (AudioConvertCtx * ctx, gint size)
+{
+  if (size > ctx->dither_buf_size) {
+    ctx->dither_buf = g_realloc (ctx->dither_buf, size);
+    ctx->dither_buf_size = size;
+  }
+  return ctx->dither_buf;
+}
+
+/* n random values in [start, end) */
+static gint32 *
+gst_audio_quantize_rpdf_int (AudioConvertCtx * ctx, gint n, gint32 start,
+    gint32 end)
+{
+  gint32 *noise;
+  guint32 *rand;
+  gint i;
+
+  noise = gst_audio_quantize_get_dither_buf (ctx, n * sizeof (gint32));
+  rand = (guint32 *) noise;
+
+  gst_fast_random_uint32_fill (rand, n);
+  for (i = 0; i < n; i++)
+    noise[i] = gst_fast_random_int32_scale (rand[i], start, end);
+
+  return noise;
+}
+
+/* n sums of two random values in [start, end) */
+static gint32 *
+gst_audio_quantize_tpdf_int (AudioConvertCtx * ctx, gint n, gint32 start,
+    gint32 end)
+{
+  gint32 *noise;
+  guint32 *rand;
+  gint i;
+
+  noise = gst_audio_quantize_get_dither_buf (ctx, 2 * n * sizeof (gint32));
+  rand = (guint32 *) noise;
+
+  /* we only ever write behind what we read */
+  gst_fast_random_uint32_fill (rand, 2 * n);
+  for (i = 0; i < n; i++)
+    noise[i] = gst_fast_random_int32_scale (rand[2 * i], start, end)
+        + gst_fast_random_int32_scale (rand[2 * i + 1], start, end);
 
-#define ADD_DITHER_RPDF_I()                                             \
-        rand = gst_fast_random_int32_range (bias - dither,              \
-	    bias + dither);                                             \
-        if (rand > 0 && tmp > 0 && G_MAXINT32 - tmp <= rand)            \
+  return noise;
+}
+
+/* n differences between a random value in [start, end) and the previous one
+ * of the same channel */
+static gint32 *
+gst_audio_quantize_tpdf_hf_int (AudioConvertCtx * ctx, gint n, gint32 start,
+    gint32 end)
+{
+  gint channels = ctx->out.channels;
+  gint32 *last_random = (gint32 *) ctx->last_random;
+  gint32 *noise, *last;
+  guint32 *rand;
+  gint i;
+
+  noise = gst_audio_quantize_get_dither_buf (ctx,
+      (n + channels) * sizeof (gint32));
+  rand = (guint32 *) noise;
+  last = noise + n;
+
+  gst_fast_random_uint32_fill (rand, n);
+  for (i = 0; i < n; i++)
+    noise[i] = gst_fast_random_int32_scale (rand[i], start, end);
+
+  memcpy (last, noise + n - channels, channels * sizeof (gint32));
+  for (i = n - 1; i >= channels; i--)
+    noise[i] -= noise[i - channels];
+  for (i = 0; i < channels; i++)
+    noise[i] -= last_random[i];
+  memcpy (last_random, last, channels * sizeof (gint32));
+
+  return noise;
+}
+
+/* n random values in [start, end] */
+static gdouble *
+gst_audio_quantize_rpdf_float (AudioConvertCtx * ctx, gint n, gdouble start,
+    gdouble end)
+{
+  gdouble *noise;
+  guint32 *rand;
+  gint i;
+
+  noise = gst_audio_quantize_get_dither_buf (ctx,
+      n * (sizeof (gdouble) + 2 * sizeof (guint32)));
+  rand = (guint32 *) (noise + n);
+
+  gst_fast_random_uint32_fill (rand, 2 * n);
+  for (i = 0; i < n; i++)
+    noise[i] = gst_fast_random_double_scale (rand[2 * i], rand[2 * i + 1],
+        start, end);
+
+  return noise;
+}
+
+/* n sums of two random values in [start, end] */
+static gdouble *
+gst_audio_quantize_tpdf_float (AudioConvertCtx * ctx, gint n, gdouble start,
+    gdouble end)
+{
+  gdouble *noise;
+  guint32 *rand;
+  gint i;
+
+  noise = gst_audio_quantize_get_dither_buf (ctx,
+      n * (sizeof (gdouble) + 4 * sizeof (guint32)));
+  rand = (guint32 *) (noise + n);
+
+  gst_fast_random_uint32_fill (rand, 4 * n);
+  for (i = 0; i < n; i++)
+    noise[i] = gst_fast_random_double_scale (rand[4 * i], rand[4 * i + 1],
+        start, end) + gst_fast_random_double_scale (rand[4 * i + 2],
+        rand[4 * i + 3], start, end);
+
+  return noise;
+}
+
+/* n differences between a random value in [start, end] and the previous one
+ * of the same channel */
+static gdouble *
+gst_audio_quantize_tpdf_hf_float (AudioConvertCtx * ctx, gint n,
+    gdouble start, gdouble end)
+{
+  gint channels = ctx->out.channels;
+  gdouble *last_random = (gdouble *) ctx->last_random;
+  gdouble *noise, *last;
+  gint i;
+
+  noise = gst_audio_quantize_rpdf_float (ctx, n + channels, start, end);
+  last = noise + n;
+
+  memcpy (last, noise + n - channels, channels * sizeof (gdouble));
+  for (i = n - 1; i >= channels; i--)
+    noise[i] -= noise[i - channels];
+  for (i = 0; i < channels; i++)
+    noise[i] -= last_random[i];
+  memcpy (last_random, last, channels * sizeof (gdouble));
+
+  return noise;
+}
+
+#define ADD_DITHER_I()                                                  \
+        if (noise[i] > 0 && tmp > 0 && G_MAXINT32 - tmp <= noise[i])    \
                 tmp = G_MAXINT32;                                       \
-        else if (rand < 0 && tmp < 0 && G_MININT32 - tmp >= rand)       \
+        else if (noise[i] < 0 && tmp < 0 && G_MININT32 - tmp >= noise[i])\
                 tmp = G_MININT32;                                       \
         else                                                            \
-                tmp += rand;
+                tmp += noise[i];
 
-#define INIT_DITHER_RPDF_F()                                            \
-  gdouble dither = 1.0/(1U<<(32 - scale - 1));
+#define ADD_DITHER_F()                                                  \
+        tmp += noise[i];
 
-#define ADD_DITHER_RPDF_F()                                             \
-        tmp += gst_fast_random_double_range (- dither, dither);
+#define INIT_DITHER_RPDF_I()                                            \
+  gint32 dither = (1<<(scale));                                         \
+  gint32 *noise = gst_audio_quantize_rpdf_int (ctx, n,                  \
+      bias - dither, bias + dither);
+
+#define INIT_DITHER_RPDF_F()                                            \
+  gdouble dither = 1.0/(1U<<(32 - scale - 1));                          \
+  gdouble *noise = gst_audio_quantize_rpdf_float (ctx, n,               \
+      - dither, dither);
 
 #define INIT_DITHER_TPDF_I()                                            \
-  gint32 rand;                                                          \
   gint32 dither = (1<<(scale - 1));                                     \
-  bias = bias >> 1;
-
-#define ADD_DITHER_TPDF_I()                                             \
-        rand = gst_fast_random_int32_range (bias - dither,              \
-                   bias + dither - 1)                                   \
-               + gst_fast_random_int32_range (bias - dither,            \
-                   bias + dither - 1);                                  \
-        if (rand > 0 && tmp > 0 && G_MAXINT32 - tmp <= rand)            \
-                tmp = G_MAXINT32;                                       \
-        else if (rand < 0 && tmp < 0 && G_MININT32 - tmp >= rand)       \
-                tmp = G_MININT32;                                       \
-        else                                                            \
-                tmp += rand;
+  gint32 *noise = gst_audio_quantize_tpdf_int (ctx, n,                  \
+      (bias >> 1) - dither, (bias >> 1) + dither);
 
 #define INIT_DITHER_TPDF_F()                                            \
-  gdouble dither = 1.0/(1U<<(32 - scale));
+  gdouble dither = 1.0/(1U<<(32 - scale));                              \
+  gdouble *noise = gst_audio_quantize_tpdf_float (ctx, n,               \
+      - dither, dither);
 
-#define ADD_DITHER_TPDF_F()                                             \
-        tmp += gst_fast_random_double_range (- dither, dither)          \
-               + gst_fast_random_double_range (- dither, dither);
+/* Like TPDF dither but the dither noise is oriented more to the
+ * higher frequencies */
 
 #define INIT_DITHER_TPDF_HF_I()                                         \
-  gint32 rand;                                                          \
   gint32 dither = (1<<(scale-1));                                       \
-  gint32 *last_random = (gint32 *) ctx->last_random, tmp_rand;          \
-  bias = bias >> 1;
-
-#define ADD_DITHER_TPDF_HF_I()                                          \
-        tmp_rand = gst_fast_random_int32_range (bias - dither,          \
-                       bias + dither);                                  \
-        rand = tmp_rand - last_random[chan_pos];                        \
-        last_random[chan_pos] = tmp_rand;                               \
-        if (rand > 0 && tmp > 0 && G_MAXINT32 - tmp <= rand)            \
-                tmp = G_MAXINT32;                                       \
-        else if (rand < 0 && tmp < 0 && G_MININT32 - tmp >= rand)       \
-                tmp = G_MININT32;                                       \
-        else                                                            \
-                tmp += rand;
-
-/* Like TPDF dither but the dither noise is oriented more to the
- * higher frequencies */
+  gint32 *noise = gst_audio_quantize_tpdf_hf_int (ctx, n,               \
+      (bias >> 1) - dither, (bias >> 1) + dither);
 
 #define INIT_DITHER_TPDF_HF_F()                                         \
-  gdouble rand;                                                         \
   gdouble dither = 1.0/(1U<<(32 - scale));                              \
-  gdouble *last_random = (gdouble *) ctx->last_random, tmp_rand;
-
-#define ADD_DITHER_TPDF_HF_F()                                          \
-        tmp_rand = gst_fast_random_double_range (- dither, dither);     \
-        rand = tmp_rand - last_random[chan_pos];                        \
-        last_random[chan_pos] = tmp_rand;                               \
-        tmp += rand;
+  gdouble *noise = gst_audio_quantize_tpdf_hf_float (ctx, n,            \
+      - dither, dither);
 
 /* Noise shaping definitions.
- * See http://en.wikipedia.org/wiki/Noise_shaping for explanations. */
+ * See http://en.wikipedia.org/wiki/Noise_shaping for explanations.
+ *
+ * The error history of the current channel is loaded into local variables
+ * by the INIT function and stored back by the DONE function. */
 
 
 /* Simple error feedback: Just accumulate the dithering and quantization
  * error and remove it from each sample. */
 
 #define INIT_NS_ERROR_FEEDBACK()                                        \
-  gdouble orig;                                                         \
-  gdouble *errors = ctx->error_buf;
+  gdouble error = ctx->error_buf[chan_pos];
 
 #define ADD_NS_ERROR_FEEDBACK()                                         \
         orig = tmp;                                                     \
-        tmp -= errors[chan_pos];
+        tmp -= error;
 
 #define UPDATE_ERROR_ERROR_FEEDBACK()                                   \
-        errors[chan_pos] += (*dst)/factor - orig;
+        error += dst[i]/factor - orig;
+
+#define DONE_NS_ERROR_FEEDBACK()                                        \
+  ctx->error_buf[chan_pos] = error;
 
 /* Same as error feedback but also add 1/2 of the previous error value.
  * This moves the noise a bit more into the higher frequencies. */
 
 #define INIT_NS_SIMPLE()                                                \
-  gdouble orig;                                                         \
-  gdouble *errors = ctx->error_buf, cur_error;
+  gdouble error0 = ctx->error_buf[chan_pos*2];                          \
+  gdouble error1 = ctx->error_buf[chan_pos*2 + 1];
 
 #define ADD_NS_SIMPLE()                                                 \
-        cur_error = errors[chan_pos*2] - 0.5 * errors[chan_pos*2 + 1];  \
-        tmp -= cur_error;                                               \
+        tmp -= error0 - 0.5 * error1;                                   \
         orig = tmp;
 
 #define UPDATE_ERROR_SIMPLE()                                           \
-        errors[chan_pos*2 + 1] = errors[chan_pos*2];                    \
-        errors[chan_pos*2] = (*dst)/factor - orig;
+        error1 = error0;                                                \
+        error0 = dst[i]/factor - orig;
+
+#define DONE_NS_SIMPLE()                                                \
+  ctx->error_buf[chan_pos*2] = error0;                                  \
+  ctx->error_buf[chan_pos*2 + 1] = error1;
 
 
 /* Noise shaping coefficients from[1], moves most power of the
@@ -265,21 +411,24 @@ static const gdouble ns_medium_coeffs[] = {
 };
 
 #define INIT_NS_MEDIUM()                                                \
-  gdouble orig;                                                         \
-  gdouble *errors = ctx->error_buf, cur_error;                          \
-  int j;
+  gdouble errors[5], cur_error;                                         \
+  int j;                                                                \
+  memcpy (errors, ctx->error_buf + chan_pos*5, sizeof (errors));
 
 #define ADD_NS_MEDIUM()                                                 \
         cur_error = 0.0;                                                \
         for (j = 0; j < 5; j++)                                         \
-          cur_error += errors[chan_pos*5 + j] * ns_medium_coeffs[j];    \
+          cur_error += errors[j] * ns_medium_coeffs[j];                 \
         tmp -= cur_error;                                               \
         orig = tmp;
 
 #define UPDATE_ERROR_MEDIUM()                                           \
         for (j = 4; j > 0; j--)                                         \
-          errors[chan_pos*5 + j] = errors[chan_pos*5 + j-1];            \
-        errors[chan_pos*5] = (*dst)/factor - orig;
+          errors[j] = errors[j-1];                                      \
+        errors[0] = dst[i]/factor - orig;
+
+#define DONE_NS_MEDIUM()                                                \
+  memcpy (ctx->error_buf + chan_pos*5, errors, sizeof (errors));
 
 /* Noise shaping coefficients by David Schleef, moves most power of the
  * error noise into inaudible frequency ranges */
@@ -289,78 +438,91 @@ static const gdouble ns_high_coeffs[] = {
 };
 
 #define INIT_NS_HIGH()                                                  \
-  gdouble orig;                                                         \
-  gdouble *errors = ctx->error_buf, cur_error;                          \
-  int j;
+  gdouble errors[8], cur_error;                                         \
+  int j;                                                                \
+  memcpy (errors, ctx->error_buf + chan_pos*8, sizeof (errors));
 
 #define ADD_NS_HIGH()                                                   \
         cur_error = 0.0;                                                \
         for (j = 0; j < 8; j++)                                         \
-          cur_error += errors[chan_pos + j] * ns_high_coeffs[j];          \
+          cur_error += errors[j] * ns_high_coeffs[j];                   \
         tmp -= cur_error;                                               \
         orig = tmp;
 
 #define UPDATE_ERROR_HIGH()                                             \
         for (j = 7; j > 0; j--)                                         \
-          errors[chan_pos + j] = errors[chan_pos + j-1];                \
-        errors[chan_pos] = (*dst)/factor - orig;
+          errors[j] = errors[j-1];                                      \
+        errors[0] = dst[i]/factor - orig;
+
+#define DONE_NS_HIGH()                                                  \
+  memcpy (ctx->error_buf + chan_pos*8, errors, sizeof (errors));
 
 
 MAKE_QUANTIZE_FUNC_I (signed_none_none, NONE_FUNC, NONE_FUNC, ROUND);
-MAKE_QUANTIZE_FUNC_I (signed_rpdf_none, INIT_DITHER_RPDF_I, ADD_DITHER_RPDF_I,
+MAKE_QUANTIZE_FUNC_I (signed_rpdf_none, INIT_DITHER_RPDF_I, ADD_DITHER_I,
     NONE_FUNC);
-MAKE_QUANTIZE_FUNC_I (signed_tpdf_none, INIT_DITHER_TPDF_I, ADD_DITHER_TPDF_I,
+MAKE_QUANTIZE_FUNC_I (signed_tpdf_none, INIT_DITHER_TPDF_I, ADD_DITHER_I,
     NONE_FUNC);
 MAKE_QUANTIZE_FUNC_I (signed_tpdf_hf_none, INIT_DITHER_TPDF_HF_I,
-    ADD_DITHER_TPDF_HF_I, NONE_FUNC);
+    ADD_DITHER_I, NONE_FUNC);
 
 MAKE_QUANTIZE_FUNC_I (unsigned_none_none, NONE_FUNC, NONE_FUNC, ROUND);
-MAKE_QUANTIZE_FUNC_I (unsigned_rpdf_none, INIT_DITHER_RPDF_I, ADD_DITHER_RPDF_I,
+MAKE_QUANTIZE_FUNC_I (unsigned_rpdf_none, INIT_DITHER_RPDF_I, ADD_DITHER_I,
     NONE_FUNC);
-MAKE_QUANTIZE_FUNC_I (unsigned_tpdf_none, INIT_DITHER_TPDF_I, ADD_DITHER_TPDF_I,
+MAKE_QUANTIZE_FUNC_I (unsigned_tpdf_none, INIT_DITHER_TPDF_I, ADD_DITHER_I,
     NONE_FUNC);
 MAKE_QUANTIZE_FUNC_I (unsigned_tpdf_hf_none, INIT_DITHER_TPDF_HF_I,
-    ADD_DITHER_TPDF_HF_I, NONE_FUNC);
+    ADD_DITHER_I, NONE_FUNC);
+
+MAKE_QUANTIZE_FUNC_F32_S16 (f32_s16_none, NONE_FUNC, NONE_FUNC, ROUND);
+MAKE_QUANTIZE_FUNC_F32_S16 (f32_s16_rpdf, INIT_DITHER_RPDF_I,
+    ADD_DITHER_I, NONE_FUNC);
+MAKE_QUANTIZE_FUNC_F32_S16 (f32_s16_tpdf, INIT_DITHER_TPDF_I,
+    ADD_DITHER_I, NONE_FUNC);
+MAKE_QUANTIZE_FUNC_F32_S16 (f32_s16_tpdf_hf, INIT_DITHER_TPDF_HF_I,
+    ADD_DITHER_I, NONE_FUNC);
 
 MAKE_QUANTIZE_FUNC_F (float_none_error_feedback, NONE_FUNC,
     INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, NONE_FUNC,
-    UPDATE_ERROR_ERROR_FEEDBACK);
+    UPDATE_ERROR_ERROR_FEEDBACK, DONE_NS_ERROR_FEEDBACK);
 MAKE_QUANTIZE_FUNC_F (float_none_simple, NONE_FUNC, INIT_NS_SIMPLE,
-    ADD_NS_SIMPLE, NONE_FUNC, UPDATE_ERROR_SIMPLE);
+    ADD_NS_SIMPLE, NONE_FUNC, UPDATE_ERROR_SIMPLE, DONE_NS_SIMPLE);
 MAKE_QUANTIZE_FUNC_F (float_none_medium, NONE_FUNC, INIT_NS_MEDIUM,
-    ADD_NS_MEDIUM, NONE_FUNC, UPDATE_ERROR_MEDIUM);
+    ADD_NS_MEDIUM, NONE_FUNC, UPDATE_ERROR_MEDIUM, DONE_NS_MEDIUM);
 MAKE_QUANTIZE_FUNC_F (float_none_high, NONE_FUNC, INIT_NS_HIGH, ADD_NS_HIGH,
-    NONE_FUNC, UPDATE_ERROR_HIGH);
+    NONE_FUNC, UPDATE_ERROR_HIGH, DONE_NS_HIGH);
 
 MAKE_QUANTIZE_FUNC_F (float_rpdf_error_feedback, INIT_DITHER_RPDF_F,
-    INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, ADD_DITHER_RPDF_F,
-    UPDATE_ERROR_ERROR_FEEDBACK);
+    INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, ADD_DITHER_F,
+    UPDATE_ERROR_ERROR_FEEDBACK, DONE_NS_ERROR_FEEDBACK);
 MAKE_QUANTIZE_FUNC_F (float_rpdf_simple, INIT_DITHER_RPDF_F, INIT_NS_SIMPLE,
-    ADD_NS_SIMPLE, ADD_DITHER_RPDF_F, UPDATE_ERROR_SIMPLE);
+    ADD_NS_SIMPLE, ADD_DITHER_F, UPDATE_ERROR_SIMPLE, DONE_NS_SIMPLE);
 MAKE_QUANTIZE_FUNC_F (float_rpdf_medium, INIT_DITHER_RPDF_F, INIT_NS_MEDIUM,
-    ADD_NS_MEDIUM, ADD_DITHER_RPDF_F, UPDATE_ERROR_MEDIUM);
+    ADD_NS_MEDIUM, ADD_DITHER_F, UPDATE_ERROR_MEDIUM, DONE_NS_MEDIUM);
 MAKE_QUANTIZE_FUNC_F (float_rpdf_high, INIT_DITHER_RPDF_F, INIT_NS_HIGH,
-    ADD_NS_HIGH, ADD_DITHER_RPDF_F, UPDATE_ERROR_HIGH);
+    ADD_NS_HIGH, ADD_DITHER_F, UPDATE_ERROR_HIGH, DONE_NS_HIGH);
 
 MAKE_QUANTIZE_FUNC_F (float_tpdf_error_feedback, INIT_DITHER_TPDF_F,
-    INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, ADD_DITHER_TPDF_F,
-    UPDATE_ERROR_ERROR_FEEDBACK);
+    INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, ADD_DITHER_F,
+    UPDATE_ERROR_ERROR_FEEDBACK, DONE_NS_ERROR_FEEDBACK);
 MAKE_QUANTIZE_FUNC_F (float_tpdf_simple, INIT_DITHER_TPDF_F, INIT_NS_SIMPLE,
-    ADD_NS_SIMPLE, ADD_DITHER_TPDF_F, UPDATE_ERROR_SIMPLE);
+    ADD_NS_SIMPLE, ADD_DITHER_F, UPDATE_ERROR_SIMPLE, DONE_NS_SIMPLE);
 MAKE_QUANTIZE_FUNC_F (float_tpdf_medium, INIT_DITHER_TPDF_F, INIT_NS_MEDIUM,
-    ADD_NS_MEDIUM, ADD_DITHER_TPDF_F, UPDATE_ERROR_MEDIUM);
+    ADD_NS_MEDIUM, ADD_DITHER_F, UPDATE_ERROR_MEDIUM, DONE_NS_MEDIUM);
 MAKE_QUANTIZE_FUNC_F (float_tpdf_high, INIT_DITHER_TPDF_F, INIT_NS_HIGH,
-    ADD_NS_HIGH, ADD_DITHER_TPDF_F, UPDATE_ERROR_HIGH);
+    ADD_NS_HIGH, ADD_DITHER_F, UPDATE_ERROR_HIGH, DONE_NS_HIGH);
 
 MAKE_QUANTIZE_FUNC_F (float_tpdf_hf_error_feedback, INIT_DITHER_TPDF_HF_F,
-    INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, ADD_DITHER_TPDF_HF_F,
-    UPDATE_ERROR_ERROR_FEEDBACK);
+    INIT_NS_ERROR_FEEDBACK, ADD_NS_ERROR_FEEDBACK, ADD_DITHER_F,
+    UPDATE_ERROR_ERROR_FEEDBACK, DONE_NS_ERROR_FEEDBACK);
 MAKE_QUANTIZE_FUNC_F (float_tpdf_hf_simple, INIT_DITHER_TPDF_HF_F,
-    INIT_NS_SIMPLE, ADD_NS_SIMPLE, ADD_DITHER_TPDF_HF_F, UPDATE_ERROR_SIMPLE);
+    INIT_NS_SIMPLE, ADD_NS_SIMPLE, ADD_DITHER_F, UPDATE_ERROR_SIMPLE,
+    DONE_NS_SIMPLE);
 MAKE_QUANTIZE_FUNC_F (float_tpdf_hf_medium, INIT_DITHER_TPDF_HF_F,
-    INIT_NS_MEDIUM, ADD_NS_MEDIUM, ADD_DITHER_TPDF_HF_F, UPDATE_ERROR_MEDIUM);
+    INIT_NS_MEDIUM, ADD_NS_MEDIUM, ADD_DITHER_F, UPDATE_ERROR_MEDIUM,
+    DONE_NS_MEDIUM);
 MAKE_QUANTIZE_FUNC_F (float_tpdf_hf_high, INIT_DITHER_TPDF_HF_F, INIT_NS_HIGH,
-    ADD_NS_HIGH, ADD_DITHER_TPDF_HF_F, UPDATE_ERROR_HIGH);
+    ADD_NS_HIGH, ADD_DITHER_F, UPDATE_ERROR_HIGH, DONE_NS_HIGH);
 
 static AudioConvertQuantize quantize_funcs[] = {
   (AudioConvertQuantize) MAKE_QUANTIZE_FUNC_NAME (signed_none_none),
@@ -389,6 +551,13 @@ static AudioConvertQuantize quantize_funcs[] = {
   (AudioConvertQuantize) MAKE_QUANTIZE_FUNC_NAME (float_tpdf_hf_high)
 };
 
+static AudioConvertFused fused_f32_s16_funcs[] = {
+  (AudioConvertFused) MAKE_QUANTIZE_FUNC_NAME (f32_s16_none),
+  (AudioConvertFused) MAKE_QUANTIZE_FUNC_NAME (f32_s16_rpdf),
+  (AudioConvertFused) MAKE_QUANTIZE_FUNC_NAME (f32_s16_tpdf),
+  (AudioConvertFused) MAKE_QUANTIZE_FUNC_NAME (f32_s16_tpdf_hf)
+};
+
 static void
 gst_audio_quantize_setup_noise_shaping (AudioConvertCtx * ctx)
 {
@@ -495,9 +664,23 @@ gst_audio_quantize_setup (AudioConvertCtx * ctx)
   return TRUE;
 }
 
+/* returns the fused float to signed 16 bit conversion function for the
+ * dither method of @ctx, noise shaping is not supported */
+AudioConvertFused
+gst_audio_quantize_get_fused_f32_s16 (AudioConvertCtx * ctx)
+{
+  g_return_val_if_fail (ctx->ns == NOISE_SHAPING_NONE, NULL);
+
+  return fused_f32_s16_funcs[ctx->dither];
+}
+
 void
 gst_audio_quantize_free (AudioConvertCtx * ctx)
 {
   gst_audio_quantize_free_dither (ctx);
   gst_audio_quantize_free_noise_shaping (ctx);
+
+  g_free (ctx->dither_buf);
+  ctx->dither_buf = NULL;
+  ctx->dither_buf_size = 0;
 }
@@ -30,5 +30,7 @@ gboolean gst_audio_quantize_setup (AudioConvertCtx * ctx);
 void gst_audio_quantize_reset (AudioConvertCtx * ctx);
 void gst_audio_quantize_free (AudioConvertCtx * ctx);
 
+AudioConvertFused gst_audio_quantize_get_fused_f32_s16 (AudioConvertCtx * ctx);
+
 
 #endif /* __GST_AUDIO_QUANTIZE_H__ */
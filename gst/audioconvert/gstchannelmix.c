@@ -49,6 +49,10 @@ gst_channel_mix_unset_matrix (AudioConvertCtx * this)
   g_free (this->matrix);
 
   this->matrix = NULL;
+  g_free (this->mix_taps);
+  this->mix_taps = NULL;
+  g_free (this->mix_offsets);
+  this->mix_offsets = NULL;
   g_free (this->tmp);
   this->tmp = NULL;
 }
@@ -591,6 +595,42 @@ gst_channel_mix_fill_matrix (AudioConvertCtx * this)
   }
 }
 
+/*
+ * Build the sparse form of the matrix we actually mix with. Downmixing
+ * matrices are mostly zeros, e.g. 5.1 to stereo only has 3 or 4 non-zero
+ * coefficients per output channel instead of 6, and remapping or upmixing
+ * only has a single one.
+ */
+
+static void
+gst_channel_mix_compile_matrix (AudioConvertCtx * this)
+{
+  gint i, j, n_taps;
+
+  this->mix_offsets = g_new (gint, this->out.channels + 1);
+  this->mix_taps = g_new (AudioConvertMixTap,
+      MAX (this->in.channels * this->out.channels, 1));
+  this->mix_single_tap = TRUE;
+
+  n_taps = 0;
+  for (j = 0; j < this->out.channels; j++) {
+    this->mix_offsets[j] = n_taps;
+    for (i = 0; i < this->in.channels; i++) {
+      if (this->matrix[i][j] == 0.)
+        continue;
+      this->mix_taps[n_taps].in = i;
+      this->mix_taps[n_taps].coeff = this->matrix[i][j];
+      n_taps++;
+    }
+    if (n_taps - this->mix_offsets[j] != 1)
+      this->mix_single_tap = FALSE;
+  }
+  this->mix_offsets[j] = n_taps;
+
+  GST_DEBUG ("%d non-zero coefficients, single tap %d", n_taps,
+      this->mix_single_tap);
+}
+
 /* only call after this->out and this->in are filled in */
 void
 gst_channel_mix_setup_matrix (AudioConvertCtx * this)
@@ -617,6 +657,7 @@ gst_channel_mix_setup_matrix (AudioConvertCtx * this)
 
   /* setup the matrix' internal values */
   gst_channel_mix_fill_matrix (this);
+  gst_channel_mix_compile_matrix (this);
 
 #ifndef GST_DISABLE_GST_DEBUG
   /* debug */
@@ -662,40 +703,59 @@ gst_channel_mix_passthrough (AudioConvertCtx * this)
 }
 
 /* IMPORTANT: out_data == in_data is possible, make sure to not overwrite data
- * you might need later on! */
+ * you might need later on!
+ *
+ * Zero coefficients are skipped, which does not change the result as each
+ * product is accumulated separately. */
 void
 gst_channel_mix_mix_int (AudioConvertCtx * this,
     gint32 * in_data, gint32 * out_data, gint samples)
 {
-  gint in, out, n;
+  gint out, n, t;
   gint64 res;
   gboolean backwards;
   gint inchannels, outchannels;
   gint32 *tmp = (gint32 *) this->tmp;
+  const AudioConvertMixTap *taps = this->mix_taps;
+  const gint *offsets = this->mix_offsets;
+  const gint32 *in;
 
-  g_return_if_fail (this->matrix != NULL);
+  g_return_if_fail (this->mix_taps != NULL);
   g_return_if_fail (this->tmp != NULL);
 
   inchannels = this->in.channels;
   outchannels = this->out.channels;
   backwards = outchannels > inchannels;
 
-  /* FIXME: use liboil here? */
   for (n = (backwards ? samples - 1 : 0); n < samples && n >= 0;
       backwards ? n-- : n++) {
-    for (out = 0; out < outchannels; out++) {
-      /* convert */
-      res = 0;
-      for (in = 0; in < inchannels; in++) {
-        res += in_data[n * inchannels + in] * this->matrix[in][out];
+    in = &in_data[n * inchannels];
+
+    if (this->mix_single_tap) {
+      /* remapping, selecting or duplicating channels */
+      for (out = 0; out < outchannels; out++) {
+        res = in[taps[out].in] * taps[out].coeff;
+
+        if (res < G_MININT32)
+          res = G_MININT32;
+        else if (res > G_MAXINT32)
+          res = G_MAXINT32;
+        tmp[out] = res;
+      }
+    } else {
+      for (out = 0; out < outchannels; out++) {
+        /* convert */
+        res = 0;
+        for (t = offsets[out]; t < offsets[out + 1]; t++)
+          res += in[taps[t].in] * taps[t].coeff;
+
+        /* clip (shouldn't we use doubles instead as intermediate format?) */
+        if (res < G_MININT32)
+          res = G_MININT32;
+        else if (res > G_MAXINT32)
+          res = G_MAXINT32;
+        tmp[out] = res;
       }
-
-      /* clip (shouldn't we use doubles instead as intermediate format?) */
-      if (res < G_MININT32)
-        res = G_MININT32;
-      else if (res > G_MAXINT32)
-        res = G_MAXINT32;
-      tmp[out] = res;
     }
     memcpy (&out_data[n * outchannels], this->tmp,
         sizeof (gint32) * outchannels);
@@ -706,35 +766,51 @@ void
 gst_channel_mix_mix_float (AudioConvertCtx * this,
     gdouble * in_data, gdouble * out_data, gint samples)
 {
-  gint in, out, n;
+  gint out, n, t;
   gdouble res;
   gboolean backwards;
   gint inchannels, outchannels;
   gdouble *tmp = (gdouble *) this->tmp;
+  const AudioConvertMixTap *taps = this->mix_taps;
+  const gint *offsets = this->mix_offsets;
+  const gdouble *in;
 
-  g_return_if_fail (this->matrix != NULL);
+  g_return_if_fail (this->mix_taps != NULL);
   g_return_if_fail (this->tmp != NULL);
 
   inchannels = this->in.channels;
   outchannels = this->out.channels;
   backwards = outchannels > inchannels;
 
-  /* FIXME: use liboil here? */
   for (n = (backwards ? samples - 1 : 0); n < samples && n >= 0;
       backwards ? n-- : n++) {
-    for (out = 0; out < outchannels; out++) {
-      /* convert */
-      res = 0.0;
-      for (in = 0; in < inchannels; in++) {
-        res += in_data[n * inchannels + in] * this->matrix[in][out];
+    in = &in_data[n * inchannels];
+
+    if (this->mix_single_tap) {
+      /* remapping, selecting or duplicating channels */
+      for (out = 0; out < outchannels; out++) {
+        res = in[taps[out].in] * taps[out].coeff;
+
+        if (res < -1.0)
+          res = -1.0;
+        else if (res > 1.0)
+          res = 1.0;
+        tmp[out] = res;
+      }
+    } else {
+      for (out = 0; out < outchannels; out++) {
+        /* convert */
+        res = 0.0;
+        for (t = offsets[out]; t < offsets[out + 1]; t++)
+          res += in[taps[t].in] * taps[t].coeff;
+
+        /* clip (shouldn't we use doubles instead as intermediate format?) */
+        if (res < -1.0)
+          res = -1.0;
+        else if (res > 1.0)
+          res = 1.0;
+        tmp[out] = res;
       }
-
-      /* clip (shouldn't we use doubles instead as intermediate format?) */
-      if (res < -1.0)
-        res = -1.0;
-      else if (res > 1.0)
-        res = 1.0;
-      tmp[out] = res;
     }
     memcpy (&out_data[n * outchannels], this->tmp,
         sizeof (gdouble) * outchannels);
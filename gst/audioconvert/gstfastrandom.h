@@ -27,15 +27,41 @@
 /* transform [0..2^32] -> [0..1] */
 #define GST_RAND_DOUBLE_TRANSFORM 2.3283064365386962890625e-10
 
+static guint32 gst_fast_random_state = 0xdeadbeef;
+
 /* This is the base function, implementing a linear congruential generator
  * and returning a pseudo random number between 0 and 2^32 - 1.
  */
 static inline guint32
 gst_fast_random_uint32 (void)
 {
-  static guint32 state = 0xdeadbeef;
+  return (gst_fast_random_state =
+      gst_fast_random_state * 1103515245 + 12345);
+}
+
+/* Fills @dest with the next @n numbers gst_fast_random_uint32() would
+ * return. Much cheaper than calling it per sample as the state stays in a
+ * register.
+ */
+static inline void
+gst_fast_random_uint32_fill (guint32 * dest, guint n)
+{
+  guint32 state = gst_fast_random_state;
 
-  return (state = state * 1103515245 + 12345);
+  for (; n; n--)
+    *dest++ = (state = state * 1103515245 + 12345);
+
+  gst_fast_random_state = state;
+}
+
+/* Maps a number from gst_fast_random_uint32() to [start, end) without a
+ * division.
+ */
+static inline gint32
+gst_fast_random_int32_scale (guint32 rand, gint32 start, gint32 end)
+{
+  return (gint32) (((guint64) rand * (guint64) ((gint64) end - start)) >> 32)
+      + start;
 }
 
 static inline guint32
@@ -84,6 +110,21 @@ gst_fast_random_double_range (gdouble start, gdouble end)
   return gst_fast_random_double () * (end - start) + start;
 }
 
+/* Maps two numbers from gst_fast_random_uint32() to [start, end] like
+ * gst_fast_random_double_range() does.
+ */
+static inline gdouble
+gst_fast_random_double_scale (guint32 rand1, guint32 rand2, gdouble start,
+    gdouble end)
+{
+  gdouble ret;
+
+  ret = rand1 * GST_RAND_DOUBLE_TRANSFORM;
+  ret = (ret + rand2) * GST_RAND_DOUBLE_TRANSFORM;
+
+  return ret * (end - start) + start;
+}
+
 #undef GST_RAND_DOUBLE_TRANSFORM
 
 #endif /* __GST_FAST_RANDOM__ */
@@ -1460,6 +1460,11 @@ plugin_init (GstPlugin * plugin)
   GST_DEBUG_CATEGORY_INIT (audio_resample_debug, "audioresample", 0,
       "audio resampling element");
 
+#ifndef DISABLE_ORC
+  /* needed for the CPU feature detection of the SIMD code paths */
+  orc_init ();
+#endif
+
 #if defined(AUDIORESAMPLE_FORMAT_AUTO) && !defined(DISABLE_ORC)
   if (!_benchmark_integer_resampling ())
     return FALSE;
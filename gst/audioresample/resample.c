@@ -114,9 +114,27 @@ speex_free (void *ptr)
 #define NULL 0
 #endif
 
-#ifdef _USE_SSE
+#ifndef HAVE_SSE_INTRINSICS
+#undef _USE_SSE
+#undef _USE_SSE2
+#endif
+
+#if defined _USE_SSE || defined _USE_SSE2
 #include "resample_sse.h"
+#include <string.h>
+#if defined HAVE_ORC && !defined DISABLE_ORC
+#include <orc/orc.h>
+#endif
+#endif
+
+/* The SIMD kernels are compiled in whenever the compiler supports them but
+ * only used if the CPU we're running on does too */
+#ifdef FIXED_POINT
+#define USE_SIMD_SINGLE(st) ((st)->use_sse2)
+#else
+#define USE_SIMD_SINGLE(st) ((st)->use_sse)
 #endif
+#define USE_SIMD_DOUBLE(st) ((st)->use_sse2)
 
 /* Numer of elements to allocate on the stack */
 #ifdef VAR_ARRAYS
@@ -154,11 +172,13 @@ struct SpeexResamplerState_
 
   spx_word16_t *mem;
   spx_word16_t *sinc_table;
-  spx_uint32_t sinc_table_length;
   resampler_basic_func resampler_ptr;
 
   int in_stride;
   int out_stride;
+
+  unsigned int use_sse:1;
+  unsigned int use_sse2:1;
 };
 
 static double kaiser12_table[68] = {
@@ -414,7 +434,11 @@ resampler_basic_direct_single (SpeexResamplerState * st,
     const spx_word16_t *sinc = &sinc_table[samp_frac_num * N];
     const spx_word16_t *iptr = &in[last_sample];
 
-#ifndef OVERRIDE_INNER_PRODUCT_SINGLE
+#ifdef OVERRIDE_INNER_PRODUCT_SINGLE
+    if (USE_SIMD_SINGLE (st)) {
+      sum = inner_product_single (sinc, iptr, N);
+    } else {
+#endif
     sum = 0;
     for (j = 0; j < N; j++)
       sum += MULT16_16 (sinc[j], iptr[j]);
@@ -431,8 +455,8 @@ resampler_basic_direct_single (SpeexResamplerState * st,
       }
       sum = accum[0] + accum[1] + accum[2] + accum[3];
 */
-#else
-    sum = inner_product_single (sinc, iptr, N);
+#ifdef OVERRIDE_INNER_PRODUCT_SINGLE
+    }
 #endif
 
     out[out_stride * out_sample++] = SATURATE32 (PSHR32 (sum, 15), 32767);
@@ -475,7 +499,11 @@ resampler_basic_direct_double (SpeexResamplerState * st,
     const spx_word16_t *sinc = &sinc_table[samp_frac_num * N];
     const spx_word16_t *iptr = &in[last_sample];
 
-#ifndef OVERRIDE_INNER_PRODUCT_DOUBLE
+#ifdef OVERRIDE_INNER_PRODUCT_DOUBLE
+    if (USE_SIMD_DOUBLE (st)) {
+      sum = inner_product_double (sinc, iptr, N);
+    } else {
+#endif
     double accum[4] = { 0, 0, 0, 0 };
 
     for (j = 0; j < N; j += 4) {
@@ -485,8 +513,8 @@ resampler_basic_direct_double (SpeexResamplerState * st,
       accum[3] += sinc[j + 3] * iptr[j + 3];
     }
     sum = accum[0] + accum[1] + accum[2] + accum[3];
-#else
-    sum = inner_product_double (sinc, iptr, N);
+#ifdef OVERRIDE_INNER_PRODUCT_DOUBLE
+    }
 #endif
 
     out[out_stride * out_sample++] = PSHR32 (sum, 15);
@@ -538,7 +566,15 @@ resampler_basic_interpolate_single (SpeexResamplerState * st,
     spx_word16_t interp[4];
 
 
-#ifndef OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+#ifdef OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+    if (USE_SIMD_SINGLE (st)) {
+      cubic_coef (frac, interp);
+      sum =
+          interpolate_product_single (iptr,
+          st->sinc_table + st->oversample + 4 - offset - 2, N, st->oversample,
+          interp);
+    } else {
+#endif
     spx_word32_t accum[4] = { 0, 0, 0, 0 };
 
     for (j = 0; j < N; j++) {
@@ -563,12 +599,8 @@ resampler_basic_interpolate_single (SpeexResamplerState * st,
             1)) + MULT16_32_Q15 (interp[1], SHR32 (accum[1],
             1)) + MULT16_32_Q15 (interp[2], SHR32 (accum[2],
             1)) + MULT16_32_Q15 (interp[3], SHR32 (accum[3], 1));
-#else
-    cubic_coef (frac, interp);
-    sum =
-        interpolate_product_single (iptr,
-        st->sinc_table + st->oversample + 4 - offset - 2, N, st->oversample,
-        interp);
+#ifdef OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+    }
 #endif
 
     out[out_stride * out_sample++] = SATURATE32 (PSHR32 (sum, 14), 32767);
@@ -628,7 +660,15 @@ resampler_basic_interpolate_double (SpeexResamplerState * st,
     spx_word16_t interp[4];
 
 
-#ifndef OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
+#ifdef OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
+    if (USE_SIMD_DOUBLE (st)) {
+      cubic_coef (frac, interp);
+      sum =
+          interpolate_product_double (iptr,
+          st->sinc_table + st->oversample + 4 - offset - 2, N, st->oversample,
+          interp);
+    } else {
+#endif
     double accum[4] = { 0, 0, 0, 0 };
 
     for (j = 0; j < N; j++) {
@@ -652,12 +692,8 @@ resampler_basic_interpolate_double (SpeexResamplerState * st,
         MULT16_32_Q15 (interp[0], accum[0]) + MULT16_32_Q15 (interp[1],
         accum[1]) + MULT16_32_Q15 (interp[2],
         accum[2]) + MULT16_32_Q15 (interp[3], accum[3]);
-#else
-    cubic_coef (frac, interp);
-    sum =
-        interpolate_product_double (iptr,
-        st->sinc_table + st->oversample + 4 - offset - 2, N, st->oversample,
-        interp);
+#ifdef OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
+    }
 #endif
 
     out[out_stride * out_sample++] = PSHR32 (sum, 15);
@@ -675,10 +711,117 @@ resampler_basic_interpolate_double (SpeexResamplerState * st,
 }
 #endif
 
+/* The sinc table only depends on the resampling ratio and the quality, so
+ * all resamplers with the same parameters share one read-only copy instead
+ * of building and keeping their own */
+typedef struct SincTable_ SincTable;
+
+struct SincTable_
+{
+  spx_uint32_t num_rate;
+  spx_uint32_t den_rate;
+  int quality;
+  int refcount;
+  spx_word16_t *table;
+  SincTable *next;
+};
+
+static SincTable *sinc_tables = NULL;
+static GStaticMutex sinc_tables_lock = G_STATIC_MUTEX_INIT;
+
+static spx_word16_t *
+sinc_table_build (SpeexResamplerState * st)
+{
+  spx_word16_t *table;
+
+  if (st->den_rate <= st->oversample) {
+    spx_uint32_t i;
+    table =
+        (spx_word16_t *) speex_alloc (st->filt_len * st->den_rate *
+        sizeof (spx_word16_t));
+    for (i = 0; i < st->den_rate; i++) {
+      spx_int32_t j;
+      for (j = 0; j < st->filt_len; j++) {
+        table[i * st->filt_len + j] =
+            sinc (st->cutoff, ((j - (spx_int32_t) st->filt_len / 2 + 1) -
+#ifdef DOUBLE_PRECISION
+                ((double) i) / st->den_rate), st->filt_len,
+#else
+                ((float) i) / st->den_rate), st->filt_len,
+#endif
+            quality_map[st->quality].window_func);
+      }
+    }
+  } else {
+    spx_int32_t i;
+    table =
+        (spx_word16_t *) speex_alloc ((st->filt_len * st->oversample +
+            8) * sizeof (spx_word16_t));
+    for (i = -4; i < (spx_int32_t) (st->oversample * st->filt_len + 4); i++)
+      table[i + 4] =
+#ifdef DOUBLE_PRECISION
+          sinc (st->cutoff, (i / (double) st->oversample - st->filt_len / 2),
+#else
+          sinc (st->cutoff, (i / (float) st->oversample - st->filt_len / 2),
+#endif
+          st->filt_len, quality_map[st->quality].window_func);
+  }
+
+  return table;
+}
+
+/* Returns the sinc table for the current ratio and quality of st, building
+ * it if no other resampler uses it yet */
+static spx_word16_t *
+sinc_table_ref (SpeexResamplerState * st)
+{
+  SincTable *t;
+
+  g_static_mutex_lock (&sinc_tables_lock);
+  for (t = sinc_tables; t; t = t->next) {
+    if (t->num_rate == st->num_rate && t->den_rate == st->den_rate &&
+        t->quality == st->quality)
+      break;
+  }
+  if (!t) {
+    t = (SincTable *) speex_alloc (sizeof (SincTable));
+    t->num_rate = st->num_rate;
+    t->den_rate = st->den_rate;
+    t->quality = st->quality;
+    t->refcount = 0;
+    t->table = sinc_table_build (st);
+    t->next = sinc_tables;
+    sinc_tables = t;
+  }
+  t->refcount++;
+  g_static_mutex_unlock (&sinc_tables_lock);
+
+  return t->table;
+}
+
+static void
+sinc_table_unref (spx_word16_t * table)
+{
+  SincTable *t, **prev;
+
+  g_static_mutex_lock (&sinc_tables_lock);
+  for (prev = &sinc_tables; (t = *prev); prev = &t->next) {
+    if (t->table == table)
+      break;
+  }
+  if (t && --t->refcount == 0) {
+    *prev = t->next;
+    speex_free (t->table);
+    speex_free (t);
+  }
+  g_static_mutex_unlock (&sinc_tables_lock);
+}
+
 static void
 update_filter (SpeexResamplerState * st)
 {
   spx_uint32_t old_length;
+  spx_word16_t *old_table;
 
   old_length = st->filt_len;
   st->oversample = quality_map[st->quality].oversample;
@@ -709,31 +852,12 @@ update_filter (SpeexResamplerState * st)
   }
 
   /* Choose the resampling type that requires the least amount of memory */
+  old_table = st->sinc_table;
+  st->sinc_table = sinc_table_ref (st);
+  if (old_table)
+    sinc_table_unref (old_table);
+
   if (st->den_rate <= st->oversample) {
-    spx_uint32_t i;
-    if (!st->sinc_table)
-      st->sinc_table =
-          (spx_word16_t *) speex_alloc (st->filt_len * st->den_rate *
-          sizeof (spx_word16_t));
-    else if (st->sinc_table_length < st->filt_len * st->den_rate) {
-      st->sinc_table =
-          (spx_word16_t *) speex_realloc (st->sinc_table,
-          st->filt_len * st->den_rate * sizeof (spx_word16_t));
-      st->sinc_table_length = st->filt_len * st->den_rate;
-    }
-    for (i = 0; i < st->den_rate; i++) {
-      spx_int32_t j;
-      for (j = 0; j < st->filt_len; j++) {
-        st->sinc_table[i * st->filt_len + j] =
-            sinc (st->cutoff, ((j - (spx_int32_t) st->filt_len / 2 + 1) -
-#ifdef DOUBLE_PRECISION
-                ((double) i) / st->den_rate), st->filt_len,
-#else
-                ((float) i) / st->den_rate), st->filt_len,
-#endif
-            quality_map[st->quality].window_func);
-      }
-    }
 #ifdef FIXED_POINT
     st->resampler_ptr = resampler_basic_direct_single;
 #else
@@ -748,25 +872,6 @@ update_filter (SpeexResamplerState * st)
 #endif
     /*fprintf (stderr, "resampler uses direct sinc table and normalised cutoff %f\n", cutoff); */
   } else {
-    spx_int32_t i;
-    if (!st->sinc_table)
-      st->sinc_table =
-          (spx_word16_t *) speex_alloc ((st->filt_len * st->oversample +
-              8) * sizeof (spx_word16_t));
-    else if (st->sinc_table_length < st->filt_len * st->oversample + 8) {
-      st->sinc_table =
-          (spx_word16_t *) speex_realloc (st->sinc_table,
-          (st->filt_len * st->oversample + 8) * sizeof (spx_word16_t));
-      st->sinc_table_length = st->filt_len * st->oversample + 8;
-    }
-    for (i = -4; i < (spx_int32_t) (st->oversample * st->filt_len + 4); i++)
-      st->sinc_table[i + 4] =
-#ifdef DOUBLE_PRECISION
-          sinc (st->cutoff, (i / (double) st->oversample - st->filt_len / 2),
-#else
-          sinc (st->cutoff, (i / (float) st->oversample - st->filt_len / 2),
-#endif
-          st->filt_len, quality_map[st->quality].window_func);
 #ifdef FIXED_POINT
     st->resampler_ptr = resampler_basic_interpolate_single;
 #else
@@ -879,6 +984,44 @@ speex_resampler_init (spx_uint32_t nb_channels, spx_uint32_t in_rate,
       out_rate, quality, err);
 }
 
+static void
+check_insn (SpeexResamplerState * st)
+{
+  st->use_sse = st->use_sse2 = 0;
+
+#if defined _USE_SSE || defined _USE_SSE2
+  {
+    const gchar *code = g_getenv ("ORC_CODE");
+
+    /* like for the Orc code, ORC_CODE=backup selects the plain C code, which
+     * makes it possible to compare both */
+    if (code && strstr (code, "backup"))
+      return;
+  }
+
+#if defined HAVE_ORC && !defined DISABLE_ORC
+  {
+    OrcTarget *target = orc_target_get_default ();
+
+    /* SSE2 implies SSE, and Orc only has a flag for the former */
+    if (target && strcmp (orc_target_get_name (target), "sse") == 0 &&
+        (orc_target_get_default_flags (target) & ORC_TARGET_SSE_SSE2)) {
+      st->use_sse = 1;
+      st->use_sse2 = 1;
+    }
+  }
+#else
+  /* no runtime detection, use whatever we are guaranteed to have */
+#ifdef __SSE__
+  st->use_sse = 1;
+#endif
+#ifdef __SSE2__
+  st->use_sse2 = 1;
+#endif
+#endif
+#endif
+}
+
 EXPORT SpeexResamplerState *
 speex_resampler_init_frac (spx_uint32_t nb_channels, spx_uint32_t ratio_num,
     spx_uint32_t ratio_den, spx_uint32_t in_rate, spx_uint32_t out_rate,
@@ -899,7 +1042,6 @@ speex_resampler_init_frac (spx_uint32_t nb_channels, spx_uint32_t ratio_num,
   st->num_rate = 0;
   st->den_rate = 0;
   st->quality = -1;
-  st->sinc_table_length = 0;
   st->mem_alloc_size = 0;
   st->filt_len = 0;
   st->mem = 0;
@@ -910,6 +1052,8 @@ speex_resampler_init_frac (spx_uint32_t nb_channels, spx_uint32_t ratio_num,
   st->in_stride = 1;
   st->out_stride = 1;
 
+  check_insn (st);
+
 #ifdef FIXED_POINT
   st->buffer_size = 160;
 #else
@@ -943,7 +1087,8 @@ EXPORT void
 speex_resampler_destroy (SpeexResamplerState * st)
 {
   speex_free (st->mem);
-  speex_free (st->sinc_table);
+  if (st->sinc_table)
+    sinc_table_unref (st->sinc_table);
   speex_free (st->last_sample);
   speex_free (st->magic_samples);
   speex_free (st->samp_frac_num);
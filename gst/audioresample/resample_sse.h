@@ -34,19 +34,136 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+/* The kernels are only called when the CPU supports SSE2, see check_insn(),
+ * so they are built for SSE2 even when the rest of the code is not, e.g. on
+ * 32 bit x86. configure checked that the compiler can do this. */
+#define SSE_TARGET __attribute__ ((target ("sse2")))
+
+#ifdef FIXED_POINT
+
+#ifdef _USE_SSE2
+#include <emmintrin.h>
+
+/* All integer kernels accumulate in 32 bits exactly like the C code, so the
+ * order of the additions does not matter and the result is bit-exact */
+SSE_TARGET static inline spx_int32_t sum_epi32(__m128i sum)
+{
+   sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+   sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+   return _mm_cvtsi128_si32(sum);
+}
+
+#define OVERRIDE_INNER_PRODUCT_SINGLE
+SSE_TARGET static inline spx_word32_t inner_product_single(const spx_word16_t *a, const spx_word16_t *b, unsigned int len)
+{
+   unsigned int i;
+   spx_word32_t ret;
+   __m128i sum = _mm_setzero_si128();
+   for (i=0;i+8<=len;i+=8)
+   {
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(a+i)), _mm_loadu_si128((const __m128i *)(b+i))));
+   }
+   if (i+4<=len)
+   {
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadl_epi64((const __m128i *)(a+i)), _mm_loadl_epi64((const __m128i *)(b+i))));
+      i+=4;
+   }
+   ret = sum_epi32(sum);
+   for (;i<len;i++)
+      ret += MULT16_16(a[i], b[i]);
+   return ret;
+}
+
+#define OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+SSE_TARGET static inline spx_word32_t interpolate_product_single(const spx_word16_t *a, const spx_word16_t *b, unsigned int len, const spx_uint32_t oversample, spx_word16_t *frac) {
+  unsigned int i;
+  spx_word32_t accum[4];
+  __m128i sum = _mm_setzero_si128();
+  for(i=0;i+2<=len;i+=2)
+  {
+    /* interleave the taps of two input samples so that madd multiplies
+     * and adds both of them into the four accumulators at once */
+    __m128i in = _mm_unpacklo_epi16(_mm_set1_epi16(a[i]), _mm_set1_epi16(a[i+1]));
+    __m128i taps = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(b+i*oversample)), _mm_loadl_epi64((const __m128i *)(b+(i+1)*oversample)));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(in, taps));
+  }
+  _mm_storeu_si128((__m128i *)accum, sum);
+  for(;i<len;i++)
+  {
+    accum[0] += MULT16_16(a[i], b[i*oversample]);
+    accum[1] += MULT16_16(a[i], b[i*oversample+1]);
+    accum[2] += MULT16_16(a[i], b[i*oversample+2]);
+    accum[3] += MULT16_16(a[i], b[i*oversample+3]);
+  }
+  return MULT16_32_Q15(frac[0], SHR32(accum[0], 1)) + MULT16_32_Q15(frac[1], SHR32(accum[1], 1)) + MULT16_32_Q15(frac[2], SHR32(accum[2], 1)) + MULT16_32_Q15(frac[3], SHR32(accum[3], 1));
+}
+
+#endif /* _USE_SSE2 */
+
+#elif defined(DOUBLE_PRECISION)
+
+#ifdef _USE_SSE2
+#include <emmintrin.h>
+
+/* Each lane accumulates the same products in the same order as one of the
+ * four accumulators of the C code, and the final sum is done in the same
+ * order too, so the result is bit-exact */
+#define OVERRIDE_INNER_PRODUCT_DOUBLE
+SSE_TARGET static inline double inner_product_double(const double *a, const double *b, unsigned int len)
+{
+   unsigned int i;
+   double accum[4];
+   __m128d sum1 = _mm_setzero_pd();
+   __m128d sum2 = _mm_setzero_pd();
+   for (i=0;i<len;i+=4)
+   {
+      sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+      sum2 = _mm_add_pd(sum2, _mm_mul_pd(_mm_loadu_pd(a+i+2), _mm_loadu_pd(b+i+2)));
+   }
+   _mm_storeu_pd(accum, sum1);
+   _mm_storeu_pd(accum+2, sum2);
+   return accum[0] + accum[1] + accum[2] + accum[3];
+}
+
+#define OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
+SSE_TARGET static inline double interpolate_product_double(const double *a, const double *b, unsigned int len, const spx_uint32_t oversample, double *frac) {
+  unsigned int i;
+  double accum[4];
+  __m128d sum1 = _mm_setzero_pd();
+  __m128d sum2 = _mm_setzero_pd();
+  __m128d t;
+  for(i=0;i<len;i++)
+  {
+    t = _mm_set1_pd(a[i]);
+    sum1 = _mm_add_pd(sum1, _mm_mul_pd(t, _mm_loadu_pd(b+i*oversample)));
+    sum2 = _mm_add_pd(sum2, _mm_mul_pd(t, _mm_loadu_pd(b+i*oversample+2)));
+  }
+  _mm_storeu_pd(accum, sum1);
+  _mm_storeu_pd(accum+2, sum2);
+  return frac[0]*accum[0] + frac[1]*accum[1] + frac[2]*accum[2] + frac[3]*accum[3];
+}
+
+#endif /* _USE_SSE2 */
+
+#else /* single precision floating point */
+
+#ifdef _USE_SSE
 #include <xmmintrin.h>
 
 #define OVERRIDE_INNER_PRODUCT_SINGLE
-static inline float inner_product_single(const float *a, const float *b, unsigned int len)
+SSE_TARGET static inline float inner_product_single(const float *a, const float *b, unsigned int len)
 {
    int i;
    float ret;
    __m128 sum = _mm_setzero_ps();
-   for (i=0;i<len;i+=8)
+   for (i=0;i+8<=len;i+=8)
    {
       sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
       sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
    }
+   /* the filter length is only guaranteed to be a multiple of 4 */
+   if (i<len)
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
    _mm_store_ss(&ret, sum);
@@ -54,7 +171,7 @@ static inline float inner_product_single(const float *a, const float *b, unsigne
 }
 
 #define OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
-static inline float interpolate_product_single(const float *a, const float *b, unsigned int len, const spx_uint32_t oversample, float *frac) {
+SSE_TARGET static inline float interpolate_product_single(const float *a, const float *b, unsigned int len, const spx_uint32_t oversample, float *frac) {
   int i;
   float ret;
   __m128 sum = _mm_setzero_ps();
@@ -71,17 +188,19 @@ static inline float interpolate_product_single(const float *a, const float *b, u
    return ret;
 }
 
+#endif /* _USE_SSE */
+
 #ifdef _USE_SSE2
 #include <emmintrin.h>
 #define OVERRIDE_INNER_PRODUCT_DOUBLE
 
-static inline double inner_product_double(const float *a, const float *b, unsigned int len)
+SSE_TARGET static inline double inner_product_double(const float *a, const float *b, unsigned int len)
 {
    int i;
    double ret;
    __m128d sum = _mm_setzero_pd();
    __m128 t;
-   for (i=0;i<len;i+=8)
+   for (i=0;i+8<=len;i+=8)
    {
       t = _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
       sum = _mm_add_pd(sum, _mm_cvtps_pd(t));
@@ -91,13 +210,19 @@ static inline double inner_product_double(const float *a, const float *b, unsign
       sum = _mm_add_pd(sum, _mm_cvtps_pd(t));
       sum = _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(t, t)));
    }
+   if (i<len)
+   {
+      t = _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+      sum = _mm_add_pd(sum, _mm_cvtps_pd(t));
+      sum = _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(t, t)));
+   }
    sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
    _mm_store_sd(&ret, sum);
    return ret;
 }
 
 #define OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
-static inline double interpolate_product_double(const float *a, const float *b, unsigned int len, const spx_uint32_t oversample, float *frac) {
+SSE_TARGET static inline double interpolate_product_double(const float *a, const float *b, unsigned int len, const spx_uint32_t oversample, float *frac) {
   int i;
   double ret;
   __m128d sum;
@@ -125,4 +250,6 @@ static inline double interpolate_product_double(const float *a, const float *b,
   return ret;
 }
 
+#endif /* _USE_SSE2 */
+
 #endif
@@ -21,5 +21,6 @@
 #define DOUBLE_PRECISION
 #define OUTSIDE_SPEEX
 #define RANDOM_PREFIX resample_double
+#define _USE_SSE2
 
 #include "resample.c"
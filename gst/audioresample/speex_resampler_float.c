@@ -20,5 +20,7 @@
 #define FLOATING_POINT
 #define OUTSIDE_SPEEX
 #define RANDOM_PREFIX resample_float
+#define _USE_SSE
+#define _USE_SSE2
 
 #include "resample.c"
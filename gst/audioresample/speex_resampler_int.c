@@ -20,5 +20,6 @@
 #define FIXED_POINT 1
 #define OUTSIDE_SPEEX 1
 #define RANDOM_PREFIX resample_int
+#define _USE_SSE2
 
 #include "resample.c"
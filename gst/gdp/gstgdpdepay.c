@@ -69,6 +69,9 @@ GST_DEBUG_CATEGORY_STATIC (gst_gdp_depay_debug);
 GST_BOILERPLATE_FULL (GstGDPDepay, gst_gdp_depay, GstElement,
     GST_TYPE_ELEMENT, _do_init);
 
+/* offset of the payload length in a GDP header */
+#define GDP_HEADER_PAYLOAD_LENGTH_OFFSET 6
+
 static gboolean gst_gdp_depay_sink_event (GstPad * pad, GstEvent * event);
 static gboolean gst_gdp_depay_src_event (GstPad * pad, GstEvent * event);
 
@@ -208,6 +211,40 @@ gst_gdp_depay_src_event (GstPad * pad, GstEvent * event)
   return res;
 }
 
+/* take the payload of the current buffer packet from the adapter. When the
+ * payload lies within one incoming buffer this is a subbuffer of it, so we
+ * only copy payloads that span incoming buffers. */
+static GstBuffer *
+gst_gdp_depay_buffer_from_adapter (GstGDPDepay * this)
+{
+  GstBuffer *buf, *meta;
+
+  guint8 header[GST_DP_HEADER_LENGTH];
+
+  /* let the dataprotocol parse the metadata from a copy of the header that
+   * claims no payload, so it doesn't allocate the payload for us */
+  memcpy (header, this->header, GST_DP_HEADER_LENGTH);
+  GST_WRITE_UINT32_BE (header + GDP_HEADER_PAYLOAD_LENGTH_OFFSET, 0);
+  meta = gst_dp_buffer_from_header (GST_DP_HEADER_LENGTH, header);
+  if (!meta)
+    return NULL;
+
+  if (this->payload_length > 0) {
+    buf = gst_adapter_take_buffer (this->adapter, this->payload_length);
+    /* the adapter can hand out the incoming buffer itself */
+    buf = gst_buffer_make_metadata_writable (buf);
+  } else {
+    buf = gst_buffer_new ();
+  }
+
+  gst_buffer_copy_metadata (buf, meta, GST_BUFFER_COPY_TIMESTAMPS);
+  GST_BUFFER_FLAGS (buf) = GST_BUFFER_FLAGS (meta) |
+      (GST_BUFFER_FLAGS (buf) & GST_BUFFER_FLAG_READONLY);
+  gst_buffer_unref (meta);
+
+  return buf;
+}
+
 static GstFlowReturn
 gst_gdp_depay_chain (GstPad * pad, GstBuffer * buffer)
 {
@@ -233,8 +270,6 @@ gst_gdp_depay_chain (GstPad * pad, GstBuffer * buffer)
     switch (this->state) {
       case GST_GDP_DEPAY_STATE_HEADER:
       {
-        guint8 *header;
-
         /* collect a complete header, validate and store the header. Figure out
          * the payload length and switch to the PAYLOAD state */
         available = gst_adapter_available (this->adapter);
@@ -242,19 +277,18 @@ gst_gdp_depay_chain (GstPad * pad, GstBuffer * buffer)
           goto done;
 
         GST_LOG_OBJECT (this, "reading GDP header from adapter");
-        header = gst_adapter_take (this->adapter, GST_DP_HEADER_LENGTH);
-        if (!gst_dp_validate_header (GST_DP_HEADER_LENGTH, header)) {
-          g_free (header);
+        /* the header storage is reused for every packet */
+        if (!this->header)
+          this->header = g_malloc (GST_DP_HEADER_LENGTH);
+        gst_adapter_copy (this->adapter, this->header, 0, GST_DP_HEADER_LENGTH);
+        gst_adapter_flush (this->adapter, GST_DP_HEADER_LENGTH);
+        if (!gst_dp_validate_header (GST_DP_HEADER_LENGTH, this->header))
           goto header_validate_error;
-        }
 
         /* store types and payload length. Also store the header, which we need
          * to make the payload. */
-        this->payload_length = gst_dp_header_payload_length (header);
-        this->payload_type = gst_dp_header_payload_type (header);
-        /* free previous header and store new one. */
-        g_free (this->header);
-        this->header = header;
+        this->payload_length = gst_dp_header_payload_length (this->header);
+        this->payload_type = gst_dp_header_payload_type (this->header);
 
         GST_LOG_OBJECT (this,
             "read GDP header, payload size %d, payload type %d, switching to state PAYLOAD",
@@ -301,19 +335,10 @@ gst_gdp_depay_chain (GstPad * pad, GstBuffer * buffer)
           goto no_caps;
 
         GST_LOG_OBJECT (this, "reading GDP buffer from adapter");
-        buf = gst_dp_buffer_from_header (GST_DP_HEADER_LENGTH, this->header);
+        buf = gst_gdp_depay_buffer_from_adapter (this);
         if (!buf)
           goto buffer_failed;
 
-        /* now take the payload if there is any */
-        if (this->payload_length > 0) {
-          guint8 *payload;
-
-          payload = gst_adapter_take (this->adapter, this->payload_length);
-          memcpy (GST_BUFFER_DATA (buf), payload, this->payload_length);
-          g_free (payload);
-        }
-
         /* set caps and push */
         gst_buffer_set_caps (buf, this->caps);
         GST_LOG_OBJECT (this, "deserialized buffer %p, pushing, timestamp %"
@@ -58,6 +58,12 @@ GST_DEBUG_CATEGORY_STATIC (gst_gdp_pay_debug);
 #define DEFAULT_CRC_HEADER TRUE
 #define DEFAULT_CRC_PAYLOAD FALSE
 #define DEFAULT_VERSION GST_DP_VERSION_1_0
+#define DEFAULT_BUFFER_LIST FALSE
+
+/* offsets of the flags and CRC fields in a GDP 1.0 header */
+#define GDP_HEADER_FLAGS_OFFSET 2
+#define GDP_HEADER_CRC_OFFSET 58
+#define GDP_PAYLOAD_CRC_OFFSET 60
 
 enum
 {
@@ -65,6 +71,7 @@ enum
   PROP_CRC_HEADER,
   PROP_CRC_PAYLOAD,
   PROP_VERSION,
+  PROP_BUFFER_LIST,
 };
 
 #define _do_init(x) \
@@ -92,6 +99,50 @@ static void gst_gdp_pay_get_property (GObject * object, guint prop_id,
 
 static void gst_gdp_pay_finalize (GObject * gobject);
 
+/* CRC-16 lookup tables; [0] is the table gst_dp_crc() uses, [n] advances
+ * a byte through n more zero bytes so we can consume 4 bytes per step */
+static guint16 gst_gdp_pay_crc_table[4][256];
+
+static void
+gst_gdp_pay_init_crc_table (void)
+{
+  guint i, j;
+  guint16 crc;
+
+  for (i = 0; i < 256; i++) {
+    crc = i << 8;
+    for (j = 0; j < 8; j++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    gst_gdp_pay_crc_table[0][i] = crc;
+  }
+  for (j = 1; j < 4; j++) {
+    for (i = 0; i < 256; i++) {
+      crc = gst_gdp_pay_crc_table[j - 1][i];
+      gst_gdp_pay_crc_table[j][i] =
+          (crc << 8) ^ gst_gdp_pay_crc_table[0][crc >> 8];
+    }
+  }
+}
+
+/* same result as gst_dp_crc() */
+static guint16
+gst_gdp_pay_crc (const guint8 * data, guint length)
+{
+  guint16 crc = 0xffff;
+
+  while (length >= 4) {
+    crc = gst_gdp_pay_crc_table[3][(crc >> 8) ^ data[0]] ^
+        gst_gdp_pay_crc_table[2][(crc & 0xff) ^ data[1]] ^
+        gst_gdp_pay_crc_table[1][data[2]] ^ gst_gdp_pay_crc_table[0][data[3]];
+    data += 4;
+    length -= 4;
+  }
+  while (length--)
+    crc = (crc << 8) ^ gst_gdp_pay_crc_table[0][(crc >> 8) ^ *data++];
+
+  return 0xffff ^ crc;
+}
+
 static void
 gst_gdp_pay_base_init (gpointer g_class)
 {
@@ -135,8 +186,27 @@ gst_gdp_pay_class_init (GstGDPPayClass * klass)
           "Version of the GStreamer Data Protocol",
           GST_TYPE_DP_VERSION, DEFAULT_VERSION,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstGDPPay:buffer-list
+   *
+   * Push each payloaded buffer as a buffer list holding the GDP header and
+   * the original buffer instead of copying both into one new buffer.
+   * Only downstream elements that handle buffer lists avoid the copy, like
+   * tcpclientsink, which sends both parts with one call. Other sinks, such
+   * as multifdsink, get the two parts merged into one buffer by the base
+   * class, which costs the same copy.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_BUFFER_LIST,
+      g_param_spec_boolean ("buffer-list", "Buffer List",
+          "Push the header and the payload as a buffer list, saves a copy "
+          "only when downstream handles buffer lists",
+          DEFAULT_BUFFER_LIST, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_gdp_pay_change_state);
+
+  gst_gdp_pay_init_crc_table ();
 }
 
 static void
@@ -161,6 +231,7 @@ gst_gdp_pay_init (GstGDPPay * gdppay, GstGDPPayClass * g_class)
   gdppay->header_flag = gdppay->crc_header | gdppay->crc_payload;
   gdppay->version = DEFAULT_VERSION;
   gdppay->offset = 0;
+  gdppay->buffer_list = DEFAULT_BUFFER_LIST;
 
   gdppay->packetizer = gst_dp_packetizer_new (gdppay->version);
 }
@@ -180,16 +251,16 @@ static void
 gst_gdp_pay_reset (GstGDPPay * this)
 {
   GST_DEBUG_OBJECT (this, "Resetting GDP object");
-  /* clear the queued buffers */
+  /* clear the queued buffers and buffer lists */
   while (this->queue) {
-    GstBuffer *buffer;
+    GstMiniObject *obj;
 
-    buffer = GST_BUFFER_CAST (this->queue->data);
+    obj = GST_MINI_OBJECT_CAST (this->queue->data);
 
     /* delete buffer from queue now */
     this->queue = g_list_delete_link (this->queue, this->queue);
 
-    gst_buffer_unref (buffer);
+    gst_mini_object_unref (obj);
   }
   if (this->caps) {
     gst_caps_unref (this->caps);
@@ -256,27 +327,45 @@ packet_failed:
 }
 
 static GstBuffer *
-gst_gdp_pay_buffer_from_buffer (GstGDPPay * this, GstBuffer * buffer)
+gst_gdp_pay_header_from_buffer (GstGDPPay * this, GstBuffer * buffer)
 {
   GstBuffer *headerbuf;
 
+  GstDPHeaderFlag flags;
+
+  gboolean payload_crc;
+
   guint8 *header;
 
   guint len;
 
-  if (!this->packetizer->header_from_buffer (buffer, this->header_flag, &len,
-          &header))
+  /* for GDP 1.0 we calculate the payload CRC ourselves with the sliced
+   * tables, the packetizer only does a byte at a time */
+  flags = this->header_flag;
+  payload_crc = (flags & GST_DP_HEADER_FLAG_CRC_PAYLOAD) &&
+      this->version == GST_DP_VERSION_1_0;
+  if (payload_crc)
+    flags &= ~GST_DP_HEADER_FLAG_CRC_PAYLOAD;
+
+  if (!this->packetizer->header_from_buffer (buffer, flags, &len, &header))
     goto no_buffer;
 
-  GST_LOG_OBJECT (this, "creating GDP header and payload buffer from buffer");
+  if (payload_crc) {
+    header[GDP_HEADER_FLAGS_OFFSET] |= GST_DP_HEADER_FLAG_CRC_PAYLOAD;
+    GST_WRITE_UINT16_BE (header + GDP_PAYLOAD_CRC_OFFSET,
+        GST_BUFFER_SIZE (buffer) ? gst_gdp_pay_crc (GST_BUFFER_DATA (buffer),
+            GST_BUFFER_SIZE (buffer)) : 0);
+    /* the header CRC covers the flags, so it needs updating too */
+    if (flags & GST_DP_HEADER_FLAG_CRC_HEADER)
+      GST_WRITE_UINT16_BE (header + GDP_HEADER_CRC_OFFSET,
+          gst_gdp_pay_crc (header, GDP_HEADER_CRC_OFFSET));
+  }
+
   headerbuf = gst_buffer_new ();
   gst_buffer_set_data (headerbuf, header, len);
   GST_BUFFER_MALLOCDATA (headerbuf) = header;
 
-  /* we do not want to lose the ref on the incoming buffer */
-  gst_buffer_ref (buffer);
-
-  return gst_buffer_join (headerbuf, buffer);
+  return headerbuf;
 
   /* ERRORS */
 no_buffer:
@@ -286,6 +375,48 @@ no_buffer:
   }
 }
 
+static GstBuffer *
+gst_gdp_pay_buffer_from_buffer (GstGDPPay * this, GstBuffer * buffer)
+{
+  GstBuffer *headerbuf;
+
+  if (!(headerbuf = gst_gdp_pay_header_from_buffer (this, buffer)))
+    return NULL;
+
+  GST_LOG_OBJECT (this, "creating GDP header and payload buffer from buffer");
+
+  /* we do not want to lose the ref on the incoming buffer */
+  gst_buffer_ref (buffer);
+
+  return gst_buffer_join (headerbuf, buffer);
+}
+
+/* create a buffer list with one group holding the GDP header and a ref to
+ * the incoming buffer. The header buffer carries the metadata of the group */
+static GstBufferList *
+gst_gdp_pay_list_from_buffer (GstGDPPay * this, GstBuffer * buffer)
+{
+  GstBufferList *list;
+
+  GstBufferListIterator *it;
+
+  GstBuffer *headerbuf;
+
+  if (!(headerbuf = gst_gdp_pay_header_from_buffer (this, buffer)))
+    return NULL;
+
+  GST_LOG_OBJECT (this, "creating GDP buffer list from buffer");
+
+  list = gst_buffer_list_new ();
+  it = gst_buffer_list_iterate (list);
+  gst_buffer_list_iterator_add_group (it);
+  gst_buffer_list_iterator_add (it, headerbuf);
+  gst_buffer_list_iterator_add (it, gst_buffer_ref (buffer));
+  gst_buffer_list_iterator_free (it);
+
+  return list;
+}
+
 static GstBuffer *
 gst_gdp_buffer_from_event (GstGDPPay * this, GstEvent * event)
 {
@@ -520,17 +651,26 @@ gst_gdp_pay_reset_streamheader (GstGDPPay * this)
   GST_DEBUG_OBJECT (this, "need to push %d queued buffers",
       g_list_length (this->queue));
   while (this->queue) {
-    GstBuffer *buffer;
+    GstMiniObject *obj;
 
-    buffer = GST_BUFFER_CAST (this->queue->data);
-    GST_DEBUG_OBJECT (this, "Pushing queued GDP buffer %p", buffer);
+    obj = GST_MINI_OBJECT_CAST (this->queue->data);
+    GST_DEBUG_OBJECT (this, "Pushing queued GDP buffer %p", obj);
 
     /* delete buffer from queue now */
     this->queue = g_list_delete_link (this->queue, this->queue);
 
     /* set caps and push */
-    gst_buffer_set_caps (buffer, caps);
-    r = gst_pad_push (this->srcpad, buffer);
+    if (GST_IS_BUFFER_LIST (obj)) {
+      GstBufferList *list = GST_BUFFER_LIST_CAST (obj);
+
+      gst_buffer_set_caps (gst_buffer_list_get (list, 0, 0), caps);
+      r = gst_pad_push_list (this->srcpad, list);
+    } else {
+      GstBuffer *buffer = GST_BUFFER_CAST (obj);
+
+      gst_buffer_set_caps (buffer, caps);
+      r = gst_pad_push (this->srcpad, buffer);
+    }
     if (r != GST_FLOW_OK) {
       GST_WARNING_OBJECT (this, "pushing queued GDP buffer returned %d", r);
       goto done;
@@ -572,6 +712,27 @@ gst_gdp_queue_buffer (GstGDPPay * this, GstBuffer * buffer)
   return GST_FLOW_OK;
 }
 
+/* same as gst_gdp_queue_buffer() for a buffer list, the caps go on the
+ * header buffer in the first group */
+static GstFlowReturn
+gst_gdp_queue_list (GstGDPPay * this, GstBufferList * list)
+{
+  if (this->sent_streamheader) {
+    GST_LOG_OBJECT (this, "Pushing GDP buffer list %p, caps %" GST_PTR_FORMAT,
+        list, this->caps);
+    gst_buffer_set_caps (gst_buffer_list_get (list, 0, 0),
+        GST_PAD_CAPS (this->srcpad));
+    return gst_pad_push_list (this->srcpad, list);
+  }
+
+  this->queue = g_list_append (this->queue, list);
+  GST_DEBUG_OBJECT (this, "streamheader not sent yet, "
+      "queued buffer list %p, now %d buffers queued",
+      list, g_list_length (this->queue));
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_gdp_pay_chain (GstPad * pad, GstBuffer * buffer)
 {
@@ -636,6 +797,29 @@ gst_gdp_pay_chain (GstPad * pad, GstBuffer * buffer)
   if (caps)
     gst_caps_unref (caps);
 
+  if (this->buffer_list) {
+    GstBufferList *list;
+
+    GstBuffer *headerbuf;
+
+    if (!(list = gst_gdp_pay_list_from_buffer (this, buffer)))
+      goto no_buffer;
+
+    headerbuf = gst_buffer_list_get (list, 0, 0);
+    if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_IN_CAPS))
+      GST_BUFFER_FLAG_SET (headerbuf, GST_BUFFER_FLAG_IN_CAPS);
+
+    /* offsets count the whole packet, header and payload */
+    GST_BUFFER_OFFSET (headerbuf) = this->offset;
+    this->offset += GST_BUFFER_SIZE (headerbuf) + GST_BUFFER_SIZE (buffer);
+    GST_BUFFER_OFFSET_END (headerbuf) = this->offset;
+    GST_BUFFER_TIMESTAMP (headerbuf) = GST_BUFFER_TIMESTAMP (buffer);
+    GST_BUFFER_DURATION (headerbuf) = GST_BUFFER_DURATION (buffer);
+
+    ret = gst_gdp_queue_list (this, list);
+    goto done;
+  }
+
   /* create a GDP header packet,
    * then create a GST buffer of the header packet and the buffer contents */
   outbuffer = gst_gdp_pay_buffer_from_buffer (this, buffer);
@@ -827,6 +1011,9 @@ gst_gdp_pay_set_property (GObject * object, guint prop_id,
     case PROP_VERSION:
       this->version = g_value_get_enum (value);
       break;
+    case PROP_BUFFER_LIST:
+      this->buffer_list = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -852,6 +1039,9 @@ gst_gdp_pay_get_property (GObject * object, guint prop_id,
     case PROP_VERSION:
       g_value_set_enum (value, this->version);
       break;
+    case PROP_BUFFER_LIST:
+      g_value_set_boolean (value, this->buffer_list);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
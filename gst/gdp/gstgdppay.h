@@ -57,7 +57,8 @@ struct _GstGDPPay
   GstBuffer *tag_buf;
 
   gboolean sent_streamheader; /* TRUE after the first streamheaders are sent */
-  GList *queue; /* list of queued buffers before streamheaders are sent */
+  GList *queue; /* list of queued buffers and buffer lists before
+                 * streamheaders are sent */
   guint64 offset;
 
   gboolean crc_header;
@@ -65,6 +66,8 @@ struct _GstGDPPay
   GstDPHeaderFlag header_flag;
   GstDPVersion version;
   GstDPPacketizer *packetizer;
+
+  gboolean buffer_list;
 };
 
 struct _GstGDPPayClass
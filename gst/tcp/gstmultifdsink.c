@@ -90,6 +90,13 @@
  * RESYNC_KEYFRAME positions the client at the most recent keyframe in the
  * buffer queue.
  *
+ * By default all clients are served from one thread. The
+ * #GstMultiFdSink:io-threads property spreads the clients over several
+ * threads, each polling its own set of file descriptors, while the streaming
+ * thread only adds the incoming buffers to the shared queue. Statistics for
+ * each of these threads can be retrieved with the
+ * #GstMultiFdSink::get-shard-stats signal.
+ *
  * multifdsink will by default synchronize on the clock before serving the 
  * buffers to the clients. This behaviour can be disabled by setting the sync 
  * property to FALSE. Multifdsink will by default not do QoS and will never
@@ -110,20 +117,36 @@
 #endif
 
 #include <fcntl.h>
+#include <limits.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 
 #ifdef HAVE_FIONREAD_IN_SYS_FILIO
 #include <sys/filio.h>
 #endif
 
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
+
 #include "gstmultifdsink.h"
 #include "gsttcp-marshal.h"
 
 #define NOT_IMPLEMENTED 0
 
+/* the maximum number of buffers we can hand to one writev/sendmsg call */
+#if defined(IOV_MAX)
+#define MAX_IOVECS      IOV_MAX
+#elif defined(UIO_MAXIOV)
+#define MAX_IOVECS      UIO_MAXIOV
+#else
+#define MAX_IOVECS      16
+#endif
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -142,6 +165,8 @@ enum
   SIGNAL_REMOVE_FLUSH,
   SIGNAL_CLEAR,
   SIGNAL_GET_STATS,
+  SIGNAL_GET_SHARD_STATS,
+  SIGNAL_GET_HISTOGRAMS,
 
   /* signals */
   SIGNAL_CLIENT_ADDED,
@@ -175,6 +200,46 @@ enum
 
 #define DEFAULT_RESEND_STREAMHEADER      TRUE
 
+#define DEFAULT_MAX_IOVECS              MIN (32, MAX_IOVECS)
+#define DEFAULT_IO_THREADS              1
+#define MAX_IO_THREADS                  64
+
+#ifdef MSG_NOSIGNAL
+#define FLAGS MSG_NOSIGNAL
+#else
+#define FLAGS 0
+#endif
+
+/* MSG_ZEROCOPY sends need the completion notifications from the error
+ * queue of the socket */
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define HAVE_ZEROCOPY
+#endif
+
+#define DEFAULT_ZEROCOPY                FALSE
+#define DEFAULT_STATS_INTERVAL          0
+/* pinning the pages and reaping the completion costs more than copying
+ * for smaller writes */
+#define ZEROCOPY_MIN_SIZE               (10 * 1024)
+
+/* The global queue of buffers is a ring of entries indexed by sequence
+ * number. Positions used throughout this file count from the newest buffer:
+ * position 0 is the most recently queued buffer, position len - 1 the
+ * oldest one. */
+#define BUFQUEUE_SEQ(sink,pos)  ((sink)->bufqueue_head - 1 - (pos))
+#define BUFQUEUE_ENTRY(sink,seq) \
+    (&(sink)->bufqueue[(seq) & ((sink)->bufqueue_size - 1)])
+
+#define DEFAULT_BUFQUEUE_SIZE   64
+
+/* clients keep the sequence number of their next buffer so that queueing a
+ * buffer doesn't have to update them. Their position is -1 when they sent
+ * everything. */
+#define CLIENT_BUFPOS(sink,client) \
+    ((gint) ((sink)->bufqueue_head - 1 - (client)->bufseq))
+#define CLIENT_SET_BUFPOS(sink,client,pos) \
+    ((client)->bufseq = BUFQUEUE_SEQ (sink, pos))
+
 enum
 {
   PROP_0,
@@ -212,6 +277,11 @@ enum
 
   PROP_NUM_FDS,
 
+  PROP_MAX_IOVECS,
+  PROP_IO_THREADS,
+  PROP_ZEROCOPY,
+  PROP_STATS_INTERVAL,
+
   PROP_LAST
 };
 
@@ -523,6 +593,71 @@ gst_multi_fd_sink_class_init (GstMultiFdSinkClass * klass)
           "The current number of client file descriptors.",
           0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstMultiFdSink::max-iovecs
+   *
+   * The maximum number of queued buffers that are gathered and written to a
+   * client with a single writev() or sendmsg() call. A value of 1 writes
+   * every buffer with a separate system call.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_IOVECS,
+      g_param_spec_uint ("max-iovecs", "Max iovecs",
+          "Maximum number of buffers to send to a client in one write "
+          "(1 = no batching)", 1, MAX_IOVECS, DEFAULT_MAX_IOVECS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFdSink::io-threads
+   *
+   * The number of threads that read from and write to the clients. Each
+   * thread polls its own set of clients, new clients are given to the thread
+   * serving the least clients. The value is used when the element goes
+   * to the READY state.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_IO_THREADS,
+      g_param_spec_uint ("io-threads", "I/O threads",
+          "Number of threads serving the clients", 1, MAX_IO_THREADS,
+          DEFAULT_IO_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFdSink::zerocopy
+   *
+   * Write large batches of buffers to socket clients with MSG_ZEROCOPY so
+   * that the kernel sends from the buffer memory instead of copying it. The
+   * buffers are kept alive until the kernel reports that it is done with
+   * them. Clients on sockets that do not support it, and clients for which
+   * the kernel falls back to copying anyway, are served with regular writes.
+   * The value is used for clients that are added after setting it.
+   *
+   * Only available on Linux 4.14 and newer.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_ZEROCOPY,
+      g_param_spec_boolean ("zerocopy", "Zero copy",
+          "Send large writes to socket clients without copying them",
+          DEFAULT_ZEROCOPY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFdSink::stats-interval
+   *
+   * Post an element message with the structure returned by the
+   * #GstMultiFdSink::get-histograms signal every stats-interval nanoseconds.
+   * The messages are posted from the streaming thread. 0 disables the
+   * messages.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Stats interval",
+          "Interval in nanoseconds between stats messages (0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstMultiFdSink::add:
    * @gstmultifdsink: the multifdsink element to emit this signal on
@@ -617,6 +752,57 @@ gst_multi_fd_sink_class_init (GstMultiFdSinkClass * klass)
           get_stats), NULL, NULL, gst_tcp_marshal_BOXED__INT,
       G_TYPE_VALUE_ARRAY, 1, G_TYPE_INT);
 
+  /**
+   * GstMultiFdSink::get-shard-stats:
+   * @gstmultifdsink: the multifdsink element to emit this signal on
+   * @shard:          the index of the I/O thread, see #GstMultiFdSink:io-threads
+   *
+   * Get statistics about the I/O thread with index @shard.
+   *
+   * Returns: a GValueArray with the statistics. The array contains guint64
+   *     values that represent respectively: number of clients served by the
+   *     thread, total number of bytes sent by the thread, number of times
+   *     the thread woke up to serve its clients.
+   *     The array can be 0-length if the sink is not running or @shard is
+   *     out of range.
+   *
+   * Since: 0.10.31
+   */
+  gst_multi_fd_sink_signals[SIGNAL_GET_SHARD_STATS] =
+      g_signal_new ("get-shard-stats", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstMultiFdSinkClass,
+          get_shard_stats), NULL, NULL, gst_tcp_marshal_BOXED__INT,
+      G_TYPE_VALUE_ARRAY, 1, G_TYPE_INT);
+
+  /**
+   * GstMultiFdSink::get-histograms:
+   * @gstmultifdsink: the multifdsink element to emit this signal on
+   *
+   * Get histograms of the queue depth, the time in the queue and the write
+   * sizes of all clients and of every client separately. The counts are
+   * accumulated since the sink was started (for the sink) or the client was
+   * added (for a client).
+   *
+   * Returns: a GstStructure named "multifdsink-stats" with the fields
+   *     "clients" (guint), "bytes-served" (guint64), "buffers-queued" (gint),
+   *     the sink histograms "queue-depth", "queue-time" and "write-size",
+   *     and "client-stats", an array with a "multifdsink-client" structure
+   *     per client holding "fd" (gint), "position" (gint), "bytes-sent"
+   *     (guint64), "dropped-buffers" (guint64) and the client histograms.
+   *     A histogram is an array of 32 guint64 bucket counts where bucket 0
+   *     counts the value 0 and bucket n the values from 2^(n-1) to 2^n - 1.
+   *     "queue-depth" counts the buffers a client was behind when it took
+   *     a buffer from the queue, "queue-time" the microseconds that buffer
+   *     was queued and "write-size" the bytes of every write.
+   *
+   * Since: 0.10.31
+   */
+  gst_multi_fd_sink_signals[SIGNAL_GET_HISTOGRAMS] =
+      g_signal_new ("get-histograms", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstMultiFdSinkClass,
+          get_histograms), NULL, NULL, gst_tcp_marshal_BOXED__VOID,
+      GST_TYPE_STRUCTURE, 0);
+
   /**
    * GstMultiFdSink::client-added:
    * @gstmultifdsink: the multifdsink element that emitted this signal
@@ -681,6 +867,9 @@ gst_multi_fd_sink_class_init (GstMultiFdSinkClass * klass)
   klass->remove_flush = GST_DEBUG_FUNCPTR (gst_multi_fd_sink_remove_flush);
   klass->clear = GST_DEBUG_FUNCPTR (gst_multi_fd_sink_clear);
   klass->get_stats = GST_DEBUG_FUNCPTR (gst_multi_fd_sink_get_stats);
+  klass->get_shard_stats =
+      GST_DEBUG_FUNCPTR (gst_multi_fd_sink_get_shard_stats);
+  klass->get_histograms = GST_DEBUG_FUNCPTR (gst_multi_fd_sink_get_histograms);
 
   GST_DEBUG_CATEGORY_INIT (multifdsink_debug, "multifdsink", 0, "FD sink");
 }
@@ -697,7 +886,13 @@ gst_multi_fd_sink_init (GstMultiFdSink * this, GstMultiFdSinkClass * klass)
   this->clients = NULL;
   this->fd_hash = g_hash_table_new (g_int_hash, g_int_equal);
 
-  this->bufqueue = g_array_new (FALSE, TRUE, sizeof (GstBuffer *));
+  this->queuelock = g_mutex_new ();
+  this->bufqueue = NULL;
+  this->bufqueue_size = 0;
+  this->bufqueue_len = 0;
+  this->bufqueue_head = 0;
+  this->keyframes = g_array_new (FALSE, FALSE, sizeof (guint64));
+  this->keyframes_start = 0;
   this->unit_type = DEFAULT_UNIT_TYPE;
   this->units_max = DEFAULT_UNITS_MAX;
   this->units_soft_max = DEFAULT_UNITS_SOFT_MAX;
@@ -715,6 +910,10 @@ gst_multi_fd_sink_init (GstMultiFdSink * this, GstMultiFdSinkClass * klass)
   this->handle_read = DEFAULT_HANDLE_READ;
 
   this->resend_streamheader = DEFAULT_RESEND_STREAMHEADER;
+  this->max_iovecs = DEFAULT_MAX_IOVECS;
+  this->io_threads = DEFAULT_IO_THREADS;
+  this->zerocopy = DEFAULT_ZEROCOPY;
+  this->stats_interval = DEFAULT_STATS_INTERVAL;
 
   this->header_flags = 0;
 }
@@ -728,7 +927,9 @@ gst_multi_fd_sink_finalize (GObject * object)
 
   CLIENTS_LOCK_FREE (this);
   g_hash_table_destroy (this->fd_hash);
-  g_array_free (this->bufqueue, TRUE);
+  g_mutex_free (this->queuelock);
+  g_free (this->bufqueue);
+  g_array_free (this->keyframes, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -811,6 +1012,193 @@ setup_dscp (GstMultiFdSink * sink)
   CLIENTS_UNLOCK (sink);
 }
 
+#ifdef HAVE_ZEROCOPY
+/* the buffers of a zerocopy send, the kernel may still read from them */
+typedef struct
+{
+  guint32 id;
+  GSList *buffers;
+} GstMultiFdSinkZeroCopy;
+
+static void
+gst_multi_fd_sink_zerocopy_free (GstMultiFdSinkZeroCopy * zc)
+{
+  g_slist_foreach (zc->buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_slist_free (zc->buffers);
+  g_slice_free (GstMultiFdSinkZeroCopy, zc);
+}
+
+/* keep a ref to the first @n_iov buffers of the client->sending queue until
+ * the completion for the zerocopy send with the next id arrives. The kernel
+ * numbers the successful zerocopy sends on a socket from 0. */
+static void
+gst_multi_fd_sink_client_zerocopy_hold (GstTCPClient * client, guint n_iov)
+{
+  GstMultiFdSinkZeroCopy *zc;
+  GSList *walk;
+  guint i;
+
+  zc = g_slice_new (GstMultiFdSinkZeroCopy);
+  zc->id = client->zerocopy_id++;
+  zc->buffers = NULL;
+  for (walk = client->sending, i = 0; i < n_iov; walk = walk->next, i++)
+    zc->buffers = g_slist_prepend (zc->buffers, gst_buffer_ref (walk->data));
+
+  g_queue_push_tail (&client->zerocopy_pending, zc);
+}
+
+/* release the buffers of the zerocopy sends with ids from @lo to @hi. The
+ * pending sends are ordered by id but the completed ranges can arrive out
+ * of order. Ids wrap around at 32 bits. */
+static void
+gst_multi_fd_sink_client_zerocopy_release (GstTCPClient * client, guint32 lo,
+    guint32 hi)
+{
+  GList *walk, *next;
+
+  for (walk = client->zerocopy_pending.head; walk; walk = next) {
+    GstMultiFdSinkZeroCopy *zc = walk->data;
+
+    next = walk->next;
+
+    if ((gint32) (zc->id - hi) > 0)
+      break;
+    if ((gint32) (zc->id - lo) < 0)
+      continue;
+
+    g_queue_delete_link (&client->zerocopy_pending, walk);
+    gst_multi_fd_sink_zerocopy_free (zc);
+  }
+}
+
+/* read the completion notifications from the error queue of the socket.
+ * Returns FALSE when the error queue contained a real error. */
+static gboolean
+gst_multi_fd_sink_client_zerocopy_reap (GstMultiFdSink * sink,
+    GstTCPClient * client)
+{
+  while (TRUE) {
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    gchar control[128];
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof (control);
+
+    if (recvmsg (client->fd.fd, &msg, MSG_ERRQUEUE) < 0) {
+      /* error queue is empty */
+      if (errno == EAGAIN)
+        break;
+      goto recv_error;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+      struct sock_extended_err *serr;
+
+      if (!(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR)
+#ifdef IPV6_RECVERR
+          && !(cmsg->cmsg_level == IPPROTO_IPV6
+              && cmsg->cmsg_type == IPV6_RECVERR)
+#endif
+          )
+        continue;
+
+      serr = (struct sock_extended_err *) CMSG_DATA (cmsg);
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+        errno = serr->ee_errno;
+        goto recv_error;
+      }
+
+      GST_LOG_OBJECT (sink, "[fd %5d] zerocopy sends %u-%u completed",
+          client->fd.fd, serr->ee_info, serr->ee_data);
+
+      /* the kernel had to copy the data after all (loopback, devices
+       * without scatter-gather), stop paying for the notifications */
+      if ((serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && client->zerocopy) {
+        GST_DEBUG_OBJECT (sink, "[fd %5d] zerocopy sends were copied, "
+            "disabling zerocopy", client->fd.fd);
+        client->zerocopy = FALSE;
+      }
+      gst_multi_fd_sink_client_zerocopy_release (client, serr->ee_info,
+          serr->ee_data);
+    }
+  }
+  return TRUE;
+
+  /* ERRORS */
+recv_error:
+  {
+    GST_WARNING_OBJECT (sink, "[fd %5d] error on socket: %s (%d)",
+        client->fd.fd, g_strerror (errno), errno);
+    return FALSE;
+  }
+}
+#endif
+
+/* enable MSG_ZEROCOPY sends on a socket client. Clients on sockets that
+ * don't support it (unix sockets, older kernels) use regular sends. */
+static void
+setup_zerocopy_client (GstMultiFdSink * sink, GstTCPClient * client)
+{
+#ifdef HAVE_ZEROCOPY
+  gint on = 1;
+
+  if (!sink->zerocopy)
+    return;
+
+  if (setsockopt (client->fd.fd, SOL_SOCKET, SO_ZEROCOPY, &on,
+          sizeof (on)) < 0) {
+    GST_DEBUG_OBJECT (sink, "[fd %5d] could not enable zerocopy: %s",
+        client->fd.fd, g_strerror (errno));
+    return;
+  }
+  client->zerocopy = TRUE;
+#endif
+}
+
+/* poll reports an error when the error queue of a client contains the
+ * completions of its zerocopy sends. Returns TRUE when there was nothing
+ * else in the error queue. */
+static gboolean
+gst_multi_fd_sink_client_check_error (GstMultiFdSink * sink,
+    GstTCPClient * client)
+{
+#ifdef HAVE_ZEROCOPY
+  if (!g_queue_is_empty (&client->zerocopy_pending))
+    return gst_multi_fd_sink_client_zerocopy_reap (sink, client);
+#endif
+  return FALSE;
+}
+
+/* select the I/O thread with the least clients for a new client.
+ * Should be called with the clientslock held, the number of clients of a
+ * shard only changes with it. Returns NULL when we are not running. */
+static GstMultiFdSinkShard *
+gst_multi_fd_sink_pick_shard (GstMultiFdSink * sink)
+{
+  GstMultiFdSinkShard *result = NULL;
+  guint i;
+
+  for (i = 0; i < sink->n_shards; i++) {
+    GstMultiFdSinkShard *shard = &sink->shards[i];
+
+    if (result == NULL || shard->n_clients < result->n_clients)
+      result = shard;
+  }
+  return result;
+}
+
+/* signal all I/O threads that their fdset changed */
+static void
+gst_multi_fd_sink_restart_shards (GstMultiFdSink * sink)
+{
+  guint i;
+
+  for (i = 0; i < sink->n_shards; i++)
+    gst_poll_restart (sink->shards[i].fdset);
+}
+
 /* "add-full" signal implementation */
 void
 gst_multi_fd_sink_add_full (GstMultiFdSink * sink, int fd,
@@ -818,6 +1206,7 @@ gst_multi_fd_sink_add_full (GstMultiFdSink * sink, int fd,
     GstTCPUnitType max_unit, guint64 max_value)
 {
   GstTCPClient *client;
+  GstMultiFdSinkShard *shard;
   GList *clink;
   GTimeVal now;
   gint flags, res;
@@ -838,10 +1227,11 @@ gst_multi_fd_sink_add_full (GstMultiFdSink * sink, int fd,
   client = g_new0 (GstTCPClient, 1);
   client->fd.fd = fd;
   client->status = GST_CLIENT_STATUS_OK;
-  client->bufpos = -1;
   client->flushcount = -1;
   client->bufoffset = 0;
   client->sending = NULL;
+  client->sending_tail = NULL;
+  client->n_sending = 0;
   client->bytes_sent = 0;
   client->dropped_buffers = 0;
   client->avg_queue_size = 0;
@@ -867,21 +1257,39 @@ gst_multi_fd_sink_add_full (GstMultiFdSink * sink, int fd,
   if (clink != NULL)
     goto duplicate;
 
+  /* pick the I/O thread that will serve this client */
+  shard = gst_multi_fd_sink_pick_shard (sink);
+  if (shard == NULL)
+    goto not_running;
+
+  SHARD_LOCK (shard);
+
+  /* the client starts waiting for the next buffer */
+  QUEUE_LOCK (sink);
+  CLIENT_SET_BUFPOS (sink, client, -1);
+  QUEUE_UNLOCK (sink);
+
   /* we can add the fd now */
   clink = sink->clients = g_list_prepend (sink->clients, client);
   g_hash_table_insert (sink->fd_hash, &client->fd.fd, clink);
+  client->shard = shard;
+  shard->clients = g_list_prepend (shard->clients, client);
+  shard->n_clients++;
+  shard->clients_cookie++;
   sink->clients_cookie++;
 
+  GST_DEBUG_OBJECT (sink, "[fd %5d] served by shard %u", fd, shard->index);
+
   /* set the socket to non blocking */
   res = fcntl (fd, F_SETFL, O_NONBLOCK);
   /* we always read from a client */
-  gst_poll_add_fd (sink->fdset, &client->fd);
+  gst_poll_add_fd (shard->fdset, &client->fd);
 
   /* we don't try to read from write only fds */
   if (sink->handle_read) {
     flags = fcntl (fd, F_GETFL, 0);
     if ((flags & O_ACCMODE) != O_WRONLY) {
-      gst_poll_fd_ctl_read (sink->fdset, &client->fd, TRUE);
+      gst_poll_fd_ctl_read (shard->fdset, &client->fd, TRUE);
     }
   }
   /* figure out the mode, can't use send() for non sockets */
@@ -889,10 +1297,12 @@ gst_multi_fd_sink_add_full (GstMultiFdSink * sink, int fd,
   if (S_ISSOCK (statbuf.st_mode)) {
     client->is_socket = TRUE;
     setup_dscp_client (sink, client);
+    setup_zerocopy_client (sink, client);
   }
 
-  gst_poll_restart (sink->fdset);
+  gst_poll_restart (shard->fdset);
 
+  SHARD_UNLOCK (shard);
   CLIENTS_UNLOCK (sink);
 
   g_signal_emit (G_OBJECT (sink),
@@ -920,6 +1330,13 @@ duplicate:
     g_free (client);
     return;
   }
+not_running:
+  {
+    CLIENTS_UNLOCK (sink);
+    GST_WARNING_OBJECT (sink, "[fd %5d] not running, refusing client", fd);
+    g_free (client);
+    return;
+  }
 }
 
 /* "add" signal implemntation */
@@ -942,17 +1359,21 @@ gst_multi_fd_sink_remove (GstMultiFdSink * sink, int fd)
   clink = g_hash_table_lookup (sink->fd_hash, &fd);
   if (clink != NULL) {
     GstTCPClient *client = (GstTCPClient *) clink->data;
+    GstMultiFdSinkShard *shard = client->shard;
 
+    SHARD_LOCK (shard);
     if (client->status != GST_CLIENT_STATUS_OK) {
       GST_INFO_OBJECT (sink,
           "[fd %5d] Client already disconnecting with status %d",
           fd, client->status);
+      SHARD_UNLOCK (shard);
       goto done;
     }
 
     client->status = GST_CLIENT_STATUS_REMOVED;
     gst_multi_fd_sink_remove_client_link (sink, clink);
-    gst_poll_restart (sink->fdset);
+    SHARD_UNLOCK (shard);
+    gst_poll_restart (shard->fdset);
   } else {
     GST_WARNING_OBJECT (sink, "[fd %5d] no client with this fd found!", fd);
   }
@@ -973,21 +1394,27 @@ gst_multi_fd_sink_remove_flush (GstMultiFdSink * sink, int fd)
   clink = g_hash_table_lookup (sink->fd_hash, &fd);
   if (clink != NULL) {
     GstTCPClient *client = (GstTCPClient *) clink->data;
+    GstMultiFdSinkShard *shard = client->shard;
 
+    SHARD_LOCK (shard);
     if (client->status != GST_CLIENT_STATUS_OK) {
       GST_INFO_OBJECT (sink,
           "[fd %5d] Client already disconnecting with status %d",
           fd, client->status);
+      SHARD_UNLOCK (shard);
       goto done;
     }
 
     /* take the position of the client as the number of buffers left to flush.
      * If the client was at position -1, we flush 0 buffers, 0 == flush 1
      * buffer, etc... */
-    client->flushcount = client->bufpos + 1;
+    QUEUE_LOCK (sink);
+    client->flushcount = CLIENT_BUFPOS (sink, client) + 1;
+    QUEUE_UNLOCK (sink);
     /* mark client as flushing. We can not remove the client right away because
      * it might have some buffers to flush in the ->sending queue. */
     client->status = GST_CLIENT_STATUS_FLUSHING;
+    SHARD_UNLOCK (shard);
   } else {
     GST_WARNING_OBJECT (sink, "[fd %5d] no client with this fd found!", fd);
   }
@@ -1001,6 +1428,7 @@ void
 gst_multi_fd_sink_clear (GstMultiFdSink * sink)
 {
   GList *clients, *next;
+  GstMultiFdSinkShard *shard;
   guint32 cookie;
 
   GST_DEBUG_OBJECT (sink, "clearing all clients");
@@ -1018,11 +1446,14 @@ restart:
 
     client = (GstTCPClient *) clients->data;
     next = g_list_next (clients);
+    shard = client->shard;
 
+    SHARD_LOCK (shard);
     client->status = GST_CLIENT_STATUS_REMOVED;
     gst_multi_fd_sink_remove_client_link (sink, clients);
+    SHARD_UNLOCK (shard);
   }
-  gst_poll_restart (sink->fdset);
+  gst_multi_fd_sink_restart_shards (sink);
   CLIENTS_UNLOCK (sink);
 }
 
@@ -1053,6 +1484,7 @@ gst_multi_fd_sink_get_stats (GstMultiFdSink * sink, int fd)
     GValue value = { 0 };
     guint64 interval;
 
+    SHARD_LOCK (client->shard);
     result = g_value_array_new (5);
 
     g_value_init (&value, G_TYPE_UINT64);
@@ -1087,6 +1519,7 @@ gst_multi_fd_sink_get_stats (GstMultiFdSink * sink, int fd)
     g_value_init (&value, G_TYPE_UINT64);
     g_value_set_uint64 (&value, client->dropped_buffers);
     result = g_value_array_append (result, &value);
+    SHARD_UNLOCK (client->shard);
   }
 
 noclient:
@@ -1101,7 +1534,161 @@ noclient:
   return result;
 }
 
-/* should be called with the clientslock helt.
+/* "get-shard-stats" signal implementation
+ * the array returned contains:
+ *
+ * guint64 : number of clients
+ * guint64 : bytes_sent
+ * guint64 : number of wakeups
+ */
+GValueArray *
+gst_multi_fd_sink_get_shard_stats (GstMultiFdSink * sink, int shard_idx)
+{
+  GstMultiFdSinkShard *shard;
+  GValueArray *result;
+  GValue value = { 0 };
+
+  CLIENTS_LOCK (sink);
+  if (shard_idx < 0 || shard_idx >= (gint) sink->n_shards)
+    goto noshard;
+
+  shard = &sink->shards[shard_idx];
+
+  SHARD_LOCK (shard);
+  result = g_value_array_new (3);
+
+  g_value_init (&value, G_TYPE_UINT64);
+  g_value_set_uint64 (&value, shard->n_clients);
+  result = g_value_array_append (result, &value);
+  g_value_unset (&value);
+  g_value_init (&value, G_TYPE_UINT64);
+  g_value_set_uint64 (&value, shard->bytes_served);
+  result = g_value_array_append (result, &value);
+  g_value_unset (&value);
+  g_value_init (&value, G_TYPE_UINT64);
+  g_value_set_uint64 (&value, shard->wakeups);
+  result = g_value_array_append (result, &value);
+  g_value_unset (&value);
+  SHARD_UNLOCK (shard);
+  CLIENTS_UNLOCK (sink);
+
+  return result;
+
+  /* ERRORS */
+noshard:
+  {
+    CLIENTS_UNLOCK (sink);
+    GST_WARNING_OBJECT (sink, "no shard with index %d", shard_idx);
+    return g_value_array_new (0);
+  }
+}
+
+static inline void
+histogram_add (GstMultiFdSinkHistogram * hist, guint64 value)
+{
+  guint bucket = 0;
+
+  /* number of significant bits */
+  while (value && bucket < GST_MULTI_FD_SINK_HISTOGRAM_BUCKETS - 1) {
+    value >>= 1;
+    bucket++;
+  }
+  hist->buckets[bucket]++;
+}
+
+static void
+histogram_set_field (GstStructure * s, const gchar * name,
+    const GstMultiFdSinkHistogram * hist)
+{
+  GValue array = { 0 };
+  GValue value = { 0 };
+  guint i;
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+  g_value_init (&value, G_TYPE_UINT64);
+  for (i = 0; i < GST_MULTI_FD_SINK_HISTOGRAM_BUCKETS; i++) {
+    g_value_set_uint64 (&value, hist->buckets[i]);
+    gst_value_array_append_value (&array, &value);
+  }
+  g_value_unset (&value);
+  gst_structure_set_value (s, name, &array);
+  g_value_unset (&array);
+}
+
+/* should be called with the clientslock held or from the streaming thread,
+ * which keeps the shards alive. Takes the lock of every shard in turn. */
+static GstStructure *
+gst_multi_fd_sink_build_histograms (GstMultiFdSink * sink)
+{
+  GstStructure *result;
+  GValue clients = { 0 };
+  GList *walk;
+  guint i, n_clients = 0;
+
+  QUEUE_LOCK (sink);
+  result = gst_structure_new ("multifdsink-stats",
+      "bytes-served", G_TYPE_UINT64, sink->bytes_served,
+      "buffers-queued", G_TYPE_INT, sink->buffers_queued, NULL);
+  histogram_set_field (result, "queue-depth", &sink->queue_depth);
+  histogram_set_field (result, "queue-time", &sink->queue_time);
+  histogram_set_field (result, "write-size", &sink->write_size);
+  QUEUE_UNLOCK (sink);
+
+  g_value_init (&clients, GST_TYPE_ARRAY);
+  for (i = 0; i < sink->n_shards; i++) {
+    GstMultiFdSinkShard *shard = &sink->shards[i];
+
+    SHARD_LOCK (shard);
+    n_clients += shard->n_clients;
+    for (walk = shard->clients; walk; walk = g_list_next (walk)) {
+      GstTCPClient *client = (GstTCPClient *) walk->data;
+      GstStructure *cs;
+      GValue value = { 0 };
+      gint position;
+
+      QUEUE_LOCK (sink);
+      position = CLIENT_BUFPOS (sink, client);
+      QUEUE_UNLOCK (sink);
+
+      cs = gst_structure_new ("multifdsink-client",
+          "fd", G_TYPE_INT, client->fd.fd,
+          "position", G_TYPE_INT, position,
+          "bytes-sent", G_TYPE_UINT64, client->bytes_sent,
+          "dropped-buffers", G_TYPE_UINT64, client->dropped_buffers, NULL);
+      histogram_set_field (cs, "queue-depth", &client->queue_depth);
+      histogram_set_field (cs, "queue-time", &client->queue_time);
+      histogram_set_field (cs, "write-size", &client->write_size);
+
+      g_value_init (&value, GST_TYPE_STRUCTURE);
+      g_value_take_boxed (&value, cs);
+      gst_value_array_append_value (&clients, &value);
+      g_value_unset (&value);
+    }
+    SHARD_UNLOCK (shard);
+  }
+  gst_structure_set (result, "clients", G_TYPE_UINT, n_clients, NULL);
+  gst_structure_set_value (result, "client-stats", &clients);
+  g_value_unset (&clients);
+
+  return result;
+}
+
+/* "get-histograms" signal implementation
+ */
+GstStructure *
+gst_multi_fd_sink_get_histograms (GstMultiFdSink * sink)
+{
+  GstStructure *result;
+
+  CLIENTS_LOCK (sink);
+  result = gst_multi_fd_sink_build_histograms (sink);
+  CLIENTS_UNLOCK (sink);
+
+  return result;
+}
+
+/* should be called with the clientslock and the lock of the shard of the
+ * client held, both are released while emitting the signals.
  * Note that we don't close the fd as we didn't open it in the first
  * place. An application should connect to the client-fd-removed signal and
  * close the fd itself.
@@ -1112,12 +1699,20 @@ gst_multi_fd_sink_remove_client_link (GstMultiFdSink * sink, GList * link)
   int fd;
   GTimeVal now;
   GstTCPClient *client = (GstTCPClient *) link->data;
+  GstMultiFdSinkShard *shard = client->shard;
   GstMultiFdSinkClass *fclass;
 
   fclass = GST_MULTI_FD_SINK_GET_CLASS (sink);
 
   fd = client->fd.fd;
 
+  if (client->writing) {
+    /* the I/O thread of the client is writing to it without the lock, it
+     * will remove the client when it sees the new status */
+    GST_DEBUG_OBJECT (sink, "[fd %5d] client is writing, delay removal", fd);
+    return;
+  }
+
   if (client->currently_removing) {
     GST_WARNING_OBJECT (sink, "[fd %5d] client is already being removed", fd);
     return;
@@ -1155,7 +1750,7 @@ gst_multi_fd_sink_remove_client_link (GstMultiFdSink * sink, GList * link)
       break;
   }
 
-  gst_poll_remove_fd (sink->fdset, &client->fd);
+  gst_poll_remove_fd (shard->fdset, &client->fd);
 
   g_get_current_time (&now);
   client->disconnect_time = GST_TIMEVAL_TO_TIME (now);
@@ -1164,13 +1759,24 @@ gst_multi_fd_sink_remove_client_link (GstMultiFdSink * sink, GList * link)
   g_slist_foreach (client->sending, (GFunc) gst_mini_object_unref, NULL);
   g_slist_free (client->sending);
   client->sending = NULL;
+  client->sending_tail = NULL;
+  client->n_sending = 0;
+
+#ifdef HAVE_ZEROCOPY
+  /* the kernel still holds the pages of unfinished zerocopy sends but the
+   * client is going away, what it receives from now on doesn't matter */
+  g_queue_foreach (&client->zerocopy_pending,
+      (GFunc) gst_multi_fd_sink_zerocopy_free, NULL);
+  g_queue_clear (&client->zerocopy_pending);
+#endif
 
   if (client->caps)
     gst_caps_unref (client->caps);
   client->caps = NULL;
 
-  /* unlock the mutex before signaling because the signal handler
+  /* unlock the mutexes before signaling because the signal handler
    * might query some properties */
+  SHARD_UNLOCK (shard);
   CLIENTS_UNLOCK (sink);
 
   g_signal_emit (G_OBJECT (sink),
@@ -1178,6 +1784,7 @@ gst_multi_fd_sink_remove_client_link (GstMultiFdSink * sink, GList * link)
 
   /* lock again before we remove the client completely */
   CLIENTS_LOCK (sink);
+  SHARD_LOCK (shard);
 
   /* fd cannot be reused in the above signal callback so we can safely
    * remove it from the hashtable here */
@@ -1191,12 +1798,16 @@ gst_multi_fd_sink_remove_client_link (GstMultiFdSink * sink, GList * link)
    * and take a shortcut when it did not change between unlocking and locking
    * our mutex. For now we just walk the list again. */
   sink->clients = g_list_remove (sink->clients, client);
+  shard->clients = g_list_remove (shard->clients, client);
+  shard->n_clients--;
+  shard->clients_cookie++;
   sink->clients_cookie++;
 
   if (fclass->removed)
     fclass->removed (sink, client->fd.fd);
 
   g_free (client);
+  SHARD_UNLOCK (shard);
   CLIENTS_UNLOCK (sink);
 
   /* and the fd is really gone now */
@@ -1204,6 +1815,43 @@ gst_multi_fd_sink_remove_client_link (GstMultiFdSink * sink, GList * link)
       gst_multi_fd_sink_signals[SIGNAL_CLIENT_FD_REMOVED], 0, fd);
 
   CLIENTS_LOCK (sink);
+  SHARD_LOCK (shard);
+}
+
+/* remove the clients in @garbage, which were marked for removal while only
+ * the lock of their shard was held. Should be called without holding any
+ * lock, takes ownership of @garbage. */
+static void
+gst_multi_fd_sink_remove_garbage (GstMultiFdSink * sink, GSList * garbage)
+{
+  GSList *walk;
+
+  if (garbage == NULL)
+    return;
+
+  CLIENTS_LOCK (sink);
+  for (walk = garbage; walk; walk = g_slist_next (walk)) {
+    GstTCPClient *client = (GstTCPClient *) walk->data;
+    GstMultiFdSinkShard *shard;
+    GList *clink;
+
+    /* the client could have been removed by another thread in the meantime,
+     * look it up again. The status is checked again too, a new client could
+     * have been allocated at the same address. */
+    clink = g_list_find (sink->clients, client);
+    if (clink == NULL)
+      continue;
+
+    shard = client->shard;
+    SHARD_LOCK (shard);
+    if (client->status != GST_CLIENT_STATUS_OK &&
+        client->status != GST_CLIENT_STATUS_FLUSHING)
+      gst_multi_fd_sink_remove_client_link (sink, clink);
+    SHARD_UNLOCK (shard);
+  }
+  CLIENTS_UNLOCK (sink);
+
+  g_slist_free (garbage);
 }
 
 /* handle a read on a client fd,
@@ -1278,6 +1926,23 @@ ioctl_failed:
   }
 }
 
+/* append @buf to the client->sending queue, taking ownership of it. We keep
+ * the tail and the length of the queue so that gathering a batch of buffers
+ * does not have to walk it. */
+static void
+gst_multi_fd_sink_client_append (GstTCPClient * client, GstBuffer * buf)
+{
+  GSList *link;
+
+  link = g_slist_prepend (NULL, buf);
+  if (client->sending_tail)
+    client->sending_tail->next = link;
+  else
+    client->sending = link;
+  client->sending_tail = link;
+  client->n_sending++;
+}
+
 /* Queue raw data for this client, creating a new buffer.
  * This takes ownership of the data by
  * setting it as GST_BUFFER_MALLOCDATA() on the created buffer so
@@ -1297,7 +1962,7 @@ gst_multi_fd_sink_client_queue_data (GstMultiFdSink * sink,
   GST_LOG_OBJECT (sink, "[fd %5d] queueing data of length %d",
       client->fd.fd, len);
 
-  client->sending = g_slist_append (client->sending, buf);
+  gst_multi_fd_sink_client_append (client, buf);
 
   return TRUE;
 }
@@ -1345,10 +2010,11 @@ is_sync_frame (GstMultiFdSink * sink, GstBuffer * buffer)
 }
 
 /* queue the given buffer for the given client, possibly adding the GDP
- * header if GDP is being used */
+ * header if GDP is being used. @header is the GDP header of @buffer shared
+ * with the other clients. */
 static gboolean
 gst_multi_fd_sink_client_queue_buffer (GstMultiFdSink * sink,
-    GstTCPClient * client, GstBuffer * buffer)
+    GstTCPClient * client, GstBuffer * buffer, GstBuffer * header)
 {
   GstCaps *caps;
 
@@ -1459,7 +2125,7 @@ gst_multi_fd_sink_client_queue_buffer (GstMultiFdSink * sink,
               len);
         }
 
-        client->sending = g_slist_append (client->sending, buffer);
+        gst_multi_fd_sink_client_append (client, buffer);
       }
     }
   }
@@ -1468,26 +2134,192 @@ gst_multi_fd_sink_client_queue_buffer (GstMultiFdSink * sink,
   caps = NULL;
   /* now we can send the buffer, possibly sending a GDP header first */
   if (sink->protocol == GST_TCP_PROTOCOL_GDP) {
-    guint8 *header;
-    guint len;
-
-    if (!gst_dp_header_from_buffer (buffer, sink->header_flags, &len, &header)) {
+    if (header == NULL) {
       GST_DEBUG_OBJECT (sink,
           "[fd %5d] could not create header, removing client", client->fd.fd);
       return FALSE;
     }
-    gst_multi_fd_sink_client_queue_data (sink, client, (gchar *) header, len);
+    GST_LOG_OBJECT (sink, "[fd %5d] queueing header of length %d",
+        client->fd.fd, GST_BUFFER_SIZE (header));
+    gst_multi_fd_sink_client_append (client, gst_buffer_ref (header));
   }
 
   GST_LOG_OBJECT (sink, "[fd %5d] queueing buffer of length %d",
       client->fd.fd, GST_BUFFER_SIZE (buffer));
 
   gst_buffer_ref (buffer);
-  client->sending = g_slist_append (client->sending, buffer);
+  gst_multi_fd_sink_client_append (client, buffer);
 
   return TRUE;
 }
 
+static inline GstMultiFdSinkEntry *
+bufqueue_entry (GstMultiFdSink * sink, gint pos)
+{
+  return BUFQUEUE_ENTRY (sink, BUFQUEUE_SEQ (sink, pos));
+}
+
+static inline GstBuffer *
+bufqueue_get (GstMultiFdSink * sink, gint pos)
+{
+  return bufqueue_entry (sink, pos)->buffer;
+}
+
+/* the number of bytes in the buffers from position 0 up to and including
+ * @pos */
+static inline guint64
+bufqueue_bytes (GstMultiFdSink * sink, gint pos)
+{
+  GstMultiFdSinkEntry *newest, *entry;
+
+  newest = bufqueue_entry (sink, 0);
+  entry = bufqueue_entry (sink, pos);
+
+  return newest->bytes - entry->bytes + GST_BUFFER_SIZE (entry->buffer);
+}
+
+/* find the first position in the queue where the buffers from position 0
+ * contain at least @bytes bytes.
+ * Returns: the position or -1 when there is not enough data queued. */
+static gint
+bufqueue_find_bytes (GstMultiFdSink * sink, guint64 bytes)
+{
+  gint lo, hi;
+
+  if (sink->bufqueue_len == 0 ||
+      bufqueue_bytes (sink, sink->bufqueue_len - 1) < bytes)
+    return -1;
+
+  /* the byte count grows with the position, bisect */
+  lo = 0;
+  hi = sink->bufqueue_len - 1;
+  while (lo < hi) {
+    gint mid = lo + (hi - lo) / 2;
+
+    if (bufqueue_bytes (sink, mid) >= bytes)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+/* add @buf as the newest buffer to the queue, takes ownership of @buf */
+static void
+bufqueue_push (GstMultiFdSink * sink, GstBuffer * buf, GstClockTime now)
+{
+  GstMultiFdSinkEntry *entry;
+  guint64 seq, bytes;
+
+  if (sink->bufqueue_len == sink->bufqueue_size) {
+    GstMultiFdSinkEntry *old = sink->bufqueue;
+    guint old_size = sink->bufqueue_size;
+    guint64 first;
+
+    /* ring is full, move the entries into a ring twice as large */
+    sink->bufqueue_size = MAX (old_size * 2, DEFAULT_BUFQUEUE_SIZE);
+    sink->bufqueue = g_new0 (GstMultiFdSinkEntry, sink->bufqueue_size);
+
+    first = sink->bufqueue_head - sink->bufqueue_len;
+    for (seq = first; seq < sink->bufqueue_head; seq++)
+      *BUFQUEUE_ENTRY (sink, seq) = old[seq & (old_size - 1)];
+
+    g_free (old);
+    GST_DEBUG_OBJECT (sink, "grew buffer queue to %u entries",
+        sink->bufqueue_size);
+  }
+
+  if (sink->bufqueue_len > 0)
+    bytes = bufqueue_entry (sink, 0)->bytes;
+  else
+    bytes = 0;
+
+  seq = sink->bufqueue_head++;
+  sink->bufqueue_len++;
+
+  entry = BUFQUEUE_ENTRY (sink, seq);
+  entry->buffer = buf;
+  entry->header = NULL;
+  entry->bytes = bytes + GST_BUFFER_SIZE (buf);
+  entry->queued = now;
+
+  /* index the sync frames so that we can find them without scanning */
+  if (is_sync_frame (sink, buf))
+    g_array_append_val (sink->keyframes, seq);
+}
+
+/* remove the oldest buffer from the queue */
+static void
+bufqueue_pop (GstMultiFdSink * sink)
+{
+  GstMultiFdSinkEntry *entry;
+  guint64 seq;
+
+  g_return_if_fail (sink->bufqueue_len > 0);
+
+  seq = sink->bufqueue_head - sink->bufqueue_len;
+  entry = BUFQUEUE_ENTRY (sink, seq);
+
+  /* unref tail buffer */
+  gst_buffer_unref (entry->buffer);
+  if (entry->header)
+    gst_buffer_unref (entry->header);
+  entry->buffer = NULL;
+  entry->header = NULL;
+  sink->bufqueue_len--;
+
+  /* drop the buffer from the sync frame index */
+  if (sink->keyframes_start < sink->keyframes->len &&
+      g_array_index (sink->keyframes, guint64, sink->keyframes_start) == seq)
+    sink->keyframes_start++;
+
+  /* compact the index when half of it is unused */
+  if (sink->keyframes_start > 32 &&
+      sink->keyframes_start * 2 > sink->keyframes->len) {
+    g_array_remove_range (sink->keyframes, 0, sink->keyframes_start);
+    sink->keyframes_start = 0;
+  }
+}
+
+/* remove all buffers from the queue */
+static void
+bufqueue_clear (GstMultiFdSink * sink)
+{
+  GST_DEBUG_OBJECT (sink, "Emptying bufqueue with %u buffers",
+      sink->bufqueue_len);
+
+  while (sink->bufqueue_len > 0)
+    bufqueue_pop (sink);
+
+  g_array_set_size (sink->keyframes, 0);
+  sink->keyframes_start = 0;
+}
+
+/* get the GDP header for the buffer at @pos. The header is created only
+ * once and shared by all clients. */
+static GstBuffer *
+bufqueue_get_header (GstMultiFdSink * sink, gint pos)
+{
+  GstMultiFdSinkEntry *entry;
+
+  entry = bufqueue_entry (sink, pos);
+
+  if (entry->header == NULL) {
+    guint8 *header;
+    guint len;
+
+    if (!gst_dp_header_from_buffer (entry->buffer, sink->header_flags, &len,
+            &header))
+      return NULL;
+
+    entry->header = gst_buffer_new ();
+    GST_BUFFER_DATA (entry->header) = header;
+    GST_BUFFER_MALLOCDATA (entry->header) = header;
+    GST_BUFFER_SIZE (entry->header) = len;
+  }
+  return entry->header;
+}
+
 /* find the keyframe in the list of buffers starting the
  * search from @idx. @direction as -1 will search backwards, 
  * 1 will search forwards.
@@ -1496,26 +2328,54 @@ gst_multi_fd_sink_client_queue_buffer (GstMultiFdSink * sink,
 static gint
 find_syncframe (GstMultiFdSink * sink, gint idx, gint direction)
 {
-  gint i, len, result;
-
-  /* take length of queued buffers */
-  len = sink->bufqueue->len;
+  guint64 seq, kseq;
+  guint lo, hi;
+  gint result;
 
   /* assume we don't find a keyframe */
   result = -1;
 
-  /* then loop over all buffers to find the first keyframe */
-  for (i = idx; i >= 0 && i < len; i += direction) {
-    GstBuffer *buf;
+  if (idx < 0 || idx >= (gint) sink->bufqueue_len)
+    return result;
 
-    buf = g_array_index (sink->bufqueue, GstBuffer *, i);
-    if (is_sync_frame (sink, buf)) {
-      GST_LOG_OBJECT (sink, "found keyframe at %d from %d, direction %d",
-          i, idx, direction);
-      result = i;
-      break;
-    }
+  lo = sink->keyframes_start;
+  hi = sink->keyframes->len;
+  if (lo == hi)
+    return result;
+
+  seq = BUFQUEUE_SEQ (sink, idx);
+
+  /* bisect the sequence numbers of the sync frames for the first one
+   * that comes after seq */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (g_array_index (sink->keyframes, guint64, mid) <= seq)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (direction > 0) {
+    /* search towards older buffers, take the last one at or before seq */
+    if (lo == sink->keyframes_start)
+      return result;
+    kseq = g_array_index (sink->keyframes, guint64, lo - 1);
+  } else {
+    /* search towards newer buffers, take the first one at or after seq */
+    if (lo > sink->keyframes_start &&
+        g_array_index (sink->keyframes, guint64, lo - 1) == seq)
+      kseq = seq;
+    else if (lo < sink->keyframes->len)
+      kseq = g_array_index (sink->keyframes, guint64, lo);
+    else
+      return result;
   }
+  result = BUFQUEUE_SEQ (sink, 0) - kseq;
+
+  GST_LOG_OBJECT (sink, "found keyframe at %d from %d, direction %d",
+      result, idx, direction);
+
   return result;
 }
 
@@ -1540,10 +2400,10 @@ get_buffers_max (GstMultiFdSink * sink, gint64 max)
       gint64 diff;
       GstClockTime first = GST_CLOCK_TIME_NONE;
 
-      len = sink->bufqueue->len;
+      len = sink->bufqueue_len;
 
       for (i = 0; i < len; i++) {
-        buf = g_array_index (sink->bufqueue, GstBuffer *, i);
+        buf = bufqueue_get (sink, i);
         if (GST_BUFFER_TIMESTAMP_IS_VALID (buf)) {
           if (first == -1)
             first = GST_BUFFER_TIMESTAMP (buf);
@@ -1558,21 +2418,14 @@ get_buffers_max (GstMultiFdSink * sink, gint64 max)
     }
     case GST_TCP_UNIT_TYPE_BYTES:
     {
-      GstBuffer *buf;
-      int i;
-      int len;
-      gint acc = 0;
+      gint i;
 
-      len = sink->bufqueue->len;
+      /* find the first buffer where we have more than max bytes */
+      i = bufqueue_find_bytes (sink, max + 1);
+      if (i != -1)
+        return i + 1;
 
-      for (i = 0; i < len; i++) {
-        buf = g_array_index (sink->bufqueue, GstBuffer *, i);
-        acc += GST_BUFFER_SIZE (buf);
-
-        if (acc > max)
-          return i + 1;
-      }
-      return len + 1;
+      return sink->bufqueue_len + 1;
     }
     default:
       return max;
@@ -1601,7 +2454,7 @@ find_limits (GstMultiFdSink * sink,
   gboolean result, max_hit;
 
   /* take length of queue */
-  len = sink->bufqueue->len;
+  len = sink->bufqueue_len;
 
   /* this must hold */
   g_assert (len > 0);
@@ -1619,6 +2472,45 @@ find_limits (GstMultiFdSink * sink,
     return FALSE;
   }
 
+  /* without time limits we can find the positions from the byte counts of
+   * the queue, this gives the same result as the loop below */
+  if (time_min == -1 && time_max == -1) {
+    gint min_pos, max_pos;
+
+    /* the min limit is checked at the start of the loop iteration after the
+     * one that satisfied it, the loop stops in the iteration after the max
+     * was hit */
+    if (bytes_min == -1) {
+      min_pos = 0;
+      *min_idx = 0;
+    } else {
+      *min_idx = bufqueue_find_bytes (sink, bytes_min);
+      min_pos = (*min_idx == -1) ? len : *min_idx + 1;
+    }
+    if (bytes_max == -1)
+      max_pos = -1;
+    else
+      max_pos = bufqueue_find_bytes (sink, bytes_max);
+
+    if (max_pos != -1 && max_pos + 1 < len) {
+      /* the max was hit, we have a result if the min was found first */
+      *max_idx = max_pos;
+      if (min_pos > max_pos + 1)
+        *min_idx = -1;
+      result = *min_idx != -1;
+    } else {
+      *max_idx = len - 1;
+      if (min_pos >= len)
+        *min_idx = -1;
+      result = FALSE;
+    }
+    /* make sure min does not exceed max */
+    if (*min_idx == -1)
+      *min_idx = *max_idx;
+
+    return result;
+  }
+
   result = FALSE;
   /* else count bytes and time */
   first = -1;
@@ -1648,7 +2540,7 @@ find_limits (GstMultiFdSink * sink,
       result = *min_idx != -1;
       break;
     }
-    buf = g_array_index (sink->bufqueue, GstBuffer *, i);
+    buf = bufqueue_get (sink, i);
 
     bytes += GST_BUFFER_SIZE (buf);
 
@@ -1754,6 +2646,8 @@ count_burst_unit (GstMultiFdSink * sink, gint * min_idx,
  * If this returns -1, it means that we haven't found a good point to
  * start streaming from yet, and this function should be called again later
  * when more buffers have arrived.
+ * Should be called with the lock of the shard of the client and the queuelock
+ * held.
  */
 static gint
 gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
@@ -1763,23 +2657,24 @@ gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
   GST_DEBUG_OBJECT (sink,
       "[fd %5d] new client, deciding where to start in queue", client->fd.fd);
   GST_DEBUG_OBJECT (sink, "queue is currently %d buffers long",
-      sink->bufqueue->len);
+      sink->bufqueue_len);
   switch (client->sync_method) {
     case GST_SYNC_METHOD_LATEST:
       /* no syncing, we are happy with whatever the client is going to get */
-      result = client->bufpos;
+      result = CLIENT_BUFPOS (sink, client);
       GST_DEBUG_OBJECT (sink,
           "[fd %5d] SYNC_METHOD_LATEST, position %d", client->fd.fd, result);
       break;
     case GST_SYNC_METHOD_NEXT_KEYFRAME:
     {
-      /* if one of the new buffers (between client->bufpos and 0) in the queue
-       * is a sync point, we can proceed, otherwise we need to keep waiting */
+      /* if one of the new buffers (between the client position and 0) in the
+       * queue is a sync point, we can proceed, otherwise we need to keep
+       * waiting */
       GST_LOG_OBJECT (sink,
           "[fd %5d] new client, bufpos %d, waiting for keyframe", client->fd.fd,
-          client->bufpos);
+          CLIENT_BUFPOS (sink, client));
 
-      result = find_prev_syncframe (sink, client->bufpos);
+      result = find_prev_syncframe (sink, CLIENT_BUFPOS (sink, client));
       if (result != -1) {
         GST_DEBUG_OBJECT (sink,
             "[fd %5d] SYNC_METHOD_NEXT_KEYFRAME: result %d",
@@ -1792,7 +2687,7 @@ gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
       GST_LOG_OBJECT (sink,
           "[fd %5d] new client, skipping buffer(s), no syncpoint found",
           client->fd.fd);
-      client->bufpos = -1;
+      CLIENT_SET_BUFPOS (sink, client, -1);
       break;
     }
     case GST_SYNC_METHOD_LATEST_KEYFRAME:
@@ -1817,7 +2712,7 @@ gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
           "[fd %5d] SYNC_METHOD_LATEST_KEYFRAME: no keyframe found, "
           "switching to SYNC_METHOD_NEXT_KEYFRAME", client->fd.fd);
       /* throw client to the waiting state */
-      client->bufpos = -1;
+      CLIENT_SET_BUFPOS (sink, client, -1);
       /* and make client sync to next keyframe */
       client->sync_method = GST_SYNC_METHOD_NEXT_KEYFRAME;
       break;
@@ -1893,7 +2788,7 @@ gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
           "no prev keyframe found in BURST_KEYFRAME sync mode, waiting for next");
 
       /* throw client to the waiting state */
-      client->bufpos = -1;
+      CLIENT_SET_BUFPOS (sink, client, -1);
       /* and make client sync to next keyframe */
       client->sync_method = GST_SYNC_METHOD_NEXT_KEYFRAME;
       result = -1;
@@ -1941,12 +2836,164 @@ gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
     }
     default:
       g_warning ("unknown sync method %d", client->sync_method);
-      result = client->bufpos;
+      result = CLIENT_BUFPOS (sink, client);
       break;
   }
   return result;
 }
 
+/* the streaming thread only keeps the buffers that the clients needed when
+ * it last looked at them, a new client can have picked an older buffer since
+ * then. Move such a client to the oldest buffer we still have. Should be
+ * called with the lock of the shard of the client and the queuelock held. */
+static void
+gst_multi_fd_sink_client_check_lost (GstMultiFdSink * sink,
+    GstTCPClient * client)
+{
+  gint pos, lost;
+
+  pos = CLIENT_BUFPOS (sink, client);
+  if (pos < (gint) sink->bufqueue_len)
+    return;
+
+  lost = pos - sink->bufqueue_len + 1;
+  GST_WARNING_OBJECT (sink, "[fd %5d] client %p lost %d buffers",
+      client->fd.fd, client, lost);
+  client->dropped_buffers += lost;
+  client->discont = TRUE;
+  CLIENT_SET_BUFPOS (sink, client, (gint) sink->bufqueue_len - 1);
+}
+
+/* take the buffer at the client's position in the global queue and queue it
+ * for sending. Should be called with the lock of the shard of the client and
+ * the queuelock held. */
+static void
+gst_multi_fd_sink_client_take_buffer (GstMultiFdSink * sink,
+    GstTCPClient * client, GstClockTime now)
+{
+  GstBuffer *buf, *header = NULL;
+  GstClockTime queued;
+  guint64 wait;
+  gint pos;
+
+  pos = CLIENT_BUFPOS (sink, client);
+
+  /* update stats before we move the client, the buffer can be queued after
+   * @now was taken */
+  queued = bufqueue_entry (sink, pos)->queued;
+  wait = (now > queued) ? (now - queued) / GST_USECOND : 0;
+  histogram_add (&client->queue_depth, pos + 1);
+  histogram_add (&client->queue_time, wait);
+  histogram_add (&sink->queue_depth, pos + 1);
+  histogram_add (&sink->queue_time, wait);
+
+  /* grab buffer and its shared header */
+  buf = bufqueue_get (sink, pos);
+  if (sink->protocol == GST_TCP_PROTOCOL_GDP)
+    header = bufqueue_get_header (sink, pos);
+  CLIENT_SET_BUFPOS (sink, client, pos - 1);
+
+  /* decrease flushcount */
+  if (client->flushcount != -1)
+    client->flushcount--;
+
+  GST_LOG_OBJECT (sink, "[fd %5d] client %p at position %d",
+      client->fd.fd, client, pos - 1);
+
+  /* queueing a buffer will ref it */
+  gst_multi_fd_sink_client_queue_buffer (sink, client, buf, header);
+}
+
+/* write the first max-iovecs buffers of the client->sending queue with one
+ * system call, starting at client->bufoffset in the first buffer.
+ *
+ * Returns: the number of bytes written or -1 with errno set on error.
+ * @maxsize contains the number of bytes we tried to write.
+ */
+static gssize
+gst_multi_fd_sink_client_writev (GstMultiFdSink * sink,
+    GstTCPClient * client, gsize * maxsize)
+{
+  struct iovec *iov;
+  GSList *walk;
+  guint i, n_iov;
+  gssize wrote;
+
+  n_iov = MIN (client->n_sending, sink->max_iovecs);
+  iov = g_newa (struct iovec, n_iov);
+
+  *maxsize = 0;
+  for (walk = client->sending, i = 0; i < n_iov; walk = walk->next, i++) {
+    GstBuffer *buf = GST_BUFFER_CAST (walk->data);
+    guint offset = (i == 0) ? client->bufoffset : 0;
+
+    iov[i].iov_base = GST_BUFFER_DATA (buf) + offset;
+    iov[i].iov_len = GST_BUFFER_SIZE (buf) - offset;
+    *maxsize += iov[i].iov_len;
+  }
+
+  GST_LOG_OBJECT (sink, "[fd %5d] writing %u buffers of %" G_GSIZE_FORMAT
+      " bytes", client->fd.fd, n_iov, *maxsize);
+
+  if (client->is_socket) {
+    struct msghdr msg;
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n_iov;
+
+#ifdef HAVE_ZEROCOPY
+    if (client->zerocopy && *maxsize >= ZEROCOPY_MIN_SIZE) {
+      wrote = sendmsg (client->fd.fd, &msg, FLAGS | MSG_ZEROCOPY);
+      if (wrote > 0) {
+        gst_multi_fd_sink_client_zerocopy_hold (client, n_iov);
+        return wrote;
+      }
+      /* the kernel could not pin the pages (optmem limit reached), copy
+       * them instead */
+      if (wrote == 0 || errno != ENOBUFS)
+        return wrote;
+
+      GST_LOG_OBJECT (sink, "[fd %5d] zerocopy send failed, copying",
+          client->fd.fd);
+    }
+#endif
+    wrote = sendmsg (client->fd.fd, &msg, FLAGS);
+  } else {
+    wrote = writev (client->fd.fd, iov, n_iov);
+  }
+  return wrote;
+}
+
+/* remove @wrote bytes from the start of the client->sending queue. Buffers
+ * that were completely written are unreffed, a partially written buffer
+ * stays at the head with client->bufoffset updated. */
+static void
+gst_multi_fd_sink_client_consume (GstMultiFdSink * sink,
+    GstTCPClient * client, gsize wrote)
+{
+  while (client->sending) {
+    GstBuffer *head;
+    gsize left;
+
+    head = GST_BUFFER_CAST (client->sending->data);
+    left = GST_BUFFER_SIZE (head) - client->bufoffset;
+
+    if (wrote < left) {
+      client->bufoffset += wrote;
+      break;
+    }
+    /* complete buffer was written, we can proceed to the next one */
+    client->sending = g_slist_delete_link (client->sending, client->sending);
+    if (--client->n_sending == 0)
+      client->sending_tail = NULL;
+    gst_buffer_unref (head);
+    /* make sure we start from byte 0 for the next buffer */
+    client->bufoffset = 0;
+    wrote -= left;
+  }
+}
+
 /* Handle a write on a client,
  * which indicates a read request from a client.
  *
@@ -1960,17 +3007,20 @@ gst_multi_fd_sink_new_client (GstMultiFdSink * sink, GstTCPClient * client)
  *
  * Then we run into the main loop that tries to send as many buffers as
  * possible. It will first exhaust the client->sending queue and if the queue
- * is empty, it will pick a buffer from the global queue.
+ * is empty, it will pick a buffer from the global queue. The sending queue is
+ * topped up from the global queue until it holds max-iovecs buffers.
  *
  * Sending the buffers from the client->sending queue is basically writing
- * the bytes to the socket and maintaining a count of the bytes that were
- * sent. When the buffer is completely sent, it is removed from the
- * client->sending queue and we try to pick a new buffer for sending.
+ * up to max-iovecs buffers to the socket with one writev/sendmsg and
+ * maintaining a count of the bytes that were sent. When a buffer is
+ * completely sent, it is removed from the client->sending queue and we try
+ * to pick new buffers for sending.
  *
  * When the sending returns a partial buffer we stop sending more data as
  * the next send operation could block.
  *
- * This functions returns FALSE if some error occured.
+ * This functions returns FALSE if some error occured. Should be called with
+ * the lock of the shard of the client held, it is released while writing.
  */
 static gboolean
 gst_multi_fd_sink_handle_client_write (GstMultiFdSink * sink,
@@ -2023,14 +3073,15 @@ gst_multi_fd_sink_handle_client_write (GstMultiFdSink * sink,
 
   more = TRUE;
   do {
-    gint maxsize;
-
+    QUEUE_LOCK (sink);
+    gst_multi_fd_sink_client_check_lost (sink, client);
     if (!client->sending) {
       /* client is not working on a buffer */
-      if (client->bufpos == -1) {
+      if (CLIENT_BUFPOS (sink, client) == -1) {
+        QUEUE_UNLOCK (sink);
         /* client is too fast, remove from write queue until new buffer is
          * available */
-        gst_poll_fd_ctl_write (sink->fdset, &client->fd, FALSE);
+        gst_poll_fd_ctl_write (client->shard->fdset, &client->fd, FALSE);
         /* if we flushed out all of the client buffers, we can stop */
         if (client->flushcount == 0)
           goto flushed;
@@ -2038,7 +3089,6 @@ gst_multi_fd_sink_handle_client_write (GstMultiFdSink * sink,
         return TRUE;
       } else {
         /* client can pick a buffer from the global queue */
-        GstBuffer *buf;
 
         /* for new connections, we need to find a good spot in the
          * bufqueue to start streaming from */
@@ -2048,59 +3098,58 @@ gst_multi_fd_sink_handle_client_write (GstMultiFdSink * sink,
           if (position >= 0) {
             /* we got a valid spot in the queue */
             client->new_connection = FALSE;
-            client->bufpos = position;
+            CLIENT_SET_BUFPOS (sink, client, position);
           } else {
+            QUEUE_UNLOCK (sink);
             /* cannot send data to this client yet */
-            gst_poll_fd_ctl_write (sink->fdset, &client->fd, FALSE);
+            gst_poll_fd_ctl_write (client->shard->fdset, &client->fd, FALSE);
             return TRUE;
           }
         }
 
         /* we flushed all remaining buffers, no need to get a new one */
-        if (client->flushcount == 0)
+        if (client->flushcount == 0) {
+          QUEUE_UNLOCK (sink);
           goto flushed;
+        }
 
-        /* grab buffer */
-        buf = g_array_index (sink->bufqueue, GstBuffer *, client->bufpos);
-        client->bufpos--;
-
-        /* decrease flushcount */
-        if (client->flushcount != -1)
-          client->flushcount--;
-
-        GST_LOG_OBJECT (sink, "[fd %5d] client %p at position %d",
-            fd, client, client->bufpos);
-
-        /* queueing a buffer will ref it */
-        gst_multi_fd_sink_client_queue_buffer (sink, client, buf);
+        gst_multi_fd_sink_client_take_buffer (sink, client, now);
 
         /* need to start from the first byte for this new buffer */
         client->bufoffset = 0;
       }
     }
 
+    /* gather more buffers from the global queue so that we can write them
+     * all out with one system call */
+    while (client->n_sending < sink->max_iovecs &&
+        CLIENT_BUFPOS (sink, client) != -1 && client->flushcount != 0 &&
+        (!client->new_connection || flushing)) {
+      gst_multi_fd_sink_client_take_buffer (sink, client, now);
+    }
+    QUEUE_UNLOCK (sink);
+
     /* see if we need to send something */
     if (client->sending) {
-      ssize_t wrote;
-      GstBuffer *head;
-
-      /* pick first buffer from list */
-      head = GST_BUFFER (client->sending->data);
-      maxsize = GST_BUFFER_SIZE (head) - client->bufoffset;
-
-      /* try to write the complete buffer */
-#ifdef MSG_NOSIGNAL
-#define FLAGS MSG_NOSIGNAL
-#else
-#define FLAGS 0
-#endif
-      if (client->is_socket) {
-        wrote =
-            send (fd, GST_BUFFER_DATA (head) + client->bufoffset, maxsize,
-            FLAGS);
-      } else {
-        wrote = write (fd, GST_BUFFER_DATA (head) + client->bufoffset, maxsize);
-      }
+      gssize wrote;
+      gsize maxsize;
+      gint errsv;
+
+      /* try to write the complete batch. We don't hold the lock of the shard
+       * while writing so that the streaming thread and the application can
+       * proceed, the client will not be removed while writing is set. */
+      client->writing = TRUE;
+      SHARD_UNLOCK (client->shard);
+      wrote = gst_multi_fd_sink_client_writev (sink, client, &maxsize);
+      errsv = errno;
+      SHARD_LOCK (client->shard);
+      client->writing = FALSE;
+      errno = errsv;
+
+      /* the client was removed while we were writing */
+      if (client->status != GST_CLIENT_STATUS_OK &&
+          client->status != GST_CLIENT_STATUS_FLUSHING)
+        goto removed;
 
       if (wrote < 0) {
         /* hmm error.. */
@@ -2113,24 +3162,25 @@ gst_multi_fd_sink_handle_client_write (GstMultiFdSink * sink,
           goto write_error;
         }
       } else {
-        if (wrote < maxsize) {
+        if ((gsize) wrote < maxsize) {
           /* partial write means that the client cannot read more and we should
            * stop sending more */
           GST_LOG_OBJECT (sink,
               "partial write on %d of %" G_GSSIZE_FORMAT " bytes", fd, wrote);
-          client->bufoffset += wrote;
           more = FALSE;
-        } else {
-          /* complete buffer was written, we can proceed to the next one */
-          client->sending = g_slist_remove (client->sending, head);
-          gst_buffer_unref (head);
-          /* make sure we start from byte 0 for the next buffer */
-          client->bufoffset = 0;
         }
+        /* drop what was written and move to the next buffer */
+        gst_multi_fd_sink_client_consume (sink, client, wrote);
+
         /* update stats */
         client->bytes_sent += wrote;
         client->last_activity_time = now;
+        client->shard->bytes_served += wrote;
+        histogram_add (&client->write_size, wrote);
+        QUEUE_LOCK (sink);
         sink->bytes_served += wrote;
+        histogram_add (&sink->write_size, wrote);
+        QUEUE_UNLOCK (sink);
       }
     }
   } while (more);
@@ -2144,6 +3194,12 @@ flushed:
     client->status = GST_CLIENT_STATUS_REMOVED;
     return FALSE;
   }
+removed:
+  {
+    GST_DEBUG_OBJECT (sink, "[fd %5d] removed while writing, status %d", fd,
+        client->status);
+    return FALSE;
+  }
 connection_reset:
   {
     GST_DEBUG_OBJECT (sink, "[fd %5d] connection reset by peer, removing", fd);
@@ -2162,7 +3218,8 @@ write_error:
 
 /* calculate the new position for a client after recovery. This function
  * does not update the client position but merely returns the required
- * position.
+ * position. Should be called with the lock of the shard of the client held
+ * from the streaming thread.
  */
 static gint
 gst_multi_fd_sink_recover_client (GstMultiFdSink * sink, GstTCPClient * client)
@@ -2171,13 +3228,14 @@ gst_multi_fd_sink_recover_client (GstMultiFdSink * sink, GstTCPClient * client)
 
   GST_WARNING_OBJECT (sink,
       "[fd %5d] client %p is lagging at %d, recover using policy %d",
-      client->fd.fd, client, client->bufpos, sink->recover_policy);
+      client->fd.fd, client, CLIENT_BUFPOS (sink, client),
+      sink->recover_policy);
 
   switch (sink->recover_policy) {
     case GST_RECOVER_POLICY_NONE:
       /* do nothing, client will catch up or get kicked out when it reaches
        * the hard max */
-      newbufpos = client->bufpos;
+      newbufpos = CLIENT_BUFPOS (sink, client);
       break;
     case GST_RECOVER_POLICY_RESYNC_LATEST:
       /* move to beginning of queue */
@@ -2190,19 +3248,11 @@ gst_multi_fd_sink_recover_client (GstMultiFdSink * sink, GstTCPClient * client)
     case GST_RECOVER_POLICY_RESYNC_KEYFRAME:
       /* find keyframe in buffers, we search backwards to find the
        * closest keyframe relative to what this client already received. */
-      newbufpos = MIN (sink->bufqueue->len - 1,
+      newbufpos = MIN ((gint) sink->bufqueue_len - 1,
           get_buffers_max (sink, sink->units_soft_max) - 1);
 
-      while (newbufpos >= 0) {
-        GstBuffer *buf;
-
-        buf = g_array_index (sink->bufqueue, GstBuffer *, newbufpos);
-        if (is_sync_frame (sink, buf)) {
-          /* found a buffer that is not a delta unit */
-          break;
-        }
-        newbufpos--;
-      }
+      /* find a buffer that is not a delta unit */
+      newbufpos = find_prev_syncframe (sink, newbufpos);
       break;
     default:
       /* unknown recovery procedure */
@@ -2214,16 +3264,19 @@ gst_multi_fd_sink_recover_client (GstMultiFdSink * sink, GstTCPClient * client)
 
 /* Queue a buffer on the global queue.
  *
- * This function adds the buffer to the front of a GArray. It removes the
- * tail buffer if the max queue size is exceeded, unreffing the queued buffer.
+ * This function adds the buffer to the head of the ring of queued buffers,
+ * indexing it when it is a sync frame. It removes the tail buffers if the
+ * max queue size is exceeded, unreffing the queued buffer and its header.
  * Note that unreffing the buffer is not a problem as clients who
  * started writing out this buffer will still have a reference to it in the
  * client->sending queue.
  *
- * After adding the buffer, we update all client positions in the queue. If
- * a client moves over the soft max, we start the recovery procedure for this
- * slow client. If it goes over the hard max, it is put into the slow list
- * and removed.
+ * The clients keep the sequence number of their next buffer so adding a
+ * buffer moves all of them without touching them. After adding the buffer,
+ * we walk the clients of each shard with only the lock of that shard held
+ * to check their positions. If a client moves over the soft max, we start
+ * the recovery procedure for this slow client. If it goes over the hard max,
+ * it is put on a garbage list and removed after the walk.
  *
  * Special care is taken of clients that were waiting for a new buffer (they
  * had a position of -1) because they can proceed after adding this new buffer.
@@ -2234,22 +3287,25 @@ static void
 gst_multi_fd_sink_queue_buffer (GstMultiFdSink * sink, GstBuffer * buf)
 {
   GList *clients, *next;
+  GSList *garbage = NULL;
   gint queuelen;
-  gboolean need_signal = FALSE;
   gint max_buffer_usage;
   gint i;
   GTimeVal nowtv;
   GstClockTime now;
   gint max_buffers, soft_max_buffers;
   guint cookie;
+  GstStructure *stats = NULL;
 
   g_get_current_time (&nowtv);
   now = GST_TIMEVAL_TO_TIME (nowtv);
 
-  CLIENTS_LOCK (sink);
-  /* add buffer to queue */
-  g_array_prepend_val (sink->bufqueue, buf);
-  queuelen = sink->bufqueue->len;
+  /* add buffer to queue, we are the only thread changing the queue so we
+   * can read it without the queuelock from now on */
+  QUEUE_LOCK (sink);
+  bufqueue_push (sink, buf, now);
+  QUEUE_UNLOCK (sink);
+  queuelen = sink->bufqueue_len;
 
   if (sink->units_max > 0)
     max_buffers = get_buffers_max (sink, sink->units_max);
@@ -2263,67 +3319,88 @@ gst_multi_fd_sink_queue_buffer (GstMultiFdSink * sink, GstBuffer * buf)
   GST_LOG_OBJECT (sink, "Using max %d, softmax %d", max_buffers,
       soft_max_buffers);
 
-  /* then loop over the clients and update the positions */
+  /* then loop over the clients and check the positions */
   max_buffer_usage = 0;
 
-restart:
-  cookie = sink->clients_cookie;
-  for (clients = sink->clients; clients; clients = next) {
-    GstTCPClient *client;
+  for (i = 0; i < sink->n_shards; i++) {
+    GstMultiFdSinkShard *shard = &sink->shards[i];
+    gboolean need_signal = FALSE;
 
-    if (cookie != sink->clients_cookie) {
-      GST_DEBUG_OBJECT (sink, "Clients cookie outdated, restarting");
-      goto restart;
-    }
+    SHARD_LOCK (shard);
+  restart:
+    cookie = shard->clients_cookie;
+    for (clients = shard->clients; clients; clients = next) {
+      GstTCPClient *client;
+      gint pos;
 
-    client = (GstTCPClient *) clients->data;
-    next = g_list_next (clients);
+      if (cookie != shard->clients_cookie) {
+        GST_DEBUG_OBJECT (sink, "Clients cookie outdated, restarting");
+        goto restart;
+      }
 
-    client->bufpos++;
-    GST_LOG_OBJECT (sink, "[fd %5d] client %p at position %d",
-        client->fd.fd, client, client->bufpos);
-    /* check soft max if needed, recover client */
-    if (soft_max_buffers > 0 && client->bufpos >= soft_max_buffers) {
-      gint newpos;
-
-      newpos = gst_multi_fd_sink_recover_client (sink, client);
-      if (newpos != client->bufpos) {
-        client->dropped_buffers += client->bufpos - newpos;
-        client->bufpos = newpos;
-        client->discont = TRUE;
-        GST_INFO_OBJECT (sink, "[fd %5d] client %p position reset to %d",
-            client->fd.fd, client, client->bufpos);
-      } else {
-        GST_INFO_OBJECT (sink,
-            "[fd %5d] client %p not recovering position",
+      client = (GstTCPClient *) clients->data;
+      next = g_list_next (clients);
+
+      /* already on the garbage list */
+      if (client->status != GST_CLIENT_STATUS_OK &&
+          client->status != GST_CLIENT_STATUS_FLUSHING)
+        continue;
+
+      pos = CLIENT_BUFPOS (sink, client);
+      GST_LOG_OBJECT (sink, "[fd %5d] client %p at position %d",
+          client->fd.fd, client, pos);
+      /* check soft max if needed, recover client */
+      if (soft_max_buffers > 0 && pos >= soft_max_buffers) {
+        gint newpos;
+
+        newpos = gst_multi_fd_sink_recover_client (sink, client);
+        if (newpos != pos) {
+          client->dropped_buffers += pos - newpos;
+          pos = newpos;
+          QUEUE_LOCK (sink);
+          CLIENT_SET_BUFPOS (sink, client, pos);
+          QUEUE_UNLOCK (sink);
+          client->discont = TRUE;
+          GST_INFO_OBJECT (sink, "[fd %5d] client %p position reset to %d",
+              client->fd.fd, client, pos);
+        } else {
+          GST_INFO_OBJECT (sink,
+              "[fd %5d] client %p not recovering position",
+              client->fd.fd, client);
+        }
+      }
+      /* check hard max and timeout, remove client */
+      if ((max_buffers > 0 && pos >= max_buffers) ||
+          (sink->timeout > 0
+              && now - client->last_activity_time > sink->timeout)) {
+        /* remove client */
+        GST_WARNING_OBJECT (sink, "[fd %5d] client %p is too slow, removing",
             client->fd.fd, client);
+        /* remove the client after the walk, the fd set will be cleared and
+         * the select thread will be signaled */
+        client->status = GST_CLIENT_STATUS_SLOW;
+        /* set client to invalid position while being removed */
+        QUEUE_LOCK (sink);
+        CLIENT_SET_BUFPOS (sink, client, -1);
+        QUEUE_UNLOCK (sink);
+        garbage = g_slist_prepend (garbage, client);
+        continue;
+      } else if (pos == 0 || client->new_connection) {
+        /* can send data to this client now. need to signal the select thread
+         * that the fd_set changed */
+        gst_poll_fd_ctl_write (shard->fdset, &client->fd, TRUE);
+        need_signal = TRUE;
+      }
+      /* keep track of maximum buffer usage */
+      if (pos > max_buffer_usage) {
+        max_buffer_usage = pos;
       }
     }
-    /* check hard max and timeout, remove client */
-    if ((max_buffers > 0 && client->bufpos >= max_buffers) ||
-        (sink->timeout > 0
-            && now - client->last_activity_time > sink->timeout)) {
-      /* remove client */
-      GST_WARNING_OBJECT (sink, "[fd %5d] client %p is too slow, removing",
-          client->fd.fd, client);
-      /* remove the client, the fd set will be cleared and the select thread
-       * will be signaled */
-      client->status = GST_CLIENT_STATUS_SLOW;
-      /* set client to invalid position while being removed */
-      client->bufpos = -1;
-      gst_multi_fd_sink_remove_client_link (sink, clients);
-      need_signal = TRUE;
-      continue;
-    } else if (client->bufpos == 0 || client->new_connection) {
-      /* can send data to this client now. need to signal the select thread that
-       * the fd_set changed */
-      gst_poll_fd_ctl_write (sink->fdset, &client->fd, TRUE);
-      need_signal = TRUE;
-    }
-    /* keep track of maximum buffer usage */
-    if (client->bufpos > max_buffer_usage) {
-      max_buffer_usage = client->bufpos;
-    }
+    SHARD_UNLOCK (shard);
+
+    /* and send a signal to the thread when its fd_set changed */
+    if (need_signal)
+      gst_poll_restart (shard->fdset);
   }
 
   /* make sure we respect bytes-min, buffers-min and time-min when they are set */
@@ -2352,7 +3429,6 @@ restart:
       sink->def_sync_method == GST_SYNC_METHOD_BURST_KEYFRAME) {
     /* no point in searching beyond the queue length */
     gint limit = queuelen;
-    GstBuffer *buf;
 
     /* no point in searching beyond the soft-max if any. */
     if (soft_max_buffers > 0) {
@@ -2361,14 +3437,11 @@ restart:
     GST_LOG_OBJECT (sink,
         "extending queue to include sync point, now at %d, limit is %d",
         max_buffer_usage, limit);
-    for (i = 0; i < limit; i++) {
-      buf = g_array_index (sink->bufqueue, GstBuffer *, i);
-      if (is_sync_frame (sink, buf)) {
-        /* found a sync frame, now extend the buffer usage to
-         * include at least this frame. */
-        max_buffer_usage = MAX (max_buffer_usage, i);
-        break;
-      }
+    i = find_next_syncframe (sink, 0);
+    if (i != -1 && i < limit) {
+      /* found a sync frame, now extend the buffer usage to
+       * include at least this frame. */
+      max_buffer_usage = MAX (max_buffer_usage, i);
     }
     GST_LOG_OBJECT (sink, "max buffer usage is now %d", max_buffer_usage);
   }
@@ -2376,42 +3449,50 @@ restart:
   GST_LOG_OBJECT (sink, "len %d, usage %d", queuelen, max_buffer_usage);
 
   /* nobody is referencing units after max_buffer_usage so we can
-   * remove them from the queue. We remove them in reverse order as
-   * this is the most optimal for GArray. */
-  for (i = queuelen - 1; i > max_buffer_usage; i--) {
-    GstBuffer *old;
-
+   * remove them from the tail of the queue. */
+  QUEUE_LOCK (sink);
+  while (queuelen - 1 > max_buffer_usage) {
     /* queue exceeded max size */
+    bufqueue_pop (sink);
     queuelen--;
-    old = g_array_index (sink->bufqueue, GstBuffer *, i);
-    sink->bufqueue = g_array_remove_index (sink->bufqueue, i);
-
-    /* unref tail buffer */
-    gst_buffer_unref (old);
   }
   /* save for stats */
   sink->buffers_queued = max_buffer_usage;
-  CLIENTS_UNLOCK (sink);
+  QUEUE_UNLOCK (sink);
+
+  /* remove the slow clients */
+  gst_multi_fd_sink_remove_garbage (sink, garbage);
 
-  /* and send a signal to thread if fd_set changed */
-  if (need_signal) {
-    gst_poll_restart (sink->fdset);
+  /* time for a stats message, post it when we released the lock */
+  if (sink->stats_interval > 0 && (sink->stats_last == 0 ||
+          now - sink->stats_last >= sink->stats_interval)) {
+    stats = gst_multi_fd_sink_build_histograms (sink);
+    sink->stats_last = now;
   }
+
+  if (stats)
+    gst_element_post_message (GST_ELEMENT_CAST (sink),
+        gst_message_new_element (GST_OBJECT_CAST (sink), stats));
 }
 
-/* Handle the clients. Basically does a blocking select for one
+/* Handle the clients of one shard. Basically does a blocking select for one
  * of the client fds to become read or writable. We also have a
  * filedescriptor to receive commands on that we need to check.
  *
  * After going out of the select call, we read and write to all
  * clients that can do so. Badly behaving clients are put on a
  * garbage list and removed.
+ *
+ * Every shard runs this function in its own thread on its own fdset. The
+ * server socket of subclasses lives in the fdset of the first shard.
  */
 static void
-gst_multi_fd_sink_handle_clients (GstMultiFdSink * sink)
+gst_multi_fd_sink_handle_clients (GstMultiFdSink * sink,
+    GstMultiFdSinkShard * shard)
 {
   int result;
   GList *clients, *next;
+  GSList *garbage = NULL;
   gboolean try_again;
   GstMultiFdSinkClass *fclass;
   guint cookie;
@@ -2425,8 +3506,9 @@ gst_multi_fd_sink_handle_clients (GstMultiFdSink * sink)
      * - server socket input (ie, new client connections)
      * - client socket input (ie, clients saying goodbye)
      * - client socket output (ie, client reads)          */
-    GST_LOG_OBJECT (sink, "waiting on action on fdset");
-    result = gst_poll_wait (sink->fdset, GST_CLOCK_TIME_NONE);
+    GST_LOG_OBJECT (sink, "shard %u waiting on action on fdset",
+        shard->index);
+    result = gst_poll_wait (shard->fdset, GST_CLOCK_TIME_NONE);
 
     /* < 0 is an error, 0 just means a timeout happened, which is impossible */
     if (result < 0) {
@@ -2435,16 +3517,16 @@ gst_multi_fd_sink_handle_clients (GstMultiFdSink * sink)
       if (errno == EBADF) {
         /* ok, so one or more of the fds is invalid. We loop over them to find
          * the ones that give an error to the F_GETFL fcntl. */
-        CLIENTS_LOCK (sink);
+        SHARD_LOCK (shard);
       restart:
-        cookie = sink->clients_cookie;
-        for (clients = sink->clients; clients; clients = next) {
+        cookie = shard->clients_cookie;
+        for (clients = shard->clients; clients; clients = next) {
           GstTCPClient *client;
           int fd;
           long flags;
           int res;
 
-          if (cookie != sink->clients_cookie) {
+          if (cookie != shard->clients_cookie) {
             GST_DEBUG_OBJECT (sink, "Cookie changed finding bad fd");
             goto restart;
           }
@@ -2458,14 +3540,16 @@ gst_multi_fd_sink_handle_clients (GstMultiFdSink * sink)
           if (res == -1) {
             GST_WARNING_OBJECT (sink, "fnctl failed for %d, removing: %s (%d)",
                 fd, g_strerror (errno), errno);
-            if (errno == EBADF) {
+            if (errno == EBADF && (client->status == GST_CLIENT_STATUS_OK ||
+                    client->status == GST_CLIENT_STATUS_FLUSHING)) {
               client->status = GST_CLIENT_STATUS_ERROR;
-              /* releases the CLIENTS lock */
-              gst_multi_fd_sink_remove_client_link (sink, clients);
+              garbage = g_slist_prepend (garbage, client);
             }
           }
         }
-        CLIENTS_UNLOCK (sink);
+        SHARD_UNLOCK (shard);
+        gst_multi_fd_sink_remove_garbage (sink, garbage);
+        garbage = NULL;
         /* after this, go back in the select loop as the read/writefds
          * are not valid */
         try_again = TRUE;
@@ -2487,18 +3571,21 @@ gst_multi_fd_sink_handle_clients (GstMultiFdSink * sink)
   } while (try_again);
 
   /* subclasses can check fdset with this virtual function */
-  if (fclass->wait)
-    fclass->wait (sink, sink->fdset);
+  if (fclass->wait && shard->index == 0)
+    fclass->wait (sink, shard->fdset);
 
-  /* Check the clients */
-  CLIENTS_LOCK (sink);
+  /* Check the clients, only the lock of this shard is held so that the
+   * streaming thread and the other shards can proceed. The clients that
+   * need to be removed are collected and removed after the walk. */
+  SHARD_LOCK (shard);
+  shard->wakeups++;
 
 restart2:
-  cookie = sink->clients_cookie;
-  for (clients = sink->clients; clients; clients = next) {
+  cookie = shard->clients_cookie;
+  for (clients = shard->clients; clients; clients = next) {
     GstTCPClient *client;
 
-    if (sink->clients_cookie != cookie) {
+    if (shard->clients_cookie != cookie) {
       GST_DEBUG_OBJECT (sink, "Restarting loop, cookie out of date");
       goto restart2;
     }
@@ -2508,46 +3595,57 @@ restart2:
 
     if (client->status != GST_CLIENT_STATUS_FLUSHING
         && client->status != GST_CLIENT_STATUS_OK) {
-      gst_multi_fd_sink_remove_client_link (sink, clients);
+      /* removed by the application or the streaming thread */
+      if (!g_slist_find (garbage, client))
+        garbage = g_slist_prepend (garbage, client);
       continue;
     }
 
-    if (gst_poll_fd_has_closed (sink->fdset, &client->fd)) {
+    if (gst_poll_fd_has_closed (shard->fdset, &client->fd)) {
       client->status = GST_CLIENT_STATUS_CLOSED;
-      gst_multi_fd_sink_remove_client_link (sink, clients);
+      garbage = g_slist_prepend (garbage, client);
       continue;
     }
-    if (gst_poll_fd_has_error (sink->fdset, &client->fd)) {
+    if (gst_poll_fd_has_error (shard->fdset, &client->fd) &&
+        !gst_multi_fd_sink_client_check_error (sink, client)) {
       GST_WARNING_OBJECT (sink, "gst_poll_fd_has_error for %d", client->fd.fd);
       client->status = GST_CLIENT_STATUS_ERROR;
-      gst_multi_fd_sink_remove_client_link (sink, clients);
+      garbage = g_slist_prepend (garbage, client);
       continue;
     }
-    if (gst_poll_fd_can_read (sink->fdset, &client->fd)) {
+    if (gst_poll_fd_can_read (shard->fdset, &client->fd)) {
       /* handle client read */
       if (!gst_multi_fd_sink_handle_client_read (sink, client)) {
-        gst_multi_fd_sink_remove_client_link (sink, clients);
+        garbage = g_slist_prepend (garbage, client);
         continue;
       }
     }
-    if (gst_poll_fd_can_write (sink->fdset, &client->fd)) {
+    if (gst_poll_fd_can_write (shard->fdset, &client->fd)) {
       /* handle client write */
       if (!gst_multi_fd_sink_handle_client_write (sink, client)) {
-        gst_multi_fd_sink_remove_client_link (sink, clients);
+        /* not all failures set a reason, the client is removed on the status */
+        if (client->status == GST_CLIENT_STATUS_OK ||
+            client->status == GST_CLIENT_STATUS_FLUSHING)
+          client->status = GST_CLIENT_STATUS_ERROR;
+        garbage = g_slist_prepend (garbage, client);
         continue;
       }
     }
   }
-  CLIENTS_UNLOCK (sink);
+  SHARD_UNLOCK (shard);
+
+  gst_multi_fd_sink_remove_garbage (sink, garbage);
 }
 
 /* we handle the client communication in another thread so that we do not block
  * the gstreamer thread while we select() on the client fds */
 static gpointer
-gst_multi_fd_sink_thread (GstMultiFdSink * sink)
+gst_multi_fd_sink_thread (GstMultiFdSinkShard * shard)
 {
+  GstMultiFdSink *sink = shard->sink;
+
   while (sink->running) {
-    gst_multi_fd_sink_handle_clients (sink);
+    gst_multi_fd_sink_handle_clients (sink, shard);
   }
   return NULL;
 }
@@ -2716,6 +3814,18 @@ gst_multi_fd_sink_set_property (GObject * object, guint prop_id,
     case PROP_RESEND_STREAMHEADER:
       multifdsink->resend_streamheader = g_value_get_boolean (value);
       break;
+    case PROP_MAX_IOVECS:
+      multifdsink->max_iovecs = g_value_get_uint (value);
+      break;
+    case PROP_IO_THREADS:
+      multifdsink->io_threads = g_value_get_uint (value);
+      break;
+    case PROP_ZEROCOPY:
+      multifdsink->zerocopy = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      multifdsink->stats_interval = g_value_get_uint64 (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -2804,6 +3914,18 @@ gst_multi_fd_sink_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_NUM_FDS:
       g_value_set_uint (value, g_hash_table_size (multifdsink->fd_hash));
       break;
+    case PROP_MAX_IOVECS:
+      g_value_set_uint (value, multifdsink->max_iovecs);
+      break;
+    case PROP_IO_THREADS:
+      g_value_set_uint (value, multifdsink->io_threads);
+      break;
+    case PROP_ZEROCOPY:
+      g_value_set_boolean (value, multifdsink->zerocopy);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, multifdsink->stats_interval);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -2818,6 +3940,8 @@ gst_multi_fd_sink_start (GstBaseSink * bsink)
 {
   GstMultiFdSinkClass *fclass;
   GstMultiFdSink *this;
+  GstMultiFdSinkShard *shards;
+  guint i, n_shards;
 
   if (GST_OBJECT_FLAG_IS_SET (bsink, GST_MULTI_FD_SINK_OPEN))
     return TRUE;
@@ -2825,21 +3949,45 @@ gst_multi_fd_sink_start (GstBaseSink * bsink)
   this = GST_MULTI_FD_SINK (bsink);
   fclass = GST_MULTI_FD_SINK_GET_CLASS (this);
 
-  GST_INFO_OBJECT (this, "starting in mode %d", this->mode);
-  if ((this->fdset = gst_poll_new (TRUE)) == NULL)
-    goto socket_pair;
+  n_shards = MAX (this->io_threads, 1);
+
+  GST_INFO_OBJECT (this, "starting in mode %d with %u I/O threads",
+      this->mode, n_shards);
+
+  shards = g_new0 (GstMultiFdSinkShard, n_shards);
+  for (i = 0; i < n_shards; i++) {
+    shards[i].sink = this;
+    shards[i].index = i;
+    SHARD_LOCK_INIT (&shards[i]);
+    if ((shards[i].fdset = gst_poll_new (TRUE)) == NULL)
+      goto socket_pair;
+  }
 
   this->streamheader = NULL;
   this->bytes_to_serve = 0;
   this->bytes_served = 0;
+  memset (&this->queue_depth, 0, sizeof (GstMultiFdSinkHistogram));
+  memset (&this->queue_time, 0, sizeof (GstMultiFdSinkHistogram));
+  memset (&this->write_size, 0, sizeof (GstMultiFdSinkHistogram));
+  this->stats_last = 0;
+
+  CLIENTS_LOCK (this);
+  this->shards = shards;
+  this->n_shards = n_shards;
+  this->fdset = shards[0].fdset;
+  CLIENTS_UNLOCK (this);
 
   if (fclass->init) {
     fclass->init (this);
   }
 
   this->running = TRUE;
-  this->thread = g_thread_create ((GThreadFunc) gst_multi_fd_sink_thread,
-      this, TRUE, NULL);
+  for (i = 0; i < n_shards; i++) {
+    shards[i].thread =
+        g_thread_create ((GThreadFunc) gst_multi_fd_sink_thread, &shards[i],
+        TRUE, NULL);
+  }
+  this->thread = shards[0].thread;
 
   GST_OBJECT_FLAG_SET (this, GST_MULTI_FD_SINK_OPEN);
 
@@ -2850,6 +3998,13 @@ socket_pair:
   {
     GST_ELEMENT_ERROR (this, RESOURCE, OPEN_READ_WRITE, (NULL),
         GST_ERROR_SYSTEM);
+    SHARD_LOCK_FREE (&shards[i]);
+    while (i > 0) {
+      i--;
+      gst_poll_free (shards[i].fdset);
+      SHARD_LOCK_FREE (&shards[i]);
+    }
+    g_free (shards);
     return FALSE;
   }
 }
@@ -2865,7 +4020,6 @@ gst_multi_fd_sink_stop (GstBaseSink * bsink)
 {
   GstMultiFdSinkClass *fclass;
   GstMultiFdSink *this;
-  GstBuffer *buf;
   int i;
 
   this = GST_MULTI_FD_SINK (bsink);
@@ -2876,13 +4030,18 @@ gst_multi_fd_sink_stop (GstBaseSink * bsink)
 
   this->running = FALSE;
 
-  gst_poll_set_flushing (this->fdset, TRUE);
-  if (this->thread) {
-    GST_DEBUG_OBJECT (this, "joining thread");
-    g_thread_join (this->thread);
-    GST_DEBUG_OBJECT (this, "joined thread");
-    this->thread = NULL;
+  for (i = 0; i < this->n_shards; i++) {
+    GstMultiFdSinkShard *shard = &this->shards[i];
+
+    gst_poll_set_flushing (shard->fdset, TRUE);
+    if (shard->thread) {
+      GST_DEBUG_OBJECT (this, "joining thread %d", i);
+      g_thread_join (shard->thread);
+      GST_DEBUG_OBJECT (this, "joined thread %d", i);
+      shard->thread = NULL;
+    }
   }
+  this->thread = NULL;
 
   /* free the clients */
   gst_multi_fd_sink_clear (this);
@@ -2896,25 +4055,23 @@ gst_multi_fd_sink_stop (GstBaseSink * bsink)
   if (fclass->close)
     fclass->close (this);
 
-  if (this->fdset) {
-    gst_poll_free (this->fdset);
-    this->fdset = NULL;
+  CLIENTS_LOCK (this);
+  for (i = 0; i < this->n_shards; i++) {
+    gst_poll_free (this->shards[i].fdset);
+    SHARD_LOCK_FREE (&this->shards[i]);
   }
+  g_free (this->shards);
+  this->shards = NULL;
+  this->n_shards = 0;
+  this->fdset = NULL;
+  CLIENTS_UNLOCK (this);
+
   g_hash_table_foreach_remove (this->fd_hash, multifdsink_hash_remove, this);
 
-  /* remove all queued buffers */
-  if (this->bufqueue) {
-    GST_DEBUG_OBJECT (this, "Emptying bufqueue with %d buffers",
-        this->bufqueue->len);
-    for (i = this->bufqueue->len - 1; i >= 0; --i) {
-      buf = g_array_index (this->bufqueue, GstBuffer *, i);
-      GST_LOG_OBJECT (this, "Removing buffer %p (%d) with refcount %d", buf, i,
-          GST_MINI_OBJECT_REFCOUNT (buf));
-      gst_buffer_unref (buf);
-      this->bufqueue = g_array_remove_index (this->bufqueue, i);
-    }
-    /* freeing the array is done in _finalize */
-  }
+  /* remove all queued buffers, freeing the ring is done in _finalize */
+  QUEUE_LOCK (this);
+  bufqueue_clear (this);
+  QUEUE_UNLOCK (this);
   GST_OBJECT_FLAG_UNSET (this, GST_MULTI_FD_SINK_OPEN);
 
   return TRUE;
@@ -2925,12 +4082,15 @@ gst_multi_fd_sink_change_state (GstElement * element, GstStateChange transition)
 {
   GstMultiFdSink *sink;
   GstStateChangeReturn ret;
+  guint i;
 
   sink = GST_MULTI_FD_SINK (element);
 
-  /* we disallow changing the state from the streaming thread */
-  if (g_thread_self () == sink->thread)
-    return GST_STATE_CHANGE_FAILURE;
+  /* we disallow changing the state from the streaming threads */
+  for (i = 0; i < sink->n_shards; i++) {
+    if (g_thread_self () == sink->shards[i].thread)
+      return GST_STATE_CHANGE_FAILURE;
+  }
 
 
   switch (transition) {
@@ -136,20 +136,66 @@ typedef enum
   GST_CLIENT_STATUS_FLUSHING    = 6
 } GstClientStatus;
 
+#define GST_MULTI_FD_SINK_HISTOGRAM_BUCKETS 32
+
+/* a histogram with power of two buckets, bucket 0 counts the value 0 and
+ * bucket n counts the values from 2^(n-1) to 2^n - 1. The last bucket also
+ * counts all larger values.
+ */
+typedef struct {
+  guint64 buckets[GST_MULTI_FD_SINK_HISTOGRAM_BUCKETS];
+} GstMultiFdSinkHistogram;
+
+/* an I/O thread that serves a subset of the clients with its own GstPoll
+ * and its own lock, so that the threads don't wait for each other
+ */
+typedef struct {
+  GstMultiFdSink *sink;
+  guint index;
+
+  GstPoll *fdset;               /* the poll set for the clients of this shard */
+  GThread *thread;              /* the thread serving the clients */
+
+  GStaticRecMutex lock;         /* protects the clients of this shard */
+  GList *clients;               /* the clients served by this shard */
+  guint n_clients;
+  guint clients_cookie;         /* detects changes to the clients list */
+
+  /* stats */
+  guint64 bytes_served;
+  guint64 wakeups;
+} GstMultiFdSinkShard;
+
 /* structure for a client
  */
 typedef struct {
   GstPollFD fd;
+  GstMultiFdSinkShard *shard;   /* the I/O thread serving this client */
 
-  gint bufpos;                  /* position of this client in the global queue */
+  guint64 bufseq;               /* sequence number of the next buffer in the
+                                   global queue, bufqueue_head when the
+                                   client sent everything */
   gint flushcount;              /* the remaining number of buffers to flush out or -1 if the 
                                    client is not flushing. */
 
   GstClientStatus status;
   gboolean is_socket;
 
+  /* The client is a cursor into the shared queue, bufseq above, and buffers
+   * only move to the sending list when the client writes them. The list
+   * holds a ref on the batch being written, at most max-iovecs queued
+   * buffers plus the caps, streamheader and GDP header buffers, because the
+   * write happens without the locks and the streaming thread can drop those
+   * buffers from the queue meanwhile. It never holds the backlog. */
   GSList *sending;              /* the buffers we need to send */
+  GSList *sending_tail;         /* the last link of the sending list */
+  guint n_sending;              /* length of the sending list */
   gint bufoffset;               /* offset in the first buffer */
+  gboolean writing;             /* writing without the lock of its shard */
+
+  gboolean zerocopy;            /* large writes use MSG_ZEROCOPY */
+  guint32 zerocopy_id;          /* id of the next zerocopy send */
+  GQueue zerocopy_pending;      /* zerocopy sends waiting for completion */
 
   gboolean discont;
 
@@ -176,13 +222,39 @@ typedef struct {
   guint64 last_activity_time;
   guint64 dropped_buffers;
   guint64 avg_queue_size;
+
+  GstMultiFdSinkHistogram queue_depth;  /* buffers behind when taking one */
+  GstMultiFdSinkHistogram queue_time;   /* microseconds a buffer was queued */
+  GstMultiFdSinkHistogram write_size;   /* bytes per write */
 } GstTCPClient;
 
+/* an entry in the global queue of buffers, shared by all clients
+ */
+typedef struct {
+  GstBuffer *buffer;
+  GstBuffer *header;            /* GDP header for buffer, created on demand */
+  guint64 bytes;                /* bytes queued up to and including buffer */
+  GstClockTime queued;          /* when the buffer was queued */
+} GstMultiFdSinkEntry;
+
+/* The locks are taken in this order: the clientslock, which protects adding
+ * and removing clients, the lock of a shard, which protects its clients, and
+ * the queuelock, which protects the global queue of buffers. The streaming
+ * thread is the only one that adds and removes buffers, it can read the
+ * queue without the queuelock. */
 #define CLIENTS_LOCK_INIT(fdsink)       (g_static_rec_mutex_init(&fdsink->clientslock))
 #define CLIENTS_LOCK_FREE(fdsink)       (g_static_rec_mutex_free(&fdsink->clientslock))
 #define CLIENTS_LOCK(fdsink)            (g_static_rec_mutex_lock(&fdsink->clientslock))
 #define CLIENTS_UNLOCK(fdsink)          (g_static_rec_mutex_unlock(&fdsink->clientslock))
 
+#define SHARD_LOCK_INIT(shard)          (g_static_rec_mutex_init(&(shard)->lock))
+#define SHARD_LOCK_FREE(shard)          (g_static_rec_mutex_free(&(shard)->lock))
+#define SHARD_LOCK(shard)               (g_static_rec_mutex_lock(&(shard)->lock))
+#define SHARD_UNLOCK(shard)             (g_static_rec_mutex_unlock(&(shard)->lock))
+
+#define QUEUE_LOCK(fdsink)              (g_mutex_lock(fdsink->queuelock))
+#define QUEUE_UNLOCK(fdsink)            (g_mutex_unlock(fdsink->queuelock))
+
 /**
  * GstMultiFdSink:
  *
@@ -201,7 +273,7 @@ struct _GstMultiFdSink {
   guint clients_cookie; /* Cookie to detect changes to the clients list */
 
   gint mode;
-  GstPoll *fdset;
+  GstPoll *fdset;       /* the poll set of the first shard */
 
   GSList *streamheader; /* GSList of GstBuffers to use as streamheader */
   gboolean previous_buffer_in_caps;
@@ -211,10 +283,23 @@ struct _GstMultiFdSink {
   gint qos_dscp;
   gboolean handle_read;
 
-  GArray *bufqueue;     /* global queue of buffers */
+  GMutex *queuelock;    /* lock to protect the queue and the global stats */
+  /* global queue of buffers, a ring where the newest buffer has sequence
+   * number bufqueue_head - 1 */
+  GstMultiFdSinkEntry *bufqueue;
+  guint bufqueue_size;  /* allocated entries, a power of 2 */
+  guint bufqueue_len;   /* number of queued buffers */
+  guint64 bufqueue_head;/* sequence number of the next buffer */
+
+  GArray *keyframes;    /* sequence numbers of queued sync frames, oldest first */
+  guint keyframes_start;/* index of the oldest valid entry in keyframes */
 
   gboolean running;     /* the thread state */
-  GThread *thread;      /* the sender thread */
+  GThread *thread;      /* the sender thread of the first shard */
+
+  guint io_threads;     /* number of shards to create when starting */
+  GstMultiFdSinkShard *shards;
+  guint n_shards;
 
   /* these values are used to check if a client is reading fast
    * enough and to control receovery */
@@ -237,11 +322,22 @@ struct _GstMultiFdSink {
 
   gboolean resend_streamheader; /* resend streamheader if it changes */
 
+  guint max_iovecs;     /* max buffers to gather in one write to a client */
+  gboolean zerocopy;    /* send large writes to sockets with MSG_ZEROCOPY */
+
   /* stats */
   gint buffers_queued;  /* number of queued buffers */
   gint bytes_queued;    /* number of queued bytes */
   gint time_queued;     /* number of queued time */
 
+  /* histograms of all clients */
+  GstMultiFdSinkHistogram queue_depth;
+  GstMultiFdSinkHistogram queue_time;
+  GstMultiFdSinkHistogram write_size;
+
+  GstClockTime stats_interval;  /* interval for posting stats messages */
+  GstClockTime stats_last;      /* when the last stats message was posted */
+
   guint8 header_flags;
 };
 
@@ -257,6 +353,8 @@ struct _GstMultiFdSinkClass {
   void          (*remove_flush) (GstMultiFdSink *sink, int fd);
   void          (*clear)        (GstMultiFdSink *sink);
   GValueArray*  (*get_stats)    (GstMultiFdSink *sink, int fd);
+  GValueArray*  (*get_shard_stats) (GstMultiFdSink *sink, int shard_idx);
+  GstStructure* (*get_histograms) (GstMultiFdSink *sink);
 
   /* vtable */
   gboolean (*init)   (GstMultiFdSink *sink);
@@ -280,6 +378,8 @@ void          gst_multi_fd_sink_remove       (GstMultiFdSink *sink, int fd);
 void          gst_multi_fd_sink_remove_flush (GstMultiFdSink *sink, int fd);
 void          gst_multi_fd_sink_clear        (GstMultiFdSink *sink);
 GValueArray*  gst_multi_fd_sink_get_stats    (GstMultiFdSink *sink, int fd);
+GValueArray*  gst_multi_fd_sink_get_shard_stats (GstMultiFdSink *sink, int shard_idx);
+GstStructure* gst_multi_fd_sink_get_histograms (GstMultiFdSink *sink);
 
 G_END_DECLS
 
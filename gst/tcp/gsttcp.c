@@ -215,19 +215,167 @@ gst_tcp_socket_close (GstPollFD * socket)
   }
 }
 
+/* sizes of the chunks we read into */
+#define READ_POOL_MIN_SIZE      4096
+#define READ_POOL_MAX_SIZE      (256 * 1024)
+/* number of filled chunks we keep around for recycling */
+#define READ_POOL_SPARE         4
+/* grow after this many reads that filled the space we had, shrink after
+ * this many reads that used less than a quarter of a chunk */
+#define READ_POOL_GROW_READS    4
+#define READ_POOL_SHRINK_READS  64
+
+void
+gst_tcp_read_pool_init (GstTCPReadPool * pool)
+{
+  pool->chunk = NULL;
+  pool->offset = 0;
+  pool->spare = NULL;
+  pool->n_spare = 0;
+  pool->size = READ_POOL_MIN_SIZE;
+  pool->full_reads = 0;
+  pool->small_reads = 0;
+}
+
+void
+gst_tcp_read_pool_clear (GstTCPReadPool * pool)
+{
+  if (pool->chunk)
+    gst_buffer_unref (pool->chunk);
+  g_slist_foreach (pool->spare, (GFunc) gst_mini_object_unref, NULL);
+  g_slist_free (pool->spare);
+
+  gst_tcp_read_pool_init (pool);
+}
+
+/* replace the current chunk with a recycled or new one of the current
+ * chunk size. A chunk can be recycled when none of the buffers we handed
+ * out still reference it. */
+static void
+gst_tcp_read_pool_next_chunk (GstTCPReadPool * pool)
+{
+  GstBuffer *chunk = NULL;
+  GSList *walk;
+
+  for (walk = pool->spare; walk; walk = g_slist_next (walk)) {
+    GstBuffer *spare = GST_BUFFER_CAST (walk->data);
+
+    if (GST_BUFFER_SIZE (spare) == pool->size &&
+        g_atomic_int_get (&GST_MINI_OBJECT_REFCOUNT (spare)) == 1) {
+      chunk = spare;
+      pool->spare = g_slist_delete_link (pool->spare, walk);
+      pool->n_spare--;
+      break;
+    }
+  }
+
+  if (pool->chunk) {
+    pool->spare = g_slist_append (pool->spare, pool->chunk);
+    pool->n_spare++;
+    /* drop the oldest when we have too many */
+    if (pool->n_spare > READ_POOL_SPARE) {
+      gst_buffer_unref (GST_BUFFER_CAST (pool->spare->data));
+      pool->spare = g_slist_delete_link (pool->spare, pool->spare);
+      pool->n_spare--;
+    }
+  }
+
+  if (chunk == NULL)
+    chunk = gst_buffer_new_and_alloc (pool->size);
+
+  pool->chunk = chunk;
+  pool->offset = 0;
+}
+
+/* adapt the chunk size to the amount of data we get per read */
+static void
+gst_tcp_read_pool_update (GstTCPReadPool * pool, gsize wanted, gsize got)
+{
+  if (got == wanted) {
+    /* there was probably more data waiting */
+    pool->small_reads = 0;
+    if (++pool->full_reads >= READ_POOL_GROW_READS &&
+        pool->size < READ_POOL_MAX_SIZE) {
+      pool->size *= 2;
+      pool->full_reads = 0;
+      GST_DEBUG ("growing read chunks to %u bytes", pool->size);
+    }
+  } else if (got < pool->size / 4) {
+    pool->full_reads = 0;
+    if (++pool->small_reads >= READ_POOL_SHRINK_READS &&
+        pool->size > READ_POOL_MIN_SIZE) {
+      pool->size /= 2;
+      pool->small_reads = 0;
+      GST_DEBUG ("shrinking read chunks to %u bytes", pool->size);
+    }
+  } else {
+    pool->full_reads = 0;
+    pool->small_reads = 0;
+  }
+}
+
+/* read what @socket has for us into the current chunk of @pool, as much as
+ * fits, without waiting for it to become readable and without posting
+ * errors. We start a new chunk when less than a quarter of the chunk is
+ * left.
+ *
+ * Returns: GST_FLOW_OK with a subbuffer of the chunk in @buf, or with @buf
+ * set to NULL when a non-blocking @socket had nothing to read,
+ * GST_FLOW_UNEXPECTED when the socket was closed and GST_FLOW_ERROR with
+ * errno set when reading failed.
+ */
+GstFlowReturn
+gst_tcp_read_pool_read (GstTCPReadPool * pool, int socket, GstBuffer ** buf)
+{
+  ssize_t bytes_read;
+  gsize readsize;
+
+  *buf = NULL;
+
+  if (pool->chunk == NULL ||
+      GST_BUFFER_SIZE (pool->chunk) - pool->offset < pool->size / 4)
+    gst_tcp_read_pool_next_chunk (pool);
+
+  readsize = GST_BUFFER_SIZE (pool->chunk) - pool->offset;
+
+  do {
+    bytes_read = read (socket, GST_BUFFER_DATA (pool->chunk) + pool->offset,
+        readsize);
+  } while (bytes_read < 0 && errno == EINTR);
+
+  if (bytes_read < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return GST_FLOW_OK;
+    return GST_FLOW_ERROR;
+  }
+
+  /* the socket was readable, nothing to read means it was closed */
+  if (bytes_read == 0)
+    return GST_FLOW_UNEXPECTED;
+
+  *buf = gst_buffer_create_sub (pool->chunk, pool->offset, bytes_read);
+  pool->offset += bytes_read;
+
+  gst_tcp_read_pool_update (pool, readsize, bytes_read);
+
+  return GST_FLOW_OK;
+}
+
 /* read a buffer from the given socket
  * returns:
  * - a GstBuffer in which data should be read
  * - NULL, indicating a connection close or an error, to be handled with
  *         EOS
+ *
+ * The data is read into the current chunk of @pool, see
+ * gst_tcp_read_pool_read().
  */
 GstFlowReturn
 gst_tcp_read_buffer (GstElement * this, int socket, GstPoll * fdset,
-    GstBuffer ** buf)
+    GstTCPReadPool * pool, GstBuffer ** buf)
 {
+  GstFlowReturn res;
   int ret;
-  ssize_t bytes_read;
-  int readsize;
 
   *buf = NULL;
 
@@ -240,26 +388,12 @@ gst_tcp_read_buffer (GstElement * this, int socket, GstPoll * fdset,
       goto select_error;
   }
 
-  /* ask how much is available for reading on the socket */
-  if ((ret = ioctl (socket, FIONREAD, &readsize)) < 0)
-    goto ioctl_error;
-
-  if (readsize == 0)
+  res = gst_tcp_read_pool_read (pool, socket, buf);
+  if (res == GST_FLOW_UNEXPECTED)
     goto got_eos;
-
-  /* sizeof(ssize_t) >= sizeof(int), so I know readsize <= SSIZE_MAX */
-
-  *buf = gst_buffer_new_and_alloc (readsize);
-
-  bytes_read = read (socket, GST_BUFFER_DATA (*buf), readsize);
-
-  if (bytes_read < 0)
+  if (res != GST_FLOW_OK || *buf == NULL)
     goto read_error;
 
-  if (bytes_read < readsize)
-    /* but mom, you promised to give me readsize bytes! */
-    goto short_read;
-
   GST_LOG_OBJECT (this, "returning buffer of size %d", GST_BUFFER_SIZE (*buf));
   return GST_FLOW_OK;
 
@@ -275,12 +409,6 @@ cancelled:
     GST_DEBUG_OBJECT (this, "Select was cancelled");
     return GST_FLOW_WRONG_STATE;
   }
-ioctl_error:
-  {
-    GST_ELEMENT_ERROR (this, RESOURCE, READ, (NULL),
-        ("ioctl failed: %s", g_strerror (errno)));
-    return GST_FLOW_ERROR;
-  }
 got_eos:
   {
     GST_DEBUG_OBJECT (this, "Got EOS on socket stream");
@@ -290,17 +418,6 @@ read_error:
   {
     GST_ELEMENT_ERROR (this, RESOURCE, READ, (NULL),
         ("read failed: %s", g_strerror (errno)));
-    gst_buffer_unref (*buf);
-    *buf = NULL;
-    return GST_FLOW_ERROR;
-  }
-short_read:
-  {
-    GST_ELEMENT_ERROR (this, RESOURCE, READ, (NULL),
-        ("short read: wanted %d bytes, got %" G_GSSIZE_FORMAT, readsize,
-            bytes_read));
-    gst_buffer_unref (*buf);
-    *buf = NULL;
     return GST_FLOW_ERROR;
   }
 }
@@ -467,6 +584,87 @@ payload_validate_error:
   }
 }
 
+/* take the next complete GDP packet from @adapter, without blocking and
+ * without posting errors, so that the data of many senders can be collected
+ * as it arrives. Packets that are not buffers or caps are skipped.
+ *
+ * Returns: GST_FLOW_OK with either @buf or @caps set to the packet, or both
+ * NULL when @adapter does not hold a complete packet yet, GST_FLOW_ERROR
+ * when the data is not valid GDP.
+ */
+GstFlowReturn
+gst_tcp_gdp_take_packet (GstAdapter * adapter, GstBuffer ** buf,
+    GstCaps ** caps)
+{
+  const guint8 *peek;
+  guint8 *header, *payload;
+  guint payload_length;
+
+  *buf = NULL;
+  *caps = NULL;
+
+again:
+  if (gst_adapter_available (adapter) < GST_DP_HEADER_LENGTH)
+    return GST_FLOW_OK;
+
+  peek = gst_adapter_peek (adapter, GST_DP_HEADER_LENGTH);
+  if (!gst_dp_validate_header (GST_DP_HEADER_LENGTH, peek))
+    goto validate_error;
+
+  payload_length = gst_dp_header_payload_length (peek);
+  if (gst_adapter_available (adapter) < GST_DP_HEADER_LENGTH + payload_length)
+    return GST_FLOW_OK;
+
+  header = gst_adapter_take (adapter, GST_DP_HEADER_LENGTH);
+
+  switch (gst_dp_header_payload_type (header)) {
+    case GST_DP_PAYLOAD_BUFFER:
+      *buf = gst_dp_buffer_from_header (GST_DP_HEADER_LENGTH, header);
+      if (*buf == NULL)
+        goto packet_error;
+      if (payload_length > 0) {
+        gst_adapter_copy (adapter, GST_BUFFER_DATA (*buf), 0, payload_length);
+        gst_adapter_flush (adapter, payload_length);
+      }
+      break;
+    case GST_DP_PAYLOAD_CAPS:
+      if (payload_length == 0)
+        goto packet_error;
+      payload = gst_adapter_take (adapter, payload_length);
+      if (gst_dp_validate_payload (GST_DP_HEADER_LENGTH, header, payload))
+        *caps = gst_dp_caps_from_packet (GST_DP_HEADER_LENGTH, header,
+            payload);
+      g_free (payload);
+      if (*caps == NULL)
+        goto packet_error;
+      break;
+    default:
+      GST_LOG ("skipping GDP packet of type %d",
+          gst_dp_header_payload_type (header));
+      if (payload_length > 0)
+        gst_adapter_flush (adapter, payload_length);
+      g_free (header);
+      goto again;
+  }
+  g_free (header);
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+validate_error:
+  {
+    GST_DEBUG ("GDP packet header does not validate");
+    return GST_FLOW_ERROR;
+  }
+packet_error:
+  {
+    GST_DEBUG ("could not parse GDP packet of type %d",
+        gst_dp_header_payload_type (header));
+    g_free (header);
+    return GST_FLOW_ERROR;
+  }
+}
+
 /* write a GDP header to the socket.  Return false if fails. */
 gboolean
 gst_tcp_gdp_write_buffer (GstElement * this, int socket, GstBuffer * buffer,
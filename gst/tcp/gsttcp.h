@@ -27,6 +27,7 @@
 #include <gst/gst.h>
 #undef GST_DISABLE_DEPRECATED
 #include <gst/dataprotocol/dataprotocol.h>
+#include <gst/base/gstadapter.h>
 
 #define TCP_HIGHEST_PORT        65535
 #define TCP_DEFAULT_HOST        "localhost"
@@ -54,16 +55,55 @@ typedef enum
   GST_TCP_PROTOCOL_GDP
 } GstTCPProtocol;
 
+/**
+ * GstTCPOverflowPolicy:
+ * @GST_TCP_OVERFLOW_BLOCK: wait until the queue has room again
+ * @GST_TCP_OVERFLOW_DROP_OLDEST: drop the oldest queued buffer
+ * @GST_TCP_OVERFLOW_DROP_TO_KEYFRAME: drop the queued buffers up to the
+ *      next keyframe, or all of them and the new buffers up to the next
+ *      keyframe when there is no keyframe queued
+ *
+ * What a sink with a bounded send queue does when the queue is full.
+ *
+ * Since: 0.10.31
+ */
+typedef enum
+{
+  GST_TCP_OVERFLOW_BLOCK,
+  GST_TCP_OVERFLOW_DROP_OLDEST,
+  GST_TCP_OVERFLOW_DROP_TO_KEYFRAME
+} GstTCPOverflowPolicy;
+
+/* state for reading raw data from a socket. The data is read into large
+ * chunks and handed out as subbuffers, chunks that are no longer referenced
+ * by any subbuffer are recycled. */
+typedef struct
+{
+  GstBuffer *chunk;     /* the chunk we are reading into */
+  guint offset;         /* bytes of the chunk handed out */
+  GSList *spare;        /* chunks that were filled, waiting to be recycled */
+  guint n_spare;
+
+  guint size;           /* size of new chunks, adapts to the data rate */
+  guint full_reads;     /* consecutive reads that filled the space we had */
+  guint small_reads;    /* consecutive reads that used little of a chunk */
+} GstTCPReadPool;
+
 gchar * gst_tcp_host_to_ip (GstElement *element, const gchar *host);
 
 gint gst_tcp_socket_write (int socket, const void *buf, size_t count);
 
 void gst_tcp_socket_close (GstPollFD *socket);
 
-GstFlowReturn gst_tcp_read_buffer (GstElement * this, int socket, GstPoll * fdset, GstBuffer **buf);
+void gst_tcp_read_pool_init (GstTCPReadPool *pool);
+void gst_tcp_read_pool_clear (GstTCPReadPool *pool);
+GstFlowReturn gst_tcp_read_pool_read (GstTCPReadPool *pool, int socket, GstBuffer **buf);
+
+GstFlowReturn gst_tcp_read_buffer (GstElement * this, int socket, GstPoll * fdset, GstTCPReadPool * pool, GstBuffer **buf);
 
 GstFlowReturn gst_tcp_gdp_read_buffer (GstElement * this, int socket, GstPoll * fdset, GstBuffer **buf);
 GstFlowReturn gst_tcp_gdp_read_caps (GstElement * this, int socket, GstPoll * fdset, GstCaps **caps);
+GstFlowReturn gst_tcp_gdp_take_packet (GstAdapter *adapter, GstBuffer **buf, GstCaps **caps);
 
 GstEvent * gst_tcp_gdp_read_event (GstElement *elem, int socket, GstPoll * fdset);
 
@@ -31,6 +31,13 @@
  * gst-launch fdsrc fd=1 ! tcpclientsink protocol=none port=3000
  * ]| everything you type in the client is shown on the server
  * </refsect2>
+ *
+ * By default the buffers are written to the socket from the streaming
+ * thread, so a slow server slows down the pipeline. When
+ * #GstTCPClientSink:blocking is FALSE, the buffers are put in a queue that a
+ * separate thread writes out. #GstTCPClientSink:buffers-max and
+ * #GstTCPClientSink:bytes-max bound the queue and
+ * #GstTCPClientSink:overflow-policy selects what happens when it is full.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -41,6 +48,12 @@
 #include "gsttcp.h"
 #include "gsttcpclientsink.h"
 #include <string.h>             /* memset */
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 /* TCPClientSink signals and args */
 enum
@@ -58,10 +71,35 @@ enum
   ARG_0,
   ARG_HOST,
   ARG_PORT,
-  ARG_PROTOCOL
+  ARG_PROTOCOL,
+  ARG_BLOCKING,
+  ARG_BUFFERS_MAX,
+  ARG_BYTES_MAX,
+  ARG_OVERFLOW_POLICY,
+  ARG_BUFFERS_DROPPED
       /* FILL ME */
 };
 
+#define DEFAULT_BLOCKING        TRUE
+#define DEFAULT_BUFFERS_MAX     100
+#define DEFAULT_BYTES_MAX       -1
+#define DEFAULT_OVERFLOW_POLICY GST_TCP_OVERFLOW_BLOCK
+
+/* max number of iovecs the writer thread sends with one call, every item
+ * takes up to 2 */
+#define WRITER_IOVECS           32
+
+/* an entry in the send queue of the non-blocking mode */
+typedef struct
+{
+  GstBuffer *header;            /* GDP header, first buffer of a group or NULL */
+  GstBuffer *buffer;            /* the data, GDP payload or second buffer of a
+                                 * group, can be NULL */
+  gsize size;                   /* bytes of header and buffer */
+  gboolean keyframe;
+  gboolean droppable;           /* caps packets are never dropped */
+} GstTCPClientSinkItem;
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -76,6 +114,12 @@ static gboolean gst_tcp_client_sink_setcaps (GstBaseSink * bsink,
     GstCaps * caps);
 static GstFlowReturn gst_tcp_client_sink_render (GstBaseSink * bsink,
     GstBuffer * buf);
+static GstFlowReturn gst_tcp_client_sink_render_list (GstBaseSink * bsink,
+    GstBufferList * list);
+static gboolean gst_tcp_client_sink_event (GstBaseSink * bsink,
+    GstEvent * event);
+static gboolean gst_tcp_client_sink_unlock (GstBaseSink * bsink);
+static gboolean gst_tcp_client_sink_unlock_stop (GstBaseSink * bsink);
 static GstStateChangeReturn gst_tcp_client_sink_change_state (GstElement *
     element, GstStateChange transition);
 
@@ -158,11 +202,76 @@ gst_tcp_client_sink_class_init (GstTCPClientSink * klass)
       g_param_spec_enum ("protocol", "Protocol", "The protocol to wrap data in",
           GST_TYPE_TCP_PROTOCOL, GST_TCP_PROTOCOL_NONE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTCPClientSink:blocking
+   *
+   * Write the buffers from the streaming thread. When FALSE, the buffers are
+   * queued and written by a separate thread so that a slow server does not
+   * stall the pipeline. The value is used when the element goes to the
+   * READY state.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_BLOCKING,
+      g_param_spec_boolean ("blocking", "Blocking",
+          "Write from the streaming thread instead of queueing the buffers",
+          DEFAULT_BLOCKING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTCPClientSink:buffers-max
+   *
+   * The maximum number of buffers in the queue when not blocking.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_BUFFERS_MAX,
+      g_param_spec_int ("buffers-max", "Buffers max",
+          "Max number of queued buffers when not blocking (-1 = no limit)",
+          -1, G_MAXINT, DEFAULT_BUFFERS_MAX,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTCPClientSink:bytes-max
+   *
+   * The maximum number of bytes in the queue when not blocking.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_BYTES_MAX,
+      g_param_spec_int ("bytes-max", "Bytes max",
+          "Max number of queued bytes when not blocking (-1 = no limit)",
+          -1, G_MAXINT, DEFAULT_BYTES_MAX,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTCPClientSink:overflow-policy
+   *
+   * What to do when the queue is full when not blocking.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_OVERFLOW_POLICY,
+      g_param_spec_enum ("overflow-policy", "Overflow policy",
+          "What to do when the queue is full",
+          GST_TYPE_TCP_OVERFLOW_POLICY, DEFAULT_OVERFLOW_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTCPClientSink:buffers-dropped
+   *
+   * The number of buffers that were dropped because the queue was full.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_BUFFERS_DROPPED,
+      g_param_spec_uint64 ("buffers-dropped", "Buffers dropped",
+          "Number of buffers dropped because the queue was full",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state = gst_tcp_client_sink_change_state;
 
   gstbasesink_class->set_caps = gst_tcp_client_sink_setcaps;
   gstbasesink_class->render = gst_tcp_client_sink_render;
+  gstbasesink_class->render_list = gst_tcp_client_sink_render_list;
+  gstbasesink_class->event = gst_tcp_client_sink_event;
+  gstbasesink_class->unlock = gst_tcp_client_sink_unlock;
+  gstbasesink_class->unlock_stop = gst_tcp_client_sink_unlock_stop;
 
   GST_DEBUG_CATEGORY_INIT (tcpclientsink_debug, "tcpclientsink", 0, "TCP sink");
 }
@@ -175,6 +284,15 @@ gst_tcp_client_sink_init (GstTCPClientSink * this)
 
   this->sock_fd.fd = -1;
   this->protocol = GST_TCP_PROTOCOL_NONE;
+
+  this->blocking = DEFAULT_BLOCKING;
+  this->buffers_max = DEFAULT_BUFFERS_MAX;
+  this->bytes_max = DEFAULT_BYTES_MAX;
+  this->overflow_policy = DEFAULT_OVERFLOW_POLICY;
+  this->lock = g_mutex_new ();
+  this->cond = g_cond_new ();
+  this->queue = g_queue_new ();
+
   GST_OBJECT_FLAG_UNSET (this, GST_TCP_CLIENT_SINK_OPEN);
 }
 
@@ -184,10 +302,363 @@ gst_tcp_client_sink_finalize (GObject * gobject)
   GstTCPClientSink *this = GST_TCP_CLIENT_SINK (gobject);
 
   g_free (this->host);
+  g_queue_free (this->queue);
+  g_cond_free (this->cond);
+  g_mutex_free (this->lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (gobject);
 }
 
+/* wrap data allocated with g_malloc in a buffer */
+static GstBuffer *
+gst_tcp_client_sink_wrap (guint8 * data, guint length)
+{
+  GstBuffer *buf;
+
+  buf = gst_buffer_new ();
+  GST_BUFFER_DATA (buf) = data;
+  GST_BUFFER_MALLOCDATA (buf) = data;
+  GST_BUFFER_SIZE (buf) = length;
+
+  return buf;
+}
+
+static GstTCPClientSinkItem *
+gst_tcp_client_sink_item_new (GstBuffer * header, GstBuffer * buffer,
+    gboolean keyframe, gboolean droppable)
+{
+  GstTCPClientSinkItem *item;
+
+  item = g_slice_new (GstTCPClientSinkItem);
+  item->header = header;
+  item->buffer = buffer;
+  item->size = (header ? GST_BUFFER_SIZE (header) : 0) +
+      (buffer ? GST_BUFFER_SIZE (buffer) : 0);
+  item->keyframe = keyframe;
+  item->droppable = droppable;
+
+  return item;
+}
+
+static void
+gst_tcp_client_sink_item_free (GstTCPClientSinkItem * item)
+{
+  if (item->header)
+    gst_buffer_unref (item->header);
+  if (item->buffer)
+    gst_buffer_unref (item->buffer);
+  g_slice_free (GstTCPClientSinkItem, item);
+}
+
+/* should be called with the lock held */
+static void
+gst_tcp_client_sink_clear_queue (GstTCPClientSink * sink)
+{
+  g_queue_foreach (sink->queue, (GFunc) gst_tcp_client_sink_item_free, NULL);
+  g_queue_clear (sink->queue);
+  sink->bytes_queued = 0;
+  sink->head_offset = 0;
+}
+
+/* the first items of the queue are being written or were partially written
+ * and can't be dropped anymore. Should be called with the lock held. */
+static guint
+gst_tcp_client_sink_first_droppable (GstTCPClientSink * sink)
+{
+  return MAX (sink->in_flight, sink->head_offset > 0 ? 1 : 0);
+}
+
+/* remove the queued items that the writer is not sending yet, except for the
+ * ones that can't be dropped. Should be called with the lock held. */
+static void
+gst_tcp_client_sink_flush_queue (GstTCPClientSink * sink)
+{
+  GList *walk, *next;
+
+  walk = g_queue_peek_nth_link (sink->queue,
+      gst_tcp_client_sink_first_droppable (sink));
+
+  for (; walk; walk = next) {
+    GstTCPClientSinkItem *item = walk->data;
+
+    next = walk->next;
+
+    if (!item->droppable)
+      continue;
+
+    sink->bytes_queued -= item->size;
+    g_queue_delete_link (sink->queue, walk);
+    gst_tcp_client_sink_item_free (item);
+  }
+  sink->wait_keyframe = FALSE;
+  g_cond_broadcast (sink->cond);
+}
+
+static void
+gst_tcp_client_sink_drop_link (GstTCPClientSink * sink, GList * link)
+{
+  GstTCPClientSinkItem *item = link->data;
+
+  sink->bytes_queued -= item->size;
+  sink->buffers_dropped++;
+  g_queue_delete_link (sink->queue, link);
+  gst_tcp_client_sink_item_free (item);
+}
+
+/* make room in the queue according to the overflow policy. Returns FALSE when
+ * nothing could be dropped. Should be called with the lock held. */
+static gboolean
+gst_tcp_client_sink_drop (GstTCPClientSink * sink)
+{
+  GList *walk, *next;
+  gboolean dropped = FALSE;
+
+  walk = g_queue_peek_nth_link (sink->queue,
+      gst_tcp_client_sink_first_droppable (sink));
+
+  for (; walk; walk = next) {
+    GstTCPClientSinkItem *item = walk->data;
+
+    next = walk->next;
+
+    if (!item->droppable)
+      continue;
+
+    /* stop at the next keyframe */
+    if (dropped && item->keyframe)
+      return TRUE;
+
+    gst_tcp_client_sink_drop_link (sink, walk);
+    dropped = TRUE;
+
+    if (sink->overflow_policy == GST_TCP_OVERFLOW_DROP_OLDEST)
+      return TRUE;
+  }
+
+  /* no keyframe left, drop the new buffers until the next keyframe */
+  if (sink->overflow_policy == GST_TCP_OVERFLOW_DROP_TO_KEYFRAME) {
+    GST_DEBUG_OBJECT (sink, "no keyframe queued, waiting for one");
+    sink->wait_keyframe = TRUE;
+  }
+  return dropped;
+}
+
+/* should be called with the lock held */
+static gboolean
+gst_tcp_client_sink_queue_full (GstTCPClientSink * sink,
+    GstTCPClientSinkItem * item)
+{
+  if (g_queue_is_empty (sink->queue))
+    return FALSE;
+
+  if (sink->buffers_max > 0 && (gint) sink->queue->length >= sink->buffers_max)
+    return TRUE;
+  if (sink->bytes_max > 0 &&
+      sink->bytes_queued + (gint64) item->size > sink->bytes_max)
+    return TRUE;
+
+  return FALSE;
+}
+
+/* add @item to the queue of the writer thread, takes ownership of @item */
+static GstFlowReturn
+gst_tcp_client_sink_queue_item (GstTCPClientSink * sink,
+    GstTCPClientSinkItem * item)
+{
+  GstFlowReturn ret;
+
+  /* nothing to send, and the writer can't make progress on an empty item */
+  if (item->size == 0) {
+    gst_tcp_client_sink_item_free (item);
+    return GST_FLOW_OK;
+  }
+
+  g_mutex_lock (sink->lock);
+  while (gst_tcp_client_sink_queue_full (sink, item)) {
+    if (sink->write_errno != 0)
+      goto write_error;
+
+    if (sink->overflow_policy == GST_TCP_OVERFLOW_BLOCK) {
+      if (sink->flushing) {
+        /* we get unlocked when pausing as well as when flushing, basesink
+         * knows which one it is. Wait until we are playing again or
+         * until we need to stop */
+        GST_DEBUG_OBJECT (sink, "unlocked, waiting for preroll");
+        g_mutex_unlock (sink->lock);
+        ret = gst_base_sink_wait_preroll (GST_BASE_SINK (sink));
+        if (ret != GST_FLOW_OK)
+          goto stopping;
+        g_mutex_lock (sink->lock);
+        continue;
+      }
+      GST_LOG_OBJECT (sink, "queue full, waiting");
+      g_cond_wait (sink->cond, sink->lock);
+      continue;
+    }
+
+    if (!gst_tcp_client_sink_drop (sink)) {
+      /* everything queued is being sent, drop the new buffer instead */
+      if (item->droppable)
+        goto drop;
+      break;
+    }
+  }
+
+  if (sink->write_errno != 0)
+    goto write_error;
+
+  if (sink->wait_keyframe && item->droppable) {
+    if (!item->keyframe)
+      goto drop;
+    sink->wait_keyframe = FALSE;
+  }
+
+  g_queue_push_tail (sink->queue, item);
+  sink->bytes_queued += item->size;
+  g_cond_broadcast (sink->cond);
+  g_mutex_unlock (sink->lock);
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+drop:
+  {
+    GST_LOG_OBJECT (sink, "queue full, dropping new buffer");
+    sink->buffers_dropped++;
+    g_mutex_unlock (sink->lock);
+    gst_tcp_client_sink_item_free (item);
+    return GST_FLOW_OK;
+  }
+stopping:
+  {
+    GST_DEBUG_OBJECT (sink, "stopping, reason %s", gst_flow_get_name (ret));
+    gst_tcp_client_sink_item_free (item);
+    return ret;
+  }
+write_error:
+  {
+    gint errsv = sink->write_errno;
+
+    g_mutex_unlock (sink->lock);
+    gst_tcp_client_sink_item_free (item);
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+        (_("Error while sending data to \"%s:%d\"."), sink->host, sink->port),
+        ("Could not write to socket: %s", g_strerror (errsv)));
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* remove @wrote bytes from the start of the queue. Should be called with the
+ * lock held. */
+static void
+gst_tcp_client_sink_consume (GstTCPClientSink * sink, gsize wrote)
+{
+  sink->data_written += wrote;
+
+  /* this also pops the empty items at the head when nothing was written */
+  while (!g_queue_is_empty (sink->queue)) {
+    GstTCPClientSinkItem *item = g_queue_peek_head (sink->queue);
+    gsize left = item->size - sink->head_offset;
+
+    if (wrote < left) {
+      sink->head_offset += wrote;
+      break;
+    }
+    g_queue_pop_head (sink->queue);
+    sink->bytes_queued -= item->size;
+    sink->head_offset = 0;
+    wrote -= left;
+    gst_tcp_client_sink_item_free (item);
+  }
+}
+
+static guint
+gst_tcp_client_sink_fill_iov (GstBuffer * buf, struct iovec *iov, gsize * skip)
+{
+  if (buf == NULL)
+    return 0;
+
+  if (*skip >= GST_BUFFER_SIZE (buf)) {
+    *skip -= GST_BUFFER_SIZE (buf);
+    return 0;
+  }
+
+  iov->iov_base = GST_BUFFER_DATA (buf) + *skip;
+  iov->iov_len = GST_BUFFER_SIZE (buf) - *skip;
+  *skip = 0;
+
+  return 1;
+}
+
+/* the writer thread of the non-blocking mode. It sends the queued items with
+ * one sendmsg call for as many items as fit in the iovecs and waits for the
+ * socket to become writable when it can't take more data. */
+static gpointer
+gst_tcp_client_sink_writer (GstTCPClientSink * sink)
+{
+  struct iovec iov[WRITER_IOVECS];
+
+  g_mutex_lock (sink->lock);
+  while (sink->running) {
+    struct msghdr msg;
+    GList *walk;
+    guint n_iov = 0;
+    gsize skip;
+    gssize wrote;
+    gint errsv;
+
+    if (g_queue_is_empty (sink->queue)) {
+      g_cond_wait (sink->cond, sink->lock);
+      continue;
+    }
+
+    skip = sink->head_offset;
+    sink->in_flight = 0;
+    for (walk = sink->queue->head; walk && n_iov + 2 <= WRITER_IOVECS;
+        walk = walk->next) {
+      GstTCPClientSinkItem *item = walk->data;
+
+      n_iov += gst_tcp_client_sink_fill_iov (item->header, &iov[n_iov], &skip);
+      n_iov += gst_tcp_client_sink_fill_iov (item->buffer, &iov[n_iov], &skip);
+      sink->in_flight++;
+    }
+    g_mutex_unlock (sink->lock);
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n_iov;
+
+    do {
+      wrote = sendmsg (sink->sock_fd.fd, &msg, MSG_NOSIGNAL);
+    } while (wrote < 0 && errno == EINTR);
+    errsv = errno;
+
+    if (wrote < 0 && errsv == EAGAIN) {
+      /* wait until the socket takes more data or until we are stopped */
+      GST_LOG_OBJECT (sink, "socket full, waiting");
+      gst_poll_wait (sink->fdset, GST_CLOCK_TIME_NONE);
+      wrote = 0;
+    }
+
+    g_mutex_lock (sink->lock);
+    sink->in_flight = 0;
+
+    if (wrote < 0) {
+      GST_DEBUG_OBJECT (sink, "write failed: %s", g_strerror (errsv));
+      sink->write_errno = errsv;
+      g_cond_broadcast (sink->cond);
+      break;
+    }
+
+    GST_LOG_OBJECT (sink, "wrote %" G_GSSIZE_FORMAT " bytes", wrote);
+    gst_tcp_client_sink_consume (sink, wrote);
+    g_cond_broadcast (sink->cond);
+  }
+  g_mutex_unlock (sink->lock);
+
+  return NULL;
+}
+
 static gboolean
 gst_tcp_client_sink_setcaps (GstBaseSink * bsink, GstCaps * caps)
 {
@@ -211,8 +682,23 @@ gst_tcp_client_sink_setcaps (GstBaseSink * bsink, GstCaps * caps)
         GST_DEBUG_OBJECT (sink, "Sending caps %s through GDP", string);
         g_free (string);
 
-        if (!gst_tcp_gdp_write_caps (GST_ELEMENT (sink), sink->sock_fd.fd,
-                caps, TRUE, sink->host, sink->port))
+        if (!sink->blocking) {
+          guint length;
+          guint8 *header, *payload;
+          GstTCPClientSinkItem *item;
+
+          if (!gst_dp_packet_from_caps (caps, 0, &length, &header, &payload))
+            goto gdp_create_error;
+
+          /* the server needs the caps, never drop them */
+          item = gst_tcp_client_sink_item_new (gst_tcp_client_sink_wrap (header,
+                  length), gst_tcp_client_sink_wrap (payload,
+                  gst_dp_header_payload_length (header)), TRUE, FALSE);
+
+          if (gst_tcp_client_sink_queue_item (sink, item) != GST_FLOW_OK)
+            goto gdp_write_error;
+        } else if (!gst_tcp_gdp_write_caps (GST_ELEMENT (sink),
+                sink->sock_fd.fd, caps, TRUE, sink->host, sink->port))
           goto gdp_write_error;
 
         sink->caps_sent = TRUE;
@@ -226,12 +712,48 @@ gst_tcp_client_sink_setcaps (GstBaseSink * bsink, GstCaps * caps)
   return TRUE;
 
   /* ERRORS */
+gdp_create_error:
+  {
+    GST_ELEMENT_ERROR (sink, CORE, TOO_LAZY, (NULL),
+        ("Could not create GDP packet from caps"));
+    return FALSE;
+  }
 gdp_write_error:
   {
     return FALSE;
   }
 }
 
+/* queue @buf, and its GDP header, for the writer thread */
+static GstFlowReturn
+gst_tcp_client_sink_render_queued (GstTCPClientSink * sink, GstBuffer * buf)
+{
+  GstTCPClientSinkItem *item;
+  GstBuffer *header = NULL;
+
+  if (sink->protocol == GST_TCP_PROTOCOL_GDP) {
+    guint length;
+    guint8 *data;
+
+    if (!gst_dp_header_from_buffer (buf, 0, &length, &data))
+      goto gdp_create_error;
+    header = gst_tcp_client_sink_wrap (data, length);
+  }
+
+  item = gst_tcp_client_sink_item_new (header, gst_buffer_ref (buf),
+      !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT), TRUE);
+
+  return gst_tcp_client_sink_queue_item (sink, item);
+
+  /* ERRORS */
+gdp_create_error:
+  {
+    GST_ELEMENT_ERROR (sink, CORE, TOO_LAZY, (NULL),
+        ("Could not create GDP header from buffer"));
+    return GST_FLOW_ERROR;
+  }
+}
+
 static GstFlowReturn
 gst_tcp_client_sink_render (GstBaseSink * bsink, GstBuffer * buf)
 {
@@ -244,6 +766,9 @@ gst_tcp_client_sink_render (GstBaseSink * bsink, GstBuffer * buf)
   g_return_val_if_fail (GST_OBJECT_FLAG_IS_SET (sink, GST_TCP_CLIENT_SINK_OPEN),
       GST_FLOW_WRONG_STATE);
 
+  if (!sink->blocking)
+    return gst_tcp_client_sink_render_queued (sink, buf);
+
   size = GST_BUFFER_SIZE (buf);
 
   GST_LOG_OBJECT (sink, "writing %d bytes for buffer data", size);
@@ -287,6 +812,116 @@ write_error:
   }
 }
 
+/* a group of a buffer list is one unit of data, like the GDP header and
+ * payload that gdppay pushes in buffer-list mode. The queue and the blocking
+ * writes send the buffers of small groups as they are, other groups are
+ * merged into one buffer. */
+static GstFlowReturn
+gst_tcp_client_sink_render_list (GstBaseSink * bsink, GstBufferList * list)
+{
+  GstTCPClientSink *sink;
+  GstBufferListIterator *it;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  sink = GST_TCP_CLIENT_SINK (bsink);
+
+  it = gst_buffer_list_iterate (list);
+  while (ret == GST_FLOW_OK && gst_buffer_list_iterator_next_group (it)) {
+    guint n_buffers = gst_buffer_list_iterator_n_buffers (it);
+    GstBuffer *buf;
+
+    if (n_buffers == 0)
+      continue;
+
+    if (sink->protocol == GST_TCP_PROTOCOL_NONE && !sink->blocking &&
+        n_buffers <= 2) {
+      GstBuffer *first, *second;
+      GstTCPClientSinkItem *item;
+      gboolean keyframe;
+
+      first = gst_buffer_list_iterator_next (it);
+      second = gst_buffer_list_iterator_next (it);
+      keyframe = !GST_BUFFER_FLAG_IS_SET (first, GST_BUFFER_FLAG_DELTA_UNIT) &&
+          (second == NULL ||
+          !GST_BUFFER_FLAG_IS_SET (second, GST_BUFFER_FLAG_DELTA_UNIT));
+
+      item = gst_tcp_client_sink_item_new (gst_buffer_ref (first),
+          second ? gst_buffer_ref (second) : NULL, keyframe, TRUE);
+      ret = gst_tcp_client_sink_queue_item (sink, item);
+    } else if (sink->protocol == GST_TCP_PROTOCOL_NONE && sink->blocking) {
+      while (ret == GST_FLOW_OK && (buf = gst_buffer_list_iterator_next (it)))
+        ret = gst_tcp_client_sink_render (bsink, buf);
+    } else {
+      buf = gst_buffer_list_iterator_merge_group (it);
+      ret = gst_tcp_client_sink_render (bsink, buf);
+      gst_buffer_unref (buf);
+    }
+  }
+  gst_buffer_list_iterator_free (it);
+
+  return ret;
+}
+
+/* wait for the writer thread to send everything before we post EOS and
+ * throw away the queued buffers when flushing */
+static gboolean
+gst_tcp_client_sink_event (GstBaseSink * bsink, GstEvent * event)
+{
+  GstTCPClientSink *sink = GST_TCP_CLIENT_SINK (bsink);
+
+  if (sink->blocking || sink->writer == NULL)
+    return TRUE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      g_mutex_lock (sink->lock);
+      while (!g_queue_is_empty (sink->queue) && sink->write_errno == 0 &&
+          !sink->flushing)
+        g_cond_wait (sink->cond, sink->lock);
+      g_mutex_unlock (sink->lock);
+      GST_DEBUG_OBJECT (sink, "queue drained");
+      break;
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+      /* the second time catches what a render racing with the flush-start
+       * still queued */
+      GST_DEBUG_OBJECT (sink, "flushing queue");
+      g_mutex_lock (sink->lock);
+      gst_tcp_client_sink_flush_queue (sink);
+      g_mutex_unlock (sink->lock);
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_tcp_client_sink_unlock (GstBaseSink * bsink)
+{
+  GstTCPClientSink *sink = GST_TCP_CLIENT_SINK (bsink);
+
+  g_mutex_lock (sink->lock);
+  sink->flushing = TRUE;
+  g_cond_broadcast (sink->cond);
+  g_mutex_unlock (sink->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_tcp_client_sink_unlock_stop (GstBaseSink * bsink)
+{
+  GstTCPClientSink *sink = GST_TCP_CLIENT_SINK (bsink);
+
+  g_mutex_lock (sink->lock);
+  sink->flushing = FALSE;
+  g_mutex_unlock (sink->lock);
+
+  return TRUE;
+}
+
 static void
 gst_tcp_client_sink_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -311,6 +946,18 @@ gst_tcp_client_sink_set_property (GObject * object, guint prop_id,
     case ARG_PROTOCOL:
       tcpclientsink->protocol = g_value_get_enum (value);
       break;
+    case ARG_BLOCKING:
+      tcpclientsink->blocking = g_value_get_boolean (value);
+      break;
+    case ARG_BUFFERS_MAX:
+      tcpclientsink->buffers_max = g_value_get_int (value);
+      break;
+    case ARG_BYTES_MAX:
+      tcpclientsink->bytes_max = g_value_get_int (value);
+      break;
+    case ARG_OVERFLOW_POLICY:
+      tcpclientsink->overflow_policy = g_value_get_enum (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -337,6 +984,23 @@ gst_tcp_client_sink_get_property (GObject * object, guint prop_id,
     case ARG_PROTOCOL:
       g_value_set_enum (value, tcpclientsink->protocol);
       break;
+    case ARG_BLOCKING:
+      g_value_set_boolean (value, tcpclientsink->blocking);
+      break;
+    case ARG_BUFFERS_MAX:
+      g_value_set_int (value, tcpclientsink->buffers_max);
+      break;
+    case ARG_BYTES_MAX:
+      g_value_set_int (value, tcpclientsink->bytes_max);
+      break;
+    case ARG_OVERFLOW_POLICY:
+      g_value_set_enum (value, tcpclientsink->overflow_policy);
+      break;
+    case ARG_BUFFERS_DROPPED:
+      g_mutex_lock (tcpclientsink->lock);
+      g_value_set_uint64 (value, tcpclientsink->buffers_dropped);
+      g_mutex_unlock (tcpclientsink->lock);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -345,6 +1009,78 @@ gst_tcp_client_sink_get_property (GObject * object, guint prop_id,
 }
 
 
+/* start the writer thread of the non-blocking mode on the connected socket */
+static gboolean
+gst_tcp_client_sink_start_writer (GstTCPClientSink * this)
+{
+  GError *error = NULL;
+
+  if (fcntl (this->sock_fd.fd, F_SETFL, O_NONBLOCK) < 0)
+    goto fcntl_error;
+
+  if ((this->fdset = gst_poll_new (TRUE)) == NULL)
+    goto socket_pair;
+
+  gst_poll_add_fd (this->fdset, &this->sock_fd);
+  gst_poll_fd_ctl_write (this->fdset, &this->sock_fd, TRUE);
+
+  this->write_errno = 0;
+  this->wait_keyframe = FALSE;
+  this->buffers_dropped = 0;
+  this->running = TRUE;
+
+  this->writer = g_thread_create ((GThreadFunc) gst_tcp_client_sink_writer,
+      this, TRUE, &error);
+  if (this->writer == NULL)
+    goto thread_error;
+
+  return TRUE;
+
+  /* ERRORS */
+fcntl_error:
+  {
+    GST_ELEMENT_ERROR (this, RESOURCE, SETTINGS, (NULL),
+        ("Could not make socket non-blocking: %s", g_strerror (errno)));
+    return FALSE;
+  }
+socket_pair:
+  {
+    GST_ELEMENT_ERROR (this, RESOURCE, OPEN_READ_WRITE, (NULL),
+        GST_ERROR_SYSTEM);
+    return FALSE;
+  }
+thread_error:
+  {
+    GST_ELEMENT_ERROR (this, RESOURCE, FAILED, (NULL),
+        ("Could not create writer thread: %s", error->message));
+    g_error_free (error);
+    this->running = FALSE;
+    gst_poll_free (this->fdset);
+    this->fdset = NULL;
+    return FALSE;
+  }
+}
+
+static void
+gst_tcp_client_sink_stop_writer (GstTCPClientSink * this)
+{
+  g_mutex_lock (this->lock);
+  this->running = FALSE;
+  g_cond_broadcast (this->cond);
+  g_mutex_unlock (this->lock);
+
+  gst_poll_set_flushing (this->fdset, TRUE);
+  g_thread_join (this->writer);
+  this->writer = NULL;
+
+  gst_poll_free (this->fdset);
+  this->fdset = NULL;
+
+  g_mutex_lock (this->lock);
+  gst_tcp_client_sink_clear_queue (this);
+  g_mutex_unlock (this->lock);
+}
+
 /* create a socket for sending to remote machine */
 static gboolean
 gst_tcp_client_sink_start (GstTCPClientSink * this)
@@ -405,10 +1141,15 @@ gst_tcp_client_sink_start (GstTCPClientSink * this)
     }
   }
 
-  GST_OBJECT_FLAG_SET (this, GST_TCP_CLIENT_SINK_OPEN);
-
   this->data_written = 0;
 
+  if (!this->blocking && !gst_tcp_client_sink_start_writer (this)) {
+    gst_tcp_socket_close (&this->sock_fd);
+    return FALSE;
+  }
+
+  GST_OBJECT_FLAG_SET (this, GST_TCP_CLIENT_SINK_OPEN);
+
   return TRUE;
 }
 
@@ -418,6 +1159,9 @@ gst_tcp_client_sink_stop (GstTCPClientSink * this)
   if (!GST_OBJECT_FLAG_IS_SET (this, GST_TCP_CLIENT_SINK_OPEN))
     return TRUE;
 
+  if (this->writer)
+    gst_tcp_client_sink_stop_writer (this);
+
   gst_tcp_socket_close (&this->sock_fd);
 
   GST_OBJECT_FLAG_UNSET (this, GST_TCP_CLIENT_SINK_OPEN);
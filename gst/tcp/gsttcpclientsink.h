@@ -78,6 +78,27 @@ struct _GstTCPClientSink {
   size_t data_written; /* how much bytes have we written ? */
   GstTCPProtocol protocol; /* used with the protocol enum */
   gboolean caps_sent; /* whether or not we sent caps already */
+
+  /* non-blocking mode, a writer thread sends the queued buffers */
+  gboolean blocking;
+  gint buffers_max;           /* max buffers in the queue */
+  gint bytes_max;             /* max bytes in the queue */
+  GstTCPOverflowPolicy overflow_policy;
+
+  GMutex *lock;               /* protects the fields below */
+  GCond *cond;                /* signaled when the queue changes */
+  GQueue *queue;              /* items waiting to be sent */
+  gint64 bytes_queued;
+  gsize head_offset;          /* bytes of the first item already sent */
+  guint in_flight;            /* items the writer is sending now */
+  gboolean wait_keyframe;     /* drop new delta units */
+  gboolean flushing;
+  gboolean running;
+  gint write_errno;           /* error of the writer, 0 if none */
+  guint64 buffers_dropped;
+
+  GThread *writer;
+  GstPoll *fdset;             /* to wait for the socket to become writable */
 };
 
 struct _GstTCPClientSinkClass {
@@ -150,6 +150,7 @@ gst_tcp_client_src_init (GstTCPClientSrc * this, GstTCPClientSrcClass * g_class)
   this->sock_fd.fd = -1;
   this->protocol = GST_TCP_PROTOCOL_NONE;
   this->caps = NULL;
+  gst_tcp_read_pool_init (&this->read_pool);
 
   GST_OBJECT_FLAG_UNSET (this, GST_TCP_CLIENT_SRC_OPEN);
 }
@@ -200,7 +201,7 @@ gst_tcp_client_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
   switch (src->protocol) {
     case GST_TCP_PROTOCOL_NONE:
       ret = gst_tcp_read_buffer (GST_ELEMENT (src), src->sock_fd.fd,
-          src->fdset, outbuf);
+          src->fdset, &src->read_pool, outbuf);
       break;
 
     case GST_TCP_PROTOCOL_GDP:
@@ -406,6 +407,7 @@ gst_tcp_client_src_stop (GstBaseSrc * bsrc)
   }
 
   gst_tcp_socket_close (&src->sock_fd);
+  gst_tcp_read_pool_clear (&src->read_pool);
   src->caps_received = FALSE;
   if (src->caps) {
     gst_caps_unref (src->caps);
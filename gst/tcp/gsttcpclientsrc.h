@@ -66,6 +66,7 @@ struct _GstTCPClientSrc {
   /* socket */
   GstPollFD sock_fd;
   GstPoll *fdset;
+  GstTCPReadPool read_pool;     /* chunks for reading raw data */
 
   GstTCPProtocol protocol; /* protocol used for reading data */
   gboolean caps_received;      /* if we have received caps yet */
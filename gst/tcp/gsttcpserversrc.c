@@ -31,6 +31,15 @@
  * gst-launch fdsrc fd=1 ! tcpclientsink protocol=none port=3000
  * ]| 
  * </refsect2>
+ *
+ * When #GstTCPServerSrc:max-clients is larger than 1, tcpserversrc keeps
+ * accepting clients and outputs the data of all of them. Every buffer is
+ * then a #GstNetBuffer with the address of the client it came from in the
+ * from field. The data is read from every client as it arrives, a slow
+ * client does not hold up the others. With the GDP protocol every client
+ * sends its own caps and its packets are collected until they are complete.
+ * A client that disconnects or sends invalid data is dropped, the stream
+ * does not end.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -38,6 +47,7 @@
 #endif
 
 #include <gst/gst-i18n-plugin.h>
+#include <gst/netbuffer/gstnetbuffer.h>
 #include "gsttcp.h"
 #include "gsttcpserversrc.h"
 #include <string.h>             /* memset */
@@ -51,6 +61,7 @@ GST_DEBUG_CATEGORY_STATIC (tcpserversrc_debug);
 
 #define TCP_DEFAULT_LISTEN_HOST         NULL    /* listen on all interfaces */
 #define TCP_BACKLOG                     1       /* client connection queue */
+#define TCP_DEFAULT_MAX_CLIENTS         1
 
 
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
@@ -64,7 +75,8 @@ enum
   PROP_0,
   PROP_HOST,
   PROP_PORT,
-  PROP_PROTOCOL
+  PROP_PROTOCOL,
+  PROP_MAX_CLIENTS
 };
 
 
@@ -126,6 +138,20 @@ gst_tcp_server_src_class_init (GstTCPServerSrcClass * klass)
       g_param_spec_enum ("protocol", "Protocol", "The protocol to wrap data in",
           GST_TYPE_TCP_PROTOCOL, GST_TCP_PROTOCOL_NONE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTCPServerSrc:max-clients
+   *
+   * The maximum number of clients that can send data at the same time. With
+   * more than one client, the buffers are #GstNetBuffer<!-- -->s carrying
+   * the address of the client. The value is used when the element goes to
+   * the READY state.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_CLIENTS,
+      g_param_spec_uint ("max-clients", "Max clients",
+          "The maximum number of simultaneous clients", 1, G_MAXINT,
+          TCP_DEFAULT_MAX_CLIENTS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstbasesrc_class->start = gst_tcp_server_src_start;
   gstbasesrc_class->stop = gst_tcp_server_src_stop;
@@ -145,6 +171,9 @@ gst_tcp_server_src_init (GstTCPServerSrc * src, GstTCPServerSrcClass * g_class)
   src->server_sock_fd.fd = -1;
   src->client_sock_fd.fd = -1;
   src->protocol = GST_TCP_PROTOCOL_NONE;
+  src->max_clients = TCP_DEFAULT_MAX_CLIENTS;
+  src->pending = g_queue_new ();
+  gst_tcp_read_pool_init (&src->read_pool);
 
   GST_OBJECT_FLAG_UNSET (src, GST_TCP_SERVER_SRC_OPEN);
 }
@@ -155,10 +184,276 @@ gst_tcp_server_src_finalize (GObject * gobject)
   GstTCPServerSrc *src = GST_TCP_SERVER_SRC (gobject);
 
   g_free (src->host);
+  g_queue_free (src->pending);
 
   G_OBJECT_CLASS (parent_class)->finalize (gobject);
 }
 
+static void
+gst_tcp_server_src_client_free (GstTCPServerSrcClient * client)
+{
+  gst_tcp_socket_close (&client->fd);
+  gst_tcp_read_pool_clear (&client->read_pool);
+  g_object_unref (client->adapter);
+  if (client->caps)
+    gst_caps_unref (client->caps);
+  g_free (client);
+}
+
+/* accept a new client on the server socket in multi-client mode */
+static gboolean
+gst_tcp_server_src_accept_client (GstTCPServerSrc * src)
+{
+  GstTCPServerSrcClient *client;
+  socklen_t len;
+  int fd, flags;
+
+  len = sizeof (struct sockaddr_in);
+  client = g_new0 (GstTCPServerSrcClient, 1);
+  if ((fd = accept (src->server_sock_fd.fd, (struct sockaddr *) &client->sin,
+              &len)) == -1)
+    goto accept_error;
+
+  /* we only read what a client has for us and never wait on one client */
+  flags = fcntl (fd, F_GETFL, 0);
+  if (flags == -1 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    goto fcntl_error;
+
+  gst_poll_fd_init (&client->fd);
+  client->fd.fd = fd;
+  gst_tcp_read_pool_init (&client->read_pool);
+  client->adapter = gst_adapter_new ();
+
+  gst_poll_add_fd (src->fdset, &client->fd);
+  gst_poll_fd_ctl_read (src->fdset, &client->fd, TRUE);
+
+  GST_OBJECT_LOCK (src);
+  src->clients = g_list_append (src->clients, client);
+  src->n_clients++;
+  GST_OBJECT_UNLOCK (src);
+
+  GST_DEBUG_OBJECT (src, "[fd %5d] accepted client from %s:%d, %u clients",
+      fd, inet_ntoa (client->sin.sin_addr), ntohs (client->sin.sin_port),
+      src->n_clients);
+
+  return TRUE;
+
+  /* ERRORS */
+accept_error:
+  {
+    /* we keep serving the clients we have */
+    GST_WARNING_OBJECT (src, "could not accept client on server socket: %s",
+        g_strerror (errno));
+    g_free (client);
+    return FALSE;
+  }
+fcntl_error:
+  {
+    GST_WARNING_OBJECT (src, "could not make client socket non-blocking: %s",
+        g_strerror (errno));
+    close (fd);
+    g_free (client);
+    return FALSE;
+  }
+}
+
+static void
+gst_tcp_server_src_remove_client (GstTCPServerSrc * src,
+    GstTCPServerSrcClient * client)
+{
+  GST_DEBUG_OBJECT (src, "[fd %5d] removing client from %s:%d",
+      client->fd.fd, inet_ntoa (client->sin.sin_addr),
+      ntohs (client->sin.sin_port));
+
+  gst_poll_remove_fd (src->fdset, &client->fd);
+
+  GST_OBJECT_LOCK (src);
+  src->clients = g_list_remove (src->clients, client);
+  src->n_clients--;
+  GST_OBJECT_UNLOCK (src);
+
+  gst_tcp_server_src_client_free (client);
+}
+
+/* wrap @buf in a GstNetBuffer carrying the address of @client */
+static GstBuffer *
+gst_tcp_server_src_tag_buffer (GstTCPServerSrc * src,
+    GstTCPServerSrcClient * client, GstBuffer * buf)
+{
+  GstNetBuffer *netbuf;
+
+  netbuf = gst_netbuffer_new ();
+  GST_BUFFER_DATA (netbuf) = GST_BUFFER_DATA (buf);
+  GST_BUFFER_SIZE (netbuf) = GST_BUFFER_SIZE (buf);
+  /* the netbuffer keeps the data of @buf alive */
+  GST_BUFFER_MALLOCDATA (netbuf) = (guint8 *) buf;
+  GST_BUFFER_FREE_FUNC (netbuf) = (GFreeFunc) gst_mini_object_unref;
+  gst_buffer_copy_metadata (GST_BUFFER_CAST (netbuf), buf,
+      GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS |
+      GST_BUFFER_COPY_CAPS);
+
+  gst_netaddress_set_ip4_address (&netbuf->from, client->sin.sin_addr.s_addr,
+      client->sin.sin_port);
+
+  return GST_BUFFER_CAST (netbuf);
+}
+
+/* read what @client has for us and queue the buffers it completes. Nothing
+ * here posts an error: whatever goes wrong only concerns this client.
+ * Returns: GST_FLOW_OK when we can keep reading from @client, anything else
+ * when it has to be removed. */
+static GstFlowReturn
+gst_tcp_server_src_read_client (GstTCPServerSrc * src,
+    GstTCPServerSrcClient * client)
+{
+  GstFlowReturn ret;
+  GstBuffer *buf;
+  GstCaps *caps;
+
+  ret = gst_tcp_read_pool_read (&client->read_pool, client->fd.fd, &buf);
+  if (ret == GST_FLOW_UNEXPECTED)
+    goto closed;
+  if (ret != GST_FLOW_OK)
+    goto read_error;
+  if (buf == NULL)
+    return GST_FLOW_OK;
+
+  GST_LOG_OBJECT (src, "[fd %5d] read %u bytes", client->fd.fd,
+      GST_BUFFER_SIZE (buf));
+
+  switch (src->protocol) {
+    case GST_TCP_PROTOCOL_NONE:
+      g_queue_push_tail (src->pending,
+          gst_tcp_server_src_tag_buffer (src, client, buf));
+      break;
+
+    case GST_TCP_PROTOCOL_GDP:
+      gst_adapter_push (client->adapter, buf);
+      while (TRUE) {
+        ret = gst_tcp_gdp_take_packet (client->adapter, &buf, &caps);
+        if (ret != GST_FLOW_OK)
+          goto gdp_error;
+
+        if (caps) {
+          GST_DEBUG_OBJECT (src, "[fd %5d] received caps through GDP: %"
+              GST_PTR_FORMAT, client->fd.fd, caps);
+          gst_caps_replace (&client->caps, caps);
+          gst_caps_unref (caps);
+        } else if (buf) {
+          if (client->caps == NULL)
+            goto no_caps;
+          gst_buffer_set_caps (buf, client->caps);
+          g_queue_push_tail (src->pending,
+              gst_tcp_server_src_tag_buffer (src, client, buf));
+        } else {
+          /* need more data */
+          break;
+        }
+      }
+      break;
+
+    default:
+      /* need to assert as buf == NULL */
+      g_assert ("Unhandled protocol type");
+      gst_buffer_unref (buf);
+      return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+closed:
+  {
+    GST_DEBUG_OBJECT (src, "[fd %5d] client closed the connection",
+        client->fd.fd);
+    return ret;
+  }
+read_error:
+  {
+    GST_WARNING_OBJECT (src, "[fd %5d] read failed: %s", client->fd.fd,
+        g_strerror (errno));
+    return ret;
+  }
+gdp_error:
+  {
+    GST_WARNING_OBJECT (src, "[fd %5d] client sent invalid GDP data",
+        client->fd.fd);
+    return ret;
+  }
+no_caps:
+  {
+    GST_WARNING_OBJECT (src, "[fd %5d] client sent a buffer before its caps",
+        client->fd.fd);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* wait for new clients and for data on all clients. Every client that has
+ * data gets one read, and the buffers this completes are queued so that we
+ * hand them out before waiting again. A client that fails is removed, the
+ * others are not affected. */
+static GstFlowReturn
+gst_tcp_server_src_create_multi (GstTCPServerSrc * src, GstBuffer ** outbuf)
+{
+  GList *walk, *next;
+  gint res;
+
+  while (g_queue_is_empty (src->pending)) {
+    /* only accept clients when we have room for them */
+    gst_poll_fd_ctl_read (src->fdset, &src->server_sock_fd,
+        src->n_clients < src->max_clients);
+
+    /* no action (0) is an error too in our case */
+    if ((res = gst_poll_wait (src->fdset, GST_CLOCK_TIME_NONE)) <= 0) {
+      if (res == -1 && errno == EBUSY)
+        goto select_cancelled;
+      else if (res == -1 && (errno == EINTR || errno == EAGAIN))
+        continue;
+      else
+        goto select_error;
+    }
+
+    if (gst_poll_fd_can_read (src->fdset, &src->server_sock_fd))
+      gst_tcp_server_src_accept_client (src);
+
+    for (walk = src->clients; walk; walk = next) {
+      GstTCPServerSrcClient *client = walk->data;
+
+      next = g_list_next (walk);
+
+      if (gst_poll_fd_has_error (src->fdset, &client->fd)) {
+        GST_DEBUG_OBJECT (src, "[fd %5d] error on client socket",
+            client->fd.fd);
+        gst_tcp_server_src_remove_client (src, client);
+        continue;
+      }
+      if (!gst_poll_fd_can_read (src->fdset, &client->fd))
+        continue;
+
+      if (gst_tcp_server_src_read_client (src, client) != GST_FLOW_OK)
+        gst_tcp_server_src_remove_client (src, client);
+    }
+  }
+
+  *outbuf = g_queue_pop_head (src->pending);
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+select_error:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("Select error: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+select_cancelled:
+  {
+    GST_DEBUG_OBJECT (src, "select canceled");
+    return GST_FLOW_WRONG_STATE;
+  }
+}
+
 static GstFlowReturn
 gst_tcp_server_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
 {
@@ -170,6 +465,11 @@ gst_tcp_server_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
   if (!GST_OBJECT_FLAG_IS_SET (src, GST_TCP_SERVER_SRC_OPEN))
     goto wrong_state;
 
+  if (src->max_clients > 1) {
+    ret = gst_tcp_server_src_create_multi (src, outbuf);
+    goto done;
+  }
+
 restart:
   if (src->client_sock_fd.fd >= 0) {
     /* if we have a client, wait for read */
@@ -208,7 +508,7 @@ restart:
   switch (src->protocol) {
     case GST_TCP_PROTOCOL_NONE:
       ret = gst_tcp_read_buffer (GST_ELEMENT (src), src->client_sock_fd.fd,
-          src->fdset, outbuf);
+          src->fdset, &src->read_pool, outbuf);
       break;
 
     case GST_TCP_PROTOCOL_GDP:
@@ -258,6 +558,7 @@ restart:
         GST_BUFFER_OFFSET (*outbuf), GST_BUFFER_OFFSET_END (*outbuf));
   }
 
+done:
   return ret;
 
 wrong_state:
@@ -319,6 +620,9 @@ gst_tcp_server_src_set_property (GObject * object, guint prop_id,
     case PROP_PROTOCOL:
       tcpserversrc->protocol = g_value_get_enum (value);
       break;
+    case PROP_MAX_CLIENTS:
+      tcpserversrc->max_clients = g_value_get_uint (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -342,6 +646,9 @@ gst_tcp_server_src_get_property (GObject * object, guint prop_id,
     case PROP_PROTOCOL:
       g_value_set_enum (value, tcpserversrc->protocol);
       break;
+    case PROP_MAX_CLIENTS:
+      g_value_set_uint (value, tcpserversrc->max_clients);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -354,6 +661,7 @@ static gboolean
 gst_tcp_server_src_start (GstBaseSrc * bsrc)
 {
   int ret;
+  int backlog;
   GstTCPServerSrc *src = GST_TCP_SERVER_SRC (bsrc);
 
   /* reset caps_received flag */
@@ -392,10 +700,13 @@ gst_tcp_server_src_start (GstBaseSrc * bsrc)
               sizeof (src->server_sin))) < 0)
     goto bind_error;
 
+  /* let the clients queue up when we accept more than one */
+  backlog = MAX (MIN ((gint) src->max_clients, SOMAXCONN), TCP_BACKLOG);
+
   GST_DEBUG_OBJECT (src, "listening on server socket %d with queue of %d",
-      src->server_sock_fd.fd, TCP_BACKLOG);
+      src->server_sock_fd.fd, backlog);
 
-  if (listen (src->server_sock_fd.fd, TCP_BACKLOG) == -1)
+  if (listen (src->server_sock_fd.fd, backlog) == -1)
     goto listen_error;
 
   /* create an fdset to keep track of our file descriptors */
@@ -459,12 +770,26 @@ static gboolean
 gst_tcp_server_src_stop (GstBaseSrc * bsrc)
 {
   GstTCPServerSrc *src = GST_TCP_SERVER_SRC (bsrc);
+  GList *clients;
+
+  GST_OBJECT_LOCK (src);
+  clients = src->clients;
+  src->clients = NULL;
+  src->n_clients = 0;
+  GST_OBJECT_UNLOCK (src);
+
+  g_list_foreach (clients, (GFunc) gst_tcp_server_src_client_free, NULL);
+  g_list_free (clients);
+
+  g_queue_foreach (src->pending, (GFunc) gst_mini_object_unref, NULL);
+  g_queue_clear (src->pending);
 
   gst_poll_free (src->fdset);
   src->fdset = NULL;
 
   gst_tcp_socket_close (&src->server_sock_fd);
   gst_tcp_socket_close (&src->client_sock_fd);
+  gst_tcp_read_pool_clear (&src->read_pool);
 
   GST_OBJECT_FLAG_UNSET (src, GST_TCP_SERVER_SRC_OPEN);
 
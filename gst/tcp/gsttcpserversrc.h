@@ -52,6 +52,17 @@ G_END_DECLS
 typedef struct _GstTCPServerSrc GstTCPServerSrc;
 typedef struct _GstTCPServerSrcClass GstTCPServerSrcClass;
 
+/* a connected client when accepting more than one client
+ */
+typedef struct {
+  GstPollFD fd;                 /* the non-blocking client socket */
+  struct sockaddr_in sin;
+
+  GstTCPReadPool read_pool;     /* chunks for reading data */
+  GstAdapter *adapter;          /* GDP data that is not a complete packet yet */
+  GstCaps *caps;                /* caps received through GDP */
+} GstTCPServerSrcClient;
+
 typedef enum {
   GST_TCP_SERVER_SRC_OPEN       = (GST_ELEMENT_FLAG_LAST << 0),
 
@@ -73,9 +84,17 @@ struct _GstTCPServerSrc {
   GstPollFD client_sock_fd;
 
   GstPoll *fdset;
+  GstTCPReadPool read_pool;     /* chunks for reading raw data */
 
   GstTCPProtocol protocol; /* protocol used for reading data */
   gboolean caps_received;      /* if we have received caps yet */
+
+  guint max_clients;           /* max number of simultaneous clients */
+  GList *clients;              /* the clients when max_clients > 1, protected
+                                * with the object lock */
+  guint n_clients;
+  GQueue *pending;             /* buffers read from the clients, not pushed
+                                * yet */
 };
 
 struct _GstTCPServerSrcClass {
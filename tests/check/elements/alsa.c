@@ -118,6 +118,67 @@ GST_START_TEST (test_alsa_mixer_track)
 
 GST_END_TEST;
 
+/* run @src ! @sink until EOS, skips the test when the device can't be opened.
+ * The "null" device discards what is played and captures silence, but it
+ * goes through the same mmap calls as a real device. */
+static void
+run_mmap_pipeline (GstElement * src, GstElement * sink)
+{
+  GstStateChangeReturn state_ret;
+  GstElement *pipeline;
+  GstMessage *msg;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  gst_bin_add_many (GST_BIN (pipeline), src, sink, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  state_ret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  if (state_ret == GST_STATE_CHANGE_FAILURE) {
+    GST_WARNING ("could not open the null device, skipping");
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+    return;
+  }
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      10 * GST_SECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "no EOS after 10 seconds");
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS,
+      "got %s instead of EOS", GST_MESSAGE_TYPE_NAME (msg));
+  gst_message_unref (msg);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+}
+
+GST_START_TEST (test_alsa_mmap)
+{
+  GstElement *src, *sink;
+  gboolean mmap;
+
+  src = gst_element_factory_make ("audiotestsrc", NULL);
+  fail_unless (src != NULL, "Failed to create 'audiotestsrc' element!");
+  g_object_set (src, "num-buffers", 20, NULL);
+  sink = gst_element_factory_make ("alsasink", NULL);
+  fail_unless (sink != NULL, "Failed to create 'alsasink' element!");
+  g_object_set (sink, "device", "null", "mmap", TRUE, NULL);
+  g_object_get (sink, "mmap", &mmap, NULL);
+  fail_unless (mmap);
+  run_mmap_pipeline (src, sink);
+
+  src = gst_element_factory_make ("alsasrc", NULL);
+  fail_unless (src != NULL, "Failed to create 'alsasrc' element!");
+  g_object_set (src, "device", "null", "mmap", TRUE, "num-buffers", 20, NULL);
+  g_object_get (src, "mmap", &mmap, NULL);
+  fail_unless (mmap);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (sink != NULL, "Failed to create 'fakesink' element!");
+  run_mmap_pipeline (src, sink);
+}
+
+GST_END_TEST;
+
 static Suite *
 alsa_suite (void)
 {
@@ -127,6 +188,7 @@ alsa_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_device_property_probe);
   tcase_add_test (tc_chain, test_alsa_mixer_track);
+  tcase_add_test (tc_chain, test_alsa_mmap);
 
   return s;
 }
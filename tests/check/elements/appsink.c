@@ -317,6 +317,300 @@ GST_START_TEST (test_buffer_list)
 
 GST_END_TEST;
 
+static GstBuffer *
+create_int_buffer (gint value)
+{
+  GstBuffer *buffer;
+  GstCaps *caps;
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  buffer = gst_buffer_new_and_alloc (sizeof (gint));
+  *(gint *) GST_BUFFER_DATA (buffer) = value;
+  gst_buffer_set_caps (buffer, caps);
+  gst_caps_unref (caps);
+
+  return buffer;
+}
+
+static void
+check_next_group (GstBufferListIterator * it, guint n_values,
+    const gint * values)
+{
+  GstBuffer *buf;
+  guint i;
+
+  fail_unless (gst_buffer_list_iterator_next_group (it));
+  fail_unless_equals_int (gst_buffer_list_iterator_n_buffers (it), n_values);
+  for (i = 0; i < n_values; i++) {
+    buf = gst_buffer_list_iterator_next (it);
+    fail_if (buf == NULL);
+    fail_unless_equals_int (*(gint *) GST_BUFFER_DATA (buf), values[i]);
+  }
+}
+
+/* Verifies that gst_app_sink_pull_buffers() takes everything queued, up to
+ * the given maximum, and keeps the groups of rendered lists intact */
+GST_START_TEST (test_pull_buffers)
+{
+  static const gint first[] = { 8 }, second[] = { 1 }, third[] = { 2, 4 },
+      last[] = { 16 };
+  GstElement *sink;
+  GstBufferList *list;
+  GstBufferListIterator *it;
+
+  sink = setup_appsink ();
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (8)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_list (mysrcpad,
+          create_buffer_list ()) == GST_FLOW_OK);
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (16)) == GST_FLOW_OK);
+  gst_caps_unref (mycaps);
+
+  /* the buffer and the list, the list keeps its groups */
+  list = gst_app_sink_pull_buffers (GST_APP_SINK (sink), 2, 0);
+  fail_unless (GST_IS_BUFFER_LIST (list));
+  fail_unless_equals_int (gst_buffer_list_n_groups (list), 3);
+  it = gst_buffer_list_iterate (list);
+  check_next_group (it, G_N_ELEMENTS (first), first);
+  check_next_group (it, G_N_ELEMENTS (second), second);
+  check_next_group (it, G_N_ELEMENTS (third), third);
+  fail_if (gst_buffer_list_iterator_next_group (it));
+  gst_buffer_list_iterator_free (it);
+  gst_buffer_list_unref (list);
+
+  /* the remaining buffer */
+  list = gst_app_sink_pull_buffers (GST_APP_SINK (sink), 0, 0);
+  fail_unless (GST_IS_BUFFER_LIST (list));
+  it = gst_buffer_list_iterate (list);
+  check_next_group (it, G_N_ELEMENTS (last), last);
+  fail_if (gst_buffer_list_iterator_next_group (it));
+  gst_buffer_list_iterator_free (it);
+  gst_buffer_list_unref (list);
+
+  /* nothing left, times out */
+  list = gst_app_sink_pull_buffers (GST_APP_SINK (sink), 0, 10 * GST_MSECOND);
+  fail_unless (list == NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_appsink (sink);
+}
+
+GST_END_TEST;
+
+static GMutex *async_mutex;
+static GCond *async_cond;
+static GThread *streaming_thread;
+static GList *async_values;
+static gboolean async_eos;
+static gboolean async_blocked;
+static gboolean async_gate;
+
+static void
+setup_async (void)
+{
+  async_mutex = g_mutex_new ();
+  async_cond = g_cond_new ();
+  async_values = NULL;
+  async_eos = FALSE;
+  async_blocked = FALSE;
+  async_gate = TRUE;
+  streaming_thread = g_thread_self ();
+}
+
+static void
+cleanup_async (void)
+{
+  g_list_free (async_values);
+  g_cond_free (async_cond);
+  g_mutex_free (async_mutex);
+}
+
+static GstFlowReturn
+async_new_buffer (GstAppSink * appsink, gpointer user_data)
+{
+  GstBuffer *buffer;
+
+  fail_if (g_thread_self () == streaming_thread);
+
+  buffer = gst_app_sink_pull_buffer (appsink);
+  fail_unless (buffer != NULL);
+
+  g_mutex_lock (async_mutex);
+  async_values = g_list_append (async_values,
+      GINT_TO_POINTER (*(gint *) GST_BUFFER_DATA (buffer)));
+  /* block on the gate until the test opens it */
+  async_blocked = TRUE;
+  g_cond_broadcast (async_cond);
+  while (!async_gate)
+    g_cond_wait (async_cond, async_mutex);
+  async_blocked = FALSE;
+  g_mutex_unlock (async_mutex);
+
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+async_eos_callback (GstAppSink * appsink, gpointer user_data)
+{
+  fail_if (g_thread_self () == streaming_thread);
+
+  g_mutex_lock (async_mutex);
+  async_eos = TRUE;
+  g_cond_broadcast (async_cond);
+  g_mutex_unlock (async_mutex);
+}
+
+static GstElement *
+setup_async_appsink (void)
+{
+  GstElement *sink;
+  GstAppSinkCallbacks callbacks = { NULL };
+
+  setup_async ();
+  sink = setup_appsink ();
+
+  callbacks.new_buffer = async_new_buffer;
+  callbacks.eos = async_eos_callback;
+  gst_app_sink_set_callbacks (GST_APP_SINK (sink), &callbacks, NULL, NULL);
+  g_object_set (sink, "async-callbacks", TRUE, NULL);
+
+  return sink;
+}
+
+static void
+check_async_values (guint n_values, const gint * values)
+{
+  GList *walk;
+  guint i;
+
+  /* wait for the eos callback, it comes after all buffer callbacks */
+  g_mutex_lock (async_mutex);
+  while (!async_eos)
+    g_cond_wait (async_cond, async_mutex);
+  g_mutex_unlock (async_mutex);
+
+  fail_unless_equals_int (g_list_length (async_values), n_values);
+  for (walk = async_values, i = 0; walk; walk = walk->next, i++)
+    fail_unless_equals_int (GPOINTER_TO_INT (walk->data), values[i]);
+}
+
+/* Verifies that asynchronous callbacks are not called from the streaming
+ * thread and keep their order */
+GST_START_TEST (test_async_callbacks)
+{
+  static const gint values[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  GstElement *sink;
+  guint i;
+
+  sink = setup_async_appsink ();
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  for (i = 0; i < G_N_ELEMENTS (values); i++)
+    fail_unless (gst_pad_push (mysrcpad,
+            create_int_buffer (values[i])) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  check_async_values (G_N_ELEMENTS (values), values);
+
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_appsink (sink);
+  cleanup_async ();
+}
+
+GST_END_TEST;
+
+/* Verifies that the oldest unannounced buffer is dropped when the callbacks
+ * fall behind */
+GST_START_TEST (test_async_callbacks_drop_old)
+{
+  static const gint values[] = { 1, 3 };
+  GstElement *sink;
+
+  sink = setup_async_appsink ();
+  g_object_set (sink, "max-pending-callbacks", 1, "callback-drop",
+      GST_APP_SINK_CALLBACK_DROP_OLD, NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  /* the callback for the first buffer blocks */
+  async_gate = FALSE;
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (1)) == GST_FLOW_OK);
+  g_mutex_lock (async_mutex);
+  while (!async_blocked)
+    g_cond_wait (async_cond, async_mutex);
+  g_mutex_unlock (async_mutex);
+
+  /* 2 is pending and gets replaced by 3 */
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (2)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (3)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  g_mutex_lock (async_mutex);
+  async_gate = TRUE;
+  g_cond_broadcast (async_cond);
+  g_mutex_unlock (async_mutex);
+
+  check_async_values (G_N_ELEMENTS (values), values);
+
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_appsink (sink);
+  cleanup_async ();
+}
+
+GST_END_TEST;
+
+/* Verifies that dropping a notification for a buffer the application already
+ * pulled doesn't drop another buffer */
+GST_START_TEST (test_async_callbacks_drop_pulled)
+{
+  static const gint values[] = { 1, 3, 4 };
+  GstElement *sink;
+  GstBuffer *buffer;
+
+  sink = setup_async_appsink ();
+  g_object_set (sink, "max-pending-callbacks", 2, "callback-drop",
+      GST_APP_SINK_CALLBACK_DROP_OLD, NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  /* the callback for the first buffer blocks */
+  async_gate = FALSE;
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (1)) == GST_FLOW_OK);
+  g_mutex_lock (async_mutex);
+  while (!async_blocked)
+    g_cond_wait (async_cond, async_mutex);
+  g_mutex_unlock (async_mutex);
+
+  /* 2 and 3 are pending, 2 is pulled before its callback runs */
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (2)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (3)) == GST_FLOW_OK);
+  buffer = gst_app_sink_pull_buffer (GST_APP_SINK (sink));
+  fail_unless_equals_int (*(gint *) GST_BUFFER_DATA (buffer), 2);
+  gst_buffer_unref (buffer);
+
+  /* only the notification for 2 is dropped, 3 stays queued */
+  fail_unless (gst_pad_push (mysrcpad, create_int_buffer (4)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  g_mutex_lock (async_mutex);
+  async_gate = TRUE;
+  g_cond_broadcast (async_cond);
+  g_mutex_unlock (async_mutex);
+
+  check_async_values (G_N_ELEMENTS (values), values);
+
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_appsink (sink);
+  cleanup_async ();
+}
+
+GST_END_TEST;
+
 static Suite *
 appsink_suite (void)
 {
@@ -329,6 +623,10 @@ appsink_suite (void)
   tcase_add_test (tc_chain, test_notify0);
   tcase_add_test (tc_chain, test_notify1);
   tcase_add_test (tc_chain, test_buffer_list);
+  tcase_add_test (tc_chain, test_pull_buffers);
+  tcase_add_test (tc_chain, test_async_callbacks);
+  tcase_add_test (tc_chain, test_async_callbacks_drop_old);
+  tcase_add_test (tc_chain, test_async_callbacks_drop_pulled);
 
   return s;
 }
@@ -0,0 +1,297 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/app/gstappsrc.h>
+
+static GstPad *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-gst-check")
+    );
+
+static GstElement *
+setup_appsrc (void)
+{
+  GstElement *appsrc;
+  GstCaps *caps;
+
+  GST_DEBUG ("setup_appsrc");
+  appsrc = gst_check_setup_element ("appsrc");
+  mysinkpad = gst_check_setup_sink_pad (appsrc, &sinktemplate, NULL);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  g_object_set (appsrc, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  return appsrc;
+}
+
+static void
+cleanup_appsrc (GstElement * appsrc)
+{
+  GST_DEBUG ("cleanup_appsrc");
+
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_sink_pad (appsrc);
+  gst_check_teardown_element (appsrc);
+}
+
+static void
+wait_for_buffers (guint n)
+{
+  g_mutex_lock (check_mutex);
+  while (g_list_length (buffers) < n)
+    g_cond_wait (check_cond, check_mutex);
+  g_mutex_unlock (check_mutex);
+}
+
+static void
+push_buffer_list (gboolean lock_free)
+{
+  GstElement *src;
+  GstBufferList *list;
+  GstBufferListIterator *it;
+  GstBuffer *buffer;
+  guint i;
+
+  src = setup_appsrc ();
+  g_object_set (src, "lock-free", lock_free, NULL);
+
+  ASSERT_SET_STATE (src, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  /* two groups, three buffers, queued as one unit */
+  list = gst_buffer_list_new ();
+  it = gst_buffer_list_iterate (list);
+  for (i = 0; i < 3; i++) {
+    if (i != 1)
+      gst_buffer_list_iterator_add_group (it);
+    buffer = gst_buffer_new_and_alloc (i + 1);
+    GST_BUFFER_DATA (buffer)[0] = i;
+    gst_buffer_list_iterator_add (it, buffer);
+  }
+  gst_buffer_list_iterator_free (it);
+
+  fail_unless (gst_app_src_push_buffer_list (GST_APP_SRC (src), list) ==
+      GST_FLOW_OK);
+
+  /* a plain buffer after the list */
+  buffer = gst_buffer_new_and_alloc (4);
+  GST_BUFFER_DATA (buffer)[0] = 3;
+  fail_unless (gst_app_src_push_buffer (GST_APP_SRC (src), buffer) ==
+      GST_FLOW_OK);
+
+  wait_for_buffers (4);
+
+  /* all buffers arrive in order with the caps of appsrc */
+  for (i = 0; i < 4; i++) {
+    buffer = GST_BUFFER_CAST (g_list_nth_data (buffers, i));
+    fail_unless_equals_int (GST_BUFFER_DATA (buffer)[0], i);
+    fail_unless_equals_int (GST_BUFFER_SIZE (buffer), i + 1);
+    fail_unless (GST_BUFFER_CAPS (buffer) != NULL);
+  }
+
+  ASSERT_SET_STATE (src, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_check_drop_buffers ();
+  cleanup_appsrc (src);
+}
+
+GST_START_TEST (test_push_buffer_list)
+{
+  push_buffer_list (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_buffer_list_lock_free)
+{
+  push_buffer_list (TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_lock_free_block)
+{
+  GstElement *src;
+  GstBuffer *buffer;
+  guint i;
+
+  src = setup_appsrc ();
+  /* room for two buffers before push-buffer blocks */
+  g_object_set (src, "lock-free", TRUE, "block", TRUE, "max-bytes",
+      (guint64) 8, NULL);
+
+  ASSERT_SET_STATE (src, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < 100; i++) {
+    buffer = gst_buffer_new_and_alloc (4);
+    GST_BUFFER_DATA (buffer)[0] = i;
+    fail_unless (gst_app_src_push_buffer (GST_APP_SRC (src), buffer) ==
+        GST_FLOW_OK);
+  }
+
+  wait_for_buffers (100);
+
+  for (i = 0; i < 100; i++) {
+    buffer = GST_BUFFER_CAST (g_list_nth_data (buffers, i));
+    fail_unless_equals_int (GST_BUFFER_DATA (buffer)[0], i);
+  }
+
+  ASSERT_SET_STATE (src, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_check_drop_buffers ();
+  cleanup_appsrc (src);
+}
+
+GST_END_TEST;
+
+#define RA_SIZE (4 * 4096)
+
+static guint64 ra_position;
+static guint ra_seeks;
+static guint ra_need_data;
+
+static void
+ra_need_data_cb (GstAppSrc * src, guint length, gpointer user_data)
+{
+  GstBuffer *buffer;
+  guint i;
+
+  ra_need_data++;
+
+  length = MIN (length, RA_SIZE - ra_position);
+  buffer = gst_buffer_new_and_alloc (length);
+  for (i = 0; i < length; i++)
+    GST_BUFFER_DATA (buffer)[i] = (ra_position + i) % 251;
+  ra_position += length;
+
+  fail_unless (gst_app_src_push_buffer (src, buffer) == GST_FLOW_OK);
+}
+
+static gboolean
+ra_seek_data_cb (GstAppSrc * src, guint64 offset, gpointer user_data)
+{
+  ra_seeks++;
+  ra_position = offset;
+
+  return TRUE;
+}
+
+static void
+ra_get_range (GstPad * pad, guint64 offset, guint size)
+{
+  GstBuffer *buffer = NULL;
+  guint i;
+
+  fail_unless (gst_pad_get_range (pad, offset, size, &buffer) == GST_FLOW_OK);
+  fail_unless (buffer != NULL);
+  fail_unless_equals_int (GST_BUFFER_SIZE (buffer), size);
+  for (i = 0; i < size; i++)
+    fail_unless_equals_int (GST_BUFFER_DATA (buffer)[i], (offset + i) % 251);
+  gst_buffer_unref (buffer);
+}
+
+static void
+random_access_cache (guint64 cache_size, gboolean temp_file)
+{
+  GstElement *src;
+  GstPad *srcpad;
+  GstAppSrcCallbacks callbacks = { NULL };
+
+  ra_position = 0;
+  ra_seeks = 0;
+  ra_need_data = 0;
+
+  src = gst_check_setup_element ("appsrc");
+  g_object_set (src, "stream-type", GST_APP_STREAM_TYPE_RANDOM_ACCESS,
+      "size", (gint64) RA_SIZE, "cache-size", cache_size,
+      "cache-block-size", 4096, "cache-temp-file", temp_file, NULL);
+  callbacks.need_data = ra_need_data_cb;
+  callbacks.seek_data = ra_seek_data_cb;
+  gst_app_src_set_callbacks (GST_APP_SRC (src), &callbacks, NULL, NULL);
+
+  ASSERT_SET_STATE (src, GST_STATE_READY, GST_STATE_CHANGE_SUCCESS);
+  srcpad = gst_element_get_static_pad (src, "src");
+  fail_unless (gst_pad_activate_pull (srcpad, TRUE));
+
+  /* the start and the end of the stream come from the application */
+  ra_get_range (srcpad, 0, 4096);
+  ra_get_range (srcpad, 3 * 4096, 4096);
+  fail_unless_equals_int (ra_seeks, 2);
+  fail_unless_equals_int (ra_need_data, 2);
+
+  /* repeated and overlapping reads are served from the cache */
+  ra_get_range (srcpad, 0, 4096);
+  ra_get_range (srcpad, 1000, 2000);
+  ra_get_range (srcpad, 3 * 4096 + 100, 500);
+  fail_unless_equals_int (ra_seeks, 2);
+  fail_unless_equals_int (ra_need_data, 2);
+
+  /* a range that is only partly cached goes to the application */
+  ra_get_range (srcpad, 4000, 200);
+  fail_unless_equals_int (ra_seeks, 3);
+  fail_unless_equals_int (ra_need_data, 3);
+
+  fail_unless (gst_pad_activate_pull (srcpad, FALSE));
+  gst_object_unref (srcpad);
+  ASSERT_SET_STATE (src, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_check_teardown_element (src);
+}
+
+GST_START_TEST (test_random_access_cache)
+{
+  random_access_cache (64 * 1024, FALSE);
+}
+
+GST_END_TEST;
+
+/* the cache only allocates what it uses */
+GST_START_TEST (test_random_access_cache_unlimited)
+{
+  random_access_cache (G_MAXUINT64, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_random_access_cache_temp_file)
+{
+  random_access_cache (64 * 1024, TRUE);
+}
+
+GST_END_TEST;
+
+static Suite *
+appsrc_suite (void)
+{
+  Suite *s = suite_create ("appsrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_push_buffer_list);
+  tcase_add_test (tc_chain, test_push_buffer_list_lock_free);
+  tcase_add_test (tc_chain, test_lock_free_block);
+  tcase_add_test (tc_chain, test_random_access_cache);
+  tcase_add_test (tc_chain, test_random_access_cache_unlimited);
+  tcase_add_test (tc_chain, test_random_access_cache_temp_file);
+
+  return s;
+}
+
+GST_CHECK_MAIN (appsrc);
@@ -644,6 +644,25 @@ GST_START_TEST (test_int_conversion)
             24, TRUE), in, get_int_caps (1, "BYTE_ORDER", 8, 8, TRUE)
         );
   }
+  /* 24 signed -> 32 signed */
+  {
+    guint8 in_le[] = { 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0xff, 0xff, 0x7f,
+      0x00, 0x00, 0x80, 0xff, 0xff, 0xff
+    };
+    guint8 in_be[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x7f, 0xff, 0xff,
+      0x80, 0x00, 0x00, 0xff, 0xff, 0xff
+    };
+    gint32 out[] = { 0, 1 << 8, 0x7fffff00, G_MININT32, -(1 << 8) };
+
+    RUN_CONVERSION ("24 signed LE to 32 signed", in_le,
+        get_int_caps (1, "LITTLE_ENDIAN", 24, 24, TRUE), out,
+        get_int_caps (1, "BYTE_ORDER", 32, 32, TRUE)
+        );
+    RUN_CONVERSION ("24 signed BE to 32 signed", in_be,
+        get_int_caps (1, "BIG_ENDIAN", 24, 24, TRUE), out,
+        get_int_caps (1, "BYTE_ORDER", 32, 32, TRUE)
+        );
+  }
 
   /* 16 bit signed <-> unsigned */
   {
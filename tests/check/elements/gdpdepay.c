@@ -258,6 +258,90 @@ GST_START_TEST (test_audio_in_one_buffer)
 
 GST_END_TEST;
 
+GST_START_TEST (test_payload_subbuffers)
+{
+  GstCaps *caps;
+  GstElement *gdpdepay;
+  GstBuffer *buffer, *inbuffer, *outbuffer;
+  guint8 *caps_header, *caps_payload, *buf_header;
+  guint header_len, payload_len;
+  guint i, n;
+  GstDPPacketizer *pk;
+
+  pk = gst_dp_packetizer_new (GST_DP_VERSION_1_0);
+
+  gdpdepay = setup_gdpdepay ();
+
+  fail_unless (gst_element_set_state (gdpdepay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* one incoming buffer with a caps packet and two buffer packets */
+  caps = gst_caps_from_string (AUDIO_CAPS_STRING);
+  fail_unless (pk->packet_from_caps (caps, 0, &header_len, &caps_header,
+          &caps_payload));
+  payload_len = gst_dp_header_payload_length (caps_header);
+
+  inbuffer = gst_buffer_new_and_alloc (3 * GST_DP_HEADER_LENGTH +
+      payload_len + 2 * 4);
+  memcpy (GST_BUFFER_DATA (inbuffer), caps_header, GST_DP_HEADER_LENGTH);
+  i = GST_DP_HEADER_LENGTH;
+  memcpy (GST_BUFFER_DATA (inbuffer) + i, caps_payload, payload_len);
+  i += payload_len;
+
+  for (n = 0; n < 2; n++) {
+    buffer = gst_buffer_new_and_alloc (4);
+    memcpy (GST_BUFFER_DATA (buffer), n ? "beef" : "f00d", 4);
+    GST_BUFFER_TIMESTAMP (buffer) = n * GST_SECOND;
+    fail_unless (pk->header_from_buffer (buffer, 0, &header_len,
+            &buf_header));
+    memcpy (GST_BUFFER_DATA (inbuffer) + i, buf_header, GST_DP_HEADER_LENGTH);
+    i += GST_DP_HEADER_LENGTH;
+    memcpy (GST_BUFFER_DATA (inbuffer) + i, GST_BUFFER_DATA (buffer), 4);
+    i += 4;
+    g_free (buf_header);
+    gst_buffer_unref (buffer);
+  }
+
+  gst_caps_unref (caps);
+  g_free (caps_header);
+  g_free (caps_payload);
+
+  /* keep a ref so we can check where the payloads point to */
+  gst_buffer_ref (inbuffer);
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+
+  /* both packets are pushed from the one chain call */
+  fail_unless_equals_int (g_list_length (buffers), 2);
+
+  for (n = 0; n < 2; n++) {
+    outbuffer = GST_BUFFER_CAST (g_list_nth_data (buffers, n));
+    fail_unless_equals_int (GST_BUFFER_SIZE (outbuffer), 4);
+    fail_unless (memcmp (GST_BUFFER_DATA (outbuffer), n ? "beef" : "f00d",
+            4) == 0);
+    fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer),
+        n * GST_SECOND);
+    /* the payload was not copied out of the incoming buffer */
+    fail_unless (GST_BUFFER_DATA (outbuffer) > GST_BUFFER_DATA (inbuffer));
+    fail_unless (GST_BUFFER_DATA (outbuffer) + 4 <=
+        GST_BUFFER_DATA (inbuffer) + GST_BUFFER_SIZE (inbuffer));
+  }
+
+  fail_unless (gst_element_set_state (gdpdepay,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+  gst_buffer_unref (inbuffer);
+  ASSERT_OBJECT_REFCOUNT (gdpdepay, "gdpdepay", 1);
+  cleanup_gdpdepay (gdpdepay);
+
+  gst_dp_packetizer_free (pk);
+}
+
+GST_END_TEST;
+
 static GstStaticPadTemplate shsinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -405,6 +489,7 @@ gdpdepay_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_audio_per_byte);
   tcase_add_test (tc_chain, test_audio_in_one_buffer);
+  tcase_add_test (tc_chain, test_payload_subbuffers);
   tcase_add_test (tc_chain, test_streamheader);
 
   return s;
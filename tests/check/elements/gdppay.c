@@ -546,6 +546,79 @@ GST_START_TEST (test_crc)
 
 GST_END_TEST;
 
+GST_START_TEST (test_buffer_list)
+{
+  GstCaps *caps;
+  GstElement *gdppay;
+  GstBuffer *inbuffer, *outbuffer;
+  GstEvent *event;
+  guint8 *payload;
+  guint16 crc_calculated, crc_read;
+  gint i;
+
+  gdppay = setup_gdppay ();
+  g_object_set (gdppay, "buffer-list", TRUE, "crc-header", TRUE,
+      "crc-payload", TRUE, NULL);
+
+  fail_unless (gst_element_set_state (gdppay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  event =
+      gst_event_new_new_segment (FALSE, 1.0, GST_FORMAT_TIME, 0, GST_SECOND, 0);
+  fail_unless (gst_pad_push_event (mysrcpad, event));
+
+  /* an odd size so the CRC also runs over a tail of less than 4 bytes */
+  inbuffer = gst_buffer_new_and_alloc (1027);
+  for (i = 0; i < 1027; i++)
+    GST_BUFFER_DATA (inbuffer)[i] = i * 7;
+  GST_BUFFER_TIMESTAMP (inbuffer) = GST_SECOND;
+  caps = gst_caps_from_string (AUDIO_CAPS_STRING);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_buffer_ref (inbuffer);
+
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+
+  /* new_segment, caps and our buffer */
+  fail_unless_equals_int (g_list_length (buffers), 3);
+
+  /* our sink pad has no chain_list function, so the group arrives merged */
+  outbuffer = GST_BUFFER_CAST (g_list_nth_data (buffers, 2));
+  fail_unless_equals_int (GST_BUFFER_SIZE (outbuffer),
+      GST_DP_HEADER_LENGTH + 1027);
+  fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer), GST_SECOND);
+  fail_unless_equals_uint64 (GST_BUFFER_OFFSET_END (outbuffer) -
+      GST_BUFFER_OFFSET (outbuffer), GST_DP_HEADER_LENGTH + 1027);
+
+  payload = GST_BUFFER_DATA (outbuffer) + GST_DP_HEADER_LENGTH;
+  fail_unless (memcmp (payload, GST_BUFFER_DATA (inbuffer), 1027) == 0);
+
+  /* both checksums must match what the dataprotocol library calculates */
+  crc_calculated = gst_dp_crc (GST_BUFFER_DATA (outbuffer), 58);
+  crc_read = GST_READ_UINT16_BE (GST_BUFFER_DATA (outbuffer) + 58);
+  fail_unless_equals_int (crc_calculated, crc_read);
+  crc_calculated = gst_dp_crc (payload, 1027);
+  crc_read = GST_READ_UINT16_BE (GST_BUFFER_DATA (outbuffer) + 60);
+  fail_unless_equals_int (crc_calculated, crc_read);
+  fail_unless (gst_dp_validate_packet (GST_DP_HEADER_LENGTH,
+          GST_BUFFER_DATA (outbuffer), payload));
+
+  /* we kept a ref on the input to compare the payload */
+  gst_buffer_unref (inbuffer);
+
+  fail_unless (gst_element_set_state (gdppay,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+
+  gst_caps_unref (caps);
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+  ASSERT_OBJECT_REFCOUNT (gdppay, "gdppay", 1);
+  cleanup_gdppay (gdppay);
+}
+
+GST_END_TEST;
+
 
 static Suite *
 gdppay_suite (void)
@@ -559,6 +632,7 @@ gdppay_suite (void)
   tcase_add_test (tc_chain, test_first_no_new_segment);
   tcase_add_test (tc_chain, test_streamheader);
   tcase_add_test (tc_chain, test_crc);
+  tcase_add_test (tc_chain, test_buffer_list);
 
   return s;
 }
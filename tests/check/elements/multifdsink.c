@@ -20,6 +20,7 @@
 
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #ifdef HAVE_FIONREAD_IN_SYS_FILIO
 #include <sys/filio.h>
 #endif
@@ -545,6 +546,69 @@ GST_START_TEST (test_burst_client_bytes)
 
 GST_END_TEST;
 
+/* burst 128 bytes to a client and check that the data arrives in order when
+ * it is written out in batches of 3 buffers */
+GST_START_TEST (test_burst_client_batched)
+{
+  GstElement *sink;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  int pfd[2];
+  gchar data[16];
+  gchar expected[17];
+  gint i;
+
+  sink = setup_multifdsink ();
+  /* make sure we keep at least 200 bytes at all times */
+  g_object_set (sink, "bytes-min", 200, NULL);
+  g_object_set (sink, "sync-method", 3, NULL);  /* 3 = burst */
+  g_object_set (sink, "burst-unit", 3, NULL);   /* 3 = bytes */
+  g_object_set (sink, "burst-value", (guint64) 128, NULL);
+  g_object_set (sink, "max-iovecs", 3, NULL);
+
+  fail_if (pipe (pfd) == -1);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+
+  /* push buffers in, 10 * 16 bytes = 160 bytes */
+  for (i = 0; i < 10; i++) {
+    gchar *bdata;
+
+    /* add the client before the last buffer to make it ready for reading */
+    if (i == 9)
+      g_signal_emit_by_name (sink, "add", pfd[1]);
+
+    buffer = gst_buffer_new_and_alloc (16);
+    gst_buffer_set_caps (buffer, caps);
+
+    /* copy some id */
+    bdata = (gchar *) GST_BUFFER_DATA (buffer);
+    g_snprintf (bdata, 16, "deadbee%08x", i);
+
+    fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  }
+
+  /* we should read the last 8 buffers (8 * 16 = 128 bytes) in order */
+  GST_DEBUG ("Reading from client");
+  for (i = 2; i < 10; i++) {
+    g_snprintf (expected, 17, "deadbee%08x", i);
+    fail_if (read (pfd[0], data, 16) < 16);
+    fail_unless (strncmp (data, expected, 16) == 0);
+  }
+  wait_bytes_served (sink, 16 * 8);
+
+  GST_DEBUG ("cleaning up multifdsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_multifdsink (sink);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
 /* keep 100 bytes and burst 80 bytes to clients */
 GST_START_TEST (test_burst_client_bytes_keyframe)
 {
@@ -838,6 +902,353 @@ GST_START_TEST (test_client_next_keyframe)
 
 GST_END_TEST;
 
+/* push buffers with ids @from up to @to, every @interval-th one is a
+ * keyframe */
+static void
+push_keyframe_buffers (GstCaps * caps, gint from, gint to, gint interval)
+{
+  GstBuffer *buffer;
+  gint i;
+
+  for (i = from; i < to; i++) {
+    gchar *data;
+
+    buffer = gst_buffer_new_and_alloc (16);
+    gst_buffer_set_caps (buffer, caps);
+
+    if (i % interval != 0)
+      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    /* copy some id */
+    data = (gchar *) GST_BUFFER_DATA (buffer);
+    g_snprintf (data, 16, "deadbee%08x", i);
+
+    fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  }
+}
+
+static void
+fail_unless_read_ids (int fd, gint from, gint to)
+{
+  gchar data[16], expected[16];
+  gint i;
+
+  for (i = from; i < to; i++) {
+    g_snprintf (expected, 16, "deadbee%08x", i);
+    fail_if (read (fd, data, 16) < 16);
+    fail_unless (strncmp (data, expected, 16) == 0,
+        "expected %s, got %.16s", expected, data);
+  }
+}
+
+/* the queue wraps around and grows and the oldest keyframes are dropped
+ * from the index, the client must still start at the latest keyframe */
+GST_START_TEST (test_client_latest_keyframe_wrapped)
+{
+  GstElement *sink;
+  GstCaps *caps;
+  int pfd1[2];
+  guint buffers_queued;
+
+  sink = setup_multifdsink ();
+  /* keep 70 buffers, more than fit in the initial queue */
+  g_object_set (sink, "bytes-min", 70 * 16, NULL);
+  g_object_set (sink, "sync-method", 2, NULL);  /* 2 = latest-keyframe */
+
+  fail_if (pipe (pfd1) == -1);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  GST_DEBUG ("Created test caps %p %" GST_PTR_FORMAT, caps, caps);
+
+  /* a keyframe every 3 buffers, the last one is 201 */
+  push_keyframe_buffers (caps, 0, 203, 3);
+
+  g_object_get (sink, "buffers-queued", &buffers_queued, NULL);
+  fail_if (buffers_queued < 70);
+
+  g_signal_emit_by_name (sink, "add", pfd1[1]);
+
+  /* push a delta buffer to make the client fd ready for reading */
+  push_keyframe_buffers (caps, 203, 204, 3);
+
+  GST_DEBUG ("Reading from client 1");
+  fail_unless_read_ids (pfd1[0], 201, 204);
+
+  /* later keyframes still get served in order */
+  push_keyframe_buffers (caps, 204, 300, 3);
+  fail_unless_read_ids (pfd1[0], 204, 300);
+
+  GST_DEBUG ("cleaning up multifdsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_multifdsink (sink);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+/* like test_burst_client_bytes_keyframe but after the queue wrapped around,
+ * grew and compacted its keyframe index */
+GST_START_TEST (test_burst_client_keyframe_wrapped)
+{
+  GstElement *sink;
+  GstCaps *caps;
+  int pfd1[2];
+  int pfd2[2];
+  int pfd3[2];
+  guint buffers_queued;
+
+  sink = setup_multifdsink ();
+  /* keep 70 buffers, more than fit in the initial queue */
+  g_object_set (sink, "bytes-min", 70 * 16, NULL);
+  g_object_set (sink, "sync-method", 4, NULL);  /* 4 = burst-keyframe */
+  g_object_set (sink, "burst-unit", 3, NULL);   /* 3 = bytes */
+  g_object_set (sink, "burst-value", (guint64) 80, NULL);
+
+  fail_if (pipe (pfd1) == -1);
+  fail_if (pipe (pfd2) == -1);
+  fail_if (pipe (pfd3) == -1);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  GST_DEBUG ("Created test caps %p %" GST_PTR_FORMAT, caps, caps);
+
+  /* a keyframe every 3 buffers: ..., 195, 198, 201 */
+  push_keyframe_buffers (caps, 0, 203, 3);
+
+  g_object_get (sink, "buffers-queued", &buffers_queued, NULL);
+  fail_if (buffers_queued < 70);
+
+  g_signal_emit_by_name (sink, "add", pfd1[1]);
+  g_signal_emit_by_name (sink, "add_full", pfd2[1], 4,
+      3, (guint64) 50, 3, (guint64) 50);
+  g_signal_emit_by_name (sink, "add_full", pfd3[1], 4,
+      3, (guint64) 160, 3, (guint64) 200);
+
+  /* push a delta buffer to make the client fds ready for reading */
+  push_keyframe_buffers (caps, 203, 204, 3);
+
+  /* 80 bytes is 5 buffers back to 199, the first keyframe before that is
+   * 198 */
+  GST_DEBUG ("Reading from client 1");
+  fail_unless_read_ids (pfd1[0], 198, 204);
+
+  /* 50 bytes is 4 buffers back to 200, keyframe 198 is above the max so we
+   * get the one after min */
+  GST_DEBUG ("Reading from client 2");
+  fail_unless_read_ids (pfd2[0], 201, 204);
+
+  /* 160 bytes is 10 buffers back to 194, the keyframe before that is 192 */
+  GST_DEBUG ("Reading from client 3");
+  fail_unless_read_ids (pfd3[0], 192, 204);
+
+  GST_DEBUG ("cleaning up multifdsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_multifdsink (sink);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+/* serve two clients from two I/O threads */
+GST_START_TEST (test_io_threads)
+{
+  GstElement *sink;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  GValueArray *stats;
+  int pfd1[2];
+  int pfd2[2];
+  gchar data[4];
+  gint i;
+
+  sink = setup_multifdsink ();
+  g_object_set (sink, "io-threads", 2, NULL);
+
+  fail_if (pipe (pfd1) == -1);
+  fail_if (pipe (pfd2) == -1);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  /* add the clients, they should end up in different threads */
+  g_signal_emit_by_name (sink, "add", pfd1[1]);
+  g_signal_emit_by_name (sink, "add", pfd2[1]);
+
+  for (i = 0; i < 2; i++) {
+    g_signal_emit_by_name (sink, "get-shard-stats", i, &stats);
+    fail_unless_equals_int (stats->n_values, 3);
+    fail_unless (g_value_get_uint64 (g_value_array_get_nth (stats, 0)) == 1);
+    g_value_array_free (stats);
+  }
+  /* out of range */
+  g_signal_emit_by_name (sink, "get-shard-stats", 2, &stats);
+  fail_unless_equals_int (stats->n_values, 0);
+  g_value_array_free (stats);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  buffer = gst_buffer_new_and_alloc (4);
+  gst_buffer_set_caps (buffer, caps);
+  memcpy (GST_BUFFER_DATA (buffer), "dead", 4);
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+
+  GST_DEBUG ("reading");
+  fail_if (read (pfd1[0], data, 4) < 4);
+  fail_unless (strncmp (data, "dead", 4) == 0);
+  fail_if (read (pfd2[0], data, 4) < 4);
+  fail_unless (strncmp (data, "dead", 4) == 0);
+  wait_bytes_served (sink, 8);
+
+  GST_DEBUG ("cleaning up multifdsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_multifdsink (sink);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+/* unix sockets don't support zerocopy, large buffers should be written
+ * with regular sends */
+GST_START_TEST (test_zerocopy_fallback)
+{
+  GstElement *sink;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  int sv[2];
+  guint8 *data;
+  gint i, size = 64 * 1024, got = 0;
+
+  sink = setup_multifdsink ();
+  g_object_set (sink, "zerocopy", TRUE, NULL);
+
+  fail_if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) == -1);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  g_signal_emit_by_name (sink, "add", sv[1]);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  buffer = gst_buffer_new_and_alloc (size);
+  gst_buffer_set_caps (buffer, caps);
+  for (i = 0; i < size; i++)
+    GST_BUFFER_DATA (buffer)[i] = i & 0xff;
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+
+  GST_DEBUG ("reading");
+  data = g_malloc (size);
+  while (got < size) {
+    gssize r = read (sv[0], data + got, size - got);
+
+    fail_if (r <= 0);
+    got += r;
+  }
+  for (i = 0; i < size; i++)
+    fail_unless (data[i] == (i & 0xff));
+  g_free (data);
+  wait_bytes_served (sink, size);
+
+  GST_DEBUG ("cleaning up multifdsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_multifdsink (sink);
+
+  close (sv[0]);
+  close (sv[1]);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+static guint64
+histogram_total (const GstStructure * s, const gchar * name)
+{
+  const GValue *hist;
+  guint64 total = 0;
+  guint i;
+
+  hist = gst_structure_get_value (s, name);
+  fail_unless (hist != NULL);
+  fail_unless_equals_int (gst_value_array_get_size (hist), 32);
+  for (i = 0; i < 32; i++)
+    total += g_value_get_uint64 (gst_value_array_get_value (hist, i));
+
+  return total;
+}
+
+GST_START_TEST (test_histograms)
+{
+  GstElement *sink;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  GstStructure *stats;
+  const GstStructure *cstats;
+  const GValue *clients;
+  int pfd[2];
+  gchar data[4];
+  guint nclients;
+  gint i, fd;
+
+  sink = setup_multifdsink ();
+
+  fail_if (pipe (pfd) == -1);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+
+  g_signal_emit_by_name (sink, "add", pfd[1]);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+  for (i = 0; i < 2; i++) {
+    buffer = gst_buffer_new_and_alloc (4);
+    gst_buffer_set_caps (buffer, caps);
+    memcpy (GST_BUFFER_DATA (buffer), "dead", 4);
+    fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  }
+
+  GST_DEBUG ("reading");
+  for (i = 0; i < 2; i++) {
+    fail_if (read (pfd[0], data, 4) < 4);
+    fail_unless (strncmp (data, "dead", 4) == 0);
+  }
+  wait_bytes_served (sink, 8);
+
+  g_signal_emit_by_name (sink, "get-histograms", &stats);
+  fail_unless (stats != NULL);
+  fail_unless (gst_structure_has_name (stats, "multifdsink-stats"));
+  fail_unless (gst_structure_get_uint (stats, "clients", &nclients));
+  fail_unless_equals_int (nclients, 1);
+
+  /* both buffers were taken from the queue once */
+  fail_unless (histogram_total (stats, "queue-depth") == 2);
+  fail_unless (histogram_total (stats, "queue-time") == 2);
+  fail_unless (histogram_total (stats, "write-size") >= 1);
+
+  clients = gst_structure_get_value (stats, "client-stats");
+  fail_unless (clients != NULL);
+  fail_unless_equals_int (gst_value_array_get_size (clients), 1);
+  cstats = gst_value_get_structure (gst_value_array_get_value (clients, 0));
+  fail_unless (gst_structure_get_int (cstats, "fd", &fd));
+  fail_unless_equals_int (fd, pfd[1]);
+  fail_unless (histogram_total (cstats, "queue-depth") == 2);
+  gst_structure_free (stats);
+
+  GST_DEBUG ("cleaning up multifdsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_multifdsink (sink);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
 /* FIXME: add test simulating chained oggs where:
  * sync-method is burst-on-connect
  * (when multifdsink actually does burst-on-connect based on byte size, not
@@ -857,9 +1268,15 @@ multifdsink_suite (void)
   tcase_add_test (tc_chain, test_streamheader);
   tcase_add_test (tc_chain, test_change_streamheader);
   tcase_add_test (tc_chain, test_burst_client_bytes);
+  tcase_add_test (tc_chain, test_burst_client_batched);
   tcase_add_test (tc_chain, test_burst_client_bytes_keyframe);
   tcase_add_test (tc_chain, test_burst_client_bytes_with_keyframe);
   tcase_add_test (tc_chain, test_client_next_keyframe);
+  tcase_add_test (tc_chain, test_client_latest_keyframe_wrapped);
+  tcase_add_test (tc_chain, test_burst_client_keyframe_wrapped);
+  tcase_add_test (tc_chain, test_io_threads);
+  tcase_add_test (tc_chain, test_zerocopy_fallback);
+  tcase_add_test (tc_chain, test_histograms);
 
   return s;
 }
@@ -0,0 +1,481 @@
+/* GStreamer
+ *
+ * unit test for tcpclientsink
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <gst/check/gstcheck.h>
+
+/* values of GstTCPOverflowPolicy */
+#define OVERFLOW_BLOCK            0
+#define OVERFLOW_DROP_OLDEST      1
+#define OVERFLOW_DROP_TO_KEYFRAME 2
+
+static GstPad *mysrcpad;
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-gst-check")
+    );
+
+/* a listening socket on the loopback device for the sink to connect to. The
+ * receive buffer is kept small so that the queue of the sink fills up
+ * quickly when nobody reads. */
+static gint
+setup_server (gint * port)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof (sin);
+  gint fd, rcvbuf = 16 * 1024;
+
+  fd = socket (AF_INET, SOCK_STREAM, 0);
+  fail_if (fd < 0);
+  fail_if (setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+          sizeof (rcvbuf)) < 0);
+
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = inet_addr ("127.0.0.1");
+  sin.sin_port = 0;
+  fail_if (bind (fd, (struct sockaddr *) &sin, sizeof (sin)) < 0);
+  fail_if (listen (fd, 1) < 0);
+  fail_if (getsockname (fd, (struct sockaddr *) &sin, &len) < 0);
+  *port = ntohs (sin.sin_port);
+
+  return fd;
+}
+
+static GstElement *
+setup_tcpclientsink (gint port)
+{
+  GstElement *sink;
+
+  GST_DEBUG ("setup_tcpclientsink");
+  sink = gst_check_setup_element ("tcpclientsink");
+  mysrcpad = gst_check_setup_src_pad (sink, &srctemplate, NULL);
+  g_object_set (sink, "host", "127.0.0.1", "port", port, "blocking", FALSE,
+      NULL);
+
+  return sink;
+}
+
+static void
+cleanup_tcpclientsink (GstElement * sink)
+{
+  GST_DEBUG ("cleanup_tcpclientsink");
+
+  gst_check_teardown_src_pad (sink);
+  gst_check_teardown_element (sink);
+}
+
+static GstBuffer *
+make_buffer (GstCaps * caps, gint size, guint8 val, gboolean keyframe)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_buffer_new_and_alloc (size);
+  if (size > 0)
+    memset (GST_BUFFER_DATA (buffer), val, size);
+  if (!keyframe)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  gst_buffer_set_caps (buffer, caps);
+
+  return buffer;
+}
+
+typedef struct
+{
+  gint fd;
+  guint64 bytes;
+  gint buffer_size;
+  gboolean in_order;
+} Reader;
+
+/* reads until the sink closes the connection and checks that the buffers,
+ * filled with their index, arrive whole and in order */
+static gpointer
+reader_thread (Reader * reader)
+{
+  guint8 *data;
+  gint prev = -1;
+
+  data = g_malloc (reader->buffer_size);
+  reader->in_order = TRUE;
+  while (TRUE) {
+    gint got = 0;
+
+    while (got < reader->buffer_size) {
+      gssize r = read (reader->fd, data + got, reader->buffer_size - got);
+
+      if (r <= 0)
+        goto done;
+      got += r;
+    }
+    reader->bytes += got;
+
+    if (data[0] <= prev || data[0] != data[reader->buffer_size - 1])
+      reader->in_order = FALSE;
+    prev = data[0];
+  }
+done:
+  g_free (data);
+
+  return NULL;
+}
+
+GST_START_TEST (test_zero_size_buffer)
+{
+  GstElement *sink;
+  GstCaps *caps;
+  gint server, client, port;
+  gchar data[4];
+
+  server = setup_server (&port);
+  sink = setup_tcpclientsink (port);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+  client = accept (server, NULL, NULL);
+  fail_if (client < 0);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+
+  /* an empty buffer must not stall the writer or the EOS below */
+  fail_unless (gst_pad_push (mysrcpad, make_buffer (caps, 0, 0,
+              TRUE)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  fail_unless (gst_pad_push (mysrcpad, make_buffer (caps, 0, 0,
+              TRUE)) == GST_FLOW_UNEXPECTED);
+
+  GST_DEBUG ("cleaning up tcpclientsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpclientsink (sink);
+
+  /* nothing was sent */
+  fail_unless (read (client, data, 4) == 0);
+
+  close (client);
+  close (server);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_eos_drains_queue)
+{
+  GstElement *sink;
+  GstCaps *caps;
+  GThread *thread;
+  Reader reader = { 0, };
+  gint server, port, i;
+  guint64 dropped;
+
+  server = setup_server (&port);
+  sink = setup_tcpclientsink (port);
+  g_object_set (sink, "buffers-max", 2, "overflow-policy", OVERFLOW_BLOCK,
+      NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+  reader.fd = accept (server, NULL, NULL);
+  fail_if (reader.fd < 0);
+  reader.buffer_size = 64 * 1024;
+  thread = g_thread_create ((GThreadFunc) reader_thread, &reader, TRUE, NULL);
+  fail_unless (thread != NULL);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+
+  /* empty buffers in between must not confuse the writer */
+  for (i = 0; i < 64; i++) {
+    fail_unless (gst_pad_push (mysrcpad, make_buffer (caps,
+                reader.buffer_size, i, TRUE)) == GST_FLOW_OK);
+    fail_unless (gst_pad_push (mysrcpad, make_buffer (caps, 0, 0,
+                TRUE)) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* everything was written when the EOS returned */
+  g_object_get (sink, "buffers-dropped", &dropped, NULL);
+  fail_unless (dropped == 0);
+
+  GST_DEBUG ("cleaning up tcpclientsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpclientsink (sink);
+
+  g_thread_join (thread);
+  fail_unless (reader.bytes == 64 * reader.buffer_size);
+  fail_unless (reader.in_order);
+
+  close (reader.fd);
+  close (server);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+/* push buffer lists with groups of one, two and three parts of a buffer and
+ * check that every group arrives whole and in order */
+static void
+check_buffer_list (gboolean blocking)
+{
+  GstElement *sink;
+  GstCaps *caps;
+  GThread *thread;
+  Reader reader = { 0, };
+  gint server, port, i;
+
+  server = setup_server (&port);
+  sink = setup_tcpclientsink (port);
+  g_object_set (sink, "blocking", blocking, "buffers-max", 2,
+      "overflow-policy", OVERFLOW_BLOCK, NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+  reader.fd = accept (server, NULL, NULL);
+  fail_if (reader.fd < 0);
+  reader.buffer_size = 48 * 1024;
+  thread = g_thread_create ((GThreadFunc) reader_thread, &reader, TRUE, NULL);
+  fail_unless (thread != NULL);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+
+  for (i = 0; i < 60; i += 3) {
+    GstBufferList *list;
+    GstBufferListIterator *it;
+    gint parts, k;
+
+    list = gst_buffer_list_new ();
+    it = gst_buffer_list_iterate (list);
+    for (parts = 1; parts <= 3; parts++) {
+      gst_buffer_list_iterator_add_group (it);
+      for (k = 0; k < parts; k++)
+        gst_buffer_list_iterator_add (it, make_buffer (caps,
+                reader.buffer_size / parts, i + parts - 1, TRUE));
+    }
+    gst_buffer_list_iterator_free (it);
+
+    fail_unless (gst_pad_push_list (mysrcpad, list) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  GST_DEBUG ("cleaning up tcpclientsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpclientsink (sink);
+
+  g_thread_join (thread);
+  fail_unless (reader.bytes == 60 * reader.buffer_size);
+  fail_unless (reader.in_order);
+
+  close (reader.fd);
+  close (server);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_START_TEST (test_buffer_list)
+{
+  check_buffer_list (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffer_list_blocking)
+{
+  check_buffer_list (TRUE);
+}
+
+GST_END_TEST;
+
+/* fill the queue while nobody reads until the sink drops buffers, then check
+ * that everything that was not dropped arrives after the EOS */
+static void
+check_overflow_policy (gint policy)
+{
+  GstElement *sink;
+  GstCaps *caps;
+  GThread *thread;
+  Reader reader = { 0, };
+  gint server, port, pushed;
+  guint64 dropped = 0;
+
+  server = setup_server (&port);
+  sink = setup_tcpclientsink (port);
+  g_object_set (sink, "buffers-max", 2, "overflow-policy", policy, NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+  reader.fd = accept (server, NULL, NULL);
+  fail_if (reader.fd < 0);
+  reader.buffer_size = 256 * 1024;
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+
+  for (pushed = 0; pushed < 200 && dropped == 0; pushed++) {
+    /* a keyframe every 4 buffers */
+    fail_unless (gst_pad_push (mysrcpad, make_buffer (caps,
+                reader.buffer_size, pushed, (pushed % 4) == 0)) == GST_FLOW_OK);
+    g_object_get (sink, "buffers-dropped", &dropped, NULL);
+  }
+  fail_unless (dropped > 0);
+
+  thread = g_thread_create ((GThreadFunc) reader_thread, &reader, TRUE, NULL);
+  fail_unless (thread != NULL);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  g_object_get (sink, "buffers-dropped", &dropped, NULL);
+
+  GST_DEBUG ("cleaning up tcpclientsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpclientsink (sink);
+
+  g_thread_join (thread);
+  fail_unless (reader.bytes == (pushed - dropped) * reader.buffer_size);
+  fail_unless (reader.in_order);
+
+  close (reader.fd);
+  close (server);
+
+  ASSERT_CAPS_REFCOUNT (caps, "caps", 1);
+  gst_caps_unref (caps);
+}
+
+GST_START_TEST (test_overflow_drop_oldest)
+{
+  check_overflow_policy (OVERFLOW_DROP_OLDEST);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_overflow_drop_to_keyframe)
+{
+  check_overflow_policy (OVERFLOW_DROP_TO_KEYFRAME);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstCaps *caps;
+  gint n_buffers;
+  gint buffer_size;
+  GstFlowReturn ret;
+} Pusher;
+
+static gpointer
+pusher_thread (Pusher * pusher)
+{
+  gint i;
+
+  pusher->ret = GST_FLOW_OK;
+  for (i = 0; i < pusher->n_buffers && pusher->ret == GST_FLOW_OK; i++)
+    pusher->ret = gst_pad_push (mysrcpad, make_buffer (pusher->caps,
+            pusher->buffer_size, i, TRUE));
+
+  return NULL;
+}
+
+/* pausing unlocks a render that waits for room in the queue, it must carry
+ * on when we play again instead of returning an error upstream */
+GST_START_TEST (test_pause_resume_full_queue)
+{
+  GstElement *sink;
+  GThread *pthread, *rthread;
+  Pusher pusher = { NULL, };
+  Reader reader = { 0, };
+  gint server, port;
+  guint64 dropped;
+
+  server = setup_server (&port);
+  sink = setup_tcpclientsink (port);
+  g_object_set (sink, "buffers-max", 2, "overflow-policy", OVERFLOW_BLOCK,
+      NULL);
+
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_ASYNC);
+  reader.fd = accept (server, NULL, NULL);
+  fail_if (reader.fd < 0);
+  reader.buffer_size = 256 * 1024;
+
+  /* more than the socket can take while nobody reads, so the pusher ends up
+   * waiting on the full queue */
+  pusher.caps = gst_caps_from_string ("application/x-gst-check");
+  pusher.n_buffers = 64;
+  pusher.buffer_size = reader.buffer_size;
+  pthread = g_thread_create ((GThreadFunc) pusher_thread, &pusher, TRUE, NULL);
+  fail_unless (pthread != NULL);
+  g_usleep (G_USEC_PER_SEC / 4);
+
+  gst_element_set_state (sink, GST_STATE_PAUSED);
+  fail_unless (gst_element_get_state (sink, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  g_usleep (G_USEC_PER_SEC / 10);
+  ASSERT_SET_STATE (sink, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  rthread = g_thread_create ((GThreadFunc) reader_thread, &reader, TRUE, NULL);
+  fail_unless (rthread != NULL);
+
+  g_thread_join (pthread);
+  fail_unless (pusher.ret == GST_FLOW_OK, "push returned %s",
+      gst_flow_get_name (pusher.ret));
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  g_object_get (sink, "buffers-dropped", &dropped, NULL);
+  fail_unless (dropped == 0);
+
+  GST_DEBUG ("cleaning up tcpclientsink");
+  ASSERT_SET_STATE (sink, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpclientsink (sink);
+
+  g_thread_join (rthread);
+  fail_unless (reader.bytes == 64 * reader.buffer_size);
+  fail_unless (reader.in_order);
+
+  close (reader.fd);
+  close (server);
+
+  ASSERT_CAPS_REFCOUNT (pusher.caps, "caps", 1);
+  gst_caps_unref (pusher.caps);
+}
+
+GST_END_TEST;
+
+static Suite *
+tcpclientsink_suite (void)
+{
+  Suite *s = suite_create ("tcpclientsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_zero_size_buffer);
+  tcase_add_test (tc_chain, test_eos_drains_queue);
+  tcase_add_test (tc_chain, test_overflow_drop_oldest);
+  tcase_add_test (tc_chain, test_overflow_drop_to_keyframe);
+  tcase_add_test (tc_chain, test_pause_resume_full_queue);
+  tcase_add_test (tc_chain, test_buffer_list);
+  tcase_add_test (tc_chain, test_buffer_list_blocking);
+
+  return s;
+}
+
+GST_CHECK_MAIN (tcpclientsink);
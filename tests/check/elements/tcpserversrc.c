@@ -0,0 +1,305 @@
+/* GStreamer
+ *
+ * unit test for tcpserversrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/dataprotocol/dataprotocol.h>
+#include <gst/netbuffer/gstnetbuffer.h>
+
+/* values of GstTCPProtocol */
+#define PROTOCOL_NONE 0
+#define PROTOCOL_GDP  1
+
+static GstPad *mysinkpad;
+static GstDPPacketizer *pk;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* find a port on the loopback device that nobody listens on */
+static gint
+get_free_port (void)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof (sin);
+  gint fd, port;
+
+  fd = socket (AF_INET, SOCK_STREAM, 0);
+  fail_if (fd < 0);
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = inet_addr ("127.0.0.1");
+  sin.sin_port = 0;
+  fail_if (bind (fd, (struct sockaddr *) &sin, sizeof (sin)) < 0);
+  fail_if (getsockname (fd, (struct sockaddr *) &sin, &len) < 0);
+  port = ntohs (sin.sin_port);
+  close (fd);
+
+  return port;
+}
+
+static GstElement *
+setup_tcpserversrc (gint port, gint protocol)
+{
+  GstElement *src;
+
+  GST_DEBUG ("setup_tcpserversrc");
+  src = gst_check_setup_element ("tcpserversrc");
+  mysinkpad = gst_check_setup_sink_pad (src, &sinktemplate, NULL);
+  g_object_set (src, "host", "127.0.0.1", "port", port, "protocol", protocol,
+      "max-clients", 4, NULL);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  return src;
+}
+
+static void
+cleanup_tcpserversrc (GstElement * src)
+{
+  GST_DEBUG ("cleanup_tcpserversrc");
+
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_sink_pad (src);
+  gst_check_teardown_element (src);
+}
+
+/* connect to the src, returns the socket and the port it was bound to in
+ * network byte order */
+static gint
+connect_client (gint port, guint16 * client_port)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof (sin);
+  gint fd;
+
+  fd = socket (AF_INET, SOCK_STREAM, 0);
+  fail_if (fd < 0);
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = inet_addr ("127.0.0.1");
+  sin.sin_port = htons (port);
+  fail_if (connect (fd, (struct sockaddr *) &sin, sizeof (sin)) < 0);
+  fail_if (getsockname (fd, (struct sockaddr *) &sin, &len) < 0);
+  *client_port = sin.sin_port;
+
+  return fd;
+}
+
+static void
+write_value (gint fd, guint8 val, gint size)
+{
+  guint8 *data;
+
+  data = g_malloc (size);
+  memset (data, val, size);
+  fail_unless (write (fd, data, size) == size);
+  g_free (data);
+}
+
+/* the number of bytes received from the client on @client_port, checking
+ * that every buffer carries its origin and the value that client sends.
+ * Should be called with the check mutex held. */
+static gint
+bytes_from (guint16 client_port, guint8 val)
+{
+  GList *walk;
+  gint bytes = 0;
+
+  for (walk = buffers; walk; walk = g_list_next (walk)) {
+    GstBuffer *buf = GST_BUFFER_CAST (walk->data);
+    guint32 address;
+    guint16 port;
+    guint i;
+
+    fail_unless (GST_IS_NETBUFFER (buf));
+    fail_unless (gst_netaddress_get_ip4_address (&GST_NETBUFFER (buf)->from,
+            &address, &port));
+    if (port != client_port)
+      continue;
+
+    for (i = 0; i < GST_BUFFER_SIZE (buf); i++)
+      fail_unless (GST_BUFFER_DATA (buf)[i] == val);
+    bytes += GST_BUFFER_SIZE (buf);
+  }
+
+  return bytes;
+}
+
+static void
+wait_bytes_from (guint16 client_port, guint8 val, gint bytes)
+{
+  g_mutex_lock (check_mutex);
+  while (bytes_from (client_port, val) < bytes)
+    g_cond_wait (check_cond, check_mutex);
+  fail_unless (bytes_from (client_port, val) == bytes);
+  g_mutex_unlock (check_mutex);
+}
+
+GST_START_TEST (test_multi_client_disconnect)
+{
+  GstElement *src;
+  gint port, fd1, fd2;
+  guint16 port1, port2;
+
+  port = get_free_port ();
+  src = setup_tcpserversrc (port, PROTOCOL_NONE);
+  ASSERT_SET_STATE (src, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  fd1 = connect_client (port, &port1);
+  fd2 = connect_client (port, &port2);
+
+  write_value (fd1, 'a', 100);
+  write_value (fd2, 'b', 100);
+  wait_bytes_from (port1, 'a', 100);
+  wait_bytes_from (port2, 'b', 100);
+
+  /* the first client goes away, the second one keeps sending */
+  close (fd1);
+  write_value (fd2, 'b', 100);
+  wait_bytes_from (port2, 'b', 200);
+
+  /* and there is room for a new one */
+  fd1 = connect_client (port, &port1);
+  write_value (fd1, 'c', 100);
+  wait_bytes_from (port1, 'c', 100);
+
+  close (fd1);
+  close (fd2);
+
+  ASSERT_SET_STATE (src, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpserversrc (src);
+}
+
+GST_END_TEST;
+
+static void
+write_gdp_caps (gint fd, GstCaps * caps)
+{
+  guint8 *header, *payload;
+  guint len;
+
+  fail_unless (pk->packet_from_caps (caps, 0, &len, &header, &payload));
+  fail_unless (write (fd, header, len) == len);
+  len = gst_dp_header_payload_length (header);
+  fail_unless (write (fd, payload, len) == len);
+  g_free (header);
+  g_free (payload);
+}
+
+/* write the GDP packet of a buffer of @size bytes of @val, but only the
+ * first @part bytes of it */
+static void
+write_gdp_buffer (gint fd, guint8 val, gint size, gint part)
+{
+  GstBuffer *buf;
+  guint8 *header, *packet;
+  guint len;
+
+  buf = gst_buffer_new_and_alloc (size);
+  memset (GST_BUFFER_DATA (buf), val, size);
+  fail_unless (pk->header_from_buffer (buf, 0, &len, &header));
+
+  packet = g_malloc (len + size);
+  memcpy (packet, header, len);
+  memcpy (packet + len, GST_BUFFER_DATA (buf), size);
+  fail_unless (write (fd, packet, part) == part);
+
+  g_free (packet);
+  g_free (header);
+  gst_buffer_unref (buf);
+}
+
+/* a client that stops in the middle of a packet or sends garbage must not
+ * hold up or end the stream of the others */
+GST_START_TEST (test_multi_client_gdp_partial)
+{
+  GstElement *src;
+  GstCaps *caps;
+  gint port, fd1, fd2, i;
+  guint16 port1, port2;
+  gchar data[4];
+
+  gst_dp_init ();
+  pk = gst_dp_packetizer_new (GST_DP_VERSION_1_0);
+
+  port = get_free_port ();
+  src = setup_tcpserversrc (port, PROTOCOL_GDP);
+  ASSERT_SET_STATE (src, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  caps = gst_caps_from_string ("application/x-gst-check");
+
+  fd1 = connect_client (port, &port1);
+  fd2 = connect_client (port, &port2);
+  write_gdp_caps (fd1, caps);
+  write_gdp_caps (fd2, caps);
+
+  /* half a header from the first client */
+  write_gdp_buffer (fd1, 'a', 100, GST_DP_HEADER_LENGTH / 2);
+  for (i = 1; i <= 4; i++) {
+    write_gdp_buffer (fd2, 'b', 100, GST_DP_HEADER_LENGTH + 100);
+    wait_bytes_from (port2, 'b', i * 100);
+  }
+
+  /* garbage from the first client, it gets disconnected */
+  write_value (fd1, 0xff, GST_DP_HEADER_LENGTH);
+  fail_unless (read (fd1, data, 4) == 0);
+
+  write_gdp_buffer (fd2, 'b', 100, GST_DP_HEADER_LENGTH + 100);
+  wait_bytes_from (port2, 'b', 500);
+
+  /* the buffers carry the caps of their client */
+  g_mutex_lock (check_mutex);
+  fail_unless (bytes_from (port1, 'a') == 0);
+  fail_unless (gst_caps_is_equal (GST_BUFFER_CAPS (buffers->data), caps));
+  g_mutex_unlock (check_mutex);
+
+  close (fd1);
+  close (fd2);
+
+  ASSERT_SET_STATE (src, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  cleanup_tcpserversrc (src);
+  gst_caps_unref (caps);
+  gst_dp_packetizer_free (pk);
+}
+
+GST_END_TEST;
+
+static Suite *
+tcpserversrc_suite (void)
+{
+  Suite *s = suite_create ("tcpserversrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_multi_client_disconnect);
+  tcase_add_test (tc_chain, test_multi_client_gdp_partial);
+
+  return s;
+}
+
+GST_CHECK_MAIN (tcpserversrc);
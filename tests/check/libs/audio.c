@@ -27,6 +27,8 @@
 #include <gst/check/gstcheck.h>
 
 #include <gst/audio/audio.h>
+#include <gst/audio/gstaudiosink.h>
+#include <gst/audio/gstaudiosrc.h>
 #include <gst/audio/multichannel.h>
 #include <string.h>
 
@@ -524,6 +526,457 @@ GST_START_TEST (test_channel_layout_value_intersect)
 
 GST_END_TEST;
 
+/* an audio source that produces silence in real time */
+typedef GstAudioSrc GstFooAudioSrc;
+typedef GstAudioSrcClass GstFooAudioSrcClass;
+
+GType gst_foo_audio_src_get_type (void);
+GST_BOILERPLATE (GstFooAudioSrc, gst_foo_audio_src, GstAudioSrc,
+    GST_TYPE_AUDIO_SRC);
+
+static GstStaticPadTemplate foo_src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw-int, "
+        "endianness = (int) BYTE_ORDER, signed = (boolean) TRUE, "
+        "width = (int) 16, depth = (int) 16, "
+        "rate = (int) 44100, channels = (int) 1"));
+
+static gboolean
+gst_foo_audio_src_open (GstAudioSrc * src)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_foo_audio_src_prepare (GstAudioSrc * src, GstRingBufferSpec * spec)
+{
+  return TRUE;
+}
+
+static guint
+gst_foo_audio_src_read (GstAudioSrc * src, gpointer data, guint length)
+{
+  /* 44100 mono samples of 2 bytes per second */
+  g_usleep ((G_USEC_PER_SEC / 2) * (guint64) length / 44100);
+  memset (data, 0, length);
+
+  return length;
+}
+
+static guint
+gst_foo_audio_src_delay (GstAudioSrc * src)
+{
+  return 0;
+}
+
+static void
+gst_foo_audio_src_reset (GstAudioSrc * src)
+{
+}
+
+static void
+gst_foo_audio_src_base_init (gpointer g_class)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&foo_src_template));
+  gst_element_class_set_details_simple (element_class,
+      "Audio Source, FooBar", "Source/Audio",
+      "Produce silence", "Foo Bar <foo@bar.com>");
+}
+
+static void
+gst_foo_audio_src_init (GstFooAudioSrc * src, GstFooAudioSrcClass * klass)
+{
+}
+
+static void
+gst_foo_audio_src_class_init (GstFooAudioSrcClass * klass)
+{
+  klass->open = gst_foo_audio_src_open;
+  klass->prepare = gst_foo_audio_src_prepare;
+  klass->unprepare = gst_foo_audio_src_open;
+  klass->close = gst_foo_audio_src_open;
+  klass->read = gst_foo_audio_src_read;
+  klass->delay = gst_foo_audio_src_delay;
+  klass->reset = gst_foo_audio_src_reset;
+}
+
+static GMutex *pool_mutex;
+static GCond *pool_cond;
+static guint pool_n_buffers;
+static GstBuffer *pool_held;
+
+static void
+pool_handoff_cb (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    gpointer user_data)
+{
+  g_mutex_lock (pool_mutex);
+  /* keep the first buffer when asked to */
+  if (GPOINTER_TO_INT (user_data) && pool_held == NULL)
+    pool_held = gst_buffer_ref (buf);
+  pool_n_buffers++;
+  g_cond_signal (pool_cond);
+  g_mutex_unlock (pool_mutex);
+}
+
+static void
+run_pool_pipeline (GstElement * pipeline, guint n_buffers)
+{
+  GstStateChangeReturn ret;
+
+  ret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  fail_if (ret == GST_STATE_CHANGE_FAILURE);
+
+  g_mutex_lock (pool_mutex);
+  pool_n_buffers = 0;
+  while (pool_n_buffers < n_buffers)
+    g_cond_wait (pool_cond, pool_mutex);
+  g_mutex_unlock (pool_mutex);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_READY) == GST_STATE_CHANGE_SUCCESS);
+}
+
+static void
+get_pool_stats (GstElement * src, guint64 * allocated, guint64 * recycled,
+    guint64 * freed)
+{
+  g_object_get (src, "buffers-allocated", allocated, "buffers-recycled",
+      recycled, "buffers-freed", freed, NULL);
+  GST_DEBUG ("allocated %" G_GUINT64_FORMAT ", recycled %" G_GUINT64_FORMAT
+      ", freed %" G_GUINT64_FORMAT, *allocated, *recycled, *freed);
+}
+
+GST_START_TEST (test_base_audio_src_buffer_pool)
+{
+  GstElement *pipeline, *src, *sink;
+  guint64 allocated, recycled, freed, last_recycled;
+  gulong id;
+
+  fail_unless (gst_element_register (NULL, "fooaudiosrc", GST_RANK_NONE,
+          gst_foo_audio_src_get_type ()));
+
+  pool_mutex = g_mutex_new ();
+  pool_cond = g_cond_new ();
+  pool_held = NULL;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("fooaudiosrc", "src");
+  fail_unless (src != NULL);
+  sink = gst_element_factory_make ("fakesink", "sink");
+  fail_unless (sink != NULL);
+  g_object_set (sink, "signal-handoffs", TRUE, "enable-last-buffer", FALSE,
+      NULL);
+  id = g_signal_connect (sink, "handoff", G_CALLBACK (pool_handoff_cb),
+      GINT_TO_POINTER (FALSE));
+  gst_bin_add_many (GST_BIN (pipeline), src, sink, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  get_pool_stats (src, &allocated, &recycled, &freed);
+  fail_unless (allocated == 0 && recycled == 0 && freed == 0);
+
+  /* fakesink releases the buffers right away, they get reused and all of
+   * them are freed when going to READY */
+  run_pool_pipeline (pipeline, 20);
+  get_pool_stats (src, &allocated, &recycled, &freed);
+  fail_unless (allocated > 0);
+  fail_unless (recycled > 0);
+  fail_unless (freed == allocated);
+  last_recycled = recycled;
+
+  /* the second time a new pool is used, one buffer stays in use */
+  g_signal_handler_disconnect (sink, id);
+  g_signal_connect (sink, "handoff", G_CALLBACK (pool_handoff_cb),
+      GINT_TO_POINTER (TRUE));
+  run_pool_pipeline (pipeline, 20);
+  get_pool_stats (src, &allocated, &recycled, &freed);
+  fail_unless (recycled > last_recycled);
+  fail_unless (pool_held != NULL);
+  fail_unless (freed == allocated - 1);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+
+  /* the buffer outlives the element and its pool */
+  gst_buffer_unref (pool_held);
+
+  g_cond_free (pool_cond);
+  g_mutex_free (pool_mutex);
+}
+
+GST_END_TEST;
+
+/* a master clock that runs SKEW_PERMILLE per mille faster than the system
+ * clock */
+#define SKEW_PERMILLE 3
+
+typedef GstSystemClock GstSkewClock;
+typedef GstSystemClockClass GstSkewClockClass;
+
+GType gst_skew_clock_get_type (void);
+G_DEFINE_TYPE (GstSkewClock, gst_skew_clock, GST_TYPE_SYSTEM_CLOCK);
+
+static GstClockTime
+gst_skew_clock_get_internal_time (GstClock * clock)
+{
+  GstClockTime time;
+
+  time = GST_CLOCK_CLASS (gst_skew_clock_parent_class)->get_internal_time
+      (clock);
+
+  return time + time / 1000 * SKEW_PERMILLE;
+}
+
+static void
+gst_skew_clock_init (GstSkewClock * clock)
+{
+}
+
+static void
+gst_skew_clock_class_init (GstSkewClockClass * klass)
+{
+  GST_CLOCK_CLASS (klass)->get_internal_time = gst_skew_clock_get_internal_time;
+}
+
+/* an audio sink that plays in real time and keeps what it played */
+#define SKEW_RATE 8000
+
+typedef GstAudioSink GstFooAudioSink;
+typedef GstAudioSinkClass GstFooAudioSinkClass;
+
+GType gst_foo_audio_sink_get_type (void);
+G_DEFINE_TYPE (GstFooAudioSink, gst_foo_audio_sink, GST_TYPE_AUDIO_SINK);
+
+static GstStaticPadTemplate foo_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw-float, "
+        "endianness = (int) BYTE_ORDER, width = (int) 64, "
+        "rate = (int) 8000, channels = (int) 1"));
+
+static GMutex *skew_mutex;
+static GCond *skew_cond;
+static GArray *skew_played;
+static GTimeVal skew_start;
+static guint64 skew_n_played;
+
+static gboolean
+gst_foo_audio_sink_open (GstAudioSink * sink)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_foo_audio_sink_prepare (GstAudioSink * sink, GstRingBufferSpec * spec)
+{
+  g_get_current_time (&skew_start);
+  skew_n_played = 0;
+
+  return TRUE;
+}
+
+static guint
+gst_foo_audio_sink_write (GstAudioSink * sink, gpointer data, guint length)
+{
+  const gdouble *samples = data;
+  GTimeVal deadline;
+  guint i, n = length / sizeof (gdouble);
+
+  /* play at the rate of the system clock */
+  skew_n_played += n;
+  deadline = skew_start;
+  g_time_val_add (&deadline, skew_n_played * G_USEC_PER_SEC / SKEW_RATE);
+
+  g_mutex_lock (skew_mutex);
+  /* skip the silence before the data */
+  for (i = 0; i < n; i++) {
+    if (skew_played->len > 0 || samples[i] > 0.0)
+      g_array_append_val (skew_played, samples[i]);
+  }
+  g_cond_signal (skew_cond);
+  g_cond_timed_wait (skew_cond, skew_mutex, &deadline);
+  g_mutex_unlock (skew_mutex);
+
+  return length;
+}
+
+static guint
+gst_foo_audio_sink_delay (GstAudioSink * sink)
+{
+  return 0;
+}
+
+static void
+gst_foo_audio_sink_reset (GstAudioSink * sink)
+{
+}
+
+static void
+gst_foo_audio_sink_init (GstFooAudioSink * sink)
+{
+}
+
+static void
+gst_foo_audio_sink_class_init (GstFooAudioSinkClass * klass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&foo_sink_template));
+  gst_element_class_set_details_simple (element_class,
+      "Audio Sink, FooBar", "Sink/Audio",
+      "Play in real time", "Foo Bar <foo@bar.com>");
+
+  klass->open = gst_foo_audio_sink_open;
+  klass->prepare = gst_foo_audio_sink_prepare;
+  klass->unprepare = gst_foo_audio_sink_open;
+  klass->close = gst_foo_audio_sink_open;
+  klass->write = gst_foo_audio_sink_write;
+  klass->delay = gst_foo_audio_sink_delay;
+  klass->reset = gst_foo_audio_sink_reset;
+}
+
+/* push a ramp, every sample is its own index, so the played samples tell
+ * where in the input the resampler was */
+#define SKEW_SAMPLES_PER_BUFFER 80
+
+static void
+skew_need_data_cb (GstElement * appsrc, guint size, gpointer user_data)
+{
+  static guint64 offset = 0;
+  GstFlowReturn ret;
+  GstBuffer *buf;
+  gdouble *data;
+  guint i;
+
+  if (user_data == NULL) {
+    offset = 0;
+    return;
+  }
+
+  buf = gst_buffer_new_and_alloc (SKEW_SAMPLES_PER_BUFFER * sizeof (gdouble));
+  data = (gdouble *) GST_BUFFER_DATA (buf);
+  for (i = 0; i < SKEW_SAMPLES_PER_BUFFER; i++)
+    data[i] = offset + i + 1;
+  GST_BUFFER_TIMESTAMP (buf) = gst_util_uint64_scale_int (offset, GST_SECOND,
+      SKEW_RATE);
+  GST_BUFFER_DURATION (buf) =
+      gst_util_uint64_scale_int (SKEW_SAMPLES_PER_BUFFER, GST_SECOND,
+      SKEW_RATE);
+  offset += SKEW_SAMPLES_PER_BUFFER;
+
+  g_signal_emit_by_name (appsrc, "push-buffer", buf, &ret);
+  gst_buffer_unref (buf);
+}
+
+/* Verifies that the resample slaving method follows a skewed master clock
+ * with a rate correction that stays within its clamp and settles */
+GST_START_TEST (test_base_audio_sink_resample_slaving)
+{
+  GstElement *pipeline, *src, *sink;
+  GstClock *master;
+  GstClockTime rate_num, rate_denom;
+  GstCaps *caps;
+  gdouble ratio, step, min_step, max_step, sum;
+  guint i, n, first;
+
+  skew_mutex = g_mutex_new ();
+  skew_cond = g_cond_new ();
+  skew_played = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  skew_need_data_cb (NULL, 0, NULL);
+
+  fail_unless (gst_element_register (NULL, "fooaudiosink", GST_RANK_NONE,
+          gst_foo_audio_sink_get_type ()));
+
+  pipeline = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("appsrc", "src");
+  fail_unless (src != NULL);
+  sink = gst_element_factory_make ("fooaudiosink", "sink");
+  fail_unless (sink != NULL);
+
+  caps = gst_caps_from_string ("audio/x-raw-float, "
+      "endianness = (int) BYTE_ORDER, width = (int) 64, "
+      "rate = (int) 8000, channels = (int) 1");
+  g_object_set (src, "caps", caps, "format", GST_FORMAT_TIME, "block", TRUE,
+      "max-bytes", (guint64) 4096, NULL);
+  gst_caps_unref (caps);
+  g_signal_connect (src, "need-data", G_CALLBACK (skew_need_data_cb), src);
+  g_object_set (sink, "slave-method", GST_BASE_AUDIO_SINK_SLAVE_RESAMPLE,
+      NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, sink, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  master = g_object_new (gst_skew_clock_get_type (), NULL);
+  gst_pipeline_use_clock (GST_PIPELINE (pipeline), master);
+
+  fail_if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE);
+
+  /* play four seconds */
+  g_mutex_lock (skew_mutex);
+  while (skew_played->len < 4 * SKEW_RATE)
+    g_cond_wait (skew_cond, skew_mutex);
+  g_mutex_unlock (skew_mutex);
+
+  /* the calibration the sink resamples with */
+  gst_clock_get_calibration (GST_BASE_AUDIO_SINK (sink)->provided_clock, NULL,
+      NULL, &rate_num, &rate_denom);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (rate_num > 0 && rate_denom > 0);
+  ratio = gst_guint64_to_gdouble (rate_denom) /
+      gst_guint64_to_gdouble (rate_num);
+  GST_DEBUG ("clock ratio %f", ratio);
+  /* the calibration found the skew */
+  fail_unless (ABS (ratio - 1.0) > SKEW_PERMILLE / 2000.0);
+  fail_unless (ABS (ratio - 1.0) < SKEW_PERMILLE / 500.0);
+
+  /* in the last two seconds, the played samples advance through the input
+   * without jumps and the rate differs from the clock ratio by at most the
+   * maximum correction of 0.5%, with some room for the calibration to move */
+  n = skew_played->len;
+  first = n - 2 * SKEW_RATE;
+  for (i = first + 1; i < n; i++) {
+    step = g_array_index (skew_played, gdouble, i) -
+        g_array_index (skew_played, gdouble, i - 1);
+    fail_unless (ABS (1.0 / (step * ratio) - 1.0) <= 0.005 + 0.001,
+        "step %f at %u, clock ratio %f", step, i, ratio);
+  }
+
+  /* and in the last second, the correction has settled */
+  first = n - SKEW_RATE;
+  min_step = max_step = g_array_index (skew_played, gdouble, first + 1) -
+      g_array_index (skew_played, gdouble, first);
+  for (i = first + 2; i < n; i++) {
+    step = g_array_index (skew_played, gdouble, i) -
+        g_array_index (skew_played, gdouble, i - 1);
+    min_step = MIN (min_step, step);
+    max_step = MAX (max_step, step);
+  }
+  sum = g_array_index (skew_played, gdouble, n - 1) -
+      g_array_index (skew_played, gdouble, first);
+  GST_DEBUG ("steps between %f and %f, average %f", min_step, max_step,
+      sum / (n - 1 - first));
+  fail_unless (max_step - min_step < 0.002);
+  fail_unless (ABS ((n - 1 - first) / (sum * ratio) - 1.0) < 0.002);
+
+  gst_object_unref (pipeline);
+  gst_object_unref (master);
+  g_array_free (skew_played, TRUE);
+  g_cond_free (skew_cond);
+  g_mutex_free (skew_mutex);
+}
+
+GST_END_TEST;
+
 static Suite *
 audio_suite (void)
 {
@@ -536,6 +989,8 @@ audio_suite (void)
   tcase_add_test (tc_chain, test_buffer_clipping_time);
   tcase_add_test (tc_chain, test_buffer_clipping_samples);
   tcase_add_test (tc_chain, test_channel_layout_value_intersect);
+  tcase_add_test (tc_chain, test_base_audio_src_buffer_pool);
+  tcase_add_test (tc_chain, test_base_audio_sink_resample_slaving);
 
   return s;
 }
@@ -0,0 +1,110 @@
+/* GStreamer
+ *
+ * appsrc-bench.c: measure push-buffer throughput of appsrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#include <stdlib.h>
+
+/*
+ * Pushes many small buffers from the application thread into
+ * appsrc ! fakesink, once with the default locked queue and once with the
+ * lock-free ring, and prints the number of buffers per second for both.
+ *
+ * usage: appsrc-bench [num-buffers] [buffer-size]
+ */
+
+static gdouble
+run (gboolean lock_free, guint num_buffers, guint size)
+{
+  GstElement *pipeline, *appsrc;
+  GstMessage *msg;
+  GstBus *bus;
+  GTimer *timer;
+  gdouble elapsed;
+  guint i;
+
+  pipeline = gst_parse_launch ("appsrc name=src ! fakesink sync=false", NULL);
+  g_assert (pipeline);
+
+  appsrc = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_set (appsrc, "lock-free", lock_free, "block", TRUE,
+      "emit-signals", FALSE, "max-bytes", (guint64) 256 * size, NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  timer = g_timer_new ();
+  for (i = 0; i < num_buffers; i++) {
+    GstBuffer *buffer;
+
+    buffer = gst_buffer_new_and_alloc (size);
+    if (gst_app_src_push_buffer (GST_APP_SRC (appsrc), buffer) != GST_FLOW_OK)
+      g_error ("push-buffer failed");
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (appsrc));
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    g_error ("pipeline posted an error");
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  g_timer_destroy (timer);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (appsrc);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  guint num_buffers = 1000000, size = 64;
+  gdouble locked, lock_free;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    num_buffers = atoi (argv[1]);
+  if (argc > 2)
+    size = atoi (argv[2]);
+
+  g_print ("pushing %u buffers of %u bytes\n", num_buffers, size);
+
+  locked = run (FALSE, num_buffers, size);
+  g_print ("locked queue:    %.3f s, %.0f buffers/s\n", locked,
+      num_buffers / locked);
+
+  lock_free = run (TRUE, num_buffers, size);
+  g_print ("lock-free ring:  %.3f s, %.0f buffers/s\n", lock_free,
+      num_buffers / lock_free);
+
+  return 0;
+}